@@ -0,0 +1,24 @@
+/**
+ * This program restores the .dat file a voltage archive was created from.
+ *
+ * Usage: blink_archive_to_dat <input archive> <output .dat> [n_threads]
+*/
+#include <iostream>
+#include <string>
+#include "../src/voltage_archive.hpp"
+
+
+int main(int argc, char **argv){
+    if(argc < 3){
+        std::cerr << "Usage: " << argv[0] << " <input archive> <output .dat> [n_threads]" << std::endl;
+        return 1;
+    }
+    try{
+        const unsigned int nThreads {argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) : 1u};
+        archive_to_dat(argv[1], argv[2], nThreads);
+    }catch(const std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
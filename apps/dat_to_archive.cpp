@@ -0,0 +1,77 @@
+/**
+ * This program compresses a .dat file of MWA VCS voltages into a chunked voltage archive, which can
+ * be read by all the AstroIO .dat readers in its place and accessed randomly by timestep.
+ *
+ * Usage: blink_dat_to_archive [-c codec] [-l level] [-t timesteps_per_chunk] [-n threads]
+ *      [-a antennas] [-f channels] <input .dat> <output archive>
+*/
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <unistd.h>
+#include "../src/astroio.hpp"
+#include "../src/voltage_archive.hpp"
+
+
+namespace {
+    void print_usage(const char *program){
+        std::cerr << "Usage: " << program << " [-c codec] [-l level] [-t timesteps_per_chunk] [-n threads]"
+            " [-a antennas] [-f channels] <input .dat> <output archive>\n"
+            "\t-c: zstd, zlib or none (default: " << archive_codec_name(default_archive_codec()) << ").\n"
+            "\t-l: compression level (default: the codec's default).\n"
+            "\t-t: timesteps in each compressed chunk (default: 100).\n"
+            "\t-n: number of compressing threads (default: 1).\n"
+            "\t-a, -f: antennas and fine channels in the file (default: MWA VCS, 128 and 128).\n"
+            "Two polarizations per antenna are assumed." << std::endl;
+    }
+}
+
+
+
+int main(int argc, char **argv){
+    ArchiveWriteOptions options;
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    int opt;
+    try{
+        while((opt = getopt(argc, argv, "c:l:t:n:a:f:")) != -1){
+            switch(opt){
+                case 'c':
+                    if(!strcmp(optarg, "zstd")) options.codec = ArchiveCodec::ZSTD;
+                    else if(!strcmp(optarg, "zlib")) options.codec = ArchiveCodec::ZLIB;
+                    else if(!strcmp(optarg, "none")) options.codec = ArchiveCodec::NONE;
+                    else throw std::invalid_argument {std::string {"unknown codec "} + optarg};
+                    break;
+                case 'l': options.compressionLevel = std::stoi(optarg); break;
+                case 't': options.timestepsPerChunk = std::stoul(optarg); break;
+                case 'n': options.nThreads = std::stoul(optarg); break;
+                case 'a': obsInfo.nAntennas = std::stoul(optarg); break;
+                case 'f': obsInfo.nFrequencies = std::stoul(optarg); break;
+                default:
+                    print_usage(argv[0]);
+                    return 1;
+            }
+        }
+    }catch(const std::exception& ex){
+        std::cerr << "Invalid argument: " << ex.what() << std::endl;
+        return 1;
+    }
+    if(argc - optind != 2){
+        print_usage(argv[0]);
+        return 1;
+    }
+    const size_t bytesPerTimestep {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nFrequencies * obsInfo.nPolarizations};
+    try{
+        auto start = std::chrono::steady_clock::now();
+        dat_to_archive(argv[optind], argv[optind + 1], bytesPerTimestep, options);
+        double elapsed {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+        VoltageArchive archive {argv[optind + 1]};
+        std::cout << "Archived " << archive.n_timesteps() << " timesteps in " << archive.n_chunks() << " "
+            << archive_codec_name(archive.codec()) << " chunks, compression ratio "
+            << static_cast<double>(archive.size()) / archive.compressed_size() << ", " << elapsed << " s." << std::endl;
+    }catch(const std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * Compares voltage archives with the .dat file they are created from, for every codec the library
+ * was built with: compression ratio and speed, time taken by `Voltages::from_dat_file` to read and
+ * expand the whole file, and time to read a single integration interval from the middle of it.
+ * The synthetic .dat file holds roughly gaussian 4-bit samples, as recorded by MWA VCS.
+ *
+ * Usage: blink_archive_bench <work_dir> [n_timesteps] [n_threads]
+*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "../src/astroio.hpp"
+#include "../src/voltage_archive.hpp"
+#include "common.hpp"
+
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <work_dir> [n_timesteps] [n_threads]" << std::endl;
+        return 1;
+    }
+    ObservationInfo obs_info {VCS_OBSERVATION_INFO};
+    obs_info.nTimesteps = argc > 2 ? std::stoul(argv[2]) : 5000u;
+    const unsigned int n_threads {argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) : 4u};
+    const unsigned int n_integration_steps {100};
+    const size_t bytes_per_timestep {static_cast<size_t>(obs_info.nAntennas) * obs_info.nFrequencies * obs_info.nPolarizations};
+    const size_t n_bytes {obs_info.nTimesteps * bytes_per_timestep};
+    const std::string dat_file {std::string {argv[1]} + "/archive_bench_synthetic.dat"};
+    const std::string archive_file {std::string {argv[1]} + "/archive_bench_synthetic.vca"};
+    write_synthetic_dat_file(dat_file, obs_info, SyntheticSamples::GAUSSIAN_NOISE);
+
+    std::vector<std::pair<std::string, std::string>> inputs {{"dat", dat_file}};
+    for(auto codec : {ArchiveCodec::NONE, ArchiveCodec::ZLIB, ArchiveCodec::ZSTD}){
+        if(!archive_codec_available(codec)) continue;
+        const std::string filename {archive_file + "." + archive_codec_name(codec)};
+        ArchiveWriteOptions options;
+        options.codec = codec;
+        options.nThreads = n_threads;
+        double elapsed {best_time(1, [&](){ dat_to_archive(dat_file, filename, bytes_per_timestep, options); })};
+        VoltageArchive archive {filename};
+        std::cout << archive_codec_name(codec) << ": compression ratio " << static_cast<double>(n_bytes) / archive.compressed_size()
+            << ", compressed with " << n_threads << " threads at " << n_bytes / elapsed / 1e6 << " MB/s" << std::endl;
+        inputs.push_back({std::string {"archive, "} + archive_codec_name(codec), filename});
+    }
+
+    for(const auto& input : inputs){
+        for(unsigned int threads : {1u, n_threads}){
+            DatReadOptions options;
+            options.nThreads = threads;
+            double elapsed {best_time(1, [&](){ Voltages::from_dat_file(input.second, obs_info, n_integration_steps, options); })};
+            std::cout << "from_dat_file (" << input.first << ", " << threads << " threads): " << elapsed << " s, "
+                << n_bytes / elapsed / 1e6 << " MB/s" << std::endl;
+        }
+        DatReadOptions options;
+        options.firstTimestep = obs_info.nTimesteps / 2;
+        options.nTimesteps = n_integration_steps;
+        double elapsed {best_time(1, [&](){ Voltages::from_dat_file(input.second, obs_info, n_integration_steps, options); })};
+        std::cout << "one interval from the middle (" << input.first << "): " << elapsed * 1e3 << " ms" << std::endl;
+    }
+    for(const auto& input : inputs) std::remove(input.second.c_str());
+    return 0;
+}
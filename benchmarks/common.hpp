@@ -0,0 +1,63 @@
+#ifndef __BENCHMARKS_COMMON_H__
+#define __BENCHMARKS_COMMON_H__
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include "../src/astroio.hpp"
+
+
+/**
+ * @brief Distribution of the 4-bit samples of a synthetic .dat file.
+ *  - UNIFORM_BYTES: uniformly distributed bytes, i.e. every 4+4 bit sample equally likely;
+ *  - GAUSSIAN_NOISE: roughly gaussian samples, as recorded by MWA VCS.
+ */
+enum class SyntheticSamples {UNIFORM_BYTES, GAUSSIAN_NOISE};
+
+
+/**
+ * @brief Write a .dat file with the shape of `obs_info` filled with `samples`, one timestep at a time.
+ * The content only depends on the arguments.
+ */
+inline void write_synthetic_dat_file(const std::string& filename, const ObservationInfo& obs_info, SyntheticSamples samples){
+    const size_t bytes_per_timestep {static_cast<size_t>(obs_info.nFrequencies) * obs_info.nAntennas * obs_info.nPolarizations};
+    std::vector<char> timestep_data(bytes_per_timestep);
+    std::mt19937 gen {42};
+    std::uniform_int_distribution<int> uniform {0, 255};
+    // Sums of uniform values, close enough to gaussian noise for the RFI detector to flag little of it.
+    auto nibble = [&gen](){
+        int v {0};
+        for(int i {0}; i < 4; i++) v += static_cast<int>(gen() % 5) - 2;
+        return v & 0xf;
+    };
+    std::ofstream out {filename, std::ios::binary};
+    for(size_t t {0}; t < obs_info.nTimesteps; t++){
+        for(auto& b : timestep_data)
+            b = static_cast<char>(samples == SyntheticSamples::UNIFORM_BYTES ? uniform(gen) : nibble() | (nibble() << 4));
+        out.write(timestep_data.data(), bytes_per_timestep);
+    }
+    if(!out) throw std::runtime_error {"write_synthetic_dat_file: error while writing " + filename};
+}
+
+
+/**
+ * @brief Shortest wall clock time, in seconds, of `n_repeats` runs of `fn`.
+ */
+inline double best_time(unsigned int n_repeats, std::function<void()> fn){
+    double best {0};
+    for(unsigned int r {0}; r < n_repeats; r++){
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double elapsed {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+        best = r == 0 ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
+
+#endif
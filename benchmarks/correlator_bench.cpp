@@ -0,0 +1,70 @@
+/**
+ * Measures the throughput of the CPU correlator, `correlate`, on synthetic voltages with the shape of a
+ * MWA VCS coarse channel: 128 tiles, 2 polarizations and 128 fine channels. Each kernel the CPU supports
+ * is run on `n_threads` threads and the best of `n_repeats` runs is reported in GOPS, counting the 8 real
+ * operations of a complex multiply-add for each baseline, polarization pair, channel and timestep.
+ *
+ * Usage: blink_correlator_bench [n_timesteps] [n_integration_steps] [n_repeats] [n_threads]
+*/
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include "../src/astroio.hpp"
+#include "../src/correlation.hpp"
+
+
+namespace {
+
+    Voltages synthetic_voltages(const ObservationInfo& obs_info, unsigned int n_integration_steps){
+        const size_t n_intervals {(obs_info.nTimesteps + n_integration_steps - 1) / n_integration_steps};
+        const size_t n_samples {n_intervals * obs_info.nFrequencies * obs_info.nAntennas * obs_info.nPolarizations * n_integration_steps};
+        MemoryBuffer<std::complex<int8_t>> buffer {n_samples};
+        std::mt19937 gen {42};
+        std::uniform_int_distribution<int> dist {-8, 7};
+        for(size_t i {0}; i < n_samples; i++) buffer.data()[i] = {static_cast<int8_t>(dist(gen)), static_cast<int8_t>(dist(gen))};
+        return Voltages {std::move(buffer), obs_info, n_integration_steps};
+    }
+
+
+    double best_time(unsigned int n_repeats, std::function<void()> fn){
+        double best {0};
+        for(unsigned int r {0}; r < n_repeats; r++){
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            double elapsed {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+            best = r == 0 ? elapsed : std::min(best, elapsed);
+        }
+        return best;
+    }
+}
+
+
+
+int main(int argc, char **argv){
+    ObservationInfo obs_info {VCS_OBSERVATION_INFO};
+    obs_info.nTimesteps = argc > 1 ? std::stoul(argv[1]) : 1000u;
+    const unsigned int n_integration_steps {argc > 2 ? static_cast<unsigned int>(std::stoul(argv[2])) : 100u};
+    const unsigned int n_repeats {argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) : 3u};
+    const unsigned int n_threads {argc > 4 ? static_cast<unsigned int>(std::stoul(argv[4])) : 1u};
+
+    const Voltages voltages {synthetic_voltages(obs_info, n_integration_steps)};
+    const double n_baselines {(obs_info.nAntennas + 1.0) * obs_info.nAntennas / 2};
+    const double n_ops {8.0 * n_baselines * obs_info.nPolarizations * obs_info.nPolarizations * obs_info.nFrequencies * obs_info.nTimesteps};
+    CorrelationOptions options;
+    options.nThreads = n_threads;
+
+    std::vector<SimdLevel> levels {SimdLevel::SCALAR};
+    if(detect_simd_level() >= SimdLevel::AVX2) levels.push_back(SimdLevel::AVX2);
+    if(detect_simd_level() >= SimdLevel::AVX512) levels.push_back(SimdLevel::AVX512);
+    for(SimdLevel level : levels){
+        const double elapsed {best_time(n_repeats, [&](){
+            auto visibilities = correlate(voltages, options, level);
+        })};
+        std::cout << "correlate (" << correlation_kernel_name(level) << ", " << n_threads << " threads): " << elapsed << " s, "
+            << n_ops / elapsed / 1e9 << " GOPS" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * Compares reading EDA2 station data straight from a HDF5 file, with `Voltages::from_eda2_hdf5_file`,
+ * against reading the binary dump of the same data with `Voltages::from_eda2_file`. The HDF5 file is
+ * written with chunks of 1024 timesteps and 64 stations, uncompressed and with deflate.
+ *
+ * Usage: blink_eda2_hdf5_bench <work_dir> [n_timesteps] [max_threads]
+*/
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include "../src/astroio.hpp"
+
+#ifdef ASTROIO_USE_HDF5
+#include <hdf5.h>
+
+
+namespace {
+
+    void write_synthetic_hdf5(const std::string& filename, const ObservationInfo& obs_info, const std::vector<int8_t>& samples,
+            bool compress){
+        hsize_t dims[3] {obs_info.nTimesteps, obs_info.nAntennas, obs_info.nPolarizations};
+        hsize_t chunk[3] {1024, 64, obs_info.nPolarizations};
+        hid_t file {H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT)};
+        hid_t group {H5Gcreate2(file, "chan_", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)};
+        hid_t type {H5Tcreate(H5T_COMPOUND, 2)};
+        H5Tinsert(type, "real", 0, H5T_NATIVE_INT8);
+        H5Tinsert(type, "imag", 1, H5T_NATIVE_INT8);
+        hid_t space {H5Screate_simple(3, dims, nullptr)};
+        hid_t plist {H5Pcreate(H5P_DATASET_CREATE)};
+        H5Pset_chunk(plist, 3, chunk);
+        if(compress) H5Pset_deflate(plist, 1);
+        hid_t dataset {H5Dcreate2(group, "data", type, space, H5P_DEFAULT, plist, H5P_DEFAULT)};
+        if(dataset < 0 || H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, samples.data()) < 0)
+            throw std::runtime_error {"write_synthetic_hdf5: error while writing " + filename};
+        H5Dclose(dataset);
+        H5Pclose(plist);
+        H5Sclose(space);
+        H5Tclose(type);
+        H5Gclose(group);
+        H5Fclose(file);
+    }
+}
+
+
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <work_dir> [n_timesteps] [max_threads]" << std::endl;
+        return 1;
+    }
+    const std::string work_dir {argv[1]};
+    ObservationInfo obs_info {EDA2_OBSERVATION_INFO};
+    obs_info.nTimesteps = argc > 2 ? std::stoul(argv[2]) : 65536u;
+    const unsigned int max_threads {argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) : 8u};
+    const unsigned int n_integration_steps {1024};
+
+    std::vector<int8_t> samples(static_cast<size_t>(obs_info.nTimesteps) * obs_info.nAntennas * obs_info.nPolarizations * 2);
+    // Small values, as in real data, so that deflate has something to compress.
+    for(size_t i {0}; i < samples.size(); i++) samples[i] = static_cast<int8_t>(((i * 2654435761u) >> 26) % 16) - 8;
+    const std::string dump_file {work_dir + "/eda2_hdf5_bench.bin"};
+    {
+        std::ofstream out {dump_file, std::ios::binary};
+        out.write(reinterpret_cast<const char*>(samples.data()), samples.size());
+    }
+    const double n_bytes {static_cast<double>(samples.size())};
+
+    for(unsigned int n_threads {1}; n_threads <= max_threads; n_threads *= 2){
+        auto start = std::chrono::steady_clock::now();
+        auto dumped = Voltages::from_eda2_file(dump_file, obs_info, n_integration_steps, n_threads);
+        double elapsed {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+        std::cout << "from_eda2_file (binary dump, " << n_threads << " threads): " << elapsed << " s, "
+            << n_bytes / elapsed / 1e6 << " MB/s" << std::endl;
+    }
+    for(bool compress : {false, true}){
+        const std::string hdf5_file {work_dir + "/eda2_hdf5_bench.h5"};
+        write_synthetic_hdf5(hdf5_file, obs_info, samples, compress);
+        for(unsigned int n_threads {1}; n_threads <= max_threads; n_threads *= 2){
+            Eda2ReadOptions options;
+            options.nThreads = n_threads;
+            auto start = std::chrono::steady_clock::now();
+            auto voltages = Voltages::from_eda2_hdf5_file(hdf5_file, obs_info, n_integration_steps, options);
+            double elapsed {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+            std::cout << "from_eda2_hdf5_file (" << (compress ? "deflate" : "uncompressed") << ", " << n_threads << " threads): "
+                << elapsed << " s, " << n_bytes / elapsed / 1e6 << " MB/s" << std::endl;
+        }
+        std::remove(hdf5_file.c_str());
+    }
+    std::remove(dump_file.c_str());
+    return 0;
+}
+
+#else
+
+int main(void){
+    std::cerr << "blink_eda2_hdf5_bench: the library was built without HDF5 support." << std::endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * Benchmarks for Voltages::from_memory, the reordering of 8+8 bit voltages held in memory (e.g. the
+ * xGPU test inputs) into the correlator layout. The blocked transpose is compared with the original
+ * sample by sample reordering on:
+ *  - the xGPU test input `input_array_128_128_128_100.bin`, if a path to it is given;
+ *  - a synthetic buffer of 10000 timesteps, 128 antennas, 128 channels and 2 polarizations.
+ *
+ * Packed 4+4 bit buffers are also read with `Voltages::from_packed_memory` and compared with unpacking
+ * them to a temporary 8+8 bit buffer first, and read as 16-bit and float samples.
+ *
+ * Usage: blink_from_memory_bench [n_repeats] [xgpu_input_file]
+*/
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "../src/astroio.hpp"
+#include "../src/utils.hpp"
+#include "../src/voltage_expansion.hpp"
+#include "../src/sample_conversion.hpp"
+
+
+namespace {
+
+    void run_benchmark(const std::string& name, size_t n_bytes, unsigned int n_repeats, std::function<void()> fn){
+        using namespace std::chrono;
+        for(unsigned int r {0}; r < n_repeats; r++){
+            auto start = high_resolution_clock::now();
+            fn();
+            auto stop = high_resolution_clock::now();
+            double elapsed {duration_cast<duration<double>>(stop - start).count()};
+            std::cout << name << " [" << r << "]: " << elapsed << " s, " << (n_bytes / elapsed / 1e9) << " GB/s" << std::endl;
+        }
+    }
+
+
+    // The reordering loop `from_memory` used before the blocked transpose, kept as a baseline.
+    std::vector<std::complex<int8_t>> naive_from_memory(const int8_t *buffer, const ObservationInfo& obs_info, unsigned int n_integration_steps){
+        const size_t samples_in_antenna {n_integration_steps * static_cast<size_t>(obs_info.nPolarizations)};
+        const size_t samples_in_frequency {samples_in_antenna * obs_info.nAntennas};
+        const size_t samples_in_time_interval {samples_in_frequency * obs_info.nFrequencies};
+        const size_t n_intervals {(obs_info.nTimesteps + n_integration_steps - 1) / n_integration_steps};
+        std::vector<std::complex<int8_t>> voltages(n_intervals * samples_in_time_interval);
+        size_t sample_idx {0};
+        for(size_t ts {0}; ts < obs_info.nTimesteps; ts++){
+            const size_t interval {ts / n_integration_steps};
+            const size_t step {ts % n_integration_steps};
+            for(size_t ch {0}; ch < obs_info.nFrequencies; ch++){
+                for(size_t a {0}; a < obs_info.nAntennas; a++){
+                    const size_t out_index {interval * samples_in_time_interval + ch * samples_in_frequency + a * samples_in_antenna};
+                    for(size_t p {0}; p < obs_info.nPolarizations; p++, sample_idx += 2)
+                        voltages[out_index + p * n_integration_steps + step] = {buffer[sample_idx], buffer[sample_idx + 1]};
+                }
+            }
+        }
+        return voltages;
+    }
+
+
+    void benchmark_buffer(const std::string& label, const int8_t *buffer, size_t length, const ObservationInfo& obs_info,
+            unsigned int n_integration_steps, unsigned int n_repeats){
+        std::cout << "--- " << label << ": " << obs_info.nTimesteps << " timesteps, " << length / 1e6 << " MB" << std::endl;
+        run_benchmark("naive reordering", length, n_repeats, [&](){
+            auto volt = naive_from_memory(buffer, obs_info, n_integration_steps);
+        });
+        const unsigned int max_threads {std::max(1u, std::thread::hardware_concurrency())};
+        for(unsigned int n_threads {1}; n_threads <= max_threads; n_threads *= 2){
+            for(bool streaming : {false, true}){
+                run_benchmark("from_memory (" + std::to_string(n_threads) + " threads" + (streaming ? ", non-temporal stores)" : ")"),
+                        length, n_repeats, [&](){
+                    auto volt = Voltages::from_memory(buffer, length, obs_info, n_integration_steps, false, n_threads, streaming);
+                });
+            }
+        }
+    }
+}
+
+
+
+int main(int argc, char **argv){
+    const unsigned int n_repeats {argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 3u};
+
+    if(argc > 2){
+        char *input;
+        size_t input_size;
+        read_data_from_file(argv[2], input, input_size);
+        if(!input) return 1;
+        ObservationInfo obs_info {VCS_OBSERVATION_INFO};
+        obs_info.nAntennas = 128;
+        obs_info.nFrequencies = 128;
+        obs_info.nPolarizations = 2;
+        obs_info.nTimesteps = 100;
+        benchmark_buffer("xGPU test input", reinterpret_cast<int8_t*>(input), input_size, obs_info, 100, n_repeats);
+        delete[] input;
+    }
+
+    ObservationInfo obs_info {VCS_OBSERVATION_INFO};
+    obs_info.nAntennas = 128;
+    obs_info.nFrequencies = 128;
+    obs_info.nPolarizations = 2;
+    obs_info.nTimesteps = 10000;
+    const size_t length {static_cast<size_t>(obs_info.nTimesteps) * obs_info.nFrequencies * obs_info.nAntennas * obs_info.nPolarizations * 2};
+    std::vector<int8_t> buffer(length);
+    std::mt19937 gen {42};
+    for(auto& b : buffer) b = static_cast<int8_t>(gen());
+    for(unsigned int n_integration_steps : {100u, 128u, 10000u})
+        benchmark_buffer("synthetic, " + std::to_string(n_integration_steps) + " integration steps", buffer.data(), length,
+            obs_info, n_integration_steps, n_repeats);
+
+    // The same bytes, interpreted as packed samples.
+    const uint8_t *packed {reinterpret_cast<const uint8_t*>(buffer.data())};
+    const size_t packed_length {length / 2};
+    const unsigned int n_integration_steps {100u};
+    std::cout << "--- packed 4+4 bit samples: " << obs_info.nTimesteps << " timesteps, " << packed_length / 1e6 << " MB" << std::endl;
+    run_benchmark("unpack to a temporary buffer + from_memory", packed_length, n_repeats, [&](){
+        MemoryBuffer<std::complex<int8_t>> unpacked {packed_length};
+        expand_4bit_samples(packed, packed_length, unpacked.data());
+        auto volt = Voltages::from_memory(reinterpret_cast<const int8_t*>(unpacked.data()), length, obs_info, n_integration_steps);
+    });
+    run_benchmark("from_packed_memory", packed_length, n_repeats, [&](){
+        auto volt = Voltages::from_packed_memory(packed, packed_length, obs_info, n_integration_steps);
+    });
+    run_benchmark("from_packed_memory, 16-bit samples", packed_length, n_repeats, [&](){
+        auto volt = BasicVoltages<int16_t>::from_packed_memory(packed, packed_length, obs_info, n_integration_steps);
+    });
+    run_benchmark("from_packed_memory, float samples", packed_length, n_repeats, [&](){
+        auto volt = BasicVoltages<float>::from_packed_memory(packed, packed_length, obs_info, n_integration_steps);
+    });
+    // The conversion alone, per level, on the 8-bit voltages.
+    auto voltages = Voltages::from_packed_memory(packed, packed_length, obs_info, n_integration_steps);
+    const size_t n_values {2 * voltages.MemoryBuffer::size()};
+    std::vector<float> converted(n_values);
+    for(auto level : {SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}){
+        if(level > detect_simd_level()) continue;
+        run_benchmark(std::string {"convert_samples int8 to float, "} + simd_level_name(level), n_values, n_repeats, [&](){
+            convert_samples(reinterpret_cast<const int8_t*>(voltages.data()), converted.data(), n_values, level);
+        });
+    }
+    return 0;
+}
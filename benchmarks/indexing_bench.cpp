@@ -0,0 +1,104 @@
+/**
+ * Benchmarks of the 64-bit indexing of voltage and visibility buffers. Each access pattern is timed
+ * with the library accessors, which index with `size_t`, and with the 32-bit arithmetic they used
+ * before, kept here as a baseline:
+ *  - a sweep over a `MemoryBuffer` with `operator[]`;
+ *  - a sweep over all the baselines of a visibility matrix with `Visibilities::at`;
+ *  - the expansion of .dat samples, the ingest hot loop.
+ *
+ * Usage: blink_indexing_bench [n_repeats]
+*/
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <vector>
+#include "../src/astroio.hpp"
+#include "../src/voltage_expansion.hpp"
+
+
+namespace {
+
+    void run_benchmark(const std::string& name, size_t n_items, unsigned int n_repeats, std::function<void()> fn){
+        using namespace std::chrono;
+        for(unsigned int r {0}; r < n_repeats; r++){
+            auto start = high_resolution_clock::now();
+            fn();
+            auto stop = high_resolution_clock::now();
+            double elapsed {duration_cast<duration<double>>(stop - start).count()};
+            std::cout << name << " [" << r << "]: " << elapsed << " s, " << (elapsed / n_items * 1e9) << " ns/item" << std::endl;
+        }
+    }
+
+
+    // `Visibilities::at` as it was, with 32-bit products.
+    std::complex<float> *at_32bit(Visibilities& vis, unsigned int interval, unsigned int frequency, unsigned int a1, unsigned int a2){
+        const unsigned int n_baselines {((vis.obsInfo.nAntennas + 1) * vis.obsInfo.nAntennas) / 2};
+        const unsigned int matrix_size {n_baselines * vis.obsInfo.nPolarizations * vis.obsInfo.nPolarizations};
+        std::complex<float> *p_data = vis.data() + matrix_size * vis.nFrequencies * interval + matrix_size * frequency;
+        const unsigned int min_a {a1 < a2 ? a1 : a2}, max_a {a1 < a2 ? a2 : a1};
+        const unsigned int baseline {(max_a * (max_a + 1)) / 2 + min_a};
+        return p_data + vis.obsInfo.nPolarizations * vis.obsInfo.nPolarizations * baseline;
+    }
+}
+
+
+
+int main(int argc, char **argv){
+    const unsigned int n_repeats {argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 3u};
+
+    // A sweep over 256 MiB of voltages.
+    const size_t n_samples {size_t {128} << 20};
+    MemoryBuffer<std::complex<int8_t>> buffer {n_samples};
+    std::mt19937 gen {42};
+    for(size_t i {0}; i < n_samples; i++) buffer[i] = {static_cast<int8_t>(gen()), static_cast<int8_t>(gen())};
+    volatile long sink {0};
+    run_benchmark("MemoryBuffer::operator[], int index (baseline)", n_samples, n_repeats, [&](){
+        long sum {0};
+        const std::complex<int8_t> *data {buffer.data()};
+        for(int i {0}; i < static_cast<int>(n_samples); i++) sum += data[i].real() * data[i].imag();
+        sink = sum;
+    });
+    run_benchmark("MemoryBuffer::operator[], size_t index", n_samples, n_repeats, [&](){
+        long sum {0};
+        for(size_t i {0}; i < n_samples; i++) sum += buffer[i].real() * buffer[i].imag();
+        sink = sum;
+    });
+
+    // All the baselines of a MWA Phase II correlation matrix, 32 fine channels.
+    ObservationInfo obs_info {VCS_OBSERVATION_INFO};
+    obs_info.nAntennas = 256;
+    obs_info.nFrequencies = 32;
+    obs_info.nTimesteps = 100;
+    const size_t matrix_size {((static_cast<size_t>(obs_info.nAntennas) + 1) * obs_info.nAntennas) / 2 * 4};
+    MemoryBuffer<std::complex<float>> mb_vis {matrix_size * obs_info.nFrequencies};
+    Visibilities vis {std::move(mb_vis), obs_info, 100, 1};
+    const size_t n_baselines {matrix_size / 4 * obs_info.nFrequencies};
+    run_benchmark("Visibilities::at, 32-bit products (baseline)", n_baselines, n_repeats, [&](){
+        float sum {0};
+        for(unsigned int ch {0}; ch < obs_info.nFrequencies; ch++)
+            for(unsigned int a1 {0}; a1 < obs_info.nAntennas; a1++)
+                for(unsigned int a2 {0}; a2 <= a1; a2++) sum += at_32bit(vis, 0, ch, a1, a2)->real();
+        sink = static_cast<long>(sum);
+    });
+    run_benchmark("Visibilities::at, 64-bit products", n_baselines, n_repeats, [&](){
+        float sum {0};
+        for(unsigned int ch {0}; ch < obs_info.nFrequencies; ch++)
+            for(unsigned int a1 {0}; a1 < obs_info.nAntennas; a1++)
+                for(unsigned int a2 {0}; a2 <= a1; a2++) sum += vis.at(0, ch, a1, a2)->real();
+        sink = static_cast<long>(sum);
+    });
+
+    // The ingest hot loop on a MWA VCS coarse channel, whose timestep count is now 64 bits.
+    ObservationInfo vcs_info {VCS_OBSERVATION_INFO};
+    vcs_info.nTimesteps = 1000;
+    const size_t bytes_per_timestep {static_cast<size_t>(vcs_info.nFrequencies) * vcs_info.nAntennas * vcs_info.nPolarizations};
+    std::vector<uint8_t> packed(vcs_info.nTimesteps * bytes_per_timestep);
+    for(auto& b : packed) b = static_cast<uint8_t>(gen());
+    std::vector<std::complex<int8_t>> expanded(packed.size());
+    run_benchmark("expand_dat_timesteps", packed.size(), n_repeats, [&](){
+        expand_dat_timesteps(packed.data(), 0, vcs_info.nTimesteps, vcs_info, 100, ChannelMask {}, expanded.data());
+    });
+    return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * Benchmarks for the voltage ingest paths. A synthetic .dat file with the shape of a MWA VCS
+ * coarse channel is written to disk and then loaded with each of the available readers.
+ *
+ * Usage: blink_ingest_bench <work_dir> [n_timesteps] [n_repeats]
+ *
+ * The best of `n_repeats` runs of each reader is reported. Note that, after the first run, the file will
+ * most likely be served from the page cache.
+*/
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+#include "../src/astroio.hpp"
+#include "../src/voltage_expansion.hpp"
+#include "../src/voltage_stream.hpp"
+#include "../src/voltage_layout.hpp"
+#include "common.hpp"
+
+
+namespace {
+
+    void run_benchmark(const std::string& name, size_t n_bytes, unsigned int n_repeats, std::function<void()> fn){
+        const double elapsed {best_time(n_repeats, fn)};
+        std::cout << name << " (best of " << n_repeats << "): " << elapsed << " s, " << (n_bytes / elapsed / 1e9) << " GB/s" << std::endl;
+    }
+}
+
+
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <work_dir> [n_timesteps] [n_repeats]" << std::endl;
+        return 1;
+    }
+    const std::string work_dir {argv[1]};
+    ObservationInfo obs_info {VCS_OBSERVATION_INFO};
+    if(argc > 2) obs_info.nTimesteps = std::stoul(argv[2]);
+    const unsigned int n_repeats {argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) : 3u};
+    const unsigned int n_integration_steps {100u};
+
+    const std::string filename {work_dir + "/ingest_bench_synthetic.dat"};
+    write_synthetic_dat_file(filename, obs_info, SyntheticSamples::UNIFORM_BYTES);
+    const size_t n_bytes {static_cast<size_t>(obs_info.nTimesteps) * obs_info.nFrequencies * obs_info.nAntennas * obs_info.nPolarizations};
+
+    for(auto backend : {ReadBackend::BUFFERED, ReadBackend::DIRECT, ReadBackend::IO_URING}){
+        for(unsigned int queue_depth : {1u, 2u, 4u}){
+            DatReadOptions options;
+            options.queueDepth = queue_depth;
+            options.backend = backend;
+            run_benchmark(std::string {"from_dat_file ("} + read_backend_name(backend) + ", queue depth "
+                    + std::to_string(queue_depth) + ")", n_bytes, n_repeats, [&](){
+                auto volt = Voltages::from_dat_file(filename, obs_info, n_integration_steps, options);
+            });
+        }
+    }
+    run_benchmark("from_dat_file_mmap", n_bytes, n_repeats, [&](){
+        auto volt = Voltages::from_dat_file_mmap(filename, obs_info, n_integration_steps);
+    });
+    const unsigned int max_threads {std::max(1u, std::thread::hardware_concurrency())};
+    for(unsigned int n_threads {1}; ; n_threads = std::min(2 * n_threads, max_threads)){
+        run_benchmark("from_dat_file (" + std::to_string(n_threads) + " threads)", n_bytes, n_repeats, [&](){
+            auto volt = Voltages::from_dat_file(filename, obs_info, n_integration_steps, n_threads);
+        });
+        if(n_threads == max_threads) break;
+    }
+
+    {
+        const std::string out_filename {work_dir + "/ingest_bench_written.dat"};
+        Voltages volt {Voltages::from_dat_file(filename, obs_info, n_integration_steps)};
+        run_benchmark("to_dat_file", n_bytes, n_repeats, [&](){
+            volt.to_dat_file(out_filename);
+        });
+        std::remove(out_filename.c_str());
+    }
+
+    run_benchmark("VoltageStream (all intervals)", n_bytes, n_repeats, [&](){
+        using namespace std::chrono;
+        auto start = high_resolution_clock::now();
+        VoltageStream stream {filename, obs_info, n_integration_steps};
+        Voltages interval {stream.allocate_interval()};
+        stream.read_next(interval);
+        std::cout << "VoltageStream time to first interval: "
+            << duration_cast<duration<double>>(high_resolution_clock::now() - start).count() << " s" << std::endl;
+        while(stream.read_next(interval));
+    });
+
+    // Expansion kernels alone, on data already in memory.
+    std::vector<uint8_t> packed(n_bytes);
+    {
+        std::ifstream in {filename, std::ios::binary};
+        in.read(reinterpret_cast<char*>(packed.data()), n_bytes);
+    }
+    const size_t n_intervals {(obs_info.nTimesteps + n_integration_steps - 1) / n_integration_steps};
+    MemoryBuffer<std::complex<int8_t>> expanded {n_intervals * n_integration_steps * n_bytes / obs_info.nTimesteps};
+    for(auto level : {SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}){
+        if(level > detect_simd_level()) continue;
+        run_benchmark(std::string {"expand_dat_timesteps ("} + simd_level_name(level) + ")", n_bytes, n_repeats, [&](){
+            expand_dat_timesteps(packed.data(), 0, obs_info.nTimesteps, obs_info, n_integration_steps, ChannelMask {}, expanded.data(), level);
+        });
+        run_benchmark(std::string {"expand_dat_timesteps with statistics ("} + simd_level_name(level) + ")", n_bytes, n_repeats, [&](){
+            VoltageStatistics statistics {obs_info.nFrequencies, obs_info.nAntennas * obs_info.nPolarizations};
+            expand_dat_timesteps(packed.data(), 0, obs_info.nTimesteps, obs_info, n_integration_steps, ChannelMask {}, expanded.data(), level,
+                std::vector<int> {}, &statistics);
+        });
+    }
+
+    // Layout policies, with dimensions known at runtime and fixed at compile time.
+    const DynamicDims dynamic_dims {DynamicDims::from_observation(obs_info, n_integration_steps)};
+    const VcsDims vcs_dims {VcsDims::from_observation(obs_info, n_integration_steps)};
+    run_benchmark("expand_dat_timesteps (beamformer layout, dynamic dims)", n_bytes, n_repeats, [&](){
+        expand_dat_timesteps(packed.data(), 0, obs_info.nTimesteps, BeamformerLayout<DynamicDims> {dynamic_dims}, expanded.data());
+    });
+    run_benchmark("expand_dat_timesteps (beamformer layout, VCS dims)", n_bytes, n_repeats, [&](){
+        expand_dat_timesteps(packed.data(), 0, obs_info.nTimesteps, BeamformerLayout<VcsDims> {vcs_dims}, expanded.data());
+    });
+    run_benchmark("expand_dat_timesteps (raw layout, VCS dims)", n_bytes, n_repeats, [&](){
+        expand_dat_timesteps(packed.data(), 0, obs_info.nTimesteps, RawLayout<VcsDims> {vcs_dims}, expanded.data());
+    });
+    std::remove(filename.c_str());
+    return 0;
+}
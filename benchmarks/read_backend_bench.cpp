@@ -0,0 +1,73 @@
+/**
+ * Compares the throughput of the raw file read backends (page cache, O_DIRECT, io_uring) on a
+ * large synthetic file. Before each run the file is evicted from the page cache, so that the
+ * buffered backend reads from disk too.
+ *
+ * Usage: blink_read_backend_bench <work_dir> [file_size_GiB] [chunk_MiB] [queue_depth]
+*/
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../src/file_reader.hpp"
+
+
+namespace {
+
+    void write_synthetic_file(const std::string& filename, size_t n_bytes){
+        std::vector<char> block(64 * 1024 * 1024);
+        for(size_t i {0}; i < block.size(); i++) block[i] = static_cast<char>(i * 2654435761u >> 24);
+        std::ofstream out {filename, std::ios::binary};
+        for(size_t written {0}; written < n_bytes; written += block.size())
+            out.write(block.data(), std::min(block.size(), n_bytes - written));
+        if(!out) throw std::runtime_error {"write_synthetic_file: error while writing " + filename};
+    }
+
+
+    void evict_from_page_cache(const std::string& filename){
+        int fd {open(filename.c_str(), O_RDONLY)};
+        if(fd < 0) return;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <work_dir> [file_size_GiB] [chunk_MiB] [queue_depth]" << std::endl;
+        return 1;
+    }
+    const std::string filename {std::string {argv[1]} + "/read_backend_bench_synthetic.bin"};
+    const size_t file_size {static_cast<size_t>((argc > 2 ? std::stod(argv[2]) : 4.0) * (1ull << 30))};
+    const size_t chunk_bytes {(argc > 3 ? std::stoul(argv[3]) : 32ul) << 20};
+    const unsigned int queue_depth {argc > 4 ? static_cast<unsigned int>(std::stoul(argv[4])) : 4u};
+
+    write_synthetic_file(filename, file_size);
+    for(auto backend : {ReadBackend::BUFFERED, ReadBackend::DIRECT, ReadBackend::IO_URING}){
+        evict_from_page_cache(filename);
+        auto reader = open_file_reader(filename, backend);
+        uint64_t checksum {0};
+        auto start = std::chrono::high_resolution_clock::now();
+        reader->read_chunks(0, reader->size(), chunk_bytes, queue_depth, [&](size_t, const uint8_t *data, size_t size){
+            // touch one word per page, so that the consumer costs (almost) nothing.
+            for(size_t i {0}; i + sizeof(uint64_t) <= size; i += 4096){
+                uint64_t word;
+                memcpy(&word, data + i, sizeof(word));
+                checksum += word;
+            }
+        });
+        double elapsed {std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count()};
+        std::cout << read_backend_name(reader->backend()) << " (requested " << read_backend_name(backend) << "): "
+            << elapsed << " s, " << (file_size / elapsed / 1e9) << " GB/s (checksum " << checksum << ")" << std::endl;
+    }
+    std::remove(filename.c_str());
+    return 0;
+}
@@ -0,0 +1,54 @@
+/**
+ * Measures the cost of the spectral kurtosis RFI detector run while a .dat file is expanded: a synthetic
+ * file with the shape of a MWA VCS coarse channel is read with `Voltages::from_dat_file`, without and
+ * with RFI flags, for several block sizes. The best of `n_repeats` runs of each is reported, with the
+ * slowdown relative to the plain read.
+ *
+ * Usage: blink_rfi_bench <work_dir> [n_timesteps] [n_repeats] [n_threads]
+*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include "../src/astroio.hpp"
+#include "common.hpp"
+
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <work_dir> [n_timesteps] [n_repeats] [n_threads]" << std::endl;
+        return 1;
+    }
+    const std::string work_dir {argv[1]};
+    ObservationInfo obs_info {VCS_OBSERVATION_INFO};
+    if(argc > 2) obs_info.nTimesteps = std::stoul(argv[2]);
+    const unsigned int n_repeats {argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) : 5u};
+    const unsigned int n_threads {argc > 4 ? static_cast<unsigned int>(std::stoul(argv[4])) : 1u};
+    const unsigned int n_integration_steps {100u};
+
+    const std::string filename {work_dir + "/rfi_bench_synthetic.dat"};
+    write_synthetic_dat_file(filename, obs_info, SyntheticSamples::GAUSSIAN_NOISE);
+    const double n_bytes {static_cast<double>(obs_info.nTimesteps) * obs_info.nFrequencies * obs_info.nAntennas * obs_info.nPolarizations};
+    DatReadOptions options;
+    options.nThreads = n_threads;
+
+    const double baseline {best_time(n_repeats, [&](){
+        auto volt = Voltages::from_dat_file(filename, obs_info, n_integration_steps, options);
+    })};
+    std::cout << "from_dat_file: " << baseline << " s, " << n_bytes / baseline / 1e9 << " GB/s" << std::endl;
+    for(unsigned int block_size : {25u, 50u, 100u}){
+        options.kurtosisBlockSize = block_size;
+        size_t n_flagged {0};
+        const double elapsed {best_time(n_repeats, [&](){
+            RfiMask rfi_mask;
+            auto volt = Voltages::from_dat_file(filename, obs_info, n_integration_steps, options, rfi_mask);
+            n_flagged = rfi_mask.count();
+        })};
+        std::cout << "from_dat_file with RFI flags (blocks of " << block_size << " timesteps): " << elapsed << " s, "
+            << n_bytes / elapsed / 1e9 << " GB/s, slowdown " << (elapsed / baseline - 1) * 100 << "%, "
+            << n_flagged << " flags" << std::endl;
+    }
+    std::remove(filename.c_str());
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * Measures the throughput of `Voltages::from_sub_file` on a synthetic MWAX subfile with the real
+ * block structure (256 inputs, 64000 samples per block), reading all the blocks or only a range of
+ * them, with an increasing number of threads.
+ *
+ * Usage: blink_subfile_bench <work_dir> [secs_per_subobs] [max_threads]
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "../src/astroio.hpp"
+#include "../src/mwax_subfile.hpp"
+
+
+namespace {
+
+    void write_synthetic_subfile(const std::string& filename, unsigned int secs_per_subobs){
+        std::stringstream header;
+        header << "HDR_SIZE 4096\nOBS_ID 1324440018\nMODE MWAX_VCS\nNBIT 8\nNPOL 2\nNTIMESAMPLES 64000\nNINPUTS 256\n"
+            << "COARSE_CHANNEL 169\nSECS_PER_SUBOBS " << secs_per_subobs << "\nUNIXTIME 1640491199\nSAMPLE_RATE 1280000\n";
+        std::vector<char> block(4096, 0);
+        memcpy(block.data(), header.str().data(), header.str().size());
+        std::ofstream out {filename, std::ios::binary};
+        out.write(block.data(), block.size());
+        block.resize(256 * 64000 * 2);
+        for(size_t i {0}; i < block.size(); i++) block[i] = static_cast<char>(i * 2654435761u >> 24);
+        // the delay block, then the data blocks.
+        for(unsigned int b {0}; b <= secs_per_subobs * 20; b++) out.write(block.data(), block.size());
+        if(!out) throw std::runtime_error {"write_synthetic_subfile: error while writing " + filename};
+    }
+}
+
+
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <work_dir> [secs_per_subobs] [max_threads]" << std::endl;
+        return 1;
+    }
+    const std::string filename {std::string {argv[1]} + "/subfile_bench_synthetic.sub"};
+    const unsigned int secs_per_subobs {argc > 2 ? static_cast<unsigned int>(std::stoul(argv[2])) : 1u};
+    const unsigned int max_threads {argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) : 8u};
+    write_synthetic_subfile(filename, secs_per_subobs);
+    const SubfileInfo info {read_subfile_info(filename)};
+    // e.g. the 10 ms integration time of a fast imaging pipeline.
+    const unsigned int n_integration_steps {12800};
+
+    for(unsigned int n_threads {1}; n_threads <= max_threads; n_threads *= 2){
+        for(size_t n_blocks : {size_t {0}, size_t {4}}){
+            SubfileReadOptions options;
+            options.nThreads = n_threads;
+            options.firstBlock = n_blocks > 0 ? info.nBlocks / 2 : 0;
+            options.nBlocks = n_blocks;
+            auto start = std::chrono::steady_clock::now();
+            auto voltages = Voltages::from_sub_file(filename, n_integration_steps, options);
+            double elapsed {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+            const double n_bytes {static_cast<double>(voltages.obsInfo.nTimesteps) * info.block_bytes() / info.samplesPerBlock};
+            std::cout << "from_sub_file (" << (n_blocks > 0 ? std::to_string(n_blocks) : std::string {"all"}) << " blocks, "
+                << n_threads << " threads): " << elapsed << " s, " << n_bytes / elapsed / 1e6 << " MB/s" << std::endl;
+        }
+    }
+    std::remove(filename.c_str());
+    return 0;
+}
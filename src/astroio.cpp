@@ -6,9 +6,27 @@
 #include <chrono>
 #include <algorithm>
 #include <exception>
+#include <stdexcept>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <cstring>
+#include <cerrno>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "utils.hpp"
 #include "astroio.hpp"
 #include "files.hpp"
+#include "voltage_expansion.hpp"
+#include "sample_conversion.hpp"
+#include "parallel.hpp"
+#include "file_reader.hpp"
+#include "voltage_archive.hpp"
+#include "mwax_subfile.hpp"
+#include "eda2_hdf5.hpp"
 
 extern const ObservationInfo VCS_OBSERVATION_INFO {
     .nAntennas = 128u,
@@ -37,116 +55,412 @@ extern const ObservationInfo EDA2_OBSERVATION_INFO {
 
 namespace {
 
-    int8_t eightBitLookup[65536][4] {};
-    bool lookupInitialized {false};
+    /**
+     * @brief Destination of the samples decoded by the 8-bit kernels, i.e. voltages of sample type `T`
+     * ordered as [integration_interval][frequency][input][time_step].
+     *
+     * 8-bit samples are decoded straight into the output. Samples of the other types are decoded a few
+     * timesteps at a time into a staging buffer of at most `STAGING_TIMESTEPS` timesteps and converted
+     * from there, so that the output is allocated and written once. Writers can be shared by threads.
+     */
+    template <typename T>
+    class SampleWriter {
+        public:
+        static constexpr bool STAGED {!std::is_same<T, int8_t>::value};
+        static constexpr size_t STAGING_TIMESTEPS {32u};
 
+        private:
+        std::complex<T> *output;
+        size_t nChannels;
+        size_t nInputs;
+        unsigned int nIntegrationSteps;
+        SimdLevel level;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<std::complex<int8_t>[]>> spareStaging;
 
-    void build_eight_bit_lookup(){
-        uint32_t index = 0;
-        int value = 0;
-        uint8_t original = 0;
-        uint8_t answer = 0;
-        uint8_t outval = 0;
+        public:
+        SampleWriter(std::complex<T> *output, size_t nChannels, size_t nInputs, unsigned int nIntegrationSteps)
+            : output {output}, nChannels {nChannels}, nInputs {nInputs}, nIntegrationSteps {nIntegrationSteps},
+            level {detect_simd_level()} {}
 
-        for (index=0; index <= 65535; index++){
-            for (outval = 0; outval < 4 ; outval++){
-                original = index >> (outval * 4);
-                original = original & 0xf; // the sample
-                if(original >= 0x8) { // it is a negative number
-                    // https://en.wikipedia.org/wiki/Two%27s_complement#Subtraction_from_2N
-                    value = original - 0x10;
+        /**
+         * @brief Write timesteps [firstTimestep, firstTimestep + nTimesteps) of inputs [firstInput, firstInput + nWritten)
+         * of every channel, all the inputs if `nWritten` is zero, with `decode(out, first, offset, n, stride)`.
+         * It must decode timesteps [offset, offset + n) of the ones requested into timestep `first` of `out`,
+         * ordered as the output but with `stride` steps in each integration interval.
+         */
+        template <typename F>
+        void write(size_t firstTimestep, size_t nTimesteps, F decode, size_t firstInput = 0, size_t nWritten = 0){
+            if(!STAGED){
+                decode(reinterpret_cast<std::complex<int8_t>*>(output), firstTimestep, 0, nTimesteps, nIntegrationSteps);
+                return;
+            }
+            if(nWritten == 0) nWritten = nInputs;
+            std::unique_ptr<std::complex<int8_t>[]> staging;
+            {
+                std::lock_guard<std::mutex> lock {mutex};
+                if(!spareStaging.empty()){
+                    staging = std::move(spareStaging.back());
+                    spareStaging.pop_back();
                 }
-                else {
-                    value = original;
+            }
+            if(!staging) staging.reset(new std::complex<int8_t>[nChannels * nInputs * STAGING_TIMESTEPS]);
+            const size_t samplesInTimeInterval {nChannels * nInputs * nIntegrationSteps};
+            for(size_t t {0}; t < nTimesteps;){
+                const size_t ts {firstTimestep + t};
+                const size_t interval {ts / nIntegrationSteps}, step {ts % nIntegrationSteps};
+                const size_t n {std::min({STAGING_TIMESTEPS, nIntegrationSteps - step, nTimesteps - t})};
+                // the staging buffer holds a single integration interval of `n` steps.
+                decode(staging.get(), 0, t, n, static_cast<unsigned int>(n));
+                for(size_t ch {0}; ch < nChannels; ch++){
+                    for(size_t row {ch * nInputs + firstInput}; row < ch * nInputs + firstInput + nWritten; row++){
+                        convert_samples(reinterpret_cast<const int8_t*>(staging.get() + row * n),
+                            reinterpret_cast<T*>(output + interval * samplesInTimeInterval + row * nIntegrationSteps + step), 2 * n, level);
+                    }
                 }
-                answer = value & 0xff;
-                eightBitLookup[index][outval] = answer;
+                t += n;
             }
+            std::lock_guard<std::mutex> lock {mutex};
+            spareStaging.push_back(std::move(staging));
         }
+    };
+
+
+    template <typename T>
+    constexpr bool SampleWriter<T>::STAGED;
+
+    template <typename T>
+    constexpr size_t SampleWriter<T>::STAGING_TIMESTEPS;
+
+
+
+    /**
+     * @brief Parallel implementation of `Voltages::from_dat_file`. The selected timesteps are split in
+     * `nThreads` disjoint ranges; each thread reads its own range with positional reads, independently
+     * of the others, and expands it into a non-overlapping part of the output with `expand(data, ts, n)`.
+     *
+     * @param firstTimestep: index of the first timestep to read from the file.
+     * @param nTimesteps: number of timesteps to read.
+     * @param outInfo: observation information of the output.
+     * @param blockSize: timesteps are only split among threads at multiples of it, e.g. the blocks of the
+     * RFI detector, which must be expanded by a single thread. It must divide `nIntegrationSteps`.
+     */
+    template <typename T, typename F>
+    void read_dat_file_parallel(FileReader& reader, size_t firstTimestep, size_t nTimesteps, size_t bytesPerTimestep,
+            const ObservationInfo& outInfo, unsigned int nIntegrationSteps, const DatReadOptions& options,
+            std::complex<T> *voltages, F expand, unsigned int blockSize = 1u){
+        const size_t samplesInTimeInterval {nIntegrationSteps * static_cast<size_t>(outInfo.nFrequencies) * outInfo.nAntennas
+            * outInfo.nPolarizations};
+        const size_t nIntegrationIntervals {(outInfo.nTimesteps + nIntegrationSteps - 1)/ nIntegrationSteps };
+        /*
+            When there are enough integration intervals, each thread gets whole intervals and zeroes
+            them itself, so that the output is written by a single thread in contiguous blocks.
+            Otherwise, timesteps are split at multiples of the expansion kernel tile height.
+        */
+        const bool splitByInterval {nIntegrationIntervals >= options.nThreads};
+        size_t granularity {8u};
+        while(granularity % blockSize != 0) granularity += 8u;
+        if(splitByInterval) granularity = nIntegrationSteps;
+        if(!splitByInterval)
+            memset(voltages, 0, sizeof(std::complex<T>) * nIntegrationIntervals * samplesInTimeInterval);
+        parallel_for_ranges(splitByInterval ? nIntegrationIntervals * nIntegrationSteps : nTimesteps, options.nThreads, granularity,
+                [&](size_t begin, size_t end){
+            if(splitByInterval){
+                memset(voltages + (begin / nIntegrationSteps) * samplesInTimeInterval, 0,
+                    sizeof(std::complex<T>) * ((end - begin) / nIntegrationSteps) * samplesInTimeInterval);
+                end = std::min(end, nTimesteps);
+            }
+            if(begin >= end) return;
+            std::vector<uint8_t> buffer(std::min<size_t>(options.timestepsPerRead, end - begin) * bytesPerTimestep);
+            for(size_t ts {begin}; ts < end; ts += options.timestepsPerRead){
+                const size_t nRead {std::min<size_t>(options.timestepsPerRead, end - ts)};
+                reader.read(buffer.data(), nRead * bytesPerTimestep, (firstTimestep + ts) * bytesPerTimestep);
+                expand(buffer.data(), ts, nRead);
+            }
+        });
     }
 }
 
 
 
-Voltages Voltages::from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps){
-    // TODO: fix edge usage.
-    const unsigned int edge {0}, timestepsPerRead {100u};
-    std::ifstream fin;
-    fin.open(filename, std::ios::binary);
-    if(!fin && fin.gcount() == 0){
-        std::cerr << "Error happened when reading the input file." << std::endl;
-        throw std::exception();
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        unsigned int nThreads){
+    DatReadOptions options;
+    options.nThreads = nThreads;
+    return from_dat_file(filename, obsInfo, nIntegrationSteps, options);
+}
+
+
+
+namespace {
+    /**
+     * @brief Input mapping that applies `inputMapping` (empty meaning the identity), then compacts the inputs
+     * of the antennas not in `flaggedAntennas`. Inputs of flagged antennas are mapped to -1, i.e. dropped.
+     */
+    std::vector<int> drop_flagged_antennas(const std::vector<int>& inputMapping, const std::vector<bool>& flaggedAntennas,
+            unsigned int nPolarizations){
+        if(flaggedAntennas.empty()) return inputMapping;
+        std::vector<int> newIndex(flaggedAntennas.size(), -1);
+        int nKept {0};
+        for(size_t a {0}; a < flaggedAntennas.size(); a++)
+            if(!flaggedAntennas[a]) newIndex[a] = nKept++;
+        const size_t nInputs {flaggedAntennas.size() * nPolarizations};
+        std::vector<int> mapping(nInputs);
+        for(size_t j {0}; j < nInputs; j++){
+            const size_t position {inputMapping.empty() ? j : static_cast<size_t>(inputMapping[j])};
+            const int antenna {newIndex[position / nPolarizations]};
+            mapping[j] = antenna < 0 ? -1 : static_cast<int>(antenna * nPolarizations + position % nPolarizations);
+        }
+        return mapping;
     }
-    if(!lookupInitialized) build_eight_bit_lookup();
-    const size_t bytesPerComplexSample {1}; // 4+4 bits 
-    const size_t nSamplesInTimestep {obsInfo.nFrequencies * obsInfo.nAntennas *  obsInfo.nPolarizations};
-    const size_t bytesPerTimestep {nSamplesInTimestep * bytesPerComplexSample};
-    const size_t bytesPerRead {timestepsPerRead * bytesPerTimestep};
-    char* buffer {new char[bytesPerRead]};
-    // We are going to read 2 complex samples at a time, one for each polarization of an antenna.
-    // Each sample is made of 2 4bit data points, that need to be expanded to 8bit data points to be
-    // processed.
-    int8_t expanded[4]; // Temp variable for doing the 4-bit expansion
-    fin.read(buffer, bytesPerRead);
-    long long bytesRead {fin.gcount()};
 
-    // variables used for output indexing
-    const size_t samplesInPol {nIntegrationSteps};
-    const size_t samplesInAntenna {samplesInPol * obsInfo.nPolarizations};
-    const size_t samplesInFrequency {samplesInAntenna * obsInfo.nAntennas};
-    const size_t samplesInTimeInterval {samplesInFrequency * obsInfo.nFrequencies};
-    const size_t nIntegrationIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1)/ nIntegrationSteps };
-    /*
-        We allocate slightly more memory than simply nComplexSamples so we can avoid dealing with
-        the boundary condition happening when obsInfo.nTimesteps % nIntegrationSteps != 0. 
-    */
-    MemoryBuffer<std::complex<int8_t>> mbVoltages {nIntegrationIntervals * samplesInTimeInterval, false, false};
-    auto voltages = mbVoltages.data();
-    memset(voltages, 0, sizeof(std::complex<int8_t>) * nIntegrationIntervals * samplesInTimeInterval);
-
-    size_t currentTimeInterval;
-    size_t currentIntegratorStep;
-    size_t total_timesteps {0};
-    while(bytesRead == bytesPerRead){
-        size_t sample_idx {0};
-        for(size_t ts = 0; ts < timestepsPerRead; ts++, total_timesteps++){
-            currentTimeInterval = total_timesteps / nIntegrationSteps;
-            currentIntegratorStep = total_timesteps % nIntegrationSteps;
-            for(size_t ch = 0; ch < obsInfo.nFrequencies; ch++){
-                for(size_t a = 0; a < obsInfo.nAntennas; a++){
-                    // set edge channels to 0
-                    if(ch < edge || ch >= (obsInfo.nFrequencies - edge)){
-                        for (size_t r = 0; r < 4; r++)
-                            expanded[r] = 0;
-                    }else{
-                        uint16_t rawSamples = *reinterpret_cast<uint16_t*>(&buffer[sample_idx]);
-                        memcpy(expanded, eightBitLookup[rawSamples], 4);
-                    }
-                    // output layout is Time, Frequency, Antenna, Polarization, Integration Step
-                    size_t outIndex = currentTimeInterval * samplesInTimeInterval + ch * samplesInFrequency + a * samplesInAntenna;
-                    voltages[outIndex + currentIntegratorStep].real(expanded[0]);
-                    voltages[outIndex + currentIntegratorStep].imag(expanded[1]);
-                    voltages[outIndex + samplesInPol + currentIntegratorStep].real(expanded[2]);
-                    voltages[outIndex + samplesInPol + currentIntegratorStep].imag(expanded[3]);
-                    
-                    sample_idx += 2; // advances 2 samples at a time
+
+
+    /**
+     * @brief Remove the antennas in `flaggedAntennas` from `obsInfo`, composing `antennaIndices` with any
+     * previous selection.
+     */
+    void keep_antennas(ObservationInfo& obsInfo, const std::vector<bool>& flaggedAntennas){
+        std::vector<unsigned int> indices;
+        for(unsigned int a {0}; a < flaggedAntennas.size(); a++)
+            if(!flaggedAntennas[a]) indices.push_back(obsInfo.antennaIndices.empty() ? a : obsInfo.antennaIndices[a]);
+        obsInfo.nAntennas = indices.size();
+        obsInfo.antennaIndices = std::move(indices);
+    }
+
+
+
+    /**
+     * @brief Implementation of `Voltages::from_dat_file`. Statistics are only computed when `statistics`
+     * is not null, and RFI flags when `rfiMask` is not null.
+     */
+    template <typename T>
+    BasicVoltages<T> read_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+            const DatReadOptions& options, VoltageStatistics *statistics, RfiMask *rfiMask = nullptr){
+        if(nIntegrationSteps == 0) throw std::invalid_argument {"from_dat_file: `nIntegrationSteps` must be positive."};
+        if(options.timestepsPerRead == 0) throw std::invalid_argument {"from_dat_file: `timestepsPerRead` must be positive."};
+        if(options.firstTimestep >= obsInfo.nTimesteps)
+            throw std::invalid_argument {"from_dat_file: `firstTimestep` is past the end of the observation."};
+        for(unsigned int ch : options.channels)
+            if(ch >= obsInfo.nFrequencies) throw std::invalid_argument {"from_dat_file: channel " + std::to_string(ch) + " does not exist."};
+        if(!options.flaggedChannels.empty() && options.flaggedChannels.size() != obsInfo.nFrequencies)
+            throw std::invalid_argument {"from_dat_file: `flaggedChannels` must have one entry per channel."};
+        if(!options.inputMapping.empty()
+                && !is_input_permutation(options.inputMapping, static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations))
+            throw std::invalid_argument {"from_dat_file: `inputMapping` is not a permutation of the inputs."};
+        if(!options.flaggedAntennas.empty() && options.flaggedAntennas.size() != obsInfo.nAntennas)
+            throw std::invalid_argument {"from_dat_file: `flaggedAntennas` must have one entry per antenna."};
+        const std::vector<int> inputMapping {drop_flagged_antennas(options.inputMapping, options.flaggedAntennas, obsInfo.nPolarizations)};
+        std::unique_ptr<FileReader> reader {open_file_reader(filename, options.backend)};
+        const size_t bytesPerComplexSample {1}; // 4+4 bits 
+        const size_t nSamplesInTimestep {static_cast<size_t>(obsInfo.nFrequencies) * obsInfo.nAntennas * obsInfo.nPolarizations};
+        const size_t bytesPerTimestep {nSamplesInTimestep * bytesPerComplexSample};
+        // The output only holds the selected timesteps and channels.
+        ObservationInfo outInfo {obsInfo};
+        const size_t remainingTimesteps {obsInfo.nTimesteps - options.firstTimestep};
+        outInfo.nTimesteps = options.nTimesteps > 0 ? std::min(options.nTimesteps, remainingTimesteps) : remainingTimesteps;
+        if(!options.channels.empty()) outInfo.nFrequencies = options.channels.size();
+        if(!options.flaggedAntennas.empty()) keep_antennas(outInfo, options.flaggedAntennas);
+        const size_t samplesInTimeInterval {nIntegrationSteps * static_cast<size_t>(outInfo.nFrequencies) * outInfo.nAntennas * outInfo.nPolarizations};
+        const size_t nIntegrationIntervals {(outInfo.nTimesteps + nIntegrationSteps - 1)/ nIntegrationSteps };
+        const size_t fileTimesteps {reader->size() / bytesPerTimestep};
+        const size_t firstTimestep {options.firstTimestep};
+        const size_t nTimesteps {fileTimesteps > firstTimestep ? std::min<size_t>(fileTimesteps - firstTimestep, outInfo.nTimesteps) : 0};
+        /*
+            We allocate slightly more memory than simply nComplexSamples so we can avoid dealing with
+            the boundary condition happening when obsInfo.nTimesteps % nIntegrationSteps != 0. 
+        */
+        MemoryBuffer<std::complex<T>> mbVoltages {nIntegrationIntervals * samplesInTimeInterval, false, false};
+        auto voltages = mbVoltages.data();
+        const SimdLevel simdLevel {detect_simd_level()};
+        const unsigned int nInputs {outInfo.nAntennas * outInfo.nPolarizations};
+        const size_t nFileInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+        SampleWriter<T> writer {voltages, outInfo.nFrequencies, nInputs, nIntegrationSteps};
+        if(statistics) *statistics = VoltageStatistics {outInfo.nFrequencies, nInputs};
+        std::unique_ptr<SpectralKurtosisFlagger> kurtosis;
+        DatReadOptions readOptions {options};
+        if(rfiMask){
+            const unsigned int blockSize {options.kurtosisBlockSize > 0 ? options.kurtosisBlockSize : nIntegrationSteps};
+            kurtosis.reset(new SpectralKurtosisFlagger {outInfo.nTimesteps, nIntegrationSteps, outInfo.nFrequencies, nInputs,
+                blockSize, options.kurtosisThreshold});
+            /*
+                Staged writers decode a few timesteps at a time, so RFI blocks are evaluated on the packed samples of
+                whole chunks instead, which must then start at multiples of the block size.
+            */
+            if(SampleWriter<T>::STAGED)
+                readOptions.timestepsPerRead = (options.timestepsPerRead + blockSize - 1) / blockSize * blockSize;
+        }
+        /*
+            Threads accumulate statistics into partial objects, at most one per thread, taken from and returned
+            to `spareStatistics` around each chunk. They are merged once all the chunks have been expanded.
+        */
+        std::vector<VoltageStatistics> spareStatistics;
+        std::mutex statisticsMutex;
+        auto flag_chunk = [&](const uint8_t *data, size_t ts, size_t n){
+            const int *rows {inputMapping.empty() ? nullptr : inputMapping.data()};
+            for(size_t t {0}; t < n;){
+                const size_t nSteps {std::min<size_t>(nIntegrationSteps - (ts + t) % nIntegrationSteps, n - t)};
+                for(unsigned int c {0}; c < outInfo.nFrequencies; c++){
+                    const unsigned int ch {options.channels.empty() ? c : options.channels[c]};
+                    if(options.flaggedChannels.flagged(ch)) continue;
+                    kurtosis->process_dat_tile(data + t * bytesPerTimestep + ch * nFileInputs, bytesPerTimestep, nFileInputs, rows,
+                        nullptr, ts + t, nSteps, c, simdLevel);
+                }
+                t += nSteps;
+            }
+        };
+        auto expand_chunk = [&](const uint8_t *data, size_t ts, size_t n, VoltageStatistics *chunkStatistics){
+            writer.write(ts, n, [&](std::complex<int8_t> *out, size_t first, size_t offset, size_t nSteps, unsigned int stride){
+                SpectralKurtosisFlagger *tileKurtosis {SampleWriter<T>::STAGED ? nullptr : kurtosis.get()};
+                if(options.channels.empty())
+                    expand_dat_timesteps(data + offset * bytesPerTimestep, first, nSteps, obsInfo, stride, options.flaggedChannels, out,
+                        simdLevel, inputMapping, chunkStatistics, tileKurtosis);
+                else
+                    expand_dat_timesteps(data + offset * bytesPerTimestep, first, nSteps, obsInfo, stride, options.channels,
+                        options.flaggedChannels, out, simdLevel, inputMapping, chunkStatistics, tileKurtosis);
+            });
+            if(kurtosis && SampleWriter<T>::STAGED) flag_chunk(data, ts, n);
+        };
+        // `ts` counts timesteps from the beginning of the selection.
+        auto expand = [&](const uint8_t *data, size_t ts, size_t n){
+            if(!statistics || options.nThreads <= 1){
+                expand_chunk(data, ts, n, statistics);
+                return;
+            }
+            VoltageStatistics partial;
+            {
+                std::lock_guard<std::mutex> lock {statisticsMutex};
+                if(spareStatistics.empty()){
+                    partial = VoltageStatistics {outInfo.nFrequencies, nInputs};
+                }else{
+                    partial = std::move(spareStatistics.back());
+                    spareStatistics.pop_back();
                 }
             }
+            expand_chunk(data, ts, n, &partial);
+            std::lock_guard<std::mutex> lock {statisticsMutex};
+            spareStatistics.push_back(std::move(partial));
+        };
+        if(options.nThreads > 1){
+            read_dat_file_parallel(*reader, firstTimestep, nTimesteps, bytesPerTimestep, outInfo, nIntegrationSteps, readOptions,
+                voltages, expand, kurtosis ? kurtosis->block_size() : 1u);
+        }else{
+            memset(voltages, 0, sizeof(std::complex<T>) * nIntegrationIntervals * samplesInTimeInterval);
+            reader->read_chunks(firstTimestep * bytesPerTimestep, nTimesteps * bytesPerTimestep, readOptions.timestepsPerRead * bytesPerTimestep,
+                    options.queueDepth, [&](size_t offset, const uint8_t *data, size_t size){
+                expand(data, offset / bytesPerTimestep, size / bytesPerTimestep);
+            });
         }
-        fin.read(buffer, bytesPerRead);
-        bytesRead = fin.gcount();
+        for(const auto& partial : spareStatistics) statistics->merge(partial);
+        if(rfiMask) *rfiMask = kurtosis->take_mask();
+        return BasicVoltages<T> {std::move(mbVoltages), outInfo, nIntegrationSteps};
     }
-    fin.close();
-    delete[] buffer;
-    return Voltages {std::move(mbVoltages), obsInfo, nIntegrationSteps};
+}
+
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        const DatReadOptions& options){
+    return read_dat_file<T>(filename, obsInfo, nIntegrationSteps, options, nullptr);
+}
+
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        const DatReadOptions& options, VoltageStatistics& statistics){
+    return read_dat_file<T>(filename, obsInfo, nIntegrationSteps, options, &statistics);
+}
+
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        const DatReadOptions& options, RfiMask& rfiMask){
+    return read_dat_file<T>(filename, obsInfo, nIntegrationSteps, options, nullptr, &rfiMask);
+}
+
+
+
+namespace {
+    /**
+     * @brief Whether `filename` is a voltage archive rather than a plain .dat file.
+     */
+    bool is_voltage_archive(const std::string& filename){
+        std::unique_ptr<FileReader> file {open_raw_file_reader(filename)};
+        return VoltageArchive::is_archive(*file);
+    }
+
+
+
+    /**
+     * @brief Implementation of `Voltages::from_dat_file_mmap`.
+     */
+    template <typename T>
+    BasicVoltages<T> read_dat_file_mmap(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps){
+        if(nIntegrationSteps == 0) throw std::invalid_argument {"from_dat_file_mmap: `nIntegrationSteps` must be positive."};
+        // Archives cannot be expanded from their pages, they are decompressed by the `FileReader` path.
+        if(is_voltage_archive(filename)) return read_dat_file<T>(filename, obsInfo, nIntegrationSteps, DatReadOptions {}, nullptr);
+        int fd {open(filename.c_str(), O_RDONLY)};
+        if(fd < 0) throw std::runtime_error {"from_dat_file_mmap: error while opening " + filename};
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size == 0){
+            close(fd);
+            throw std::runtime_error {"from_dat_file_mmap: cannot determine the size of " + filename};
+        }
+        const size_t fileSize {static_cast<size_t>(st.st_size)};
+        void *mapping {mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0)};
+        // The mapping stays valid after the descriptor is closed.
+        close(fd);
+        if(mapping == MAP_FAILED) throw std::runtime_error {"from_dat_file_mmap: mmap failed on " + filename};
+        // The file is consumed front to back exactly once: let the kernel read ahead aggressively
+        // and drop pages behind us.
+        madvise(mapping, fileSize, MADV_SEQUENTIAL);
+        madvise(mapping, fileSize, MADV_WILLNEED);
+
+        const size_t nSamplesInTimestep {static_cast<size_t>(obsInfo.nFrequencies) * obsInfo.nAntennas * obsInfo.nPolarizations};
+        const size_t bytesPerTimestep {nSamplesInTimestep}; // 4+4 bits per complex sample
+        const size_t samplesInTimeInterval {nIntegrationSteps * nSamplesInTimestep};
+        const size_t nIntegrationIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1)/ nIntegrationSteps };
+        const size_t nTimesteps {std::min(fileSize / bytesPerTimestep, static_cast<size_t>(obsInfo.nTimesteps))};
+
+        try{
+            MemoryBuffer<std::complex<T>> mbVoltages {nIntegrationIntervals * samplesInTimeInterval, false, false};
+            auto voltages = mbVoltages.data();
+            memset(voltages, 0, sizeof(std::complex<T>) * nIntegrationIntervals * samplesInTimeInterval);
+
+            const uint8_t *data {static_cast<const uint8_t*>(mapping)};
+            SampleWriter<T> writer {voltages, obsInfo.nFrequencies, static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations,
+                nIntegrationSteps};
+            writer.write(0, nTimesteps, [&](std::complex<int8_t> *out, size_t first, size_t offset, size_t n, unsigned int stride){
+                expand_dat_timesteps(data + offset * bytesPerTimestep, first, n, obsInfo, stride, ChannelMask {}, out);
+            });
+            munmap(mapping, fileSize);
+            return BasicVoltages<T> {std::move(mbVoltages), obsInfo, nIntegrationSteps};
+        }catch(...){
+            munmap(mapping, fileSize);
+            throw;
+        }
+    }
+}
+
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_dat_file_mmap(const std::string& filename, const ObservationInfo& obsInfo,
+        unsigned int nIntegrationSteps){
+    return read_dat_file_mmap<T>(filename, obsInfo, nIntegrationSteps);
 }
 
 
 #ifdef __GPU__
-__global__ void dat_file_expansion_kernel(int8_t *input, size_t input_size, ObservationInfo obsInfo, unsigned int nIntegrationSteps, unsigned int edge, int8_t* output){
+__global__ void dat_file_expansion_kernel(int8_t *input, size_t input_size, ObservationInfo obsInfo, unsigned int nIntegrationSteps,
+        const uint64_t *flaggedChannels, int8_t* output){
 
-    size_t start_index {blockDim.x * blockIdx.x + threadIdx.x};
-    size_t grid_size {gridDim.x * blockDim.x};
+    size_t start_index {static_cast<size_t>(blockDim.x) * blockIdx.x + threadIdx.x};
+    size_t grid_size {static_cast<size_t>(gridDim.x) * blockDim.x};
     uint16_t *buffer = reinterpret_cast<uint16_t*>(input);
     const size_t samplesInPol {nIntegrationSteps};
     const size_t samplesInAntenna {samplesInPol * obsInfo.nPolarizations};
@@ -163,31 +477,26 @@ __global__ void dat_file_expansion_kernel(int8_t *input, size_t input_size, Obse
         size_t currentTimeInterval = currentTimeStep / nIntegrationSteps;
         size_t currentIntegratorStep = currentTimeStep % nIntegrationSteps;
 
-        // set edge channels to 0
-        if(ch < edge || ch >= (obsInfo.nFrequencies - edge)){
-            expanded[0] = 0;
-            expanded[1] = 0;
-            expanded[2] = 0;
-            expanded[3] = 0;
-        }else{
-            uint16_t raw_samples = buffer[idx];
-            int value = 0;
-            uint8_t original = 0;
-            uint8_t answer = 0;
-            uint8_t outval = 0;
-            for (outval = 0; outval < 4 ; outval++){
-                original = raw_samples >> (outval * 4);
-                original = original & 0xf; // the sample
-                if(original >= 0x8) { // it is a negative number
-                    // https://en.wikipedia.org/wiki/Two%27s_complement#Subtraction_from_2N
-                    value = original - 0x10;
-                }
-                else {
-                    value = original;
-                }
-                answer = value & 0xff;
-                expanded[outval] = answer;
+        // flagged channels have already been zeroed by the host, do not even load their samples.
+        if(flaggedChannels && ((flaggedChannels[ch / 64] >> (ch % 64)) & 1u)) continue;
+
+        uint16_t raw_samples = buffer[idx];
+        int value = 0;
+        uint8_t original = 0;
+        uint8_t answer = 0;
+        uint8_t outval = 0;
+        for (outval = 0; outval < 4 ; outval++){
+            original = raw_samples >> (outval * 4);
+            original = original & 0xf; // the sample
+            if(original >= 0x8) { // it is a negative number
+                // https://en.wikipedia.org/wiki/Two%27s_complement#Subtraction_from_2N
+                value = original - 0x10;
+            }
+            else {
+                value = original;
             }
+            answer = value & 0xff;
+            expanded[outval] = answer;
         }
 
         // output layout is Time, Frequency, Antenna, Polarization, Integration Step
@@ -201,7 +510,12 @@ __global__ void dat_file_expansion_kernel(int8_t *input, size_t input_size, Obse
 
 
 
-Voltages Voltages::from_dat_file_gpu(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps){
+Voltages read_dat_file_gpu(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        const ChannelMask& flaggedChannels){
+    if(!flaggedChannels.empty() && flaggedChannels.size() != obsInfo.nFrequencies)
+        throw std::invalid_argument {"from_dat_file_gpu: `flaggedChannels` must have one entry per channel."};
+    if(is_voltage_archive(filename))
+        throw std::invalid_argument {"from_dat_file_gpu: " + filename + " is a voltage archive, read it with `from_dat_file`."};
     std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
     // Step 1: read the whole file in memory
     std::ifstream fin;
@@ -244,86 +558,483 @@ Voltages Voltages::from_dat_file_gpu(const std::string& filename, const Observat
     gpuGetDeviceProperties(&props, gpu_id);
     unsigned int n_blocks = props.multiProcessorCount * 2;
     auto voltages = mbVoltages.data();
-    dat_file_expansion_kernel<<<n_blocks, 1024>>>(orig_input, nTotalSamples, obsInfo, nIntegrationSteps, 0, reinterpret_cast<int8_t*>(voltages));
+    // Flagged channels are cleared one run of consecutive channels at a time, which is a contiguous
+    // block of each integration interval, and skipped by the kernel.
+    uint64_t *dev_flagged_channels {nullptr};
+    if(flaggedChannels.count() > 0){
+        const size_t maskBytes {sizeof(uint64_t) * ((flaggedChannels.size() + 63) / 64)};
+        gpuMalloc(&dev_flagged_channels, maskBytes);
+        gpuMemcpy(dev_flagged_channels, flaggedChannels.data(), maskBytes, gpuMemcpyHostToDevice);
+        for(size_t interval {0}; interval < nIntegrationIntervals; interval++){
+            for(unsigned int ch {0}; ch < obsInfo.nFrequencies; ch++){
+                if(!flaggedChannels.flagged(ch)) continue;
+                const unsigned int runEnd {flaggedChannels.end_of_run(ch)};
+                gpuMemset(voltages + interval * samplesInTimeInterval + ch * samplesInFrequency, 0,
+                    sizeof(std::complex<int8_t>) * (runEnd - ch) * samplesInFrequency);
+                ch = runEnd;
+            }
+        }
+    }
+    dat_file_expansion_kernel<<<n_blocks, 1024>>>(orig_input, nTotalSamples, obsInfo, nIntegrationSteps, dev_flagged_channels,
+        reinterpret_cast<int8_t*>(voltages));
     gpuDeviceSynchronize();
     gpuFree(orig_input);
+    if(dev_flagged_channels) gpuFree(dev_flagged_channels);
     std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> exec_time = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
     std::cout << "'from_dat_file_gpu' took " << exec_time.count() << "seconds." << std::endl;
     return Voltages {std::move(mbVoltages), obsInfo, nIntegrationSteps};
 }
+
+
+
+namespace {
+    /**
+     * @brief The GPU kernel only decodes 8-bit samples: the other sample types are rejected before the file is read.
+     */
+    template <typename T>
+    BasicVoltages<T> gpu_sample_type(Voltages&&){
+        throw std::invalid_argument {"from_dat_file_gpu: only 8-bit samples are supported."};
+    }
+
+
+    template <>
+    Voltages gpu_sample_type<int8_t>(Voltages&& voltages){
+        return std::move(voltages);
+    }
+}
+
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_dat_file_gpu(const std::string& filename, const ObservationInfo& obsInfo,
+        unsigned int nIntegrationSteps, const ChannelMask& flaggedChannels){
+    if(!std::is_same<T, int8_t>::value)
+        throw std::invalid_argument {"from_dat_file_gpu: only 8-bit samples are supported."};
+    return gpu_sample_type<T>(read_dat_file_gpu(filename, obsInfo, nIntegrationSteps, flaggedChannels));
+}
 #else
-Voltages Voltages::from_dat_file_gpu(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps){
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_dat_file_gpu(const std::string& filename, const ObservationInfo& obsInfo,
+        unsigned int nIntegrationSteps, const ChannelMask& flaggedChannels){
     throw std::runtime_error("from_dat_file_gpu cannot be called on a CPU-only compile of the code."); 
 }
 #endif
 
 
-Voltages Voltages::from_memory(const int8_t *buffer, size_t length, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, bool use_pinned_mem){
-    const size_t bytesPerComplexSample {2}; // 4+4 bits 
-    const size_t nSamplesInTimestep {obsInfo.nFrequencies * obsInfo.nAntennas *  obsInfo.nPolarizations};
-    const size_t nComplexSamples {obsInfo.nTimesteps * nSamplesInTimestep};
-    const size_t samplesSize {nComplexSamples * bytesPerComplexSample};
-    if(length != nComplexSamples * bytesPerComplexSample){
-        std::cerr << "Error: unexpected buffer size (" << length << "). Expected " <<  samplesSize << std::endl;
-        throw std::exception(); // TODO bette exception.
+namespace {
+    /**
+     * @brief Allocate the voltage array for `obsInfo`, to be filled by a reordering of all its timesteps.
+     *
+     * We allocate slightly more memory than simply nComplexSamples so we can avoid dealing with
+     * the boundary condition happening when obsInfo.nTimesteps % nIntegrationSteps != 0. Every sample
+     * is overwritten by the reordering, except for that padding at the end of the last interval, which
+     * is zeroed here.
+     */
+    template <typename T>
+    MemoryBuffer<std::complex<T>> allocate_reordered_voltages(const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+            bool use_pinned_mem){
+        const size_t nTimesteps {obsInfo.nTimesteps};
+        const size_t samplesInFrequency {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations * nIntegrationSteps};
+        const size_t samplesInTimeInterval {samplesInFrequency * obsInfo.nFrequencies};
+        const size_t nIntegrationIntervals {(nTimesteps + nIntegrationSteps - 1)/ nIntegrationSteps };
+        MemoryBuffer<std::complex<T>> mbVoltages {nIntegrationIntervals * samplesInTimeInterval, false, use_pinned_mem};
+        const size_t nValidSteps {nTimesteps - (nIntegrationIntervals - 1) * nIntegrationSteps};
+        if(nIntegrationIntervals > 0 && nValidSteps < nIntegrationSteps){
+            std::complex<T> *lastInterval {mbVoltages.data() + (nIntegrationIntervals - 1) * samplesInTimeInterval};
+            for(size_t row {0}; row < samplesInTimeInterval; row += nIntegrationSteps)
+                memset(lastInterval + row + nValidSteps, 0, (nIntegrationSteps - nValidSteps) * sizeof(std::complex<T>));
+        }
+        return mbVoltages;
     }
-    size_t samplesInPol {nIntegrationSteps};
-    const size_t samplesInAntenna {samplesInPol * obsInfo.nPolarizations};
-    const size_t samplesInFrequency {samplesInAntenna * obsInfo.nAntennas};
-    const size_t samplesInTimeInterval {samplesInFrequency * obsInfo.nFrequencies};
-    size_t currentTimeInterval;
-    size_t currentIntegratorStep;
-    const size_t nIntegrationIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1)/ nIntegrationSteps };
-    size_t sample_idx {0};
-    /*
-        We allocate slightly more memory than simply nComplexSamples so we can avoid dealing with
-        the boundary condition happening when obsInfo.nTimesteps % nIntegrationSteps != 0. 
-    */
-    MemoryBuffer<std::complex<int8_t>> mbVoltages {nIntegrationIntervals * samplesInTimeInterval, false, use_pinned_mem};
-    auto voltages = mbVoltages.data();
-    memset(voltages, 0, sizeof(std::complex<int8_t>) * nIntegrationIntervals * samplesInTimeInterval);
-    for(size_t ts = 0; ts < obsInfo.nTimesteps; ts++){
-        currentTimeInterval = ts / nIntegrationSteps;
-        currentIntegratorStep = ts % nIntegrationSteps;
-        for(size_t ch = 0; ch < obsInfo.nFrequencies; ch++){
-            for(size_t a = 0; a < obsInfo.nAntennas; a++){
-                // output layout is Time, Frequency, Antenna, Polarization, Integration Step
-                 size_t outIndex = currentTimeInterval * samplesInTimeInterval + ch * samplesInFrequency + a * samplesInAntenna;
-                voltages[outIndex + currentIntegratorStep].real(buffer[sample_idx++]);
-                voltages[outIndex + currentIntegratorStep].imag(buffer[sample_idx++]);
-                voltages[outIndex + samplesInPol + currentIntegratorStep].real(buffer[sample_idx++]);
-                voltages[outIndex + samplesInPol + currentIntegratorStep].imag(buffer[sample_idx++]);         
+
+
+
+    /**
+     * @brief Implementation of `Voltages::from_memory`.
+     */
+    template <typename T>
+    BasicVoltages<T> reorder_memory(const int8_t *buffer, size_t length, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+            const std::vector<int>& inputMapping, bool use_pinned_mem, unsigned int nThreads, bool streamingStores){
+        const size_t bytesPerComplexSample {2}; // 8+8 bits
+        const size_t nSamplesInTimestep {static_cast<size_t>(obsInfo.nFrequencies) * obsInfo.nAntennas *  obsInfo.nPolarizations};
+        const size_t nTimesteps {obsInfo.nTimesteps};
+        const size_t samplesSize {nTimesteps * nSamplesInTimestep * bytesPerComplexSample};
+        if(length != samplesSize)
+            throw std::invalid_argument {"from_memory: unexpected buffer size (" + std::to_string(length) + "). Expected "
+                + std::to_string(samplesSize) + "."};
+        if(!inputMapping.empty() && !is_input_permutation(inputMapping, static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations))
+            throw std::invalid_argument {"from_memory: `inputMapping` is not a permutation of the inputs."};
+        const size_t nIntegrationIntervals {(nTimesteps + nIntegrationSteps - 1)/ nIntegrationSteps };
+        MemoryBuffer<std::complex<T>> mbVoltages {allocate_reordered_voltages<T>(obsInfo, nIntegrationSteps, use_pinned_mem)};
+        const std::complex<int8_t> *input {reinterpret_cast<const std::complex<int8_t>*>(buffer)};
+        const SimdLevel simdLevel {detect_simd_level()};
+        SampleWriter<T> writer {mbVoltages.data(), obsInfo.nFrequencies, static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations,
+            nIntegrationSteps};
+        // Staging buffers are read back straight away, they must stay in cache.
+        const bool streamToOutput {streamingStores && !SampleWriter<T>::STAGED};
+        /*
+            Threads get whole integration intervals when there are enough of them, otherwise timesteps are split
+            in multiples of the transpose tile height.
+        */
+        const bool splitByInterval {nIntegrationIntervals >= nThreads};
+        parallel_for_ranges(nTimesteps, nThreads, splitByInterval ? nIntegrationSteps : 64u, [&](size_t begin, size_t end){
+            writer.write(begin, end - begin, [&](std::complex<int8_t> *out, size_t first, size_t offset, size_t n, unsigned int stride){
+                reorder_complex_timesteps(input + (begin + offset) * nSamplesInTimestep, first, n, obsInfo, stride,
+                    out, simdLevel, streamToOutput, inputMapping);
+            });
+        });
+        return {std::move(mbVoltages), obsInfo, nIntegrationSteps};
+    }
+
+
+
+    /**
+     * @brief Implementation of `Voltages::from_packed_memory`.
+     */
+    template <typename T>
+    BasicVoltages<T> expand_packed_memory(const uint8_t *buffer, size_t length, const ObservationInfo& obsInfo,
+            unsigned int nIntegrationSteps, const std::vector<int>& inputMapping, bool use_pinned_mem, unsigned int nThreads){
+        const size_t bytesPerTimestep {static_cast<size_t>(obsInfo.nFrequencies) * obsInfo.nAntennas * obsInfo.nPolarizations};
+        const size_t nTimesteps {obsInfo.nTimesteps};
+        if(length != nTimesteps * bytesPerTimestep)
+            throw std::invalid_argument {"from_packed_memory: unexpected buffer size (" + std::to_string(length) + "). Expected "
+                + std::to_string(nTimesteps * bytesPerTimestep) + "."};
+        if(nIntegrationSteps == 0) throw std::invalid_argument {"from_packed_memory: `nIntegrationSteps` must be positive."};
+        if(!inputMapping.empty() && !is_input_permutation(inputMapping, static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations))
+            throw std::invalid_argument {"from_packed_memory: `inputMapping` is not a permutation of the inputs."};
+        const size_t nIntegrationIntervals {(nTimesteps + nIntegrationSteps - 1)/ nIntegrationSteps };
+        MemoryBuffer<std::complex<T>> mbVoltages {allocate_reordered_voltages<T>(obsInfo, nIntegrationSteps, use_pinned_mem)};
+        const SimdLevel simdLevel {detect_simd_level()};
+        SampleWriter<T> writer {mbVoltages.data(), obsInfo.nFrequencies, static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations,
+            nIntegrationSteps};
+        // Same split as `from_memory`; the expansion kernels work on blocks of 8 timesteps.
+        const bool splitByInterval {nIntegrationIntervals >= nThreads};
+        parallel_for_ranges(nTimesteps, nThreads, splitByInterval ? nIntegrationSteps : 64u, [&](size_t begin, size_t end){
+            writer.write(begin, end - begin, [&](std::complex<int8_t> *out, size_t first, size_t offset, size_t n, unsigned int stride){
+                expand_dat_timesteps(buffer + (begin + offset) * bytesPerTimestep, first, n, obsInfo, stride, ChannelMask {},
+                    out, simdLevel, inputMapping);
+            });
+        });
+        return {std::move(mbVoltages), obsInfo, nIntegrationSteps};
+    }
+
+
+
+    /**
+     * @brief Implementation of `Voltages::from_eda2_file`.
+     */
+    template <typename T>
+    BasicVoltages<T> read_eda2_file(const std::string& filename, const ObservationInfo& obs_info, unsigned int nIntegrationSteps,
+            unsigned int nThreads){
+        int fd {open(filename.c_str(), O_RDONLY)};
+        if(fd < 0) throw std::runtime_error {"from_eda2_file: error while opening " + filename};
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size == 0){
+            close(fd);
+            throw std::runtime_error {"from_eda2_file: cannot determine the size of " + filename};
+        }
+        const size_t fileSize {static_cast<size_t>(st.st_size)};
+        // Samples are reordered straight from the mapped pages into the output, without intermediate copies.
+        void *mapping {mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0)};
+        if(mapping == MAP_FAILED){
+            // e.g. filesystems not supporting mmap: read the file at once in a buffer of the right size.
+            std::unique_ptr<int8_t[]> buffer {new int8_t[fileSize]};
+            try{
+                if(pread_full(fd, buffer.get(), fileSize, 0) != fileSize)
+                    throw std::runtime_error {"from_eda2_file: unexpected end of file in " + filename};
+            }catch(...){
+                close(fd);
+                throw;
+            }
+            close(fd);
+            return reorder_memory<T>(buffer.get(), fileSize, obs_info, nIntegrationSteps, {}, false, nThreads, false);
+        }
+        close(fd);
+        madvise(mapping, fileSize, MADV_SEQUENTIAL);
+        madvise(mapping, fileSize, MADV_WILLNEED);
+        try{
+            auto volt = reorder_memory<T>(reinterpret_cast<const int8_t*>(mapping), fileSize, obs_info, nIntegrationSteps,
+                {}, false, nThreads, false);
+            munmap(mapping, fileSize);
+            return volt;
+        }catch(...){
+            munmap(mapping, fileSize);
+            throw;
+        }
+    }
+
+
+
+    /**
+     * @brief Implementation of `Voltages::to_dat_file`.
+     */
+    void write_dat_file(const Voltages& voltages, const std::string& filename, const std::vector<int>& inputMapping){
+        const ObservationInfo& obsInfo {voltages.obsInfo};
+        if(voltages.on_gpu()) throw std::invalid_argument {"Voltages::to_dat_file: data must reside in CPU memory."};
+        const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+        if(!inputMapping.empty() && !is_input_permutation(inputMapping, nInputs))
+            throw std::invalid_argument {"Voltages::to_dat_file: `inputMapping` is not a permutation of the inputs."};
+        const size_t bytesPerTimestep {nInputs * obsInfo.nFrequencies};
+        const size_t nTimesteps {obsInfo.nTimesteps};
+        /*
+            Chunks hold a whole number of timesteps and, when possible, of pages, so that every write but
+            the last one covers entire pages of the file.
+        */
+        const size_t pageSize {4096u}, chunkBytes {4u << 20};
+        size_t stepsPerPage {1};
+        while((stepsPerPage * bytesPerTimestep) % pageSize != 0) stepsPerPage *= 2;
+        const size_t timestepsPerChunk {std::max(stepsPerPage, chunkBytes / bytesPerTimestep / stepsPerPage * stepsPerPage)};
+
+        int fd {open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)};
+        if(fd < 0) throw std::runtime_error {"Voltages::to_dat_file: error while opening " + filename + ": " + strerror(errno)};
+        std::unique_ptr<uint8_t, decltype(&free)> buffers[2] {{nullptr, free}, {nullptr, free}};
+        for(auto& buffer : buffers){
+            void *p {nullptr};
+            if(posix_memalign(&p, pageSize, timestepsPerChunk * bytesPerTimestep) != 0){
+                close(fd);
+                throw std::bad_alloc {};
+            }
+            buffer.reset(static_cast<uint8_t*>(p));
+        }
+        const SimdLevel simdLevel {detect_simd_level()};
+        // Each chunk is written asynchronously while the next one is packed in the other buffer.
+        std::future<void> pendingWrite;
+        try{
+            for(size_t t {0}, chunk {0}; t < nTimesteps; t += timestepsPerChunk, chunk++){
+                const size_t nSteps {std::min(timestepsPerChunk, nTimesteps - t)};
+                uint8_t *buffer {buffers[chunk % 2].get()};
+                pack_dat_timesteps(voltages.data(), t, nSteps, obsInfo, voltages.nIntegrationSteps, buffer, simdLevel, inputMapping);
+                if(pendingWrite.valid()) pendingWrite.get();
+                pendingWrite = std::async(std::launch::async, [fd, buffer, nSteps, t, bytesPerTimestep](){
+                    pwrite_full(fd, buffer, nSteps * bytesPerTimestep, t * bytesPerTimestep);
+                });
             }
+            if(pendingWrite.valid()) pendingWrite.get();
+        }catch(...){
+            if(pendingWrite.valid()) pendingWrite.wait();
+            close(fd);
+            throw;
         }
+        if(close(fd) != 0) throw std::runtime_error {"Voltages::to_dat_file: error while closing " + filename + ": " + strerror(errno)};
     }
-    return {std::move(mbVoltages), obsInfo, nIntegrationSteps};
+
+
+
+    const Voltages& as_8bit_samples(const Voltages& voltages){
+        return voltages;
+    }
+
+
+    template <typename T>
+    Voltages as_8bit_samples(const BasicVoltages<T>& voltages){
+        return convert_voltages<int8_t>(voltages);
+    }
+}
+
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_memory(const int8_t *buffer, size_t length, const ObservationInfo& obsInfo,
+        unsigned int nIntegrationSteps, bool use_pinned_mem, unsigned int nThreads, bool streamingStores){
+    return from_memory(buffer, length, obsInfo, nIntegrationSteps, std::vector<int> {}, use_pinned_mem, nThreads, streamingStores);
+}
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_memory(const int8_t *buffer, size_t length, const ObservationInfo& obsInfo,
+        unsigned int nIntegrationSteps, const std::vector<int>& inputMapping, bool use_pinned_mem, unsigned int nThreads,
+        bool streamingStores){
+    return reorder_memory<T>(buffer, length, obsInfo, nIntegrationSteps, inputMapping, use_pinned_mem, nThreads, streamingStores);
+}
+
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_packed_memory(const uint8_t *buffer, size_t length, const ObservationInfo& obsInfo,
+        unsigned int nIntegrationSteps, const std::vector<int>& inputMapping, bool use_pinned_mem, unsigned int nThreads){
+    return expand_packed_memory<T>(buffer, length, obsInfo, nIntegrationSteps, inputMapping, use_pinned_mem, nThreads);
 }
 
 
 
-Voltages Voltages::from_eda2_file(const std::string& filename, const ObservationInfo& obs_info, unsigned int nIntegrationSteps){
-    // TODO: more efficient implementation
-    char *buffer {nullptr};
-    size_t size {0};
-    read_data_from_file(filename, buffer, size);
-    auto volt = Voltages::from_memory(reinterpret_cast<int8_t*>(buffer), size, obs_info, nIntegrationSteps, false);
-    delete[] buffer;
-    return volt;
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_eda2_file(const std::string& filename, const ObservationInfo& obs_info,
+        unsigned int nIntegrationSteps, unsigned int nThreads){
+    return read_eda2_file<T>(filename, obs_info, nIntegrationSteps, nThreads);
 }
 
 
+
+namespace {
+    /**
+     * @brief Implementation of `Voltages::from_eda2_hdf5_file`.
+     */
+    template <typename T>
+    BasicVoltages<T> read_eda2_hdf5_file(const std::string& filename, const ObservationInfo& obs_info, unsigned int nIntegrationSteps,
+            const Eda2ReadOptions& options, bool use_pinned_mem){
+        if(nIntegrationSteps == 0) throw std::invalid_argument {"from_eda2_hdf5_file: `nIntegrationSteps` must be positive."};
+        Eda2Hdf5File file {filename, options.dataset, obs_info};
+        if(options.firstTimestep >= file.n_timesteps())
+            throw std::invalid_argument {"from_eda2_hdf5_file: `firstTimestep` is past the end of the dataset."};
+        const size_t remaining {file.n_timesteps() - options.firstTimestep};
+        const size_t nTimesteps {options.nTimesteps > 0 ? std::min(options.nTimesteps, remaining) : remaining};
+        ObservationInfo outInfo {obs_info};
+        outInfo.nTimesteps = nTimesteps;
+
+        /*
+            Hyperslabs cover the timesteps of one chunk and the stations of one chunk, with boundaries at
+            multiples of the chunk extents in the dataset, so that no chunk is read twice. HDF5 memory selections
+            cannot reorder axes: each hyperslab is read into a staging buffer and transposed from there.
+        */
+        const size_t slabTimesteps {file.chunk_timesteps() > 0 ? file.chunk_timesteps() : std::max<size_t>(1, options.timestepsPerRead)};
+        const unsigned int slabAntennas {file.chunk_antennas()};
+        const size_t firstSlab {options.firstTimestep / slabTimesteps};
+        const size_t nTimeSlabs {(options.firstTimestep + nTimesteps - 1) / slabTimesteps - firstSlab + 1};
+        const size_t nAntennaSlabs {(obs_info.nAntennas + slabAntennas - 1) / slabAntennas};
+        const size_t slabSamples {slabTimesteps * obs_info.nFrequencies * slabAntennas * obs_info.nPolarizations};
+
+        MemoryBuffer<std::complex<T>> mbVoltages {allocate_reordered_voltages<T>(outInfo, nIntegrationSteps, use_pinned_mem)};
+        const SimdLevel simdLevel {detect_simd_level()};
+        SampleWriter<T> writer {mbVoltages.data(), outInfo.nFrequencies, static_cast<size_t>(outInfo.nAntennas) * outInfo.nPolarizations,
+            nIntegrationSteps};
+        parallel_for_ranges(nTimeSlabs * nAntennaSlabs, options.nThreads, 1u, [&](size_t begin, size_t end){
+            std::unique_ptr<std::complex<int8_t>[]> staging {new std::complex<int8_t>[slabSamples]};
+            for(size_t item {begin}; item < end; item++){
+                const size_t slab {firstSlab + item / nAntennaSlabs};
+                const unsigned int firstAntenna {static_cast<unsigned int>(item % nAntennaSlabs) * slabAntennas};
+                const unsigned int nAntennas {std::min(slabAntennas, obs_info.nAntennas - firstAntenna)};
+                const size_t first {std::max(options.firstTimestep, slab * slabTimesteps)};
+                const size_t last {std::min(options.firstTimestep + nTimesteps, (slab + 1) * slabTimesteps)};
+                file.read(first, last - first, firstAntenna, nAntennas, staging.get());
+                const size_t firstInput {static_cast<size_t>(firstAntenna) * obs_info.nPolarizations};
+                const size_t nInputs {static_cast<size_t>(nAntennas) * obs_info.nPolarizations};
+                writer.write(first - options.firstTimestep, last - first,
+                        [&](std::complex<int8_t> *out, size_t firstStep, size_t offset, size_t n, unsigned int stride){
+                    reorder_complex_input_range(staging.get() + offset * obs_info.nFrequencies * nInputs, firstStep, n,
+                        firstInput, nInputs, outInfo, stride, out, simdLevel);
+                }, firstInput, nInputs);
+            }
+        });
+        return {std::move(mbVoltages), outInfo, nIntegrationSteps};
+    }
+}
+
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_eda2_hdf5_file(const std::string& filename, const ObservationInfo& obs_info,
+        unsigned int nIntegrationSteps, const Eda2ReadOptions& options, bool use_pinned_mem){
+    return read_eda2_hdf5_file<T>(filename, obs_info, nIntegrationSteps, options, use_pinned_mem);
+}
+
+
+
+namespace {
+    /**
+     * @brief Implementation of `Voltages::from_sub_file`.
+     */
+    template <typename T>
+    BasicVoltages<T> read_sub_file(const std::string& filename, unsigned int nIntegrationSteps, const SubfileReadOptions& options,
+            bool use_pinned_mem){
+        if(nIntegrationSteps == 0) throw std::invalid_argument {"from_sub_file: `nIntegrationSteps` must be positive."};
+        const SubfileInfo info {read_subfile_info(filename)};
+        if(options.firstBlock >= info.nBlocks)
+            throw std::invalid_argument {"from_sub_file: `firstBlock` is past the end of the subfile."};
+        const size_t nInputs {static_cast<size_t>(info.obsInfo.nAntennas) * info.obsInfo.nPolarizations};
+        if(!options.inputMapping.empty() && !is_input_permutation(options.inputMapping, nInputs))
+            throw std::invalid_argument {"from_sub_file: `inputMapping` is not a permutation of the inputs."};
+        const size_t remainingBlocks {info.nBlocks - options.firstBlock};
+        const size_t nBlocks {options.nBlocks > 0 ? std::min(options.nBlocks, remainingBlocks) : remainingBlocks};
+        ObservationInfo outInfo {info.obsInfo};
+        outInfo.nTimesteps = nBlocks * info.samplesPerBlock;
+
+        int fd {open(filename.c_str(), O_RDONLY)};
+        if(fd < 0) throw std::runtime_error {"from_sub_file: error while opening " + filename};
+        const size_t fileSize {info.block_offset(info.nBlocks)};
+        void *mapping {mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0)};
+        close(fd);
+        if(mapping == MAP_FAILED) throw std::runtime_error {"from_sub_file: mmap failed on " + filename};
+        // Only the selected blocks are paged in.
+        const size_t pageSize {static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+        const size_t firstByte {info.block_offset(options.firstBlock) / pageSize * pageSize};
+        madvise(static_cast<char*>(mapping) + firstByte, info.block_offset(options.firstBlock + nBlocks) - firstByte, MADV_WILLNEED);
+        try{
+            MemoryBuffer<std::complex<T>> mbVoltages {allocate_reordered_voltages<T>(outInfo, nIntegrationSteps, use_pinned_mem)};
+            auto voltages = mbVoltages.data();
+            parallel_for_ranges(nBlocks, options.nThreads, 1u, [&](size_t begin, size_t end){
+                for(size_t b {begin}; b < end; b++){
+                    const auto *block = reinterpret_cast<const std::complex<int8_t>*>(static_cast<const char*>(mapping)
+                        + info.block_offset(options.firstBlock + b));
+                    reorder_subfile_block(block, b * info.samplesPerBlock, info.samplesPerBlock, nInputs, nIntegrationSteps,
+                        options.inputMapping, voltages);
+                }
+            });
+            munmap(mapping, fileSize);
+            return {std::move(mbVoltages), outInfo, nIntegrationSteps};
+        }catch(...){
+            munmap(mapping, fileSize);
+            throw;
+        }
+    }
+}
+
+
+
+template <typename T>
+BasicVoltages<T> BasicVoltages<T>::from_sub_file(const std::string& filename, unsigned int nIntegrationSteps,
+        const SubfileReadOptions& options, bool use_pinned_mem){
+    return read_sub_file<T>(filename, nIntegrationSteps, options, use_pinned_mem);
+}
+
+
+
+template <typename T>
+void BasicVoltages<T>::to_dat_file(const std::string& filename, const std::vector<int>& inputMapping) const {
+    if(this->on_gpu()) throw std::invalid_argument {"Voltages::to_dat_file: data must reside in CPU memory."};
+    // Samples are saturated to 4 bits anyway: convert them to 8 bits first, then pack them.
+    write_dat_file(as_8bit_samples(*this), filename, inputMapping);
+}
+
+
+
+template <typename T>
+void BasicVoltages<T>::apply_rfi_mask(const RfiMask& rfiMask){
+    if(this->on_gpu()) throw std::invalid_argument {"Voltages::apply_rfi_mask: data must reside in CPU memory."};
+    const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+    const unsigned int nInputs {obsInfo.nAntennas * obsInfo.nPolarizations};
+    if(rfiMask.n_intervals() != nIntervals || rfiMask.n_channels() != obsInfo.nFrequencies || rfiMask.n_inputs() != nInputs)
+        throw std::invalid_argument {"Voltages::apply_rfi_mask: the mask does not have the shape of the voltages."};
+    std::complex<T> *samples {this->data()};
+    for(size_t interval {0}; interval < nIntervals; interval++)
+        for(unsigned int ch {0}; ch < obsInfo.nFrequencies; ch++)
+            for(unsigned int input {0}; input < nInputs; input++)
+                if(rfiMask.flagged(interval, ch, input))
+                    std::fill_n(samples + ((interval * obsInfo.nFrequencies + ch) * nInputs + input) * nIntegrationSteps,
+                        nIntegrationSteps, std::complex<T> {0, 0});
+}
+
+
+
+// Sample types voltages can be read as.
+template class BasicVoltages<int8_t>;
+template class BasicVoltages<int16_t>;
+template class BasicVoltages<float>;
+
+
+
 Visibilities Visibilities::from_fits_file(const std::string& filename, const ObservationInfo& oInfo){
 
     FITS fitsImage {FITS::from_file(filename)};
     ObservationInfo obsInfo {oInfo};
-    const unsigned int n_baselines {((obsInfo.nAntennas + 1) * obsInfo.nAntennas) / 2};
+    const size_t n_baselines {((static_cast<size_t>(obsInfo.nAntennas) + 1) * obsInfo.nAntennas) / 2};
     const size_t matrixSize {n_baselines * obsInfo.nPolarizations * obsInfo.nPolarizations};
 
     size_t nHDUs {fitsImage.size()};
 
-    unsigned int nIntegrationIntervals {static_cast<unsigned int>(nHDUs)}, nAveragedChannels;
-    unsigned int nIntegrationSteps {obsInfo.nTimesteps / nIntegrationIntervals};
+    const size_t nIntegrationIntervals {nHDUs};
+    unsigned int nAveragedChannels;
+    const unsigned int nIntegrationSteps {static_cast<unsigned int>(obsInfo.nTimesteps / nIntegrationIntervals)};
     
     size_t xcorrSize {obsInfo.nFrequencies * matrixSize * nIntegrationIntervals};
 
@@ -360,7 +1071,7 @@ void Visibilities::to_fits_file(const std::string& filename) const{
     const size_t nFrequencies {obsInfo.nFrequencies / nAveragedChannels}; 
     // one axis for matrix, one for frequency
     float integrationTime {static_cast<float>(obsInfo.timeResolution * nIntegrationSteps)};
-    for(unsigned int interval {0}; interval < this->integration_intervals(); interval++){
+    for(size_t interval {0}; interval < this->integration_intervals(); interval++){
         FITS::HDU hdu;
         std::complex<float>* pToMatrix = const_cast<std::complex<float>*>(this->data() + interval * (nFrequencies * this->matrix_size()));
         int msElapsed {static_cast<int>(interval *  (obsInfo.timeResolution * nIntegrationSteps * 1e3))};
@@ -485,3 +1196,39 @@ std::vector<std::vector<DatFile>> parse_mwa_dat_files(std::string directory, int
     auto selected_dat_files = std::vector<std::string>(dat_files.begin() + start_file_index, dat_files.begin() + start_file_index + file_count);
     return parse_mwa_dat_files(selected_dat_files);
 }
+
+
+
+std::vector<Voltages> load_dat_files(const std::vector<DatFile>& files, unsigned int nIntegrationSteps, ThreadPool& pool,
+        unsigned int maxFilesInFlight, const DatReadOptions& options){
+    const size_t maxInFlight {maxFilesInFlight == 0 ? pool.size() : maxFilesInFlight};
+    std::vector<std::future<Voltages>> pending;
+    std::vector<Voltages> voltages;
+    voltages.reserve(files.size());
+    // Files are submitted in order and collected in order, so at most `maxInFlight` of them are
+    // read at the same time.
+    size_t nSubmitted {0};
+    for(size_t i {0}; i < files.size(); i++){
+        while(nSubmitted < files.size() && nSubmitted - i < maxInFlight){
+            const DatFile& file {files[nSubmitted++]};
+            pending.push_back(pool.submit([&file, nIntegrationSteps, options](){
+                return Voltages::from_dat_file(file.first, file.second, nIntegrationSteps, options);
+            }));
+        }
+        try{
+            voltages.push_back(pending[i].get());
+        }catch(...){
+            // Tasks still running reference `files`: let them complete before leaving.
+            for(size_t j {i + 1}; j < pending.size(); j++) pending[j].wait();
+            throw;
+        }
+    }
+    return voltages;
+}
+
+
+
+std::vector<Voltages> load_dat_files(const std::vector<DatFile>& files, unsigned int nIntegrationSteps, unsigned int nThreads){
+    ThreadPool pool {nThreads};
+    return load_dat_files(files, nIntegrationSteps, pool);
+}
@@ -14,6 +14,10 @@
 
 #include "FITS.hpp"
 #include "memory_buffer.hpp"
+#include "file_reader.hpp"
+#include "channel_mask.hpp"
+#include "voltage_statistics.hpp"
+#include "spectral_kurtosis.hpp"
 
 enum class TelescopeID {MWA1, MWA2, MWA3, EDA2};
 /**
@@ -24,7 +28,8 @@ struct ObservationInfo {
     unsigned int nAntennas;
     unsigned int nFrequencies;
     unsigned int nPolarizations;
-    unsigned int nTimesteps;
+    // 64 bits, so that hours of high time resolution data can be held and indexed in a single object.
+    size_t nTimesteps;
     // Time resolution in seconds
     double timeResolution;
     // Fine channel frequency resolution in MHz
@@ -42,6 +47,9 @@ struct ObservationInfo {
     TelescopeID telescope;
     std::string metadata_file;
     std::string calibration_solutions_file;
+    // Index, in the original observation, of each antenna held by the data, when some antennas (e.g. flagged
+    // tiles) have been dropped at ingest. Empty means that all the antennas are present, in order.
+    std::vector<unsigned int> antennaIndices;
 };
 
 
@@ -57,49 +65,129 @@ extern const ObservationInfo VCS_OBSERVATION_INFO;
 
 // Prefilled ObservationInfo structure for EDA2 data
 extern const ObservationInfo EDA2_OBSERVATION_INFO;
+
+
+/**
+ * @brief Options controlling how `Voltages::from_dat_file` reads a .dat file.
+ */
+struct DatReadOptions {
+    // Number of threads reading and expanding the file. When greater than one, the file is split in
+    // disjoint timestep ranges, each read with `pread` and expanded by its own thread.
+    unsigned int nThreads {1};
+    // Number of timesteps read from the file at each read call. Determines the size of the staging buffers.
+    unsigned int timestepsPerRead {100u};
+    // Number of staging buffers used by the single threaded reader. When greater than one, an I/O thread
+    // reads up to `queueDepth` chunks ahead while the calling thread expands them.
+    unsigned int queueDepth {2u};
+    // How data is read from disk: through the page cache, with O_DIRECT, or with io_uring.
+    ReadBackend backend {ReadBackend::BUFFERED};
+    // Index of the first timestep to read. Timesteps before it are not read from disk.
+    size_t firstTimestep {0u};
+    // Number of timesteps to read starting from `firstTimestep`. Zero means up to the end of the observation.
+    size_t nTimesteps {0u};
+    // Indices of the channels to expand, in the order they will appear in the output. Empty means all of them.
+    std::vector<unsigned int> channels;
+    // Channels set to zero instead of being expanded, e.g. the edges of the PFB or channels affected by RFI.
+    // Indexed as in the file, regardless of `channels`. Empty means no channel is flagged.
+    ChannelMask flaggedChannels;
+    // Position, within a channel, where each input (station/polarization pair in file order) is written,
+    // e.g. the correlator input mapping returned by `read_metafits_mapping`. Empty keeps the file order.
+    std::vector<int> inputMapping;
+    // Antennas dropped from the output, indexed as after `inputMapping` has been applied, e.g. the flags
+    // returned by `read_metafits_flagged_antennas`. The remaining antennas are compacted, keeping their
+    // order, and `obsInfo.antennaIndices` records where they come from. Empty means no antenna is dropped.
+    std::vector<bool> flaggedAntennas;
+    // Number of timesteps the spectral kurtosis RFI detector is computed on, when RFI flags are requested
+    // (see `SpectralKurtosisFlagger`). It must divide `nIntegrationSteps`; zero means whole integration intervals.
+    unsigned int kurtosisBlockSize {0u};
+    // Number of standard deviations the spectral kurtosis of a block can deviate from one before it is flagged.
+    // Continuous waves bring the estimator to zero: with short blocks, high thresholds leave them undetected.
+    double kurtosisThreshold {3.0};
+};
+
+/**
+ * @brief Options controlling how `Voltages::from_sub_file` reads a MWAX subfile.
+ */
+struct SubfileReadOptions {
+    // Number of threads reordering the data blocks, each thread taking a contiguous range of blocks.
+    unsigned int nThreads {1};
+    // Index of the first data block to read. Blocks before it are not read from disk.
+    size_t firstBlock {0u};
+    // Number of blocks to read starting from `firstBlock`. Zero means up to the end of the subfile.
+    size_t nBlocks {0u};
+    // Output position of each input (station/polarization pair in file order). Empty keeps the file order.
+    std::vector<int> inputMapping;
+};
+
+/**
+ * @brief Options controlling how `Voltages::from_eda2_hdf5_file` reads an EDA2 station HDF5 file.
+ */
+struct Eda2ReadOptions {
+    // Number of threads reading and reordering the data, each taking whole hyperslabs.
+    unsigned int nThreads {1};
+    // Index of the first timestep to read.
+    size_t firstTimestep {0u};
+    // Number of timesteps to read starting from `firstTimestep`. Zero means up to the end of the dataset.
+    size_t nTimesteps {0u};
+    // Timesteps in a hyperslab when the dataset is not chunked; chunked datasets are read one chunk at a time.
+    size_t timestepsPerRead {16384u};
+    // Path of the voltage dataset within the file.
+    std::string dataset {"chan_/data"};
+};
+
 /**
  * @brief Voltage data making up an observation recorded by a radiotelescope.
  * 
- * Data is stored as an array `data` of 16-bit complex samples, 8 bits for the real
- * part and 8 bits for the complex one. Telescope and observation characteristics 
+ * Data is stored as an array `data` of complex samples of type `std::complex<T>`, e.g. 8 bits for
+ * the real part and 8 bits for the complex one for `Voltages`. Telescope and observation characteristics 
  * are collected into the `obsInfo` attribute. Data layout facilitates the integration
  * operation over `nIntegrationSteps` time steps. In particular, the array data represents
  * a multidimentional matrix whose dimensions are
  *  [integration_interval][frequency][antenna][polarization][time_step].
+ *
+ * The class is instantiated for `int8_t`, `int16_t` and `float` samples; 4+4 bit samples are held by
+ * `PackedVoltages`. Readers decode the input with the 8-bit kernels and, for the other sample types,
+ * convert a few timesteps at a time with the vectorised kernels of `sample_conversion.hpp` while
+ * decoding, so that the output is written once and downstream code receives samples of the type it works with.
  */
-class Voltages : public MemoryBuffer<std::complex<int8_t>> {
+template <typename T>
+class BasicVoltages : public MemoryBuffer<std::complex<T>> {
+
+    using Buffer = MemoryBuffer<std::complex<T>>;
 
     public:
+    using SampleType = T;
+
     ObservationInfo obsInfo;
     unsigned int nIntegrationSteps;
 
-    Voltages& operator=(Voltages&& other){
-        MemoryBuffer::operator=(std::move(other));
+    BasicVoltages& operator=(BasicVoltages&& other){
+        Buffer::operator=(std::move(other));
         obsInfo = other.obsInfo;
         nIntegrationSteps = other.nIntegrationSteps;
         return *this;
     }
 
-    Voltages& operator=(Voltages& other){
+    BasicVoltages& operator=(BasicVoltages& other){
         if(this == &other) return *this;
-        MemoryBuffer::operator=(other);
+        Buffer::operator=(other);
         obsInfo = other.obsInfo;
         nIntegrationSteps = other.nIntegrationSteps;
         return *this;
     }
 
-    Voltages(MemoryBuffer<std::complex<int8_t>>&& data, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps) : MemoryBuffer {std::move(data)} {
+    BasicVoltages(Buffer&& data, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps) : Buffer {std::move(data)} {
         this->obsInfo = obsInfo;
         this->nIntegrationSteps = nIntegrationSteps;
     }
 
-    Voltages(const Voltages& other) : MemoryBuffer {other} {
+    BasicVoltages(const BasicVoltages& other) : Buffer {other} {
         obsInfo = other.obsInfo;
         nIntegrationSteps = other.nIntegrationSteps;
     }
 
 
-    Voltages(Voltages&& other) : MemoryBuffer {std::move(other)} {
+    BasicVoltages(BasicVoltages&& other) : Buffer {std::move(other)} {
         obsInfo = other.obsInfo;
         nIntegrationSteps = other.nIntegrationSteps;
     }
@@ -123,14 +211,64 @@ class Voltages : public MemoryBuffer<std::complex<int8_t>> {
      * @param obsInfo; metadata information regarding the obervation. For VCS data, you can use the constant
      * VCS_OVSERVATION_INFO.
      * @param nIntegrationSteps: number of timesteps to integrate over when/if data will be correlated.
-     * @param edge: set to zero `edge` channels at the top and the bottom of the frequency band.
-     * @param timestepsPerRead: number of timesteps o read from the file at each read call. Might be useful
-     * to optimise memory consumption.
+     * @param nThreads: number of threads reading and expanding the file. When greater than one, the file
+     * is split in disjoint timestep ranges, each read with `pread` and expanded by its own thread.
+     * @return A new instance of the Voltage class.
+     */
+    static BasicVoltages from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        unsigned int nThreads = 1);
+
+    /**
+     * Read voltage data from a .dat file, as above, with the reading strategy specified by `options`.
+     *
+     * `options` can also restrict the read to a range of timesteps and a subset of channels. Only the
+     * selected timesteps are read from disk and only the selected channels are expanded. The returned
+     * object has `obsInfo.nTimesteps` and `obsInfo.nFrequencies` set to the size of the selection; the
+     * start time is not changed, as it only has a resolution of one second.
+     */
+    static BasicVoltages from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        const DatReadOptions& options);
+
+    /**
+     * As above, but statistics of the expanded samples (mean power, histograms of the 4-bit values and
+     * saturation counts, see `VoltageStatistics`) are also computed while the file is expanded, and
+     * returned in `statistics`. Its previous content is replaced.
+     */
+    static BasicVoltages from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        const DatReadOptions& options, VoltageStatistics& statistics);
+
+    /**
+     * As above, but impulsive RFI is detected while the file is expanded, with a spectral kurtosis estimator
+     * computed on blocks of `options.kurtosisBlockSize` timesteps of each channel and input (see
+     * `SpectralKurtosisFlagger`). The (interval, channel, input) triplets holding a block that deviates from
+     * Gaussian noise are flagged in `rfiMask`, whose previous content is replaced. Samples are not changed:
+     * `apply_rfi_mask` zeroes the flagged ones, e.g. before correlation.
+     */
+    static BasicVoltages from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        const DatReadOptions& options, RfiMask& rfiMask);
+
+    /**
+     * Read voltage data from a .dat file by memory mapping it. Samples are expanded directly from
+     * the mapped pages, avoiding the intermediate staging buffer and `read` calls of `from_dat_file`.
+     * The kernel is advised the file will be read sequentially, once. The resulting layout is the same
+     * as the one produced by `from_dat_file`. Voltage archives cannot be mapped and are read as
+     * `from_dat_file` does.
+     *
+     * @param filename: path to the .dat file.
+     * @param obsInfo; metadata information regarding the obervation. For VCS data, you can use the constant
+     * VCS_OVSERVATION_INFO.
+     * @param nIntegrationSteps: number of timesteps to integrate over when/if data will be correlated.
      * @return A new instance of the Voltage class.
      */
-    static Voltages from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps);
+    static BasicVoltages from_dat_file_mmap(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps);
 
-    static Voltages from_dat_file_gpu(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps);
+    /**
+     * Read voltage data from a .dat file and expand it on the GPU. Channels in `flaggedChannels` are
+     * zeroed with a memset and skipped by the expansion kernel. The data stays on the GPU, hence only
+     * 8-bit samples are supported. Voltage archives are rejected with `std::invalid_argument`.
+     */
+    static BasicVoltages from_dat_file_gpu(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        const ChannelMask& flaggedChannels = ChannelMask {});
     /**
      * Read voltage data from a memory buffer.
      * Data in memory is ordered according to the following axes, from the slowest to the fastest:
@@ -147,24 +285,128 @@ class Voltages : public MemoryBuffer<std::complex<int8_t>> {
      * @param nIntegrationSteps: number of timesteps to integrate over when/if data will be correlated.
      * @param use_pinned_mem: if GPU support is enabled, gives the option to pin CPU memory for fast memory
      * transfers to GPU.
+     * @param nThreads: number of threads reordering the data, which is done with a cache blocked transpose.
+     * @param streamingStores: write the output with non-temporal stores, bypassing the cache. It pays off
+     * when the output is much larger than the last level cache and is not consumed right away.
+     * @return A new instance of the Voltage class.
+     */
+    static BasicVoltages from_memory(const int8_t *buffer, size_t length, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,\
+        bool use_pinned_mem = false, unsigned int nThreads = 1, bool streamingStores = false);
+
+    /**
+     * As above, but input `j` of each channel is written to the output position `inputMapping[j]`, i.e.
+     * station * nPolarizations + polarization, while the data is being reordered. The mapping, e.g. as
+     * returned by `read_metafits_mapping`, must be a permutation of the inputs.
+     */
+    static BasicVoltages from_memory(const int8_t *buffer, size_t length, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        const std::vector<int>& inputMapping, bool use_pinned_mem = false, unsigned int nThreads = 1, bool streamingStores = false);
+
+    /**
+     * Read voltage data from a memory buffer holding packed 4+4 bit samples, i.e. in the format of a
+     * .dat file, ordered as
+     *      [time][channel][station][polarization]
+     * Samples are expanded and reordered in a single pass, with the same kernels used by `from_dat_file`,
+     * without an intermediate 8+8 bit copy of the buffer.
+     *
+     * @param buffer: memory buffer where to read data from.
+     * @param length: number of bytes in the buffer, i.e. one per complex sample.
+     * @param obsInfo; metadata information regarding the obervation.
+     * @param nIntegrationSteps: number of timesteps to integrate over when/if data will be correlated.
+     * @param inputMapping: if not empty, output position of each input, as for `from_memory`.
+     * @param use_pinned_mem: if GPU support is enabled, gives the option to pin CPU memory for fast memory
+     * transfers to GPU.
+     * @param nThreads: number of threads expanding the data.
      * @return A new instance of the Voltage class.
-     * 
-     * TODO: check if we need the edge feature.
      */
-    static Voltages from_memory(const int8_t *buffer, size_t length, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,\
-        bool use_pinned_mem = false);
+    static BasicVoltages from_packed_memory(const uint8_t *buffer, size_t length, const ObservationInfo& obsInfo,
+        unsigned int nIntegrationSteps, const std::vector<int>& inputMapping = std::vector<int> {}, bool use_pinned_mem = false,
+        unsigned int nThreads = 1);
 
 
 
     /**
      * Read EDA2 voltage data from a binary dump of the corresponding HDF5 file.
-     * (This is mainly used for testing purposes, we should probably read the HDF5 file directly)
+     * (This is mainly used for testing purposes; see `from_eda2_hdf5_file` to read the HDF5 file directly)
+     *
+     * The file is memory mapped and reordered directly into the output with the same blocked transpose
+     * used by `from_memory`, which is run on `nThreads` threads.
     */
-    static Voltages from_eda2_file(const std::string& filename, const ObservationInfo& obs_info, unsigned int nIntegrationSteps);
+    static BasicVoltages from_eda2_file(const std::string& filename, const ObservationInfo& obs_info, unsigned int nIntegrationSteps,
+        unsigned int nThreads = 1);
+
+    /**
+     * Read EDA2 voltage data straight from the station HDF5 file, without dumping it to a binary file first.
+     * The dataset must hold 8+8 bit samples ordered as [time][channel][station][polarization] (see `Eda2Hdf5File`).
+     *
+     * The dataset is read in hyperslabs aligned to its chunks, each covering the stations of a chunk, so that
+     * every chunk is read and decompressed once. Hyperslabs are reordered into the output as soon as they are
+     * read, by `options.nThreads` threads; calls into the HDF5 library itself are serialised.
+     * `obsInfo.nTimesteps` is set to the number of timesteps read.
+     *
+     * @param filename: path to the HDF5 file.
+     * @param obs_info: channels, stations and polarizations in the file, e.g. EDA2_OBSERVATION_INFO.
+     * @param nIntegrationSteps: number of timesteps to integrate over when/if data will be correlated.
+     * @param options: timesteps to read, threads and dataset path.
+     * @param use_pinned_mem: if GPU support is enabled, gives the option to pin CPU memory for fast memory
+     * transfers to GPU.
+     * @throws std::runtime_error if the library was built without HDF5 support or the file cannot be read.
+     */
+    static BasicVoltages from_eda2_hdf5_file(const std::string& filename, const ObservationInfo& obs_info,
+        unsigned int nIntegrationSteps, const Eda2ReadOptions& options = Eda2ReadOptions {}, bool use_pinned_mem = false);
+
+    /**
+     * Read voltage data from a MWAX voltage subfile (.sub), the format recorded by MWA Phase 3. The observation
+     * information is taken from the header of the file (see `parse_subfile_header`); the data has a single
+     * frequency channel, at the coarse channel resolution.
+     *
+     * The file is mapped in memory and its 8+8 bit samples are copied, block by block, straight into the
+     * layout of the returned object. Blocks are independent: they are split among `options.nThreads` threads,
+     * and `options` can restrict the read to a range of blocks, in which case only those are read from disk.
+     * `obsInfo.nTimesteps` is then set to the number of timesteps read; the start time is not changed.
+     *
+     * @param filename: path to the .sub file.
+     * @param nIntegrationSteps: number of timesteps to integrate over when/if data will be correlated.
+     * @param options: blocks to read, threads and input mapping.
+     * @param use_pinned_mem: if GPU support is enabled, gives the option to pin CPU memory for fast memory
+     * transfers to GPU.
+     */
+    static BasicVoltages from_sub_file(const std::string& filename, unsigned int nIntegrationSteps,
+        const SubfileReadOptions& options = SubfileReadOptions {}, bool use_pinned_mem = false);
+
+    /**
+     * Write the voltages to a .dat file, i.e. packed back to 4+4 bit samples ordered as
+     *      [time][channel][station][polarization]
+     * Only the `obsInfo.nTimesteps` timesteps are written, not the padding of the last integration interval.
+     * Values outside of the 4-bit range [-8, 7] are saturated; voltages read with `from_dat_file` are
+     * written back byte for byte.
+     *
+     * Timesteps are packed in chunks of a few MiB, aligned to the page size, and each chunk is written
+     * while the next one is being packed.
+     *
+     * @param filename: path to the .dat file to create or overwrite.
+     * @param inputMapping: if not empty, the input mapping the voltages were read with. It is undone, such
+     * that inputs are written in the original file order.
+     */
+    void to_dat_file(const std::string& filename, const std::vector<int>& inputMapping = std::vector<int> {}) const;
+
+    /**
+     * Set to zero the samples of each integration interval, channel and input flagged in `rfiMask`, e.g. the
+     * mask computed by `from_dat_file`, so that they do not contribute to the visibilities.
+     *
+     * @throws std::invalid_argument if the mask does not have the shape of the voltages, or the data resides
+     * in GPU memory.
+     */
+    void apply_rfi_mask(const RfiMask& rfiMask);
 
 };
 
 
+/**
+ * @brief Voltages with 8+8 bit complex samples, the format expected by the correlator.
+ */
+using Voltages = BasicVoltages<int8_t>;
+
+
 /**
  * @brief Correlated voltages, also known as visibilities.
  * 
@@ -225,12 +467,12 @@ class Visibilities : public MemoryBuffer<std::complex<float>> {
     }
 
 
-    std::complex<float> *at(unsigned int interval, unsigned int frequency, unsigned int a1, unsigned a2){
+    std::complex<float> *at(size_t interval, unsigned int frequency, unsigned int a1, unsigned a2){
         const size_t nValuesInTimeInterval {this->matrix_size() * nFrequencies};
         // TODO: use actual frequency instead of a "frequency index". To do so, information must
         // be provided by the user.
         std::complex<float> *pData = this->data() + nValuesInTimeInterval * interval + this->matrix_size() * frequency;
-        unsigned int min_a, max_a;
+        size_t min_a, max_a;
         if(a1 < a2) {
             min_a = a1;
             max_a = a2;
@@ -238,8 +480,8 @@ class Visibilities : public MemoryBuffer<std::complex<float>> {
             min_a = a2;
             max_a = a1;
         }
-        unsigned int baseline = (max_a * (max_a + 1))/2 + min_a;
-        pData += this->obsInfo.nPolarizations * this->obsInfo.nPolarizations * baseline;
+        const size_t baseline {(max_a * (max_a + 1))/2 + min_a};
+        pData += static_cast<size_t>(this->obsInfo.nPolarizations) * this->obsInfo.nPolarizations * baseline;
         return pData;
     }
 
@@ -252,7 +494,7 @@ class Visibilities : public MemoryBuffer<std::complex<float>> {
     
     // Number of complex visibilities in one frequency channel.
     size_t matrix_size() const {
-        const size_t n_baselines {((obsInfo.nAntennas + 1) * obsInfo.nAntennas) / 2};
+        const size_t n_baselines {((static_cast<size_t>(obsInfo.nAntennas) + 1) * obsInfo.nAntennas) / 2};
         return n_baselines * obsInfo.nPolarizations * obsInfo.nPolarizations;
     }
 
@@ -316,4 +558,29 @@ std::vector<std::vector<DatFile>> parse_mwa_dat_files(std::vector<std::string>&
  * observation, single 24 files.
 */
 std::vector<std::vector<DatFile>> parse_mwa_dat_files(std::string directory, int start_second = 0, int count = -1);
+
+
+class ThreadPool;
+
+/**
+ * @brief Load concurrently a group of .dat files, typically the 24 coarse channels making up one second
+ * of observation as returned by `parse_mwa_dat_files`.
+ *
+ * @param files: the .dat files to load, each with its own observation information.
+ * @param nIntegrationSteps: number of timesteps to integrate over when/if data will be correlated.
+ * @param pool: worker pool the files are loaded on. Reuse the same pool across calls to avoid creating
+ * threads every second of data.
+ * @param maxFilesInFlight: maximum number of files being read at the same time, useful to limit the load on
+ * the filesystem. Zero means as many as the workers in the pool.
+ * @param options: how each file is read, see `Voltages::from_dat_file`.
+ * @return A `Voltages` object for each file, in the same order as `files`.
+ */
+std::vector<Voltages> load_dat_files(const std::vector<DatFile>& files, unsigned int nIntegrationSteps, ThreadPool& pool,
+    unsigned int maxFilesInFlight = 0, const DatReadOptions& options = DatReadOptions {});
+
+
+/**
+ * @brief As above, on a temporary pool of `nThreads` workers.
+ */
+std::vector<Voltages> load_dat_files(const std::vector<DatFile>& files, unsigned int nIntegrationSteps, unsigned int nThreads);
 #endif
@@ -0,0 +1,88 @@
+#ifndef __CHANNEL_MASK_H__
+#define __CHANNEL_MASK_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+
+
+/**
+ * @brief A set of flagged fine channels, e.g. the edges of the polyphase filterbank or channels known
+ * to be affected by RFI, stored as a bitmask with one bit per channel.
+ *
+ * A default constructed mask has no channels and flags nothing; it can be passed wherever a mask is
+ * optional.
+ */
+class ChannelMask {
+    private:
+    std::vector<uint64_t> words;
+    unsigned int nChannels {0};
+
+    public:
+    ChannelMask() {}
+
+    /**
+     * @brief Create a mask for `nChannels` channels, none of which is flagged.
+     */
+    explicit ChannelMask(unsigned int nChannels) : words((nChannels + 63) / 64, 0), nChannels {nChannels} {}
+
+    /**
+     * @brief Create a mask flagging `edge` channels at the bottom and the top of a band of `nChannels` channels.
+     */
+    static ChannelMask edges(unsigned int nChannels, unsigned int edge){
+        ChannelMask mask {nChannels};
+        for(unsigned int ch {0}; ch < nChannels; ch++)
+            if(ch < edge || ch + edge >= nChannels) mask.flag(ch);
+        return mask;
+    }
+
+    /**
+     * @brief Number of channels the mask refers to, zero for an empty mask.
+     */
+    unsigned int size() const { return nChannels; }
+
+    bool empty() const { return nChannels == 0; }
+
+    void flag(unsigned int ch){
+        if(ch >= nChannels) throw std::out_of_range {"ChannelMask::flag: channel index out of range."};
+        words[ch / 64] |= uint64_t {1} << (ch % 64);
+    }
+
+    void unflag(unsigned int ch){
+        if(ch >= nChannels) throw std::out_of_range {"ChannelMask::unflag: channel index out of range."};
+        words[ch / 64] &= ~(uint64_t {1} << (ch % 64));
+    }
+
+    /**
+     * @brief Whether channel `ch` is flagged. Channels outside the mask are never flagged.
+     */
+    bool flagged(unsigned int ch) const {
+        return ch < nChannels && ((words[ch / 64] >> (ch % 64)) & 1u);
+    }
+
+    /**
+     * @brief Number of flagged channels.
+     */
+    unsigned int count() const {
+        unsigned int n {0};
+        for(uint64_t w : words) n += static_cast<unsigned int>(__builtin_popcountll(w));
+        return n;
+    }
+
+    /**
+     * @brief Index of the first channel not flagged from `ch` onwards, or `size()`. Used to process
+     * runs of consecutive flagged channels at once.
+     */
+    unsigned int end_of_run(unsigned int ch) const {
+        while(ch < nChannels && flagged(ch)) ch++;
+        return ch;
+    }
+
+    /**
+     * @brief The bitmask, as `(size() + 63) / 64` words; bit `ch % 64` of word `ch / 64` is channel `ch`.
+     */
+    const uint64_t* data() const { return words.data(); }
+};
+
+#endif
@@ -0,0 +1,368 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include "correlation.hpp"
+#include "parallel.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#define ASTROIO_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Rows (inputs) of the first, unconjugated, operand and of the second, conjugated, one in a tile of baselines.
+    constexpr size_t TILE_ROWS {32};
+    constexpr size_t TILE_COLUMNS {4};
+    // Bytes, i.e. two samples, multiplied by a single 32-bit lane of the dot product instructions.
+    constexpr size_t GROUP_BYTES {4};
+    // Bytes of a row correlated in 32-bit lanes before they are added to the 64-bit totals: groups of four
+    // products, at most 4 * 255 * 127, keep 8192 groups below 2^31.
+    constexpr size_t CHUNK_BYTES {32768};
+    // Row length granularity, in bytes, i.e. the widest vector.
+    constexpr size_t ROW_ALIGNMENT {64};
+
+
+    /*
+        Samples of the inputs of one channel and interval, laid out for the kernels, and the integer
+        products accumulated for the output channel they contribute to.
+    */
+    struct CorrelationScratch {
+        // Rows, i.e. inputs, rounded up to whole tiles, and bytes in each row, zero padded.
+        size_t nRows {0};
+        size_t rowBytes {0};
+        // Interleaved (re, im) samples, saturated to [-127, 127], as [row][byte].
+        std::vector<int8_t> samples;
+        // (-im, re) pairs: the dot product of a row of `samples` with one of these is the imaginary part
+        // of the product of the first row with the conjugate of the second.
+        std::vector<int8_t> conjugates;
+        // `samples` as [group][row][byte in group], so that a vector holds a group of consecutive rows. Plus
+        // 128, i.e. unsigned, for the kernels taking unsigned operands.
+        std::vector<uint8_t> transposed;
+        // Sum of the bytes of each row of `samples` and `conjugates`, over all the channels accumulated.
+        std::vector<int64_t> sums;
+        std::vector<int64_t> conjugateSums;
+        // Products of the rows of `samples` with the conjugate of the others, as [second row][first row].
+        std::vector<int64_t> re;
+        std::vector<int64_t> im;
+
+        CorrelationScratch(size_t nInputs, size_t nSteps) : nRows {(nInputs + TILE_ROWS - 1) / TILE_ROWS * TILE_ROWS},
+            rowBytes {(2 * nSteps + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT},
+            samples(nRows * rowBytes, 0), conjugates(nRows * rowBytes, 0), transposed(nRows * rowBytes, 0),
+            sums(nRows, 0), conjugateSums(nRows, 0), re(nRows * nRows, 0), im(nRows * nRows, 0) {}
+    };
+
+
+    /*
+        Correlation kernels compute the products of the rows [i0, i0 + TILE_ROWS) with the conjugate of the rows
+        [j0, j0 + TILE_COLUMNS), over the bytes [begin, end) of the rows, at most CHUNK_BYTES, and store them in
+        `re` and `im`, or add them to the previous values if `accumulate` is true. `begin` and `end` are multiples
+        of ROW_ALIGNMENT.
+
+        Vector kernels are register tiled: a vector holds a group of bytes of consecutive first rows, and is
+        multiplied by the same group of each second row broadcast to all the lanes, so that each lane sums the
+        products of a single baseline and no horizontal reduction is needed. Kernels taking unsigned
+        operands compute the products plus 128 times the sum of the second row, which the caller subtracts.
+    */
+    using CorrelationKernelFn = void (*)(CorrelationScratch&, size_t, size_t, size_t, size_t, bool);
+
+    /*
+        Row kernels saturate the `nBytes` bytes of a row to [-127, 127], store them in `samples` and their
+        (-im, re) pairs in `conjugates`, and add the sum of the bytes of each to `sum` and `conjugateSum`.
+    */
+    using RowKernel = void (*)(const int8_t*, size_t, int8_t*, int8_t*, int64_t&, int64_t&);
+
+    struct CorrelationKernel {
+        CorrelationKernelFn fn;
+        RowKernel prepareRow;
+        bool offset;
+        const char *name;
+    };
+
+
+    void prepare_row_scalar_range(const int8_t *row, size_t begin, size_t nBytes, int8_t *samples, int8_t *conjugates,
+            int64_t& sum, int64_t& conjugateSum){
+        for(size_t k {begin}; k < nBytes; k += 2){
+            const int8_t re {std::max<int8_t>(row[k], -127)}, im {std::max<int8_t>(row[k + 1], -127)};
+            samples[k] = re;
+            samples[k + 1] = im;
+            conjugates[k] = static_cast<int8_t>(-im);
+            conjugates[k + 1] = re;
+            sum += re + im;
+            conjugateSum += re - im;
+        }
+    }
+
+
+    void prepare_row_scalar(const int8_t *row, size_t nBytes, int8_t *samples, int8_t *conjugates, int64_t& sum, int64_t& conjugateSum){
+        prepare_row_scalar_range(row, 0, nBytes, samples, conjugates, sum, conjugateSum);
+    }
+
+
+    void correlate_tile_scalar(CorrelationScratch& s, size_t i0, size_t j0, size_t begin, size_t end, bool accumulate){
+        for(size_t j {j0}; j < j0 + TILE_COLUMNS; j++){
+            const int8_t *b {s.samples.data() + j * s.rowBytes}, *c {s.conjugates.data() + j * s.rowBytes};
+            for(size_t i {i0}; i < i0 + TILE_ROWS; i++){
+                const int8_t *a {s.samples.data() + i * s.rowBytes};
+                int32_t sumRe {0}, sumIm {0};
+                for(size_t k {begin}; k < end; k++){
+                    sumRe += a[k] * b[k];
+                    sumIm += a[k] * c[k];
+                }
+                s.re[j * s.nRows + i] = (accumulate ? s.re[j * s.nRows + i] : 0) + sumRe;
+                s.im[j * s.nRows + i] = (accumulate ? s.im[j * s.nRows + i] : 0) + sumIm;
+            }
+        }
+    }
+
+
+    inline int32_t load_group(const int8_t *p){
+        int32_t v;
+        std::memcpy(&v, p, GROUP_BYTES);
+        return v;
+    }
+
+
+    #ifdef ASTROIO_X86_SIMD
+
+    __attribute__((target("avx2")))
+    int32_t hsum_epi32_avx2(__m256i v){
+        __m128i x {_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1))};
+        x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+        x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(x);
+    }
+
+
+    __attribute__((target("avx2")))
+    void prepare_row_avx2(const int8_t *row, size_t nBytes, int8_t *samples, int8_t *conjugates, int64_t& sum, int64_t& conjugateSum){
+        const __m256i minimum {_mm256_set1_epi8(-127)};
+        // swaps the bytes of each (re, im) pair, then negates the first one.
+        const __m256i swap {_mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)};
+        const __m256i negateFirst {_mm256_set1_epi16(0x01FF)};
+        const __m256i onesU8 {_mm256_set1_epi8(1)}, ones16 {_mm256_set1_epi16(1)};
+        __m256i acc {_mm256_setzero_si256()}, accConjugate {_mm256_setzero_si256()};
+        size_t k {0};
+        for(; k + 32 <= nBytes; k += 32){
+            const __m256i v {_mm256_max_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + k)), minimum)};
+            const __m256i c {_mm256_sign_epi8(_mm256_shuffle_epi8(v, swap), negateFirst)};
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(samples + k), v);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(conjugates + k), c);
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(onesU8, v), ones16));
+            accConjugate = _mm256_add_epi32(accConjugate, _mm256_madd_epi16(_mm256_maddubs_epi16(onesU8, c), ones16));
+        }
+        sum += hsum_epi32_avx2(acc);
+        conjugateSum += hsum_epi32_avx2(accConjugate);
+        prepare_row_scalar_range(row, k, nBytes, samples, conjugates, sum, conjugateSum);
+    }
+
+
+    __attribute__((target("avx2")))
+    inline void store_sums_avx2(int64_t *dest, __m256i sums, bool accumulate){
+        __m256i lo {_mm256_cvtepi32_epi64(_mm256_castsi256_si128(sums))}, hi {_mm256_cvtepi32_epi64(_mm256_extracti128_si256(sums, 1))};
+        if(accumulate){
+            lo = _mm256_add_epi64(lo, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest)));
+            hi = _mm256_add_epi64(hi, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + 4)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + 4), hi);
+    }
+
+
+    /*
+        vpmaddubsw multiplies unsigned by signed bytes: the first rows enter as their absolute value and
+        their sign is moved to the second one. Pairs of products, at most 2 * 127^2, fit the 16-bit lanes.
+        The tile is processed as 2 x 2 sub-tiles of 16 first rows and 2 second rows, whose 8 accumulators
+        fit the registers.
+    */
+    __attribute__((target("avx2")))
+    void correlate_tile_avx2(CorrelationScratch& s, size_t i0, size_t j0, size_t begin, size_t end, bool accumulate){
+        const __m256i ones {_mm256_set1_epi16(1)};
+        for(size_t ii {0}; ii < TILE_ROWS; ii += 16){
+            for(size_t jj {0}; jj < TILE_COLUMNS; jj += 2){
+                const int8_t *b[2] {s.samples.data() + (j0 + jj) * s.rowBytes, s.samples.data() + (j0 + jj + 1) * s.rowBytes};
+                const int8_t *c[2] {s.conjugates.data() + (j0 + jj) * s.rowBytes, s.conjugates.data() + (j0 + jj + 1) * s.rowBytes};
+                // accumulator (y * 2 + x) * 2 + {0: real, 1: imaginary} for rows [i0 + ii + 8x, i0 + ii + 8x + 8), j0 + jj + y.
+                __m256i acc[8];
+                for(auto& v : acc) v = _mm256_setzero_si256();
+                for(size_t k {begin}; k < end; k += GROUP_BYTES){
+                    const uint8_t *pa {s.transposed.data() + (k / GROUP_BYTES * s.nRows + i0 + ii) * GROUP_BYTES};
+                    const __m256i va[2] {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pa)),
+                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pa + 32))};
+                    const __m256i absA[2] {_mm256_abs_epi8(va[0]), _mm256_abs_epi8(va[1])};
+                    for(unsigned int y {0}; y < 2; y++){
+                        const __m256i vb {_mm256_set1_epi32(load_group(b[y] + k))}, vc {_mm256_set1_epi32(load_group(c[y] + k))};
+                        for(unsigned int x {0}; x < 2; x++){
+                            const __m256i pRe {_mm256_maddubs_epi16(absA[x], _mm256_sign_epi8(vb, va[x]))};
+                            const __m256i pIm {_mm256_maddubs_epi16(absA[x], _mm256_sign_epi8(vc, va[x]))};
+                            acc[(y * 2 + x) * 2] = _mm256_add_epi32(acc[(y * 2 + x) * 2], _mm256_madd_epi16(pRe, ones));
+                            acc[(y * 2 + x) * 2 + 1] = _mm256_add_epi32(acc[(y * 2 + x) * 2 + 1], _mm256_madd_epi16(pIm, ones));
+                        }
+                    }
+                }
+                for(unsigned int y {0}; y < 2; y++){
+                    for(unsigned int x {0}; x < 2; x++){
+                        const size_t offset {(j0 + jj + y) * s.nRows + i0 + ii + 8 * x};
+                        store_sums_avx2(s.re.data() + offset, acc[(y * 2 + x) * 2], accumulate);
+                        store_sums_avx2(s.im.data() + offset, acc[(y * 2 + x) * 2 + 1], accumulate);
+                    }
+                }
+            }
+        }
+    }
+
+
+    __attribute__((target("avx512f")))
+    inline void store_sums_avx512(int64_t *dest, __m512i sums, bool accumulate){
+        __m512i lo {_mm512_cvtepi32_epi64(_mm512_castsi512_si256(sums))}, hi {_mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(sums, 1))};
+        if(accumulate){
+            lo = _mm512_add_epi64(lo, _mm512_loadu_si512(dest));
+            hi = _mm512_add_epi64(hi, _mm512_loadu_si512(dest + 8));
+        }
+        _mm512_storeu_si512(dest, lo);
+        _mm512_storeu_si512(dest + 8, hi);
+    }
+
+
+    /*
+        vpdpbusd multiplies unsigned by signed bytes and adds groups of four products straight into 32-bit
+        lanes. The first rows enter offset by 128, so that a single instruction computes the products of 16
+        baselines; the offset is removed with the row sums once the channel is done.
+    */
+    __attribute__((target("avx512f,avx512bw,avx512vnni")))
+    void correlate_tile_avx512vnni(CorrelationScratch& s, size_t i0, size_t j0, size_t begin, size_t end, bool accumulate){
+        const int8_t *b {s.samples.data() + j0 * s.rowBytes}, *c {s.conjugates.data() + j0 * s.rowBytes};
+        // accumulator (y * 2 + x) * 2 + {0: real, 1: imaginary} for rows [i0 + 16x, i0 + 16x + 16), j0 + y.
+        __m512i acc[4 * TILE_COLUMNS];
+        for(auto& v : acc) v = _mm512_setzero_si512();
+        for(size_t k {begin}; k < end; k += GROUP_BYTES){
+            const uint8_t *pa {s.transposed.data() + (k / GROUP_BYTES * s.nRows + i0) * GROUP_BYTES};
+            const __m512i va[2] {_mm512_loadu_si512(pa), _mm512_loadu_si512(pa + 64)};
+            for(unsigned int y {0}; y < TILE_COLUMNS; y++){
+                const __m512i vb {_mm512_set1_epi32(load_group(b + y * s.rowBytes + k))};
+                const __m512i vc {_mm512_set1_epi32(load_group(c + y * s.rowBytes + k))};
+                for(unsigned int x {0}; x < 2; x++){
+                    acc[(y * 2 + x) * 2] = _mm512_dpbusd_epi32(acc[(y * 2 + x) * 2], va[x], vb);
+                    acc[(y * 2 + x) * 2 + 1] = _mm512_dpbusd_epi32(acc[(y * 2 + x) * 2 + 1], va[x], vc);
+                }
+            }
+        }
+        for(unsigned int y {0}; y < TILE_COLUMNS; y++){
+            for(unsigned int x {0}; x < 2; x++){
+                const size_t offset {(j0 + y) * s.nRows + i0 + 16 * x};
+                store_sums_avx512(s.re.data() + offset, acc[(y * 2 + x) * 2], accumulate);
+                store_sums_avx512(s.im.data() + offset, acc[(y * 2 + x) * 2 + 1], accumulate);
+            }
+        }
+    }
+
+    #endif
+
+
+    CorrelationKernel select_correlation_kernel(SimdLevel level){
+        #ifdef ASTROIO_X86_SIMD
+        const SimdLevel supported {std::min(level, detect_simd_level())};
+        if(supported == SimdLevel::AVX512 && __builtin_cpu_supports("avx512vnni"))
+            return {correlate_tile_avx512vnni, prepare_row_avx2, true, "AVX-512 VNNI"};
+        // vpmaddubsw needs AVX2 for 256-bit vectors; narrower ones are not worth a kernel of their own.
+        if(supported >= SimdLevel::AVX2) return {correlate_tile_avx2, prepare_row_avx2, false, "AVX2"};
+        #endif
+        return {correlate_tile_scalar, prepare_row_scalar, false, "scalar"};
+    }
+
+
+    /**
+     * @brief Lay out the `nSteps` samples of each of `nInputs` rows for `kernel`, and add the sums of their
+     * bytes to the running ones.
+     */
+    void load_rows(const std::complex<int8_t> *rows, size_t nInputs, size_t nSteps, const CorrelationKernel& kernel,
+            CorrelationScratch& s){
+        // adding 128 to each byte flips its sign bit.
+        const uint32_t bias {kernel.offset ? 0x80808080u : 0u};
+        for(size_t r {0}; r < nInputs; r++){
+            int8_t *pSamples {s.samples.data() + r * s.rowBytes};
+            kernel.prepareRow(reinterpret_cast<const int8_t*>(rows + r * nSteps), 2 * nSteps, pSamples,
+                s.conjugates.data() + r * s.rowBytes, s.sums[r], s.conjugateSums[r]);
+            for(size_t k {0}; k < 2 * nSteps; k += GROUP_BYTES){
+                uint32_t group;
+                std::memcpy(&group, pSamples + k, GROUP_BYTES);
+                group ^= bias;
+                std::memcpy(s.transposed.data() + (k / GROUP_BYTES * s.nRows + r) * GROUP_BYTES, &group, GROUP_BYTES);
+            }
+        }
+    }
+}
+
+
+
+Visibilities correlate(const Voltages& voltages, const CorrelationOptions& options, SimdLevel level){
+    if(voltages.on_gpu()) throw std::invalid_argument {"correlate: voltages must reside in CPU memory."};
+    const ObservationInfo& obsInfo {voltages.obsInfo};
+    const unsigned int nAveraged {options.nAveragedChannels};
+    if(nAveraged == 0 || obsInfo.nFrequencies % nAveraged != 0)
+        throw std::invalid_argument {"correlate: the number of averaged channels must divide the number of channels."};
+    const unsigned int nPols {obsInfo.nPolarizations};
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * nPols};
+    const size_t nSteps {voltages.nIntegrationSteps};
+    const size_t nIntervals {(obsInfo.nTimesteps + nSteps - 1) / nSteps};
+    const unsigned int nOutChannels {obsInfo.nFrequencies / nAveraged};
+
+    const size_t nBaselines {(static_cast<size_t>(obsInfo.nAntennas) + 1) * obsInfo.nAntennas / 2};
+    MemoryBuffer<std::complex<float>> buffer {nIntervals * nOutChannels * nBaselines * nPols * nPols};
+    Visibilities visibilities {std::move(buffer), obsInfo, voltages.nIntegrationSteps, nAveraged};
+    const size_t matrixSize {visibilities.matrix_size()};
+    const CorrelationKernel kernel {select_correlation_kernel(level)};
+
+    parallel_for_ranges(nIntervals * nOutChannels, options.nThreads, 1, [&](size_t first, size_t last){
+        CorrelationScratch s {nInputs, nSteps};
+        for(size_t item {first}; item < last; item++){
+            const size_t interval {item / nOutChannels}, outChannel {item % nOutChannels};
+            std::fill(s.sums.begin(), s.sums.end(), 0);
+            std::fill(s.conjugateSums.begin(), s.conjugateSums.end(), 0);
+            for(unsigned int c {0}; c < nAveraged; c++){
+                const size_t channel {outChannel * nAveraged + c};
+                load_rows(voltages.data() + (interval * obsInfo.nFrequencies + channel) * nInputs * nSteps, nInputs, nSteps,
+                    kernel, s);
+                for(size_t i0 {0}; i0 < nInputs; i0 += TILE_ROWS){
+                    // columns up to the last input of the antenna of the last row in the tile.
+                    const size_t lastRow {std::min(i0 + TILE_ROWS, nInputs) - 1};
+                    const size_t nColumns {(lastRow / nPols + 1) * nPols};
+                    for(size_t j0 {0}; j0 < nColumns; j0 += TILE_COLUMNS)
+                        for(size_t begin {0}; begin < s.rowBytes; begin += CHUNK_BYTES)
+                            kernel.fn(s, i0, j0, begin, std::min(s.rowBytes, begin + CHUNK_BYTES), c > 0 || begin > 0);
+                }
+            }
+            // the last interval only holds data for part of its timesteps.
+            const size_t validSteps {std::min(nSteps, obsInfo.nTimesteps - interval * nSteps)};
+            const float norm {1.0f / static_cast<float>(validSteps * nAveraged)};
+            std::complex<float> *pVis {visibilities.data() + item * matrixSize};
+            // blocks of first antennas, so that the products are read along the rows of `re` and `im`.
+            const size_t blockAntennas {std::max<size_t>(1, TILE_ROWS / nPols)};
+            for(size_t b0 {0}; b0 < obsInfo.nAntennas; b0 += blockAntennas){
+                const size_t b1 {std::min<size_t>(obsInfo.nAntennas, b0 + blockAntennas)};
+                for(size_t a2 {0}; a2 < b1; a2++){
+                    for(unsigned int p2 {0}; p2 < nPols; p2++){
+                        const size_t j {a2 * nPols + p2};
+                        const int64_t *pRe {s.re.data() + j * s.nRows}, *pIm {s.im.data() + j * s.nRows};
+                        const int64_t offsetRe {kernel.offset ? 128 * s.sums[j] : 0}, offsetIm {kernel.offset ? 128 * s.conjugateSums[j] : 0};
+                        for(size_t a1 {std::max(a2, b0)}; a1 < b1; a1++){
+                            std::complex<float> *pBaseline {pVis + (a1 * (a1 + 1) / 2 + a2) * nPols * nPols};
+                            for(unsigned int p1 {0}; p1 < nPols; p1++){
+                                const size_t i {a1 * nPols + p1};
+                                pBaseline[p1 * nPols + p2] = {static_cast<float>(pRe[i] - offsetRe) * norm,
+                                    static_cast<float>(pIm[i] - offsetIm) * norm};
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+    return visibilities;
+}
+
+
+
+const char* correlation_kernel_name(SimdLevel level){
+    return select_correlation_kernel(level).name;
+}
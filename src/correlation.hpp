@@ -0,0 +1,48 @@
+#ifndef __CORRELATION_H__
+#define __CORRELATION_H__
+
+#include "astroio.hpp"
+#include "voltage_expansion.hpp"
+
+
+/**
+ * @brief Options controlling how `correlate` cross correlates voltages.
+ */
+struct CorrelationOptions {
+    // Number of threads, each correlating its own range of (integration interval, output channel) pairs.
+    unsigned int nThreads {1};
+    // Number of contiguous channels averaged into each output channel. It must divide the number of channels.
+    unsigned int nAveragedChannels {1};
+};
+
+
+/**
+ * @brief Cross correlate voltages on the CPU, producing the visibilities of every baseline, autocorrelations
+ * included, integrated over each interval of `voltages.nIntegrationSteps` timesteps.
+ *
+ * The visibility of antennas a1 >= a2 and polarizations p1, p2 is
+ *      at(interval, channel, a1, a2)[p1 * nPolarizations + p2] = <v(a1, p1) * conj(v(a2, p2))>,
+ * averaged over the timesteps of the interval holding data (the last one may be partially filled) and
+ * over the `nAveragedChannels` channels.
+ *
+ * Products are computed with 8-bit dot product instructions and accumulated in exact 32-bit, then
+ * 64-bit, integers on register-tiled blocks of baselines; the kernels only differ in speed. Samples of
+ * -128 are saturated to -127, so that all the products fit the instructions.
+ *
+ * @param voltages: 8+8 bit voltages in CPU memory.
+ * @param options: threads and channel averaging.
+ * @param level: instruction set to use. Levels not supported by the CPU are lowered automatically;
+ * the AVX-512 kernel needs the VNNI extension, without it the AVX2 one is used, and SSE4.1 runs the scalar one.
+ * @throws std::invalid_argument if the voltages reside in GPU memory or `options.nAveragedChannels` does not
+ * divide the number of channels.
+ */
+Visibilities correlate(const Voltages& voltages, const CorrelationOptions& options = CorrelationOptions {},
+    SimdLevel level = detect_simd_level());
+
+
+/**
+ * @brief Name of the kernel `correlate` runs for a requested instruction set, e.g. "AVX-512 VNNI".
+ */
+const char* correlation_kernel_name(SimdLevel level);
+
+#endif
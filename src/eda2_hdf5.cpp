@@ -0,0 +1,160 @@
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include "eda2_hdf5.hpp"
+
+#ifdef ASTROIO_USE_HDF5
+#include <hdf5.h>
+#endif
+
+
+#ifdef ASTROIO_USE_HDF5
+
+struct Eda2Hdf5File::Handles {
+    hid_t file {-1};
+    hid_t dataset {-1};
+    hid_t fileSpace {-1};
+    hid_t memoryType {-1};
+    int rank {0};
+    // axis of the dataset along which stations are counted, and number of elements of a station along it.
+    int antennaAxis {1};
+    hsize_t antennaExtent {1};
+    std::vector<hsize_t> dims;
+
+    ~Handles(){
+        if(memoryType >= 0) H5Tclose(memoryType);
+        if(fileSpace >= 0) H5Sclose(fileSpace);
+        if(dataset >= 0) H5Dclose(dataset);
+        if(file >= 0) H5Fclose(file);
+    }
+};
+
+
+
+namespace {
+    // Whether `type` is a compound of two 8-bit integers, at offsets 0 and 1.
+    bool is_complex_int8(hid_t type){
+        if(H5Tget_class(type) != H5T_COMPOUND || H5Tget_size(type) != 2 || H5Tget_nmembers(type) != 2) return false;
+        for(unsigned int m {0}; m < 2; m++){
+            hid_t member {H5Tget_member_type(type, m)};
+            const bool ok {H5Tget_class(member) == H5T_INTEGER && H5Tget_size(member) == 1 && H5Tget_member_offset(type, m) == m};
+            H5Tclose(member);
+            if(!ok) return false;
+        }
+        return true;
+    }
+}
+
+
+
+bool eda2_hdf5_available(){ return true; }
+
+
+
+Eda2Hdf5File::Eda2Hdf5File(const std::string& filename, const std::string& dataset, const ObservationInfo& obsInfo)
+        : handles {new Handles}, obsInfo (obsInfo) {
+    Handles& h {*handles};
+    hid_t fileType {-1}, createPlist {-1};
+    H5E_BEGIN_TRY {
+        h.file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if(h.file >= 0) h.dataset = H5Dopen2(h.file, dataset.c_str(), H5P_DEFAULT);
+    } H5E_END_TRY;
+    if(h.file < 0) throw std::runtime_error {"Eda2Hdf5File: error while opening " + filename};
+    if(h.dataset < 0) throw std::runtime_error {"Eda2Hdf5File: dataset " + dataset + " not found in " + filename};
+    h.fileSpace = H5Dget_space(h.dataset);
+    h.rank = H5Sget_simple_extent_ndims(h.fileSpace);
+    if(h.rank < 2 || h.rank > 5) throw std::invalid_argument {"Eda2Hdf5File: unexpected rank of dataset " + dataset};
+    h.dims.resize(h.rank);
+    H5Sget_simple_extent_dims(h.fileSpace, h.dims.data(), nullptr);
+
+    // Complex samples are either compounds, read as they are, or a last dimension of two signed bytes.
+    fileType = H5Dget_type(h.dataset);
+    const bool compound {is_complex_int8(fileType)};
+    const bool pairs {H5Tget_class(fileType) == H5T_INTEGER && H5Tget_size(fileType) == 1 && H5Tget_sign(fileType) == H5T_SGN_2
+        && h.dims.back() == 2};
+    h.memoryType = compound ? H5Tcopy(fileType) : H5Tcopy(H5T_NATIVE_SCHAR);
+    H5Tclose(fileType);
+    if(!compound && !pairs) throw std::invalid_argument {"Eda2Hdf5File: samples of dataset " + dataset + " are not 8+8 bit complex numbers."};
+    const int sampleRank {compound ? h.rank : h.rank - 1};
+
+    const hsize_t nAntennas {obsInfo.nAntennas}, nPolarizations {obsInfo.nPolarizations}, nFrequencies {obsInfo.nFrequencies};
+    bool shapeOk {false};
+    switch(sampleRank){
+        case 2:
+            shapeOk = nFrequencies == 1 && h.dims[1] == nAntennas * nPolarizations;
+            h.antennaExtent = nPolarizations;
+            break;
+        case 3:
+            shapeOk = nFrequencies == 1 && h.dims[1] == nAntennas && h.dims[2] == nPolarizations;
+            break;
+        case 4:
+            shapeOk = h.dims[1] == nFrequencies && h.dims[2] == nAntennas && h.dims[3] == nPolarizations;
+            h.antennaAxis = 2;
+            break;
+    }
+    if(!shapeOk) throw std::invalid_argument {"Eda2Hdf5File: the shape of dataset " + dataset + " does not match the observation."};
+    nTimesteps = h.dims[0];
+
+    createPlist = H5Dget_create_plist(h.dataset);
+    chunkTimesteps = 0;
+    chunkAntennas = obsInfo.nAntennas;
+    if(H5Pget_layout(createPlist) == H5D_CHUNKED){
+        std::vector<hsize_t> chunkDims(h.rank);
+        H5Pget_chunk(createPlist, h.rank, chunkDims.data());
+        chunkTimesteps = chunkDims[0];
+        chunkAntennas = static_cast<unsigned int>(std::max<hsize_t>(1, chunkDims[h.antennaAxis] / h.antennaExtent));
+    }
+    H5Pclose(createPlist);
+}
+
+
+
+void Eda2Hdf5File::read(size_t first, size_t count, unsigned int firstAntenna, unsigned int nAntennas, std::complex<int8_t> *output){
+    if(first > nTimesteps || count > nTimesteps - first || firstAntenna + nAntennas > obsInfo.nAntennas)
+        throw std::invalid_argument {"Eda2Hdf5File::read: selection outside of the dataset."};
+    if(count == 0 || nAntennas == 0) return;
+    const Handles& h {*handles};
+    std::vector<hsize_t> start(h.rank, 0), extent {h.dims};
+    start[0] = first;
+    extent[0] = count;
+    start[h.antennaAxis] = firstAntenna * h.antennaExtent;
+    extent[h.antennaAxis] = nAntennas * h.antennaExtent;
+    std::lock_guard<std::mutex> lock {hdf5Mutex};
+    // Each call uses its own copy of the dataspace, on which the selection is made.
+    hid_t selection {H5Scopy(h.fileSpace)};
+    hid_t memorySpace {H5Screate_simple(h.rank, extent.data(), nullptr)};
+    herr_t status {-1};
+    H5E_BEGIN_TRY {
+        if(H5Sselect_hyperslab(selection, H5S_SELECT_SET, start.data(), nullptr, extent.data(), nullptr) >= 0)
+            status = H5Dread(h.dataset, h.memoryType, memorySpace, selection, H5P_DEFAULT, output);
+    } H5E_END_TRY;
+    H5Sclose(memorySpace);
+    H5Sclose(selection);
+    if(status < 0) throw std::runtime_error {"Eda2Hdf5File::read: error while reading the dataset."};
+}
+
+#else
+
+struct Eda2Hdf5File::Handles {};
+
+
+
+bool eda2_hdf5_available(){ return false; }
+
+
+
+Eda2Hdf5File::Eda2Hdf5File(const std::string&, const std::string&, const ObservationInfo& obsInfo) : obsInfo (obsInfo) {
+    throw std::runtime_error {"Eda2Hdf5File: the library was built without HDF5 support."};
+}
+
+
+
+void Eda2Hdf5File::read(size_t, size_t, unsigned int, unsigned int, std::complex<int8_t>*){
+    throw std::runtime_error {"Eda2Hdf5File: the library was built without HDF5 support."};
+}
+
+#endif
+
+
+
+Eda2Hdf5File::~Eda2Hdf5File(){}
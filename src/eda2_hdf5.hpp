@@ -0,0 +1,82 @@
+#ifndef __EDA2_HDF5_H__
+#define __EDA2_HDF5_H__
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <complex>
+#include <cstdint>
+#include <cstddef>
+#include "astroio.hpp"
+
+
+/**
+ * @brief Whether the library was built with HDF5 support, needed to read EDA2 station files directly.
+ */
+bool eda2_hdf5_available();
+
+
+/**
+ * @brief The voltage dataset of an EDA2 station HDF5 file, read without converting the file to a binary dump.
+ *
+ * The dataset holds 8+8 bit complex samples ordered as [time][channel][station][polarization], the same
+ * order as the binary dumps read by `Voltages::from_eda2_file`. Its shape can be any of
+ *      [time][station x polarization], [time][station][polarization], [time][channel][station][polarization]
+ * (the first two for single channel data only). Samples are either compounds of two 8-bit integers, the
+ * real part first, or 8-bit integers with an extra, last dimension of size two.
+ *
+ * `read` selects hyperslabs of whole stations and timesteps. Callers get the best performance when the
+ * hyperslabs are aligned to the chunks of the dataset, whose extents are returned by `chunk_timesteps`
+ * and `chunk_antennas`: every chunk is then read, and decompressed, exactly once.
+ */
+class Eda2Hdf5File {
+    private:
+    struct Handles;
+    std::unique_ptr<Handles> handles;
+    ObservationInfo obsInfo;
+    size_t nTimesteps;
+    size_t chunkTimesteps;
+    unsigned int chunkAntennas;
+    // The HDF5 library is not thread safe unless built with a specific option.
+    std::mutex hdf5Mutex;
+
+    public:
+    /**
+     * @brief Open the dataset `dataset` of the HDF5 file `filename`.
+     *
+     * @param obsInfo: number of channels, stations and polarizations of the data, e.g. EDA2_OBSERVATION_INFO.
+     * @throws std::runtime_error if the dataset cannot be opened, or the library was built without HDF5 support.
+     * @throws std::invalid_argument if the shape or type of the dataset do not match `obsInfo`.
+     */
+    Eda2Hdf5File(const std::string& filename, const std::string& dataset, const ObservationInfo& obsInfo);
+
+    ~Eda2Hdf5File();
+
+    Eda2Hdf5File(const Eda2Hdf5File&) = delete;
+    Eda2Hdf5File& operator=(const Eda2Hdf5File&) = delete;
+
+    /**
+     * @brief Number of timesteps in the dataset.
+     */
+    size_t n_timesteps() const { return nTimesteps; }
+
+    /**
+     * @brief Number of timesteps in a chunk of the dataset, or zero if the dataset is not chunked.
+     */
+    size_t chunk_timesteps() const { return chunkTimesteps; }
+
+    /**
+     * @brief Number of stations in a chunk of the dataset. It is the number of stations in the data if
+     * the dataset is not chunked along the station axis.
+     */
+    unsigned int chunk_antennas() const { return chunkAntennas; }
+
+    /**
+     * @brief Read `count` timesteps, starting from `first`, of the stations [firstAntenna, firstAntenna + nAntennas)
+     * into `output`, ordered as [time][channel][station - firstAntenna][polarization]. It can be called from
+     * multiple threads; calls into the HDF5 library are serialised.
+     */
+    void read(size_t first, size_t count, unsigned int firstAntenna, unsigned int nAntennas, std::complex<int8_t> *output);
+};
+
+#endif
@@ -0,0 +1,529 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+#include "file_reader.hpp"
+#include "voltage_archive.hpp"
+#include "utils.hpp"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASTROIO_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+
+namespace {
+
+    // Alignment of offsets, sizes and buffer addresses required by O_DIRECT on all the common filesystems.
+    constexpr size_t DIRECT_IO_ALIGNMENT {4096};
+
+
+    struct FreeDeleter {
+        void operator()(uint8_t *p) const { free(p); }
+    };
+
+    using AlignedBuffer = std::unique_ptr<uint8_t, FreeDeleter>;
+
+
+    AlignedBuffer allocate_aligned(size_t nBytes){
+        void *p {nullptr};
+        if(posix_memalign(&p, DIRECT_IO_ALIGNMENT, std::max(nBytes, DIRECT_IO_ALIGNMENT)) != 0)
+            throw std::bad_alloc {};
+        return AlignedBuffer {static_cast<uint8_t*>(p)};
+    }
+
+
+    size_t align_down(size_t value){ return value - value % DIRECT_IO_ALIGNMENT; }
+
+
+    size_t align_up(size_t value){ return align_down(value + DIRECT_IO_ALIGNMENT - 1); }
+
+
+    /**
+     * Read range of an O_DIRECT read covering the requested bytes [offset, offset + count).
+     * Data for the requested bytes starts `skip` bytes into the buffer.
+     */
+    struct DirectWindow {
+        size_t offset;
+        size_t count;
+        size_t skip;
+
+        DirectWindow(size_t requestedOffset, size_t requestedCount) :
+            offset {align_down(requestedOffset)},
+            count {align_up(requestedOffset + requestedCount) - align_down(requestedOffset)},
+            skip {requestedOffset - align_down(requestedOffset)} {}
+    };
+
+
+    /**
+     * Read from a file opened with O_DIRECT until at least `needed` bytes are available or the end of
+     * file is reached. Stops as soon as a read returns a non aligned number of bytes, since a following
+     * read would start at a non aligned offset.
+     */
+    size_t direct_pread(int fd, uint8_t *buffer, size_t count, size_t offset, size_t needed){
+        size_t total {0};
+        while(total < needed){
+            ssize_t n {pread(fd, buffer + total, count - total, offset + total)};
+            if(n < 0){
+                if(errno == EINTR) continue;
+                throw std::runtime_error {std::string {"FileReader: O_DIRECT read failed: "} + strerror(errno)};
+            }
+            if(n == 0) break;
+            total += n;
+            if(total % DIRECT_IO_ALIGNMENT) break;
+        }
+        return total;
+    }
+
+
+    /**
+     * Pipeline shared by the thread based backends. An I/O thread calls `fill(c, buffer)` to read chunk
+     * `c` into one of `queueDepth` staging buffers of `bufferBytes` bytes; `fill` returns a pointer to
+     * the beginning of the chunk data within the buffer. The calling thread passes filled buffers, in
+     * order, to `consume(c, data)`.
+     */
+    void threaded_read_ahead(size_t nChunks, unsigned int queueDepth, size_t bufferBytes,
+            const std::function<const uint8_t*(size_t, uint8_t*)>& fill,
+            const std::function<void(size_t, const uint8_t*)>& consume){
+        queueDepth = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(queueDepth, nChunks)));
+        std::vector<AlignedBuffer> buffers;
+        for(unsigned int i {0}; i < queueDepth; i++) buffers.push_back(allocate_aligned(bufferBytes));
+        if(queueDepth == 1){
+            for(size_t c {0}; c < nChunks; c++) consume(c, fill(c, buffers[0].get()));
+            return;
+        }
+        std::vector<const uint8_t*> chunkData(queueDepth);
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t nFilled {0}, nConsumed {0};
+        bool stop {false};
+        std::exception_ptr ioError;
+        std::thread ioThread {[&](){
+            try{
+                for(size_t c {0}; c < nChunks; c++){
+                    {
+                        std::unique_lock<std::mutex> lock {mutex};
+                        cv.wait(lock, [&](){ return stop || c - nConsumed < queueDepth; });
+                        if(stop) return;
+                    }
+                    const uint8_t *data {fill(c, buffers[c % queueDepth].get())};
+                    std::lock_guard<std::mutex> lock {mutex};
+                    chunkData[c % queueDepth] = data;
+                    nFilled = c + 1;
+                    cv.notify_all();
+                }
+            }catch(...){
+                std::lock_guard<std::mutex> lock {mutex};
+                ioError = std::current_exception();
+                cv.notify_all();
+            }
+        }};
+        try{
+            for(size_t c {0}; c < nChunks; c++){
+                const uint8_t *data;
+                {
+                    std::unique_lock<std::mutex> lock {mutex};
+                    cv.wait(lock, [&](){ return ioError || nFilled > c; });
+                    if(ioError) break;
+                    data = chunkData[c % queueDepth];
+                }
+                consume(c, data);
+                std::lock_guard<std::mutex> lock {mutex};
+                nConsumed = c + 1;
+                cv.notify_all();
+            }
+        }catch(...){
+            {
+                std::lock_guard<std::mutex> lock {mutex};
+                stop = true;
+                cv.notify_all();
+            }
+            ioThread.join();
+            throw;
+        }
+        ioThread.join();
+        if(ioError) std::rethrow_exception(ioError);
+    }
+
+
+    int open_file(const std::string& filename, int flags, size_t& fileSize){
+        int fd {open(filename.c_str(), O_RDONLY | flags)};
+        if(fd < 0) return fd;
+        struct stat st;
+        if(fstat(fd, &st) != 0){
+            close(fd);
+            return -1;
+        }
+        fileSize = static_cast<size_t>(st.st_size);
+        return fd;
+    }
+
+
+
+    class BufferedFileReader : public FileReader {
+        private:
+        int fd;
+
+        public:
+        explicit BufferedFileReader(const std::string& filename) : FileReader {filename} {
+            fd = open_file(filename, 0, fileSize);
+            if(fd < 0) throw std::runtime_error {"FileReader: error while opening " + filename};
+            #ifdef POSIX_FADV_SEQUENTIAL
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            #endif
+        }
+
+        ~BufferedFileReader(){ close(fd); }
+
+        ReadBackend backend() const override { return ReadBackend::BUFFERED; }
+
+        void read(void *buffer, size_t count, size_t offset) override {
+            if(pread_full(fd, buffer, count, offset) != count)
+                throw std::runtime_error {"FileReader: unexpected end of file " + filename};
+        }
+
+        void read_chunks(size_t offset, size_t nBytes, size_t chunkBytes, unsigned int queueDepth,
+                const ChunkConsumer& consume) override {
+            if(nBytes == 0) return;
+            const size_t nChunks {(nBytes + chunkBytes - 1) / chunkBytes};
+            auto chunk_size = [&](size_t c) { return std::min(chunkBytes, nBytes - c * chunkBytes); };
+            threaded_read_ahead(nChunks, queueDepth, chunkBytes, [&](size_t c, uint8_t *buffer) -> const uint8_t* {
+                read(buffer, chunk_size(c), offset + c * chunkBytes);
+                return buffer;
+            }, [&](size_t c, const uint8_t *data){
+                consume(c * chunkBytes, data, chunk_size(c));
+            });
+        }
+    };
+
+
+
+    class DirectFileReader : public FileReader {
+        protected:
+        int directFd;
+        // Descriptor without O_DIRECT, used to complete reads cut short by the kernel.
+        int bufferedFd;
+
+        /**
+         * Read the requested bytes through an aligned window into `buffer`, which must be at least
+         * `window.count` bytes long and aligned. Return a pointer to the requested data.
+         */
+        const uint8_t* read_window(uint8_t *buffer, size_t count, size_t offset){
+            const DirectWindow window {offset, count};
+            const size_t needed {window.skip + count};
+            size_t got {direct_pread(directFd, buffer, window.count, window.offset, needed)};
+            if(got < needed) got += pread_full(bufferedFd, buffer + got, needed - got, window.offset + got);
+            if(got < needed) throw std::runtime_error {"FileReader: unexpected end of file " + filename};
+            return buffer + window.skip;
+        }
+
+        public:
+        DirectFileReader(const std::string& filename, int directFd, size_t fileSize) : FileReader {filename}, directFd {directFd} {
+            this->fileSize = fileSize;
+            bufferedFd = open(filename.c_str(), O_RDONLY);
+            if(bufferedFd < 0){
+                close(directFd);
+                throw std::runtime_error {"FileReader: error while opening " + filename};
+            }
+        }
+
+        ~DirectFileReader(){
+            close(directFd);
+            close(bufferedFd);
+        }
+
+        ReadBackend backend() const override { return ReadBackend::DIRECT; }
+
+        void read(void *buffer, size_t count, size_t offset) override {
+            // Read in place when the request satisfies the O_DIRECT constraints, otherwise bounce.
+            if(reinterpret_cast<uintptr_t>(buffer) % DIRECT_IO_ALIGNMENT == 0 && offset % DIRECT_IO_ALIGNMENT == 0
+                    && count % DIRECT_IO_ALIGNMENT == 0){
+                size_t got {direct_pread(directFd, static_cast<uint8_t*>(buffer), count, offset, count)};
+                if(got < count) got += pread_full(bufferedFd, static_cast<uint8_t*>(buffer) + got, count - got, offset + got);
+                if(got < count) throw std::runtime_error {"FileReader: unexpected end of file " + filename};
+                return;
+            }
+            const DirectWindow window {offset, count};
+            AlignedBuffer bounce {allocate_aligned(window.count)};
+            memcpy(buffer, read_window(bounce.get(), count, offset), count);
+        }
+
+        void read_chunks(size_t offset, size_t nBytes, size_t chunkBytes, unsigned int queueDepth,
+                const ChunkConsumer& consume) override {
+            if(nBytes == 0) return;
+            const size_t nChunks {(nBytes + chunkBytes - 1) / chunkBytes};
+            auto chunk_size = [&](size_t c) { return std::min(chunkBytes, nBytes - c * chunkBytes); };
+            threaded_read_ahead(nChunks, queueDepth, align_up(chunkBytes) + DIRECT_IO_ALIGNMENT,
+                    [&](size_t c, uint8_t *buffer){
+                return read_window(buffer, chunk_size(c), offset + c * chunkBytes);
+            }, [&](size_t c, const uint8_t *data){
+                consume(c * chunkBytes, data, chunk_size(c));
+            });
+        }
+    };
+
+
+
+    #ifdef ASTROIO_IO_URING
+
+    /**
+     * Minimal io_uring instance, driven through the raw system calls so that no extra library is needed.
+     */
+    class IoUring {
+        private:
+        int ringFd {-1};
+        io_uring_params params;
+        void *sqRing {MAP_FAILED}, *cqRing {MAP_FAILED};
+        size_t sqRingSize {0}, cqRingSize {0};
+        io_uring_sqe *sqes {static_cast<io_uring_sqe*>(MAP_FAILED)};
+        unsigned int *sqTail, *sqMask, *sqArray, *cqHead, *cqTail, *cqMask;
+        io_uring_cqe *cqes;
+        unsigned int toSubmit {0};
+        bool buffersRegistered {false};
+
+        template <typename T>
+        T* ring_field(void *ring, unsigned int offset){
+            return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+        }
+
+        public:
+        explicit IoUring(unsigned int entries){
+            memset(&params, 0, sizeof(params));
+            ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+            if(ringFd < 0) throw std::runtime_error {std::string {"io_uring_setup: "} + strerror(errno)};
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool singleMmap {(params.features & IORING_FEAT_SINGLE_MMAP) != 0};
+            if(singleMmap) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+            sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+            cqRing = singleMmap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ringFd, IORING_OFF_CQ_RING);
+            sqes = static_cast<io_uring_sqe*>(mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+            if(sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED){
+                release();
+                throw std::runtime_error {"io_uring: cannot map the rings."};
+            }
+            sqTail = ring_field<unsigned int>(sqRing, params.sq_off.tail);
+            sqMask = ring_field<unsigned int>(sqRing, params.sq_off.ring_mask);
+            sqArray = ring_field<unsigned int>(sqRing, params.sq_off.array);
+            cqHead = ring_field<unsigned int>(cqRing, params.cq_off.head);
+            cqTail = ring_field<unsigned int>(cqRing, params.cq_off.tail);
+            cqMask = ring_field<unsigned int>(cqRing, params.cq_off.ring_mask);
+            cqes = ring_field<io_uring_cqe>(cqRing, params.cq_off.cqes);
+        }
+
+        IoUring(const IoUring&) = delete;
+        IoUring& operator=(const IoUring&) = delete;
+
+        ~IoUring(){ release(); }
+
+        void release(){
+            if(sqes != MAP_FAILED) munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+            if(cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+            if(sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+            if(ringFd >= 0) close(ringFd);
+            sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+            sqRing = cqRing = MAP_FAILED;
+            ringFd = -1;
+        }
+
+        /**
+         * Register buffers so that reads into them skip the per-request page pinning. Returns false
+         * if the kernel refused (e.g. because of RLIMIT_MEMLOCK); plain reads will then be used.
+         */
+        bool register_buffers(const std::vector<iovec>& buffers){
+            buffersRegistered = syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS,
+                buffers.data(), static_cast<unsigned int>(buffers.size())) == 0;
+            return buffersRegistered;
+        }
+
+        void queue_read(int fd, void *buffer, unsigned int count, size_t offset, unsigned int bufferIndex, uint64_t userData){
+            const unsigned int tail {*sqTail};
+            const unsigned int index {tail & *sqMask};
+            io_uring_sqe *sqe {&sqes[index]};
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = buffersRegistered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->off = offset;
+            sqe->addr = reinterpret_cast<uint64_t>(buffer);
+            sqe->len = count;
+            sqe->buf_index = buffersRegistered ? bufferIndex : 0;
+            sqe->user_data = userData;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            toSubmit++;
+        }
+
+        /**
+         * Submit the queued reads without waiting for their completion.
+         */
+        void submit(){
+            while(toSubmit > 0){
+                int ret {static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, 0, 0, nullptr, 0))};
+                if(ret < 0){
+                    if(errno == EINTR) continue;
+                    throw std::runtime_error {std::string {"io_uring_enter: "} + strerror(errno)};
+                }
+                toSubmit -= std::min<unsigned int>(toSubmit, ret);
+            }
+        }
+
+        /**
+         * Submit the queued reads and wait for one completion. Return its user data and result.
+         */
+        std::pair<uint64_t, int> wait_completion(){
+            while(true){
+                unsigned int head {*cqHead};
+                if(head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)){
+                    const io_uring_cqe& cqe {cqes[head & *cqMask]};
+                    std::pair<uint64_t, int> result {cqe.user_data, cqe.res};
+                    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                    return result;
+                }
+                int ret {static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0))};
+                if(ret < 0){
+                    if(errno == EINTR) continue;
+                    throw std::runtime_error {std::string {"io_uring_enter: "} + strerror(errno)};
+                }
+                toSubmit -= std::min<unsigned int>(toSubmit, ret);
+            }
+        }
+
+        /**
+         * Whether the kernel supports io_uring. The probe ring is only set up on the first call.
+         */
+        static bool available(){
+            static const bool isAvailable {[](){
+                try{
+                    IoUring probe {1};
+                    return true;
+                }catch(const std::runtime_error&){
+                    return false;
+                }
+            }()};
+            return isAvailable;
+        }
+    };
+
+
+
+    class IoUringFileReader : public DirectFileReader {
+        public:
+        using DirectFileReader::DirectFileReader;
+
+        ReadBackend backend() const override { return ReadBackend::IO_URING; }
+
+        void read_chunks(size_t offset, size_t nBytes, size_t chunkBytes, unsigned int queueDepth,
+                const ChunkConsumer& consume) override {
+            if(nBytes == 0) return;
+            const size_t nChunks {(nBytes + chunkBytes - 1) / chunkBytes};
+            auto chunk_size = [&](size_t c) { return std::min(chunkBytes, nBytes - c * chunkBytes); };
+            const unsigned int depth {static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(queueDepth, nChunks)))};
+            const size_t bufferBytes {align_up(chunkBytes) + DIRECT_IO_ALIGNMENT};
+            std::vector<AlignedBuffer> buffers;
+            std::vector<iovec> iovecs;
+            for(unsigned int i {0}; i < depth; i++){
+                buffers.push_back(allocate_aligned(bufferBytes));
+                iovecs.push_back({buffers.back().get(), bufferBytes});
+            }
+            IoUring ring {depth};
+            ring.register_buffers(iovecs);
+            std::vector<int> results(depth);
+            std::vector<bool> completed(depth, false);
+            size_t nSubmitted {0}, nCompleted {0};
+            auto submit = [&](size_t c){
+                const DirectWindow window {offset + c * chunkBytes, chunk_size(c)};
+                ring.queue_read(directFd, buffers[c % depth].get(), window.count, window.offset, c % depth, c);
+                nSubmitted++;
+            };
+            try{
+                for(size_t c {0}; c < depth; c++) submit(c);
+                ring.submit();
+                for(size_t c {0}; c < nChunks; c++){
+                    const unsigned int slot {static_cast<unsigned int>(c % depth)};
+                    while(!completed[slot]){
+                        auto completion = ring.wait_completion();
+                        nCompleted++;
+                        completed[completion.first % depth] = true;
+                        results[completion.first % depth] = completion.second;
+                    }
+                    completed[slot] = false;
+                    if(results[slot] < 0)
+                        throw std::runtime_error {std::string {"FileReader: io_uring read failed: "} + strerror(-results[slot])};
+                    const DirectWindow window {offset + c * chunkBytes, chunk_size(c)};
+                    const size_t needed {window.skip + chunk_size(c)};
+                    size_t got {static_cast<size_t>(results[slot])};
+                    uint8_t *buffer {buffers[slot].get()};
+                    if(got < needed) got += pread_full(bufferedFd, buffer + got, needed - got, window.offset + got);
+                    if(got < needed) throw std::runtime_error {"FileReader: unexpected end of file " + filename};
+                    consume(c * chunkBytes, buffer + window.skip, chunk_size(c));
+                    if(c + depth < nChunks){
+                        submit(c + depth);
+                        ring.submit();
+                    }
+                }
+            }catch(...){
+                // The kernel may still be writing into the buffers: wait for in-flight reads first.
+                try{
+                    while(nCompleted < nSubmitted){
+                        ring.wait_completion();
+                        nCompleted++;
+                    }
+                }catch(...){}
+                throw;
+            }
+        }
+    };
+
+    #endif
+}
+
+
+
+std::unique_ptr<FileReader> open_raw_file_reader(const std::string& filename, ReadBackend backend){
+    if(backend != ReadBackend::BUFFERED){
+        size_t fileSize {0};
+        int directFd {open_file(filename, O_DIRECT, fileSize)};
+        if(directFd >= 0){
+            #ifdef ASTROIO_IO_URING
+            if(backend == ReadBackend::IO_URING && IoUring::available())
+                return std::unique_ptr<FileReader> {new IoUringFileReader {filename, directFd, fileSize}};
+            #endif
+            return std::unique_ptr<FileReader> {new DirectFileReader {filename, directFd, fileSize}};
+        }
+    }
+    return std::unique_ptr<FileReader> {new BufferedFileReader {filename}};
+}
+
+
+
+std::unique_ptr<FileReader> open_file_reader(const std::string& filename, ReadBackend backend){
+    std::unique_ptr<FileReader> reader {open_raw_file_reader(filename, backend)};
+    if(VoltageArchive::is_archive(*reader)) return std::unique_ptr<FileReader> {new VoltageArchive {std::move(reader)}};
+    return reader;
+}
+
+
+
+const char* read_backend_name(ReadBackend backend){
+    switch(backend){
+        case ReadBackend::DIRECT: return "O_DIRECT";
+        case ReadBackend::IO_URING: return "io_uring";
+        default: return "buffered";
+    }
+}
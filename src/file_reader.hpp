@@ -0,0 +1,94 @@
+#ifndef __FILE_READER_H__
+#define __FILE_READER_H__
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ * @brief Strategies available to read raw data files from disk.
+ *
+ * - BUFFERED: `pread` through the page cache. Reads ahead of the consumer are performed by an I/O thread.
+ * - DIRECT: `pread` on a file opened with O_DIRECT into aligned buffers, bypassing the page cache.
+ * - IO_URING: asynchronous reads submitted to an io_uring instance with registered, aligned buffers on
+ *   a file opened with O_DIRECT. No extra thread is needed to keep multiple reads in flight.
+ *
+ * When a backend is not available (e.g. O_DIRECT is not supported by the filesystem, or io_uring by the
+ * kernel), readers silently fall back to the next simpler one.
+ */
+enum class ReadBackend {BUFFERED, DIRECT, IO_URING};
+
+
+/**
+ * @brief Function receiving consecutive chunks of a file: `consume(offset, data, size)`, where `offset`
+ * is relative to the beginning of the requested range. `data` is only valid during the call.
+ */
+using ChunkConsumer = std::function<void(size_t, const uint8_t*, size_t)>;
+
+
+/**
+ * @brief A read-only file accessed through one of the `ReadBackend`s.
+ */
+class FileReader {
+    protected:
+    std::string filename;
+    size_t fileSize {0};
+
+    public:
+    explicit FileReader(const std::string& filename) : filename {filename} {}
+
+    virtual ~FileReader() {}
+
+    /**
+     * @brief Size of the file in bytes.
+     */
+    size_t size() const { return fileSize; }
+
+    /**
+     * @brief Path of the file.
+     */
+    const std::string& file_name() const { return filename; }
+
+    /**
+     * @brief Backend actually used to read the file.
+     */
+    virtual ReadBackend backend() const = 0;
+
+    /**
+     * @brief Read exactly `count` bytes starting at `offset` into `buffer`.
+     * @throws std::runtime_error if the file is shorter than `offset + count` bytes.
+     */
+    virtual void read(void *buffer, size_t count, size_t offset) = 0;
+
+    /**
+     * @brief Read `nBytes` bytes, starting at `offset`, in chunks of `chunkBytes` bytes and pass them,
+     * in order, to `consume`. Up to `queueDepth` chunks are read ahead of the one being consumed; a depth
+     * of one means reads and calls to `consume` alternate.
+     */
+    virtual void read_chunks(size_t offset, size_t nBytes, size_t chunkBytes, unsigned int queueDepth,
+        const ChunkConsumer& consume) = 0;
+};
+
+
+/**
+ * @brief Open a file for reading with the given backend, or the closest available one. Voltage archives
+ * (see `voltage_archive.hpp`) are recognised and read as the .dat file they were created from.
+ */
+std::unique_ptr<FileReader> open_file_reader(const std::string& filename, ReadBackend backend = ReadBackend::BUFFERED);
+
+
+/**
+ * @brief As `open_file_reader`, but the bytes stored on disk are returned as they are, even for archives.
+ */
+std::unique_ptr<FileReader> open_raw_file_reader(const std::string& filename, ReadBackend backend = ReadBackend::BUFFERED);
+
+
+/**
+ * @brief Return a human readable name for a read backend.
+ */
+const char* read_backend_name(ReadBackend backend);
+
+#endif
@@ -243,8 +243,8 @@ class MemoryBuffer {
         return *this;
     }
 
-    T& operator[](int i){ return _data[i]; }
-    const T& operator[](int i) const { return _data[i]; }
+    T& operator[](size_t i){ return _data[i]; }
+    const T& operator[](size_t i) const { return _data[i]; }
 
     ~MemoryBuffer(){
         if(!_pinned && !_on_gpu && _data) delete[] _data;
@@ -87,6 +87,8 @@ public :
    std::string polProducts;
 
    std::vector<int> input_mapping;
+   // antenna_flags[a] is true when any input of antenna a has a non-zero Flag.
+   std::vector<bool> antenna_flags;
 
    // time :
    double startUnixTime;
@@ -749,6 +751,7 @@ int CObsMetadata::ReadAntPositions()
    antenna_positions.resize(nrow/2); // was antennae.resize(nrow/2);
 //   inputs.resize(nrow);
    input_mapping.resize(nrow);
+   antenna_flags.assign(nrow/2, false);
    for(long int i=0; i!=nrow; ++i)
    {
       int input, antenna, tile, rx, slot, flag, gainValues[24];
@@ -777,6 +780,7 @@ int CObsMetadata::ReadAntPositions()
          fits_read_col(_fptr, TINT, gainsCol, i+1, 1, 24, 0, gainValues, 0, &status);
       checkStatus(status,"Could not read tile");
       input_mapping[i] = 2 * antenna + (pol == 'X' ? 0 : 1);
+      if(flag != 0) antenna_flags[antenna] = true;
       
       if(pol == 'X'){
           InputMapping& ant = antenna_positions[antenna]; // was MWAAntenna &ant = antennae[antenna];
@@ -848,6 +852,16 @@ std::vector<int> read_metafits_mapping(const std::string& filename){
 }
 
 
+std::vector<bool> read_metafits_flagged_antennas(const std::string& filename){
+   ::CObsMetadata meta;
+	if(!meta.ReadMetaData(filename.c_str())){
+      std::cerr << "impossible to read metadata file." << std::endl;
+      throw std::exception();
+   }
+   return meta.antenna_flags;
+}
+
+
 ObservationInfo read_obsinfo(const std::string& filename){
    ::CObsMetadata meta;
 	if(!meta.ReadMetaData(filename.c_str())){
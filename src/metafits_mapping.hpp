@@ -5,5 +5,8 @@
 #include <vector>
 #include "astroio.hpp"
 std::vector<int> read_metafits_mapping(const std::string& filename);
+// Flag column of the metafits file, per antenna in the order of `read_metafits_mapping`. An antenna is
+// flagged when any of its inputs is.
+std::vector<bool> read_metafits_flagged_antennas(const std::string& filename);
 ObservationInfo read_obsinfo(const std::string& filename);
 #endif
@@ -0,0 +1,132 @@
+#include <sstream>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <memory>
+#include "mwax_subfile.hpp"
+#include "file_reader.hpp"
+#include "sample_conversion.hpp"
+
+
+namespace {
+
+    const std::string& header_value(const std::map<std::string, std::string>& header, const std::string& key){
+        auto entry = header.find(key);
+        if(entry == header.end()) throw std::invalid_argument {"parse_subfile_header: missing key " + key + "."};
+        return entry->second;
+    }
+
+
+    unsigned long long header_integer(const std::map<std::string, std::string>& header, const std::string& key){
+        const std::string& value {header_value(header, key)};
+        size_t parsed {0};
+        unsigned long long result {0};
+        try{
+            result = std::stoull(value, &parsed);
+        }catch(const std::exception&){
+            parsed = 0;
+        }
+        if(value.empty() || parsed != value.size() || value[0] == '-')
+            throw std::invalid_argument {"parse_subfile_header: invalid value of " + key + ": '" + value + "'."};
+        return result;
+    }
+}
+
+
+
+SubfileInfo parse_subfile_header(const char *header, size_t length){
+    SubfileInfo info;
+    // The header ends at the first null byte.
+    std::istringstream lines {std::string {header, strnlen(header, length)}};
+    std::string line;
+    while(std::getline(lines, line)){
+        std::istringstream fields {line};
+        std::string key, value;
+        if(!(fields >> key)) continue;
+        std::getline(fields >> std::ws, value);
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+        info.header[key] = value;
+    }
+    const auto& entries = info.header;
+    if(header_integer(entries, "NBIT") != 8)
+        throw std::invalid_argument {"parse_subfile_header: only 8 bit samples are supported."};
+    const unsigned long long nInputs {header_integer(entries, "NINPUTS")}, nPolarizations {header_integer(entries, "NPOL")};
+    const unsigned long long sampleRate {header_integer(entries, "SAMPLE_RATE")};
+    info.samplesPerBlock = header_integer(entries, "NTIMESAMPLES");
+    info.headerBytes = entries.count("HDR_SIZE") ? header_integer(entries, "HDR_SIZE") : 4096u;
+    if(nPolarizations == 0 || nInputs == 0 || nInputs % nPolarizations != 0 || sampleRate == 0 || info.samplesPerBlock == 0)
+        throw std::invalid_argument {"parse_subfile_header: inconsistent NINPUTS, NPOL, SAMPLE_RATE or NTIMESAMPLES."};
+    const unsigned long long samplesInSubobservation {header_integer(entries, "SECS_PER_SUBOBS") * sampleRate};
+    if(samplesInSubobservation % info.samplesPerBlock != 0)
+        throw std::invalid_argument {"parse_subfile_header: the sub-observation is not made of whole blocks."};
+    info.nBlocks = samplesInSubobservation / info.samplesPerBlock;
+
+    ObservationInfo& obsInfo {info.obsInfo};
+    obsInfo = VCS_OBSERVATION_INFO;
+    obsInfo.telescope = TelescopeID::MWA3;
+    obsInfo.nPolarizations = static_cast<unsigned int>(nPolarizations);
+    obsInfo.nAntennas = static_cast<unsigned int>(nInputs / nPolarizations);
+    obsInfo.nFrequencies = 1;
+    obsInfo.nTimesteps = info.nBlocks * info.samplesPerBlock;
+    obsInfo.timeResolution = 1.0 / sampleRate;
+    if(entries.count("BANDWIDTH_HZ")){
+        obsInfo.coarseChannelBandwidth = header_integer(entries, "BANDWIDTH_HZ") / 1e6;
+        obsInfo.frequencyResolution = obsInfo.coarseChannelBandwidth;
+    }
+    obsInfo.startTime = static_cast<time_t>(header_integer(entries, "UNIXTIME"));
+    obsInfo.coarseChannel = static_cast<unsigned int>(header_integer(entries, "COARSE_CHANNEL"));
+    obsInfo.coarse_channel_index = entries.count("CORR_COARSE_CHANNEL") && header_integer(entries, "CORR_COARSE_CHANNEL") > 0
+        ? static_cast<unsigned int>(header_integer(entries, "CORR_COARSE_CHANNEL") - 1) : 0u;
+    obsInfo.id = header_value(entries, "OBS_ID");
+    return info;
+}
+
+
+
+SubfileInfo read_subfile_info(const std::string& filename){
+    std::unique_ptr<FileReader> reader {open_raw_file_reader(filename)};
+    // The header size is only known once the header is read: read the default size first.
+    std::vector<char> header(std::min<size_t>(4096u, reader->size()));
+    reader->read(header.data(), header.size(), 0);
+    SubfileInfo info {parse_subfile_header(header.data(), header.size())};
+    if(info.headerBytes > header.size()){
+        if(info.headerBytes > reader->size()) throw std::runtime_error {"read_subfile_info: truncated header in " + filename};
+        header.resize(info.headerBytes);
+        reader->read(header.data(), header.size(), 0);
+        info = parse_subfile_header(header.data(), header.size());
+    }
+    if(reader->size() < info.block_offset(info.nBlocks))
+        throw std::runtime_error {"read_subfile_info: " + filename + " is truncated: " + std::to_string(reader->size())
+            + " bytes, expected " + std::to_string(info.block_offset(info.nBlocks)) + "."};
+    return info;
+}
+
+
+
+template <typename T>
+void reorder_subfile_block(const std::complex<int8_t> *block, size_t firstTimestep, size_t samplesPerBlock, size_t nInputs,
+        unsigned int nIntegrationSteps, const std::vector<int>& inputMapping, std::complex<T> *output){
+    const size_t samplesInTimeInterval {nInputs * nIntegrationSteps};
+    const SimdLevel level {detect_simd_level()};
+    // Each input contributes a contiguous run of samples to every integration interval the block overlaps.
+    for(size_t input {0}; input < nInputs; input++){
+        const size_t row {inputMapping.empty() ? input : static_cast<size_t>(inputMapping[input])};
+        const std::complex<int8_t> *samples {block + input * samplesPerBlock};
+        for(size_t s {0}; s < samplesPerBlock;){
+            const size_t ts {firstTimestep + s};
+            const size_t interval {ts / nIntegrationSteps}, step {ts % nIntegrationSteps};
+            const size_t n {std::min<size_t>(nIntegrationSteps - step, samplesPerBlock - s)};
+            convert_samples(reinterpret_cast<const int8_t*>(samples + s),
+                reinterpret_cast<T*>(output + interval * samplesInTimeInterval + row * nIntegrationSteps + step), 2 * n, level);
+            s += n;
+        }
+    }
+}
+
+
+template void reorder_subfile_block(const std::complex<int8_t>*, size_t, size_t, size_t, unsigned int, const std::vector<int>&,
+    std::complex<int8_t>*);
+template void reorder_subfile_block(const std::complex<int8_t>*, size_t, size_t, size_t, unsigned int, const std::vector<int>&,
+    std::complex<int16_t>*);
+template void reorder_subfile_block(const std::complex<int8_t>*, size_t, size_t, size_t, unsigned int, const std::vector<int>&,
+    std::complex<float>*);
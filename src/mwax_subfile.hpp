@@ -0,0 +1,95 @@
+#ifndef __MWAX_SUBFILE_H__
+#define __MWAX_SUBFILE_H__
+
+#include <string>
+#include <map>
+#include <vector>
+#include <complex>
+#include <cstdint>
+#include <cstddef>
+#include "astroio.hpp"
+
+/*
+    MWAX voltage subfiles (.sub) hold one sub-observation, typically 8 seconds, of a single coarse
+    channel recorded by MWA Phase 3. A subfile is made of:
+     - an ASCII header of `HDR_SIZE` (4096) bytes, one "KEY VALUE" pair per line, padded with zeros;
+     - one block of delay and metadata information, of the same size as a data block;
+     - `SECS_PER_SUBOBS * SAMPLE_RATE / NTIMESAMPLES` data blocks, e.g. 160 blocks of 50 ms. Each block
+       holds `NTIMESAMPLES` consecutive samples of every input, ordered as [input][time_sample], with
+       8 bits for the real and 8 bits for the imaginary part of each sample.
+    Inputs are station/polarization pairs, the polarization varying fastest. Samples are at the coarse
+    channel resolution: voltages read from a subfile have a single frequency channel.
+*/
+
+
+/**
+ * @brief Information about a subfile, read from its header.
+ */
+struct SubfileInfo {
+    // The observation the sub-observation belongs to, restricted to the timesteps in the subfile.
+    ObservationInfo obsInfo;
+    // All the entries of the header, as strings.
+    std::map<std::string, std::string> header;
+    // Size of the header, in bytes.
+    size_t headerBytes;
+    // Number of samples of each input in a data block.
+    size_t samplesPerBlock;
+    // Number of data blocks, excluding the delay block.
+    size_t nBlocks;
+
+    /**
+     * @brief Size of a block, in bytes.
+     */
+    size_t block_bytes() const {
+        return samplesPerBlock * obsInfo.nAntennas * obsInfo.nPolarizations * sizeof(std::complex<int8_t>);
+    }
+
+    /**
+     * @brief Offset, from the beginning of the file, of the given data block.
+     */
+    size_t block_offset(size_t block) const { return headerBytes + (block + 1) * block_bytes(); }
+};
+
+
+/**
+ * @brief Parse the ASCII header of a subfile.
+ *
+ * `obsInfo` describes the whole subfile: `nAntennas` is `NINPUTS / NPOL`, `nFrequencies` is one,
+ * `nTimesteps` is `nBlocks * samplesPerBlock`, `timeResolution` is the inverse of `SAMPLE_RATE`,
+ * `startTime` is `UNIXTIME` and `id` is `OBS_ID`. `coarseChannel` is the receiver channel number
+ * (`COARSE_CHANNEL`) and `coarse_channel_index` the zero based position of the channel in the
+ * correlated band (`CORR_COARSE_CHANNEL - 1`).
+ *
+ * @param header: the header, not necessarily null terminated.
+ * @param length: size of `header`, in bytes.
+ * @throws std::invalid_argument if a mandatory key is missing or has an unsupported value, e.g. samples
+ * of other than 8 bits.
+ */
+SubfileInfo parse_subfile_header(const char *header, size_t length);
+
+
+/**
+ * @brief Read the header of a subfile and check that the file holds all the data blocks it announces.
+ * @throws std::runtime_error if the file cannot be read or is truncated.
+ */
+SubfileInfo read_subfile_info(const std::string& filename);
+
+
+/**
+ * @brief Copy one data block into voltages with a single channel, ordered as
+ *      [integration_interval][input][integration_step],
+ * converting the samples to `T`. It is instantiated for `int8_t`, `int16_t` and `float`.
+ *
+ * @param block: the samples of the block, ordered as [input][time_sample].
+ * @param firstTimestep: index, within `output`, of the first timestep of the block.
+ * @param samplesPerBlock: number of samples of each input in the block.
+ * @param nInputs: number of inputs, i.e. stations x polarizations.
+ * @param nIntegrationSteps: number of timesteps in an integration interval.
+ * @param inputMapping: if not empty, output position of each input.
+ * @param output: pointer to the beginning of the whole voltage array.
+ */
+template <typename T>
+void reorder_subfile_block(const std::complex<int8_t> *block, size_t firstTimestep, size_t samplesPerBlock, size_t nInputs,
+    unsigned int nIntegrationSteps, const std::vector<int>& inputMapping, std::complex<T> *output);
+
+#endif
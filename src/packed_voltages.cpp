@@ -0,0 +1,122 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "packed_voltages.hpp"
+
+namespace {
+    // Number of timesteps gathered for each input before being stored, so that every store
+    // writes a whole 64-bit word of consecutive integration steps.
+    constexpr size_t REORDER_STEPS {8};
+
+
+    inline uint8_t pack_sample(std::complex<int8_t> sample){
+        const int re {std::max(-8, std::min(7, static_cast<int>(sample.real())))};
+        const int im {std::max(-8, std::min(7, static_cast<int>(sample.imag())))};
+        return static_cast<uint8_t>((re & 0xF) | ((im & 0xF) << 4));
+    }
+
+
+    size_t packed_buffer_size(const ObservationInfo& obsInfo, unsigned int nIntegrationSteps){
+        const size_t nIntegrationIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+        return nIntegrationIntervals * nIntegrationSteps * obsInfo.nFrequencies * obsInfo.nAntennas * obsInfo.nPolarizations;
+    }
+}
+
+
+
+void reorder_dat_timesteps(const uint8_t *input, size_t firstTimestep, size_t nTimesteps,
+        const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, uint8_t *output){
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t bytesPerTimestep {nInputs * obsInfo.nFrequencies};
+    const size_t samplesInFrequency {nInputs * nIntegrationSteps};
+    const size_t samplesInTimeInterval {samplesInFrequency * obsInfo.nFrequencies};
+
+    size_t t {0};
+    while(t < nTimesteps){
+        // Process at once all the timesteps falling in the current integration interval.
+        const size_t currentTimestep {firstTimestep + t};
+        const size_t currentTimeInterval {currentTimestep / nIntegrationSteps};
+        const size_t currentIntegratorStep {currentTimestep % nIntegrationSteps};
+        const size_t nSteps {std::min(nIntegrationSteps - currentIntegratorStep, nTimesteps - t)};
+        const uint8_t *pInput {input + t * bytesPerTimestep};
+        uint8_t *pOutput {output + currentTimeInterval * samplesInTimeInterval + currentIntegratorStep};
+        for(size_t ch {0}; ch < obsInfo.nFrequencies; ch++){
+            const uint8_t *pIn {pInput + ch * nInputs};
+            uint8_t *pOut {pOutput + ch * samplesInFrequency};
+            size_t s {0};
+            for(; s + REORDER_STEPS <= nSteps; s += REORDER_STEPS){
+                const uint8_t *rows {pIn + s * bytesPerTimestep};
+                for(size_t j {0}; j < nInputs; j++){
+                    uint8_t tile[REORDER_STEPS];
+                    for(size_t k {0}; k < REORDER_STEPS; k++) tile[k] = rows[k * bytesPerTimestep + j];
+                    memcpy(pOut + j * nIntegrationSteps + s, tile, REORDER_STEPS);
+                }
+            }
+            for(; s < nSteps; s++){
+                const uint8_t *row {pIn + s * bytesPerTimestep};
+                for(size_t j {0}; j < nInputs; j++) pOut[j * nIntegrationSteps + s] = row[j];
+            }
+        }
+        t += nSteps;
+    }
+}
+
+
+
+void PackedVoltages::unpack(size_t offset, size_t nSamples, std::complex<int8_t> *output, SimdLevel level) const {
+    if(on_gpu()) throw std::invalid_argument {"PackedVoltages::unpack: data must reside in CPU memory."};
+    if(offset + nSamples > MemoryBuffer::size())
+        throw std::out_of_range {"PackedVoltages::unpack: requested samples exceed the buffer size."};
+    expand_4bit_samples(data() + offset, nSamples, output, level);
+}
+
+
+
+void PackedVoltages::unpack_channel(size_t interval, unsigned int channel, std::complex<int8_t> *output,
+        SimdLevel level) const {
+    const size_t blockSize {channel_block_size()};
+    unpack((interval * obsInfo.nFrequencies + channel) * blockSize, blockSize, output, level);
+}
+
+
+
+Voltages PackedVoltages::to_voltages(bool use_pinned_mem) const {
+    const size_t nSamples {MemoryBuffer::size()};
+    MemoryBuffer<std::complex<int8_t>> mbVoltages {nSamples, false, use_pinned_mem};
+    unpack(0, nSamples, mbVoltages.data());
+    return Voltages {std::move(mbVoltages), obsInfo, nIntegrationSteps};
+}
+
+
+
+PackedVoltages PackedVoltages::from_dat_file(const std::string& filename, const ObservationInfo& obsInfo,
+        unsigned int nIntegrationSteps, ReadBackend backend){
+    if(nIntegrationSteps == 0) throw std::invalid_argument {"PackedVoltages::from_dat_file: `nIntegrationSteps` must be positive."};
+    std::unique_ptr<FileReader> reader {open_file_reader(filename, backend)};
+    const size_t bytesPerTimestep {static_cast<size_t>(obsInfo.nFrequencies) * obsInfo.nAntennas * obsInfo.nPolarizations};
+    const size_t nTimesteps {std::min(reader->size() / bytesPerTimestep, static_cast<size_t>(obsInfo.nTimesteps))};
+    const size_t nBytes {packed_buffer_size(obsInfo, nIntegrationSteps)};
+    MemoryBuffer<uint8_t> mbVoltages {nBytes, false, false};
+    uint8_t *voltages {mbVoltages.data()};
+    // zero is a valid packed sample, (0, 0), used to pad missing timesteps.
+    memset(voltages, 0, nBytes);
+    const size_t timestepsPerRead {100u};
+    reader->read_chunks(0, nTimesteps * bytesPerTimestep, timestepsPerRead * bytesPerTimestep, 2u,
+            [&](size_t offset, const uint8_t *data, size_t size){
+        reorder_dat_timesteps(data, offset / bytesPerTimestep, size / bytesPerTimestep, obsInfo, nIntegrationSteps, voltages);
+    });
+    return PackedVoltages {std::move(mbVoltages), obsInfo, nIntegrationSteps};
+}
+
+
+
+PackedVoltages PackedVoltages::from_voltages(const Voltages& voltages){
+    if(voltages.on_gpu()) throw std::invalid_argument {"PackedVoltages::from_voltages: data must reside in CPU memory."};
+    const size_t nSamples {packed_buffer_size(voltages.obsInfo, voltages.nIntegrationSteps)};
+    MemoryBuffer<uint8_t> mbVoltages {nSamples, false, false};
+    const std::complex<int8_t> *input {voltages.data()};
+    uint8_t *output {mbVoltages.data()};
+    for(size_t i {0}; i < nSamples; i++) output[i] = pack_sample(input[i]);
+    return PackedVoltages {std::move(mbVoltages), voltages.obsInfo, voltages.nIntegrationSteps};
+}
@@ -0,0 +1,121 @@
+#ifndef __PACKED_VOLTAGES_H__
+#define __PACKED_VOLTAGES_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <complex>
+#include <string>
+
+#include "astroio.hpp"
+#include "memory_buffer.hpp"
+#include "file_reader.hpp"
+#include "voltage_expansion.hpp"
+
+
+/**
+ * @brief Voltage data kept in the 4+4 bit format of .dat files, but already reordered into the
+ * layout used by `Voltages`:
+ *      [integration_interval][frequency][antenna][polarization][time_step].
+ *
+ * Each byte holds one complex sample, the real part in the low nibble and the imaginary part in the
+ * high nibble, both in two's complement. The object takes half the memory of the equivalent `Voltages`
+ * one, so that twice as many seconds of data can be kept resident. Samples are expanded to 8+8 bits
+ * on demand, block by block, with the `unpack*` methods.
+ */
+class PackedVoltages : public MemoryBuffer<uint8_t> {
+
+    public:
+    ObservationInfo obsInfo;
+    unsigned int nIntegrationSteps;
+
+    PackedVoltages(MemoryBuffer<uint8_t>&& data, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps)
+        : MemoryBuffer {std::move(data)}, obsInfo (obsInfo), nIntegrationSteps {nIntegrationSteps} {}
+
+    PackedVoltages(const PackedVoltages& other) = default;
+    PackedVoltages(PackedVoltages&& other) = default;
+    PackedVoltages& operator=(const PackedVoltages& other) = default;
+    PackedVoltages& operator=(PackedVoltages&& other) = default;
+
+    /**
+     * @brief Number of complex samples in the array.
+     */
+    size_t size() const {
+        return static_cast<size_t>(obsInfo.nPolarizations) * obsInfo.nAntennas * obsInfo.nFrequencies * obsInfo.nTimesteps;
+    }
+
+    /**
+     * @brief Number of integration intervals in the array.
+     */
+    size_t integration_intervals() const {
+        return (obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps;
+    }
+
+    /**
+     * @brief Number of complex samples in one frequency channel of an integration interval, i.e. the
+     * size of the blocks returned by `unpack_channel`.
+     */
+    size_t channel_block_size() const {
+        return static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations * nIntegrationSteps;
+    }
+
+    /**
+     * @brief Pointer to the `nIntegrationSteps` packed samples of the given antenna and polarization.
+     */
+    const uint8_t* at(size_t interval, unsigned int channel, unsigned int antenna, unsigned int polarization) const {
+        const size_t input {static_cast<size_t>(antenna) * obsInfo.nPolarizations + polarization};
+        return data() + (interval * obsInfo.nFrequencies + channel) * channel_block_size() + input * nIntegrationSteps;
+    }
+
+    /**
+     * @brief Expand `nSamples` samples, starting from the `offset`-th one, into 8+8 bit samples.
+     * The output uses the same layout, hence can be any subarray of a `Voltages` object.
+     */
+    void unpack(size_t offset, size_t nSamples, std::complex<int8_t> *output, SimdLevel level = detect_simd_level()) const;
+
+    /**
+     * @brief Expand a whole frequency channel of an integration interval, i.e. `channel_block_size()`
+     * samples ordered as [antenna][polarization][time_step]. This is the unit downstream kernels
+     * typically work on, and its size is small enough to stay in cache.
+     */
+    void unpack_channel(size_t interval, unsigned int channel, std::complex<int8_t> *output,
+        SimdLevel level = detect_simd_level()) const;
+
+    /**
+     * @brief Expand all the samples into a new `Voltages` object.
+     */
+    Voltages to_voltages(bool use_pinned_mem = false) const;
+
+    /**
+     * @brief Read a .dat file keeping the samples packed. The result holds the same samples, in the same
+     * layout, as the one returned by `Voltages::from_dat_file`.
+     *
+     * @param filename: path to the .dat file.
+     * @param obsInfo; metadata information regarding the obervation.
+     * @param nIntegrationSteps: number of timesteps in an integration interval.
+     * @param backend: how data is read from disk.
+     */
+    static PackedVoltages from_dat_file(const std::string& filename, const ObservationInfo& obsInfo,
+        unsigned int nIntegrationSteps, ReadBackend backend = ReadBackend::BUFFERED);
+
+    /**
+     * @brief Pack 8+8 bit voltages. Values outside the 4-bit range [-8, 7] are clipped.
+     */
+    static PackedVoltages from_voltages(const Voltages& voltages);
+};
+
+
+/**
+ * @brief Reorder `nTimesteps` consecutive timesteps of .dat samples, the first of which is timestep
+ * `firstTimestep` of the observation, into the `PackedVoltages` layout, without expanding them.
+ *
+ * @param input: packed samples, ordered as [time][channel][station][polarization].
+ * @param firstTimestep: index, within the observation, of the first timestep in `input`.
+ * @param nTimesteps: number of timesteps in `input`.
+ * @param obsInfo: observation the samples belong to.
+ * @param nIntegrationSteps: number of timesteps in an integration interval.
+ * @param output: pointer to the beginning of the whole packed voltage array.
+ */
+void reorder_dat_timesteps(const uint8_t *input, size_t firstTimestep, size_t nTimesteps,
+    const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, uint8_t *output);
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <thread>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+
+
+/**
+ * @brief Split the range [0, nItems) in at most `nThreads` contiguous ranges whose boundaries are
+ * multiples of `granularity`, and process each of them in a separate thread.
+ *
+ * @param nItems: number of items to process.
+ * @param nThreads: maximum number of threads to use. The calling thread processes the first range.
+ * @param granularity: range boundaries are multiples of this number (except for the last one).
+ * @param fn: callable invoked as `fn(begin, end)` on each range.
+ *
+ * If any invocation of `fn` throws, the first exception is rethrown after all threads have completed.
+ * If a thread cannot be created, the ones already started are joined and the error is rethrown.
+ */
+template <typename F>
+void parallel_for_ranges(size_t nItems, unsigned int nThreads, size_t granularity, F fn){
+    if(nItems == 0) return;
+    if(granularity == 0) granularity = 1;
+    const size_t nUnits {(nItems + granularity - 1) / granularity};
+    const size_t nRanges {std::max<size_t>(1, std::min<size_t>(nThreads, nUnits))};
+    std::vector<std::exception_ptr> errors(nRanges);
+    auto run_range = [&](size_t r){
+        const size_t begin {std::min(nItems, (nUnits * r / nRanges) * granularity)};
+        const size_t end {std::min(nItems, (nUnits * (r + 1) / nRanges) * granularity)};
+        try{
+            if(begin < end) fn(begin, end);
+        }catch(...){
+            errors[r] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    try{
+        for(size_t r {1}; r < nRanges; r++) threads.emplace_back(run_range, r);
+    }catch(...){
+        // destroying joinable threads would terminate the program.
+        for(auto& t : threads) t.join();
+        throw;
+    }
+    run_range(0);
+    for(auto& t : threads) t.join();
+    for(auto& e : errors) if(e) std::rethrow_exception(e);
+}
+
+
+
+/**
+ * @brief A fixed set of worker threads executing submitted tasks in FIFO order.
+ *
+ * Creating threads is relatively expensive, so a pool is meant to be created once and reused across
+ * many batches of work (e.g. every second of an observation).
+ */
+class ThreadPool {
+    private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping {false};
+
+    public:
+    /**
+     * @brief Start `nThreads` worker threads (at least one).
+     */
+    explicit ThreadPool(unsigned int nThreads){
+        nThreads = std::max(1u, nThreads);
+        for(unsigned int i {0}; i < nThreads; i++){
+            workers.emplace_back([this](){
+                while(true){
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock {mutex};
+                        cv.wait(lock, [this](){ return stopping || !tasks.empty(); });
+                        if(tasks.empty()) return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Wait for all the submitted tasks to complete and join the workers.
+     */
+    ~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock {mutex};
+            stopping = true;
+        }
+        cv.notify_all();
+        for(auto& w : workers) w.join();
+    }
+
+    /**
+     * @brief Number of worker threads.
+     */
+    size_t size() const { return workers.size(); }
+
+    /**
+     * @brief Schedule `fn()` for execution on one of the workers.
+     * @return a future holding the value returned, or the exception thrown, by `fn`.
+     */
+    template <typename F>
+    std::future<typename std::result_of<F()>::type> submit(F fn){
+        using R = typename std::result_of<F()>::type;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::move(fn));
+        std::future<R> result {task->get_future()};
+        {
+            std::lock_guard<std::mutex> lock {mutex};
+            if(stopping) throw std::runtime_error {"ThreadPool::submit: the pool is being destroyed."};
+            tasks.emplace([task](){ (*task)(); });
+        }
+        cv.notify_one();
+        return result;
+    }
+};
+
+#endif
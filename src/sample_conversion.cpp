@@ -0,0 +1,294 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "sample_conversion.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#define ASTROIO_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+    template <typename Out>
+    Out round_saturate(float value){
+        const float lo {std::numeric_limits<Out>::min()}, hi {std::numeric_limits<Out>::max()};
+        // written such that NaNs are mapped to `lo`, as done by the vector kernels.
+        value = value >= lo ? value : lo;
+        value = value <= hi ? value : hi;
+        return static_cast<Out>(std::nearbyint(value));
+    }
+
+
+    inline void convert_value(int8_t value, int16_t& out){ out = value; }
+    inline void convert_value(int8_t value, float& out){ out = value; }
+    inline void convert_value(int16_t value, float& out){ out = value; }
+    inline void convert_value(int16_t value, int8_t& out){ out = static_cast<int8_t>(std::min<int>(127, std::max<int>(-128, value))); }
+    inline void convert_value(float value, int8_t& out){ out = round_saturate<int8_t>(value); }
+    inline void convert_value(float value, int16_t& out){ out = round_saturate<int16_t>(value); }
+
+
+    template <typename In, typename Out>
+    void convert_scalar(const In *input, Out *output, size_t n){
+        for(size_t i {0}; i < n; i++) convert_value(input[i], output[i]);
+    }
+
+
+    #ifdef ASTROIO_X86_SIMD
+
+    /*
+        Vector kernels convert whole registers and leave the remainder to the scalar loop. Floats are
+        clamped before the conversion to integers, which otherwise maps out of range values and NaNs
+        to INT32_MIN, and `cvtps` rounds to nearest even, as `nearbyint` does in the default rounding mode.
+    */
+
+    __attribute__((target("sse4.1")))
+    __m128i round_saturate_sse4(const float *input, float lo, float hi){
+        const __m128 v {_mm_min_ps(_mm_max_ps(_mm_loadu_ps(input), _mm_set1_ps(lo)), _mm_set1_ps(hi))};
+        return _mm_cvtps_epi32(v);
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void convert_sse4(const int8_t *input, int16_t *output, size_t n){
+        size_t i {0};
+        for(; i + 8 <= n; i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i),
+                _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(input + i))));
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void convert_sse4(const int8_t *input, float *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16){
+            const __m128i v {_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i))};
+            _mm_storeu_ps(output + i, _mm_cvtepi32_ps(_mm_cvtepi8_epi32(v)));
+            _mm_storeu_ps(output + i + 4, _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(v, 4))));
+            _mm_storeu_ps(output + i + 8, _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(v, 8))));
+            _mm_storeu_ps(output + i + 12, _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(v, 12))));
+        }
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void convert_sse4(const int16_t *input, int8_t *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16){
+            const __m128i a {_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i))};
+            const __m128i b {_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 8))};
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packs_epi16(a, b));
+        }
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void convert_sse4(const int16_t *input, float *output, size_t n){
+        size_t i {0};
+        for(; i + 8 <= n; i += 8){
+            const __m128i v {_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i))};
+            _mm_storeu_ps(output + i, _mm_cvtepi32_ps(_mm_cvtepi16_epi32(v)));
+            _mm_storeu_ps(output + i + 4, _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(v, 8))));
+        }
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void convert_sse4(const float *input, int8_t *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16){
+            const __m128i ab {_mm_packs_epi32(round_saturate_sse4(input + i, -128.0f, 127.0f),
+                round_saturate_sse4(input + i + 4, -128.0f, 127.0f))};
+            const __m128i cd {_mm_packs_epi32(round_saturate_sse4(input + i + 8, -128.0f, 127.0f),
+                round_saturate_sse4(input + i + 12, -128.0f, 127.0f))};
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packs_epi16(ab, cd));
+        }
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void convert_sse4(const float *input, int16_t *output, size_t n){
+        size_t i {0};
+        for(; i + 8 <= n; i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packs_epi32(
+                round_saturate_sse4(input + i, -32768.0f, 32767.0f), round_saturate_sse4(input + i + 4, -32768.0f, 32767.0f)));
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx2")))
+    __m256i round_saturate_avx2(const float *input, float lo, float hi){
+        const __m256 v {_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(input), _mm256_set1_ps(lo)), _mm256_set1_ps(hi))};
+        return _mm256_cvtps_epi32(v);
+    }
+
+
+    __attribute__((target("avx2")))
+    void convert_avx2(const int8_t *input, int16_t *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i),
+                _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i))));
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx2")))
+    void convert_avx2(const int8_t *input, float *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16){
+            const __m128i v {_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i))};
+            _mm256_storeu_ps(output + i, _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v)));
+            _mm256_storeu_ps(output + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(v, 8))));
+        }
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx2")))
+    void convert_avx2(const int16_t *input, int8_t *output, size_t n){
+        size_t i {0};
+        for(; i + 32 <= n; i += 32){
+            const __m256i a {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i))};
+            const __m256i b {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + 16))};
+            // packs works within 128-bit lanes: restore the order of the 64-bit halves.
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i),
+                _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx2")))
+    void convert_avx2(const int16_t *input, float *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16){
+            const __m256i v {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i))};
+            _mm256_storeu_ps(output + i, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v))));
+            _mm256_storeu_ps(output + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1))));
+        }
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx2")))
+    void convert_avx2(const float *input, int8_t *output, size_t n){
+        size_t i {0};
+        for(; i + 32 <= n; i += 32){
+            const __m256i ab {_mm256_packs_epi32(round_saturate_avx2(input + i, -128.0f, 127.0f),
+                round_saturate_avx2(input + i + 8, -128.0f, 127.0f))};
+            const __m256i cd {_mm256_packs_epi32(round_saturate_avx2(input + i + 16, -128.0f, 127.0f),
+                round_saturate_avx2(input + i + 24, -128.0f, 127.0f))};
+            // each lane holds 4 bytes from each of the 4 inputs, in the order a, b, c, d.
+            const __m256i order {_mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)};
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i),
+                _mm256_permutevar8x32_epi32(_mm256_packs_epi16(ab, cd), order));
+        }
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx2")))
+    void convert_avx2(const float *input, int16_t *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16){
+            const __m256i ab {_mm256_packs_epi32(round_saturate_avx2(input + i, -32768.0f, 32767.0f),
+                round_saturate_avx2(input + i + 8, -32768.0f, 32767.0f))};
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_permute4x64_epi64(ab, _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    __m512i round_saturate_avx512(const float *input, float lo, float hi){
+        const __m512 v {_mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(input), _mm512_set1_ps(lo)), _mm512_set1_ps(hi))};
+        return _mm512_cvtps_epi32(v);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void convert_avx512(const int8_t *input, int16_t *output, size_t n){
+        size_t i {0};
+        for(; i + 32 <= n; i += 32)
+            _mm512_storeu_si512(output + i, _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i))));
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void convert_avx512(const int8_t *input, float *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(output + i, _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i)))));
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void convert_avx512(const int16_t *input, int8_t *output, size_t n){
+        size_t i {0};
+        for(; i + 32 <= n; i += 32)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm512_cvtsepi16_epi8(_mm512_loadu_si512(input + i)));
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void convert_avx512(const int16_t *input, float *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(output + i, _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i)))));
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void convert_avx512(const float *input, int8_t *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm512_cvtsepi32_epi8(round_saturate_avx512(input + i, -128.0f, 127.0f)));
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void convert_avx512(const float *input, int16_t *output, size_t n){
+        size_t i {0};
+        for(; i + 16 <= n; i += 16)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i),
+                _mm512_cvtsepi32_epi16(round_saturate_avx512(input + i, -32768.0f, 32767.0f)));
+        convert_scalar(input + i, output + i, n - i);
+    }
+
+    #endif
+
+
+    template <typename In, typename Out>
+    void convert(const In *input, Out *output, size_t n, SimdLevel level){
+        #ifdef ASTROIO_X86_SIMD
+        switch(std::min(level, detect_simd_level())){
+            case SimdLevel::AVX512: convert_avx512(input, output, n); return;
+            case SimdLevel::AVX2: convert_avx2(input, output, n); return;
+            case SimdLevel::SSE4: convert_sse4(input, output, n); return;
+            default: break;
+        }
+        #endif
+        convert_scalar(input, output, n);
+    }
+}
+
+
+
+void convert_samples(const int8_t *input, int16_t *output, size_t n, SimdLevel level){ convert(input, output, n, level); }
+void convert_samples(const int8_t *input, float *output, size_t n, SimdLevel level){ convert(input, output, n, level); }
+void convert_samples(const int16_t *input, int8_t *output, size_t n, SimdLevel level){ convert(input, output, n, level); }
+void convert_samples(const int16_t *input, float *output, size_t n, SimdLevel level){ convert(input, output, n, level); }
+void convert_samples(const float *input, int8_t *output, size_t n, SimdLevel level){ convert(input, output, n, level); }
+void convert_samples(const float *input, int16_t *output, size_t n, SimdLevel level){ convert(input, output, n, level); }
@@ -0,0 +1,62 @@
+#ifndef __SAMPLE_CONVERSION_H__
+#define __SAMPLE_CONVERSION_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <complex>
+#include <stdexcept>
+#include "astroio.hpp"
+#include "memory_buffer.hpp"
+#include "voltage_expansion.hpp"
+#include "parallel.hpp"
+
+/*
+    Conversions between the sample types voltages can be stored with. Widening conversions are exact.
+    Narrowing ones round to the nearest integer, ties to even, and saturate to the range of the output
+    type; NaNs become the smallest value of the range.
+
+    Each function converts `n` real values, so a complex array of `m` samples is converted with `n = 2 * m`.
+*/
+
+void convert_samples(const int8_t *input, int16_t *output, size_t n, SimdLevel level = detect_simd_level());
+void convert_samples(const int8_t *input, float *output, size_t n, SimdLevel level = detect_simd_level());
+void convert_samples(const int16_t *input, int8_t *output, size_t n, SimdLevel level = detect_simd_level());
+void convert_samples(const int16_t *input, float *output, size_t n, SimdLevel level = detect_simd_level());
+void convert_samples(const float *input, int8_t *output, size_t n, SimdLevel level = detect_simd_level());
+void convert_samples(const float *input, int16_t *output, size_t n, SimdLevel level = detect_simd_level());
+
+
+/**
+ * @brief Conversion to the same type, i.e. a copy.
+ */
+template <typename T>
+void convert_samples(const T *input, T *output, size_t n, SimdLevel = detect_simd_level()){
+    memcpy(output, input, n * sizeof(T));
+}
+
+
+/**
+ * @brief Convert voltages to another sample type. The layout, observation information and padding of
+ * the last integration interval are preserved.
+ *
+ * @param voltages: voltages to convert; they must reside in CPU memory.
+ * @param nThreads: number of threads converting the samples.
+ * @param use_pinned_mem: if GPU support is enabled, gives the option to pin the memory of the result.
+ */
+template <typename T, typename U>
+BasicVoltages<T> convert_voltages(const BasicVoltages<U>& voltages, unsigned int nThreads = 1, bool use_pinned_mem = false){
+    if(voltages.on_gpu()) throw std::invalid_argument {"convert_voltages: data must reside in CPU memory."};
+    // The base class size includes the padding of the last integration interval.
+    const size_t nSamples {voltages.MemoryBuffer<std::complex<U>>::size()};
+    MemoryBuffer<std::complex<T>> mbVoltages {nSamples, false, use_pinned_mem};
+    const U *input {reinterpret_cast<const U*>(voltages.data())};
+    T *output {reinterpret_cast<T*>(mbVoltages.data())};
+    const SimdLevel level {detect_simd_level()};
+    parallel_for_ranges(nSamples, nThreads, 4096u, [&](size_t begin, size_t end){
+        convert_samples(input + 2 * begin, output + 2 * begin, 2 * (end - begin), level);
+    });
+    return BasicVoltages<T> {std::move(mbVoltages), voltages.obsInfo, voltages.nIntegrationSteps};
+}
+
+#endif
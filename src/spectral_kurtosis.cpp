@@ -0,0 +1,400 @@
+#include <cmath>
+#include <algorithm>
+#include "spectral_kurtosis.hpp"
+#include "voltage_expansion.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#define ASTROIO_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Largest block, in timesteps, whose sums fit 32-bit counters: 2^16 powers of at most 128, squared.
+    constexpr size_t MAX_BLOCK_SIZE {65536};
+    // Timesteps of packed samples summed in 16-bit lanes before they are added to the 32-bit sums.
+    constexpr size_t MAX_DAT_STEPS {256};
+    // Samples summed in 32-bit lanes before they are added to the 64-bit totals: 2^16 samples of power
+    // at most 128 keep the sum of the squared powers below 2^31.
+    constexpr size_t MAX_LANE_SAMPLES {65536};
+
+
+    /*
+        Power sum kernels add to `s1` and `s2` the power, and its square, of `nSamples` consecutive samples.
+        Vector kernels compute the power of each sample as the sum of the squares of its bytes with a
+        multiply-add of unsigned by signed bytes on the absolute values, which is exact as long as they
+        are below 128, then both sums with multiply-adds of 16-bit lanes.
+    */
+    using PowerSumKernel = void (*)(const std::complex<int8_t>*, size_t, uint64_t&, uint64_t&);
+
+
+    void power_sums_scalar(const std::complex<int8_t> *samples, size_t nSamples, uint64_t& s1, uint64_t& s2){
+        for(size_t i {0}; i < nSamples; i++){
+            const uint32_t p {static_cast<uint32_t>(samples[i].real() * samples[i].real() + samples[i].imag() * samples[i].imag())};
+            s1 += p;
+            s2 += static_cast<uint64_t>(p) * p;
+        }
+    }
+
+
+    #ifdef ASTROIO_X86_SIMD
+
+    __attribute__((target("sse4.1")))
+    uint32_t hsum_epi32(__m128i v){
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void power_sums_sse4(const std::complex<int8_t> *samples, size_t nSamples, uint64_t& s1, uint64_t& s2){
+        const __m128i ones {_mm_set1_epi16(1)};
+        for(size_t begin {0}; begin < nSamples; begin += MAX_LANE_SAMPLES){
+            const size_t end {std::min(nSamples, begin + MAX_LANE_SAMPLES)};
+            __m128i acc1 {_mm_setzero_si128()}, acc2 {_mm_setzero_si128()};
+            size_t i {begin};
+            for(; i + 8 <= end; i += 8){
+                const __m128i a {_mm_abs_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i)))};
+                const __m128i p {_mm_maddubs_epi16(a, a)};
+                acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(p, ones));
+                acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(p, p));
+            }
+            s1 += hsum_epi32(acc1);
+            s2 += hsum_epi32(acc2);
+            power_sums_scalar(samples + i, end - i, s1, s2);
+        }
+    }
+
+
+    __attribute__((target("avx2")))
+    void power_sums_avx2(const std::complex<int8_t> *samples, size_t nSamples, uint64_t& s1, uint64_t& s2){
+        const __m256i ones {_mm256_set1_epi16(1)};
+        for(size_t begin {0}; begin < nSamples; begin += MAX_LANE_SAMPLES){
+            const size_t end {std::min(nSamples, begin + MAX_LANE_SAMPLES)};
+            __m256i acc1 {_mm256_setzero_si256()}, acc2 {_mm256_setzero_si256()};
+            size_t i {begin};
+            for(; i + 16 <= end; i += 16){
+                const __m256i a {_mm256_abs_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i)))};
+                const __m256i p {_mm256_maddubs_epi16(a, a)};
+                acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(p, ones));
+                acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(p, p));
+            }
+            s1 += hsum_epi32(_mm_add_epi32(_mm256_castsi256_si128(acc1), _mm256_extracti128_si256(acc1, 1)));
+            s2 += hsum_epi32(_mm_add_epi32(_mm256_castsi256_si128(acc2), _mm256_extracti128_si256(acc2, 1)));
+            power_sums_scalar(samples + i, end - i, s1, s2);
+        }
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void power_sums_avx512(const std::complex<int8_t> *samples, size_t nSamples, uint64_t& s1, uint64_t& s2){
+        const __m512i ones {_mm512_set1_epi16(1)};
+        for(size_t begin {0}; begin < nSamples; begin += MAX_LANE_SAMPLES){
+            const size_t end {std::min(nSamples, begin + MAX_LANE_SAMPLES)};
+            __m512i acc1 {_mm512_setzero_si512()}, acc2 {_mm512_setzero_si512()};
+            for(size_t i {begin}; i < end; i += 32){
+                // the tail is loaded with a byte mask, zeroing the samples past the end.
+                const size_t nBytes {std::min<size_t>(32, end - i) * 2};
+                const __mmask64 mask {nBytes == 64 ? ~__mmask64 {0} : (__mmask64 {1} << nBytes) - 1};
+                const __m512i a {_mm512_abs_epi8(_mm512_maskz_loadu_epi8(mask, samples + i))};
+                const __m512i p {_mm512_maddubs_epi16(a, a)};
+                acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(p, ones));
+                acc2 = _mm512_add_epi32(acc2, _mm512_madd_epi16(p, p));
+            }
+            s1 += static_cast<uint32_t>(_mm512_reduce_add_epi32(acc1));
+            s2 += static_cast<uint32_t>(_mm512_reduce_add_epi32(acc2));
+        }
+    }
+
+    #endif
+
+
+    // Square of each 4-bit value, indexed by its two's complement representation.
+    constexpr uint8_t nibble_squares[16] {0, 1, 4, 9, 16, 25, 36, 49, 64, 49, 36, 25, 16, 9, 4, 1};
+
+
+    /*
+        Packed power sum kernels add to `s1` and `s2` the power, and its square, of each input over at most
+        MAX_DAT_STEPS rows of packed samples. Inputs are processed in vectors of consecutive inputs: the power
+        of a sample is the sum of the squares of its nibbles, looked up with a byte shuffle, and is summed in
+        16-bit lanes; its square, at most 2^14, is summed in 32-bit lanes.
+    */
+    using DatPowerSumKernel = void (*)(const uint8_t*, size_t, size_t, size_t, uint32_t*, uint32_t*);
+
+
+    void dat_power_sums_scalar_range(const uint8_t *input, size_t inStride, size_t nSteps, size_t firstInput, size_t nInputs,
+            uint32_t *s1, uint32_t *s2){
+        for(size_t j {firstInput}; j < nInputs; j++){
+            uint32_t sum1 {0}, sum2 {0};
+            for(size_t s {0}; s < nSteps; s++){
+                const uint8_t sample {input[s * inStride + j]};
+                const uint32_t p {static_cast<uint32_t>(nibble_squares[sample & 0xf] + nibble_squares[sample >> 4])};
+                sum1 += p;
+                sum2 += p * p;
+            }
+            s1[j] += sum1;
+            s2[j] += sum2;
+        }
+    }
+
+
+    void dat_power_sums_scalar(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint32_t *s1, uint32_t *s2){
+        dat_power_sums_scalar_range(input, inStride, nSteps, 0, nInputs, s1, s2);
+    }
+
+
+    #ifdef ASTROIO_X86_SIMD
+
+    __attribute__((target("sse4.1")))
+    void dat_power_sums_sse4(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint32_t *s1, uint32_t *s2){
+        const __m128i lowNibble {_mm_set1_epi8(0x0F)};
+        const __m128i squares {_mm_loadu_si128(reinterpret_cast<const __m128i*>(nibble_squares))};
+        const size_t nVecInputs {nInputs - nInputs % 16};
+        for(size_t j {0}; j < nVecInputs; j += 16){
+            __m128i sum1[2] {_mm_setzero_si128(), _mm_setzero_si128()};
+            __m128i sum2[4] {_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+            for(size_t s {0}; s < nSteps; s++){
+                const __m128i v {_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + s * inStride + j))};
+                const __m128i p {_mm_add_epi8(_mm_shuffle_epi8(squares, _mm_and_si128(v, lowNibble)),
+                    _mm_shuffle_epi8(squares, _mm_and_si128(_mm_srli_epi16(v, 4), lowNibble)))};
+                for(unsigned int h {0}; h < 2; h++){
+                    const __m128i p16 {_mm_cvtepu8_epi16(h == 0 ? p : _mm_srli_si128(p, 8))};
+                    const __m128i q {_mm_mullo_epi16(p16, p16)};
+                    sum1[h] = _mm_add_epi16(sum1[h], p16);
+                    sum2[2 * h] = _mm_add_epi32(sum2[2 * h], _mm_cvtepu16_epi32(q));
+                    sum2[2 * h + 1] = _mm_add_epi32(sum2[2 * h + 1], _mm_cvtepu16_epi32(_mm_srli_si128(q, 8)));
+                }
+            }
+            for(unsigned int k {0}; k < 4; k++){
+                __m128i *pS1 {reinterpret_cast<__m128i*>(s1 + j + 4 * k)}, *pS2 {reinterpret_cast<__m128i*>(s2 + j + 4 * k)};
+                const __m128i part1 {_mm_cvtepu16_epi32(k % 2 == 0 ? sum1[k / 2] : _mm_srli_si128(sum1[k / 2], 8))};
+                _mm_storeu_si128(pS1, _mm_add_epi32(_mm_loadu_si128(pS1), part1));
+                _mm_storeu_si128(pS2, _mm_add_epi32(_mm_loadu_si128(pS2), sum2[k]));
+            }
+        }
+        dat_power_sums_scalar_range(input, inStride, nSteps, nVecInputs, nInputs, s1, s2);
+    }
+
+
+    __attribute__((target("avx2")))
+    void dat_power_sums_avx2(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint32_t *s1, uint32_t *s2){
+        const __m256i lowNibble {_mm256_set1_epi8(0x0F)};
+        const __m256i squares {_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nibble_squares)))};
+        const size_t nVecInputs {nInputs - nInputs % 32};
+        for(size_t j {0}; j < nVecInputs; j += 32){
+            __m256i sum1[2] {_mm256_setzero_si256(), _mm256_setzero_si256()};
+            __m256i sum2[4] {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+            for(size_t s {0}; s < nSteps; s++){
+                const __m256i v {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + s * inStride + j))};
+                const __m256i p {_mm256_add_epi8(_mm256_shuffle_epi8(squares, _mm256_and_si256(v, lowNibble)),
+                    _mm256_shuffle_epi8(squares, _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibble)))};
+                for(unsigned int h {0}; h < 2; h++){
+                    const __m256i p16 {_mm256_cvtepu8_epi16(h == 0 ? _mm256_castsi256_si128(p) : _mm256_extracti128_si256(p, 1))};
+                    const __m256i q {_mm256_mullo_epi16(p16, p16)};
+                    sum1[h] = _mm256_add_epi16(sum1[h], p16);
+                    sum2[2 * h] = _mm256_add_epi32(sum2[2 * h], _mm256_cvtepu16_epi32(_mm256_castsi256_si128(q)));
+                    sum2[2 * h + 1] = _mm256_add_epi32(sum2[2 * h + 1], _mm256_cvtepu16_epi32(_mm256_extracti128_si256(q, 1)));
+                }
+            }
+            for(unsigned int k {0}; k < 4; k++){
+                __m256i *pS1 {reinterpret_cast<__m256i*>(s1 + j + 8 * k)}, *pS2 {reinterpret_cast<__m256i*>(s2 + j + 8 * k)};
+                const __m256i part1 {_mm256_cvtepu16_epi32(k % 2 == 0 ? _mm256_castsi256_si128(sum1[k / 2])
+                    : _mm256_extracti128_si256(sum1[k / 2], 1))};
+                _mm256_storeu_si256(pS1, _mm256_add_epi32(_mm256_loadu_si256(pS1), part1));
+                _mm256_storeu_si256(pS2, _mm256_add_epi32(_mm256_loadu_si256(pS2), sum2[k]));
+            }
+        }
+        dat_power_sums_scalar_range(input, inStride, nSteps, nVecInputs, nInputs, s1, s2);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void dat_power_sums_avx512(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint32_t *s1, uint32_t *s2){
+        const __m512i lowNibble {_mm512_set1_epi8(0x0F)};
+        const __m512i squares {_mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nibble_squares)))};
+        const size_t nVecInputs {nInputs - nInputs % 64};
+        for(size_t j {0}; j < nVecInputs; j += 64){
+            __m512i sum1[2] {_mm512_setzero_si512(), _mm512_setzero_si512()};
+            __m512i sum2[4] {_mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512()};
+            for(size_t s {0}; s < nSteps; s++){
+                const __m512i v {_mm512_loadu_si512(input + s * inStride + j)};
+                const __m512i p {_mm512_add_epi8(_mm512_shuffle_epi8(squares, _mm512_and_si512(v, lowNibble)),
+                    _mm512_shuffle_epi8(squares, _mm512_and_si512(_mm512_srli_epi16(v, 4), lowNibble)))};
+                for(unsigned int h {0}; h < 2; h++){
+                    const __m512i p16 {_mm512_cvtepu8_epi16(h == 0 ? _mm512_castsi512_si256(p) : _mm512_extracti64x4_epi64(p, 1))};
+                    const __m512i q {_mm512_mullo_epi16(p16, p16)};
+                    sum1[h] = _mm512_add_epi16(sum1[h], p16);
+                    sum2[2 * h] = _mm512_add_epi32(sum2[2 * h], _mm512_cvtepu16_epi32(_mm512_castsi512_si256(q)));
+                    sum2[2 * h + 1] = _mm512_add_epi32(sum2[2 * h + 1], _mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(q, 1)));
+                }
+            }
+            for(unsigned int k {0}; k < 4; k++){
+                const __m512i part1 {_mm512_cvtepu16_epi32(k % 2 == 0 ? _mm512_castsi512_si256(sum1[k / 2])
+                    : _mm512_extracti64x4_epi64(sum1[k / 2], 1))};
+                _mm512_storeu_si512(s1 + j + 16 * k, _mm512_add_epi32(_mm512_loadu_si512(s1 + j + 16 * k), part1));
+                _mm512_storeu_si512(s2 + j + 16 * k, _mm512_add_epi32(_mm512_loadu_si512(s2 + j + 16 * k), sum2[k]));
+            }
+        }
+        dat_power_sums_scalar_range(input, inStride, nSteps, nVecInputs, nInputs, s1, s2);
+    }
+
+    #endif
+
+
+    DatPowerSumKernel select_dat_power_sum_kernel(SimdLevel level){
+        #ifdef ASTROIO_X86_SIMD
+        switch(std::min(level, detect_simd_level())){
+            case SimdLevel::AVX512: return dat_power_sums_avx512;
+            case SimdLevel::AVX2: return dat_power_sums_avx2;
+            case SimdLevel::SSE4: return dat_power_sums_sse4;
+            default: break;
+        }
+        #endif
+        return dat_power_sums_scalar;
+    }
+
+
+    /**
+     * @brief Zero `s1` and `s2`, then sum into them `nSteps` rows of packed samples, MAX_DAT_STEPS at a time.
+     */
+    void sum_dat_block(DatPowerSumKernel kernel, const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs,
+            uint32_t *s1, uint32_t *s2){
+        std::fill_n(s1, nInputs, 0u);
+        std::fill_n(s2, nInputs, 0u);
+        for(size_t s {0}; s < nSteps; s += MAX_DAT_STEPS)
+            kernel(input + s * inStride, inStride, std::min(MAX_DAT_STEPS, nSteps - s), nInputs, s1, s2);
+    }
+
+
+    /**
+     * @brief Whether a block with sums `s1` and `s2` of `nSamples` samples is outside of the bounds returned
+     * by `ratio_bounds`.
+     */
+    inline bool outside_bounds(uint64_t s1, uint64_t s2, size_t nSamples, double lower, double upper){
+        const double x {static_cast<double>(nSamples) * static_cast<double>(s2)};
+        const double y {static_cast<double>(s1) * static_cast<double>(s1)};
+        return s1 != 0 && (x < lower * y || x > upper * y);
+    }
+
+
+    PowerSumKernel select_power_sum_kernel(SimdLevel level){
+        #ifdef ASTROIO_X86_SIMD
+        switch(std::min(level, detect_simd_level())){
+            case SimdLevel::AVX512: return power_sums_avx512;
+            case SimdLevel::AVX2: return power_sums_avx2;
+            case SimdLevel::SSE4: return power_sums_sse4;
+            default: break;
+        }
+        #endif
+        return power_sums_scalar;
+    }
+}
+
+
+
+double spectral_kurtosis(uint64_t s1, uint64_t s2, size_t nSamples){
+    if(s1 == 0 || nSamples < 2) return 1.0;
+    const double m {static_cast<double>(nSamples)}, sum {static_cast<double>(s1)};
+    return (m + 1) / (m - 1) * (m * static_cast<double>(s2) / (sum * sum) - 1);
+}
+
+
+
+double spectral_kurtosis_sigma(size_t nSamples){
+    const double m {static_cast<double>(nSamples)};
+    return std::sqrt(4 * m * m / ((m - 1) * (m + 2) * (m + 3)));
+}
+
+
+
+void power_sums(const std::complex<int8_t> *samples, size_t stride, size_t nSamples, size_t nRows, uint64_t *s1,
+        uint64_t *s2, SimdLevel level){
+    const PowerSumKernel kernel {select_power_sum_kernel(level)};
+    for(size_t r {0}; r < nRows; r++){
+        s1[r] = s2[r] = 0;
+        kernel(samples + r * stride, nSamples, s1[r], s2[r]);
+    }
+}
+
+
+
+void dat_power_sums(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint64_t *s1, uint64_t *s2,
+        SimdLevel level){
+    const DatPowerSumKernel kernel {select_dat_power_sum_kernel(level)};
+    std::vector<uint32_t> sum1(nInputs), sum2(nInputs);
+    std::fill_n(s1, nInputs, 0u);
+    std::fill_n(s2, nInputs, 0u);
+    // partial sums are moved to 64-bit counters before the 32-bit ones can overflow.
+    for(size_t s {0}; s < nSteps; s += MAX_BLOCK_SIZE){
+        sum_dat_block(kernel, input + s * inStride, inStride, std::min(MAX_BLOCK_SIZE, nSteps - s), nInputs, sum1.data(), sum2.data());
+        for(size_t j {0}; j < nInputs; j++){
+            s1[j] += sum1[j];
+            s2[j] += sum2[j];
+        }
+    }
+}
+
+
+
+SpectralKurtosisFlagger::SpectralKurtosisFlagger(size_t nTimesteps, unsigned int nIntegrationSteps, unsigned int nChannels,
+        unsigned int nInputs, unsigned int blockSize, double threshold) : nTimesteps {nTimesteps},
+        nIntegrationSteps {nIntegrationSteps}, blockSize {blockSize}, threshold {threshold} {
+    if(blockSize < 2 || blockSize > MAX_BLOCK_SIZE || nIntegrationSteps % blockSize != 0)
+        throw std::invalid_argument {"SpectralKurtosisFlagger: the block size must be in [2, 65536] and divide the number of integration steps."};
+    rfiMask = RfiMask {(nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps, nChannels, nInputs};
+}
+
+
+
+void SpectralKurtosisFlagger::ratio_bounds(size_t nSamples, double& lower, double& upper) const {
+    // SK = (M + 1) / (M - 1) * (M * s2 / s1^2 - 1) is in [1 - t sigma, 1 + t sigma].
+    const double m {static_cast<double>(nSamples)};
+    const double width {threshold * spectral_kurtosis_sigma(nSamples)};
+    lower = 1.0 + (1.0 - width) * (m - 1) / (m + 1);
+    upper = 1.0 + (1.0 + width) * (m - 1) / (m + 1);
+}
+
+
+
+void SpectralKurtosisFlagger::process_dat_tile(const uint8_t *input, size_t inStride, size_t nInputsInTile, const int *rows,
+        const std::complex<int8_t> *channelData, size_t firstTimestep, size_t nSteps, unsigned int channel, SimdLevel level){
+    if(nSteps == 0) return;
+    const size_t interval {firstTimestep / nIntegrationSteps};
+    const size_t firstStep {firstTimestep % nIntegrationSteps}, endStep {firstStep + nSteps};
+    // The last interval of the observation is only partially filled with data.
+    const size_t validSteps {std::min<size_t>(nIntegrationSteps, nTimesteps - interval * nIntegrationSteps)};
+    const unsigned int nInputs {rfiMask.n_inputs()};
+    const size_t nWords {(nInputs + 63u) / 64u};
+    const DatPowerSumKernel datKernel {select_dat_power_sum_kernel(level)};
+    const PowerSumKernel rowKernel {select_power_sum_kernel(level)};
+    std::vector<uint32_t> s1, s2;
+    std::vector<uint64_t> bits(nWords);
+    for(size_t blockStart {firstStep / blockSize * blockSize}; blockStart < endStep; blockStart += blockSize){
+        const size_t blockEnd {std::min<size_t>(blockStart + blockSize, validSteps)};
+        // Blocks not completed by this call are evaluated by a later one.
+        if(blockEnd > endStep || blockEnd - blockStart < 2) continue;
+        const size_t n {blockEnd - blockStart};
+        double lower, upper;
+        ratio_bounds(n, lower, upper);
+        std::fill(bits.begin(), bits.end(), 0u);
+        if(blockStart >= firstStep){
+            // The whole block is in the tile: sum it while the packed samples are still in cache.
+            s1.resize(nInputsInTile);
+            s2.resize(nInputsInTile);
+            sum_dat_block(datKernel, input + (blockStart - firstStep) * inStride, inStride, n, nInputsInTile, s1.data(), s2.data());
+            for(size_t j {0}; j < nInputsInTile; j++){
+                if(rows && rows[j] < 0) continue;
+                const size_t r {rows ? static_cast<size_t>(rows[j]) : j};
+                if(outside_bounds(s1[j], s2[j], n, lower, upper)) bits[r / 64] |= uint64_t {1} << (r % 64);
+            }
+        }else{
+            // The block started in an earlier tile: sum it from the expanded samples, one input at a time.
+            for(size_t r {0}; r < nInputs; r++){
+                uint64_t sum1 {0}, sum2 {0};
+                rowKernel(channelData + r * nIntegrationSteps + blockStart, n, sum1, sum2);
+                if(outside_bounds(sum1, sum2, n, lower, upper)) bits[r / 64] |= uint64_t {1} << (r % 64);
+            }
+        }
+        for(size_t w {0}; w < nWords; w++) rfiMask.flag_word(interval, channel, w, bits[w]);
+    }
+}
@@ -0,0 +1,191 @@
+#ifndef __SPECTRAL_KURTOSIS_H__
+#define __SPECTRAL_KURTOSIS_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <complex>
+#include <stdexcept>
+
+// defined in voltage_expansion.hpp
+enum class SimdLevel;
+
+
+/**
+ * @brief RFI flags of voltages, one bit per [integration_interval][channel][input], where inputs are
+ * station/polarization pairs indexed as in the `Voltages` they refer to.
+ *
+ * The inputs of each interval and channel take a whole number of 64-bit words, so that the flags of
+ * different channels, or intervals, can be set concurrently.
+ */
+class RfiMask {
+    private:
+    std::vector<uint64_t> words;
+    size_t nIntervals {0};
+    unsigned int nChannels {0};
+    unsigned int nInputs {0};
+    size_t wordsPerChannel {0};
+
+    size_t word_index(size_t interval, unsigned int channel, unsigned int input) const {
+        return (interval * nChannels + channel) * wordsPerChannel + input / 64;
+    }
+
+    public:
+    RfiMask() {}
+
+    /**
+     * @brief Create a mask with nothing flagged.
+     */
+    RfiMask(size_t nIntervals, unsigned int nChannels, unsigned int nInputs) : nIntervals {nIntervals},
+        nChannels {nChannels}, nInputs {nInputs}, wordsPerChannel {(nInputs + 63u) / 64u} {
+        words.assign(nIntervals * nChannels * wordsPerChannel, 0u);
+    }
+
+    bool empty() const { return nIntervals == 0; }
+
+    size_t n_intervals() const { return nIntervals; }
+
+    unsigned int n_channels() const { return nChannels; }
+
+    unsigned int n_inputs() const { return nInputs; }
+
+    void flag(size_t interval, unsigned int channel, unsigned int input){
+        if(interval >= nIntervals || channel >= nChannels || input >= nInputs)
+            throw std::out_of_range {"RfiMask::flag: index out of range."};
+        words[word_index(interval, channel, input)] |= uint64_t {1} << (input % 64);
+    }
+
+    /**
+     * @brief Flag the inputs [64 * word, 64 * word + 64) of an interval and channel whose bit is set in
+     * `bits`. The update is atomic: threads can flag inputs sharing a word at the same time.
+     */
+    void flag_word(size_t interval, unsigned int channel, size_t word, uint64_t bits){
+        if(bits != 0) __atomic_fetch_or(&words[(interval * nChannels + channel) * wordsPerChannel + word], bits, __ATOMIC_RELAXED);
+    }
+
+    bool flagged(size_t interval, unsigned int channel, unsigned int input) const {
+        return interval < nIntervals && channel < nChannels && input < nInputs
+            && ((words[word_index(interval, channel, input)] >> (input % 64)) & 1u);
+    }
+
+    /**
+     * @brief Number of flagged (interval, channel, input) triplets.
+     */
+    size_t count() const {
+        size_t n {0};
+        for(uint64_t w : words) n += static_cast<size_t>(__builtin_popcountll(w));
+        return n;
+    }
+
+    /**
+     * @brief The bitmask: bit `input % 64` of word `(interval * n_channels() + channel) * ((n_inputs() + 63) / 64) + input / 64`.
+     */
+    const uint64_t* data() const { return words.data(); }
+};
+
+
+/**
+ * @brief Spectral kurtosis estimator of `nSamples` power samples, from the sum `s1` of the powers and the
+ * sum `s2` of their squares:
+ *      SK = (M + 1) / (M - 1) * (M * s2 / s1^2 - 1),   M = nSamples.
+ * Its expected value is one for Gaussian noise. Continuous wave signals push it towards zero and
+ * intermittent ones, e.g. impulses, above one. Returns one, i.e. no evidence of RFI, if `s1` is zero.
+ */
+double spectral_kurtosis(uint64_t s1, uint64_t s2, size_t nSamples);
+
+
+/**
+ * @brief Standard deviation of the spectral kurtosis estimator of `nSamples` samples of Gaussian noise,
+ * sqrt(4 M^2 / ((M - 1) (M + 2) (M + 3))).
+ */
+double spectral_kurtosis_sigma(size_t nSamples);
+
+
+/**
+ * @brief Sum of the power, re^2 + im^2, and of the squared power of `nSamples` consecutive samples of
+ * each of `nRows` rows placed `stride` samples apart. Exact for samples in the 4-bit range [-8, 7].
+ *
+ * @param level: instruction set to use. Levels not supported by the CPU are lowered automatically.
+ */
+void power_sums(const std::complex<int8_t> *samples, size_t stride, size_t nSamples, size_t nRows, uint64_t *s1,
+    uint64_t *s2, SimdLevel level);
+
+
+/**
+ * @brief Sum of the power, and of the squared power, of each of `nInputs` inputs over `nSteps` rows of
+ * packed 4+4 bit .dat samples, `inStride` bytes apart. Sums are stored, not accumulated, in `s1` and `s2`.
+ *
+ * @param level: instruction set to use. Levels not supported by the CPU are lowered automatically.
+ */
+void dat_power_sums(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint64_t *s1, uint64_t *s2,
+    SimdLevel level);
+
+
+/**
+ * @brief Spectral kurtosis RFI detector, run by the expansion functions on each tile of .dat samples they
+ * expand, i.e. the timesteps of an integration interval and channel, while it is still in cache.
+ *
+ * Integration intervals are split in blocks of `blockSize` timesteps. The spectral kurtosis of each
+ * block of each input and channel is computed from the running sums of the power and of its square,
+ * and the (interval, channel, input) the block belongs to is flagged if it deviates from one by more
+ * than `threshold` standard deviations of the estimator. The last block of the observation may be
+ * shorter than the others.
+ *
+ * Blocks within a tile are summed across inputs straight from the packed samples. Blocks spanning
+ * several tiles, e.g. when reads are not aligned to the blocks, are summed from the expanded output by
+ * the call that writes their last timestep. Calls writing different timesteps of the same block must
+ * then be made in order by the same thread, e.g. by splitting timesteps among threads at multiples of
+ * `blockSize`. Other calls can run concurrently.
+ */
+class SpectralKurtosisFlagger {
+    private:
+    RfiMask rfiMask;
+    size_t nTimesteps;
+    unsigned int nIntegrationSteps;
+    unsigned int blockSize;
+    double threshold;
+
+    /**
+     * @brief Bounds on `M * s2 / s1^2` equivalent to the accepted interval of the estimator for blocks of
+     * `nSamples` samples, so that blocks are tested without divisions.
+     */
+    void ratio_bounds(size_t nSamples, double& lower, double& upper) const;
+
+    public:
+    /**
+     * @param nTimesteps: number of timesteps of the voltages.
+     * @param nIntegrationSteps: number of timesteps in an integration interval of the voltages.
+     * @param nChannels: number of channels of the voltages.
+     * @param nInputs: number of inputs in each channel of the voltages.
+     * @param blockSize: number of timesteps the estimator is computed on. It must divide `nIntegrationSteps`
+     * and be in [2, 65536].
+     * @param threshold: number of standard deviations the estimator can deviate from one before a block is flagged.
+     * @throws std::invalid_argument if `blockSize` is out of range or does not divide `nIntegrationSteps`.
+     */
+    SpectralKurtosisFlagger(size_t nTimesteps, unsigned int nIntegrationSteps, unsigned int nChannels, unsigned int nInputs,
+        unsigned int blockSize, double threshold);
+
+    /**
+     * @brief Evaluate the blocks completed by a tile of timesteps [firstTimestep, firstTimestep + nSteps),
+     * all falling in the same integration interval, of channel `channel`.
+     *
+     * @param input: `nSteps` rows of `nInputsInTile` packed samples, `inStride` bytes apart.
+     * @param rows: if not null, input `j` of each row is input `rows[j]` of the output, or is ignored if
+     * `rows[j]` is negative.
+     * @param channelData: expanded samples of the interval and channel, ordered as [input][integration_step],
+     * i.e. the beginning of the channel in the voltage array, not the first timestep written.
+     */
+    void process_dat_tile(const uint8_t *input, size_t inStride, size_t nInputsInTile, const int *rows,
+        const std::complex<int8_t> *channelData, size_t firstTimestep, size_t nSteps, unsigned int channel, SimdLevel level);
+
+    unsigned int block_size() const { return blockSize; }
+
+    const RfiMask& mask() const { return rfiMask; }
+
+    /**
+     * @brief Move the flags out of the detector.
+     */
+    RfiMask take_mask() { return std::move(rfiMask); }
+};
+
+#endif
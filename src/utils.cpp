@@ -1,12 +1,40 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "utils.hpp"
 
 #define PARSE_BUFFER_SIZE 1024
 
 
 
 void read_data_from_file(std::string filename, char*& data, size_t& file_size){
+    // Fast path: regular files are read at once into a buffer of the right size.
+    int fd {open(filename.c_str(), O_RDONLY)};
+    if(fd >= 0){
+        struct stat st;
+        if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+            const size_t size {static_cast<size_t>(st.st_size)};
+            // One extra byte to null terminate text files.
+            data = new char[size + 1];
+            try{
+                file_size = pread_full(fd, data, size, 0);
+            }catch(...){
+                delete[] data;
+                close(fd);
+                throw;
+            }
+            data[file_size] = '\0';
+            close(fd);
+            return;
+        }
+        close(fd);
+    }
+    // Files whose size is not known in advance (e.g. pipes) are read in chunks.
     std::ifstream f;
     f.open(filename, std::ios::binary);
     if(!f){
@@ -20,7 +48,7 @@ void read_data_from_file(std::string filename, char*& data, size_t& file_size){
     const size_t read_size {4096};
     while(f){
         // check if we need to reallocate memory
-         if(bytes_read + read_size > buff_size){
+         if(bytes_read + read_size >= buff_size){
             buff_size *= 2;
             char *tmp = new char[buff_size];
             memcpy(tmp, data, bytes_read);
@@ -30,11 +58,44 @@ void read_data_from_file(std::string filename, char*& data, size_t& file_size){
         f.read(data + bytes_read, read_size);
         bytes_read += f.gcount();
     }
+    data[bytes_read] = '\0';
     file_size = bytes_read;
 }
 
 
 
+size_t pread_full(int fd, void *buffer, size_t count, size_t offset){
+    size_t total {0};
+    char *pBuffer {static_cast<char*>(buffer)};
+    while(total < count){
+        ssize_t n {pread(fd, pBuffer + total, count - total, offset + total)};
+        if(n < 0){
+            if(errno == EINTR) continue;
+            throw std::runtime_error {std::string {"pread_full: "} + strerror(errno)};
+        }
+        if(n == 0) break;
+        total += n;
+    }
+    return total;
+}
+
+
+
+void pwrite_full(int fd, const void *buffer, size_t count, size_t offset){
+    size_t total {0};
+    const char *pBuffer {static_cast<const char*>(buffer)};
+    while(total < count){
+        ssize_t n {pwrite(fd, pBuffer + total, count - total, offset + total)};
+        if(n < 0){
+            if(errno == EINTR) continue;
+            throw std::runtime_error {std::string {"pwrite_full: "} + strerror(errno)};
+        }
+        total += n;
+    }
+}
+
+
+
 double parse_timespec(const char * const spec){
     static char buffer[PARSE_BUFFER_SIZE];
     double result;
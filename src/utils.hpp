@@ -7,6 +7,10 @@
 
 /**
  * @brief Read data from a given file.
+ *
+ * Regular files are read with a single allocation of the size returned by `fstat`; other files
+ * (e.g. pipes) in chunks, growing the buffer as needed. The content is followed by a null byte
+ * not counted in `file_size`.
  * 
  * @param filename [IN] path to the file to be read.
  * @param data [OUT] reference to a pointer which will store the location of 
@@ -17,6 +21,27 @@ void read_data_from_file(std::string filename, char*& data, size_t&file_size);
 
 
 
+/**
+ * @brief Read `count` bytes from a file descriptor starting at `offset`, retrying on short reads
+ * and interrupted system calls. The file position is not changed.
+ *
+ * @return number of bytes read. It is smaller than `count` only if the end of file was reached.
+ * @throws std::runtime_error if the read fails.
+ */
+size_t pread_full(int fd, void *buffer, size_t count, size_t offset);
+
+
+
+/**
+ * @brief Write `count` bytes to a file descriptor starting at `offset`, retrying on short writes
+ * and interrupted system calls. The file position is not changed.
+ *
+ * @throws std::runtime_error if the write fails.
+ */
+void pwrite_full(int fd, const void *buffer, size_t count, size_t offset);
+
+
+
 /**
  * @brief Converts a human readable timespec to the corresponding number of seconds.
  * 
@@ -0,0 +1,437 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <future>
+#include "voltage_archive.hpp"
+#include "parallel.hpp"
+#include "utils.hpp"
+
+#ifdef ASTROIO_USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ASTROIO_USE_ZSTD
+#include <zstd.h>
+#endif
+
+
+namespace {
+
+    const char HEADER_MAGIC[8] {'A', 'I', 'O', 'V', 'A', 'R', 'C', 'H'};
+    const char TRAILER_MAGIC[8] {'A', 'I', 'O', 'V', 'A', 'I', 'D', 'X'};
+    constexpr uint32_t FORMAT_VERSION {1u};
+    constexpr size_t HEADER_BYTES {64u};
+    constexpr size_t TRAILER_BYTES {32u};
+    constexpr size_t INDEX_ENTRY_BYTES {16u};
+    // Number of decompressed chunks kept by a `VoltageArchive` to serve partial reads.
+    constexpr size_t CACHED_CHUNKS {8u};
+
+
+    void put_uint(uint8_t *p, uint64_t value, unsigned int nBytes){
+        for(unsigned int i {0}; i < nBytes; i++) p[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+
+    uint64_t get_uint(const uint8_t *p, unsigned int nBytes){
+        uint64_t value {0};
+        for(unsigned int i {0}; i < nBytes; i++) value |= static_cast<uint64_t>(p[i]) << (8 * i);
+        return value;
+    }
+
+
+    std::vector<uint8_t> compress_chunk(ArchiveCodec codec, int level, const uint8_t *input, size_t nBytes){
+        std::vector<uint8_t> output;
+        switch(codec){
+            #ifdef ASTROIO_USE_ZLIB
+            case ArchiveCodec::ZLIB: {
+                uLongf outBytes {compressBound(nBytes)};
+                output.resize(outBytes);
+                if(compress2(output.data(), &outBytes, input, nBytes, level != 0 ? level : Z_DEFAULT_COMPRESSION) != Z_OK)
+                    throw std::runtime_error {"VoltageArchiveWriter: zlib compression failed."};
+                output.resize(outBytes);
+                break;
+            }
+            #endif
+            #ifdef ASTROIO_USE_ZSTD
+            case ArchiveCodec::ZSTD: {
+                output.resize(ZSTD_compressBound(nBytes));
+                const size_t outBytes {ZSTD_compress(output.data(), output.size(), input, nBytes, level != 0 ? level : 3)};
+                if(ZSTD_isError(outBytes))
+                    throw std::runtime_error {std::string {"VoltageArchiveWriter: zstd compression failed: "} + ZSTD_getErrorName(outBytes)};
+                output.resize(outBytes);
+                break;
+            }
+            #endif
+            case ArchiveCodec::NONE:
+                output.assign(input, input + nBytes);
+                break;
+            default:
+                throw std::invalid_argument {std::string {"VoltageArchiveWriter: codec "} + archive_codec_name(codec) + " is not available."};
+        }
+        return output;
+    }
+
+
+    /**
+     * Decompress a chunk, which must expand to exactly `nBytes` bytes.
+     */
+    void decompress_chunk_data(ArchiveCodec codec, const uint8_t *input, size_t inputBytes, uint8_t *output, size_t nBytes,
+            const std::string& filename){
+        bool ok {false};
+        switch(codec){
+            #ifdef ASTROIO_USE_ZLIB
+            case ArchiveCodec::ZLIB: {
+                uLongf outBytes {nBytes};
+                ok = uncompress(output, &outBytes, input, inputBytes) == Z_OK && outBytes == nBytes;
+                break;
+            }
+            #endif
+            #ifdef ASTROIO_USE_ZSTD
+            case ArchiveCodec::ZSTD: {
+                const size_t outBytes {ZSTD_decompress(output, nBytes, input, inputBytes)};
+                ok = !ZSTD_isError(outBytes) && outBytes == nBytes;
+                break;
+            }
+            #endif
+            default:
+                break;
+        }
+        if(!ok) throw std::runtime_error {"VoltageArchive: corrupted chunk in " + filename};
+    }
+}
+
+
+
+bool archive_codec_available(ArchiveCodec codec){
+    switch(codec){
+        case ArchiveCodec::NONE: return true;
+        #ifdef ASTROIO_USE_ZLIB
+        case ArchiveCodec::ZLIB: return true;
+        #endif
+        #ifdef ASTROIO_USE_ZSTD
+        case ArchiveCodec::ZSTD: return true;
+        #endif
+        default: return false;
+    }
+}
+
+
+
+ArchiveCodec default_archive_codec(){
+    if(archive_codec_available(ArchiveCodec::ZSTD)) return ArchiveCodec::ZSTD;
+    if(archive_codec_available(ArchiveCodec::ZLIB)) return ArchiveCodec::ZLIB;
+    return ArchiveCodec::NONE;
+}
+
+
+
+const char* archive_codec_name(ArchiveCodec codec){
+    switch(codec){
+        case ArchiveCodec::NONE: return "none";
+        case ArchiveCodec::ZLIB: return "zlib";
+        case ArchiveCodec::ZSTD: return "zstd";
+        default: return "unknown";
+    }
+}
+
+
+
+VoltageArchiveWriter::VoltageArchiveWriter(const std::string& filename, size_t bytesPerTimestep, const ArchiveWriteOptions& options)
+        : filename {filename}, bytesPerTimestep {bytesPerTimestep}, options (options) {
+    if(bytesPerTimestep == 0 || options.timestepsPerChunk == 0)
+        throw std::invalid_argument {"VoltageArchiveWriter: timesteps and chunks must not be empty."};
+    if(!archive_codec_available(options.codec))
+        throw std::invalid_argument {std::string {"VoltageArchiveWriter: codec "} + archive_codec_name(options.codec) + " is not available."};
+    this->options.nThreads = std::max(1u, options.nThreads);
+    pending.resize(this->options.nThreads * options.timestepsPerChunk * bytesPerTimestep);
+    fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) throw std::runtime_error {"VoltageArchiveWriter: error while opening " + filename + ": " + strerror(errno)};
+    uint8_t header[HEADER_BYTES] {};
+    memcpy(header, HEADER_MAGIC, sizeof(HEADER_MAGIC));
+    put_uint(header + 8, FORMAT_VERSION, 4);
+    put_uint(header + 12, static_cast<uint32_t>(options.codec), 4);
+    put_uint(header + 16, bytesPerTimestep, 8);
+    put_uint(header + 24, options.timestepsPerChunk, 8);
+    try{
+        pwrite_full(fd, header, HEADER_BYTES, 0);
+    }catch(...){
+        ::close(fd);
+        throw;
+    }
+    fileOffset = HEADER_BYTES;
+}
+
+
+
+VoltageArchiveWriter::~VoltageArchiveWriter(){
+    try{
+        close();
+    }catch(...){}
+}
+
+
+
+/**
+ * Compress and write the whole chunks held in `pending`, and the last partial one if `all` is true.
+ */
+void VoltageArchiveWriter::flush(bool all){
+    const size_t chunkTimesteps {options.timestepsPerChunk};
+    const size_t nChunks {all ? (nPendingTimesteps + chunkTimesteps - 1) / chunkTimesteps : nPendingTimesteps / chunkTimesteps};
+    if(nChunks == 0) return;
+    std::vector<std::vector<uint8_t>> compressed(nChunks);
+    parallel_for_ranges(nChunks, options.nThreads, 1u, [&](size_t begin, size_t end){
+        for(size_t c {begin}; c < end; c++){
+            const size_t nSteps {std::min(chunkTimesteps, nPendingTimesteps - c * chunkTimesteps)};
+            compressed[c] = compress_chunk(options.codec, options.compressionLevel, pending.data() + c * chunkTimesteps * bytesPerTimestep,
+                nSteps * bytesPerTimestep);
+        }
+    });
+    for(const auto& chunk : compressed){
+        pwrite_full(fd, chunk.data(), chunk.size(), fileOffset);
+        index.push_back(fileOffset);
+        index.push_back(chunk.size());
+        fileOffset += chunk.size();
+    }
+    const size_t nWritten {std::min(nPendingTimesteps, nChunks * chunkTimesteps)};
+    memmove(pending.data(), pending.data() + nWritten * bytesPerTimestep, (nPendingTimesteps - nWritten) * bytesPerTimestep);
+    nPendingTimesteps -= nWritten;
+}
+
+
+
+void VoltageArchiveWriter::write(const uint8_t *data, size_t nTimesteps){
+    if(fd < 0) throw std::runtime_error {"VoltageArchiveWriter::write: the archive is closed."};
+    const size_t capacity {pending.size() / bytesPerTimestep};
+    while(nTimesteps > 0){
+        const size_t n {std::min(nTimesteps, capacity - nPendingTimesteps)};
+        memcpy(pending.data() + nPendingTimesteps * bytesPerTimestep, data, n * bytesPerTimestep);
+        nPendingTimesteps += n;
+        this->nTimesteps += n;
+        data += n * bytesPerTimestep;
+        nTimesteps -= n;
+        if(nPendingTimesteps == capacity) flush(false);
+    }
+}
+
+
+
+void VoltageArchiveWriter::close(){
+    if(fd < 0) return;
+    try{
+        flush(true);
+        std::vector<uint8_t> footer(index.size() * 8 + TRAILER_BYTES);
+        for(size_t i {0}; i < index.size(); i++) put_uint(footer.data() + 8 * i, index[i], 8);
+        uint8_t *trailer {footer.data() + index.size() * 8};
+        put_uint(trailer, nTimesteps, 8);
+        put_uint(trailer + 8, index.size() / 2, 8);
+        put_uint(trailer + 16, fileOffset, 8);
+        memcpy(trailer + 24, TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+        pwrite_full(fd, footer.data(), footer.size(), fileOffset);
+    }catch(...){
+        ::close(fd);
+        fd = -1;
+        throw;
+    }
+    const int ret {::close(fd)};
+    fd = -1;
+    if(ret != 0) throw std::runtime_error {"VoltageArchiveWriter: error while closing " + filename + ": " + strerror(errno)};
+}
+
+
+
+VoltageArchive::VoltageArchive(std::unique_ptr<FileReader> file) : FileReader {file->file_name()}, file {std::move(file)} {
+    const std::string& name {this->file->file_name()};
+    const size_t archiveBytes {this->file->size()};
+    if(!is_archive(*this->file))
+        throw std::runtime_error {"VoltageArchive: " + name + " is not a voltage archive."};
+    uint8_t header[HEADER_BYTES], trailer[TRAILER_BYTES];
+    this->file->read(header, HEADER_BYTES, 0);
+    this->file->read(trailer, TRAILER_BYTES, archiveBytes - TRAILER_BYTES);
+    if(get_uint(header + 8, 4) != FORMAT_VERSION)
+        throw std::runtime_error {"VoltageArchive: unsupported format version in " + name};
+    archiveCodec = static_cast<ArchiveCodec>(get_uint(header + 12, 4));
+    if(!archive_codec_available(archiveCodec))
+        throw std::runtime_error {std::string {"VoltageArchive: codec "} + archive_codec_name(archiveCodec) + " of " + name + " is not available."};
+    bytesPerTimestep = get_uint(header + 16, 8);
+    timestepsPerChunk = get_uint(header + 24, 8);
+    nTimesteps = get_uint(trailer, 8);
+    const size_t nChunks {get_uint(trailer + 8, 8)};
+    const size_t indexOffset {get_uint(trailer + 16, 8)};
+    // Everything is checked before it is used to size allocations, so that a truncated file is reported as such.
+    if(memcmp(trailer + 24, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) || bytesPerTimestep == 0 || timestepsPerChunk == 0
+            || nChunks != (nTimesteps + timestepsPerChunk - 1) / timestepsPerChunk
+            || indexOffset < HEADER_BYTES || indexOffset > archiveBytes - TRAILER_BYTES
+            || (archiveBytes - TRAILER_BYTES - indexOffset) / INDEX_ENTRY_BYTES != nChunks
+            || (archiveBytes - TRAILER_BYTES - indexOffset) % INDEX_ENTRY_BYTES != 0)
+        throw std::runtime_error {"VoltageArchive: truncated or corrupted index in " + name};
+    std::vector<uint8_t> rawIndex(nChunks * INDEX_ENTRY_BYTES);
+    this->file->read(rawIndex.data(), rawIndex.size(), indexOffset);
+    index.resize(2 * nChunks);
+    for(size_t i {0}; i < index.size(); i++){
+        index[i] = get_uint(rawIndex.data() + 8 * i, 8);
+        if(i % 2 == 1 && (index[i - 1] < HEADER_BYTES || index[i - 1] > indexOffset || index[i] > indexOffset - index[i - 1]))
+            throw std::runtime_error {"VoltageArchive: truncated or corrupted index in " + name};
+    }
+    fileSize = nTimesteps * bytesPerTimestep;
+}
+
+
+
+VoltageArchive::VoltageArchive(const std::string& filename, ReadBackend backend)
+    : VoltageArchive {open_raw_file_reader(filename, backend)} {}
+
+
+
+bool VoltageArchive::is_archive(FileReader& file){
+    if(file.size() < HEADER_BYTES + TRAILER_BYTES) return false;
+    char magic[sizeof(HEADER_MAGIC)];
+    file.read(magic, sizeof(magic), 0);
+    return memcmp(magic, HEADER_MAGIC, sizeof(magic)) == 0;
+}
+
+
+
+size_t VoltageArchive::chunk_bytes(size_t chunk) const {
+    return std::min(timestepsPerChunk, nTimesteps - chunk * timestepsPerChunk) * bytesPerTimestep;
+}
+
+
+
+void VoltageArchive::decompress_chunk(size_t chunk, uint8_t *output){
+    const size_t offset {index[2 * chunk]}, compressedBytes {index[2 * chunk + 1]};
+    if(archiveCodec == ArchiveCodec::NONE){
+        if(compressedBytes != chunk_bytes(chunk)) throw std::runtime_error {"VoltageArchive: corrupted chunk in " + filename};
+        file->read(output, compressedBytes, offset);
+        return;
+    }
+    std::vector<uint8_t> compressed(compressedBytes);
+    file->read(compressed.data(), compressedBytes, offset);
+    decompress_chunk_data(archiveCodec, compressed.data(), compressedBytes, output, chunk_bytes(chunk), filename);
+}
+
+
+
+std::shared_ptr<std::vector<uint8_t>> VoltageArchive::cached_chunk(size_t chunk){
+    {
+        std::lock_guard<std::mutex> lock {cacheMutex};
+        for(const auto& entry : cache)
+            if(entry.chunk == chunk) return entry.data;
+    }
+    auto data = std::make_shared<std::vector<uint8_t>>(chunk_bytes(chunk));
+    decompress_chunk(chunk, data->data());
+    std::lock_guard<std::mutex> lock {cacheMutex};
+    if(cache.size() < CACHED_CHUNKS){
+        cache.push_back({chunk, data});
+    }else{
+        cache[nextCacheSlot] = {chunk, data};
+        nextCacheSlot = (nextCacheSlot + 1) % CACHED_CHUNKS;
+    }
+    return data;
+}
+
+
+
+void VoltageArchive::read(void *buffer, size_t count, size_t offset){
+    if(offset > fileSize || count > fileSize - offset)
+        throw std::runtime_error {"FileReader: unexpected end of file " + filename};
+    if(count == 0) return;
+    uint8_t *output {static_cast<uint8_t*>(buffer)};
+    const size_t fullChunkBytes {timestepsPerChunk * bytesPerTimestep};
+    for(size_t c {offset / fullChunkBytes}; c <= (offset + count - 1) / fullChunkBytes; c++){
+        const size_t chunkStart {c * fullChunkBytes}, chunkEnd {chunkStart + chunk_bytes(c)};
+        const size_t begin {std::max(offset, chunkStart)}, end {std::min(offset + count, chunkEnd)};
+        if(begin == chunkStart && end == chunkEnd){
+            decompress_chunk(c, output + (begin - offset));
+        }else{
+            auto data = cached_chunk(c);
+            memcpy(output + (begin - offset), data->data() + (begin - chunkStart), end - begin);
+        }
+    }
+}
+
+
+
+void VoltageArchive::read_chunks(size_t offset, size_t nBytes, size_t chunkBytes, unsigned int queueDepth,
+        const ChunkConsumer& consume){
+    if(nBytes == 0) return;
+    const size_t nChunks {(nBytes + chunkBytes - 1) / chunkBytes};
+    auto chunk_size = [&](size_t c) { return std::min(chunkBytes, nBytes - c * chunkBytes); };
+    const unsigned int depth {static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(queueDepth, nChunks)))};
+    std::vector<std::vector<uint8_t>> buffers(depth, std::vector<uint8_t>(std::min(chunkBytes, nBytes)));
+    if(depth == 1){
+        for(size_t c {0}; c < nChunks; c++){
+            read(buffers[0].data(), chunk_size(c), offset + c * chunkBytes);
+            consume(c * chunkBytes, buffers[0].data(), chunk_size(c));
+        }
+        return;
+    }
+    // Declared after the buffers, so that the workers are joined before the buffers are released.
+    ThreadPool pool {depth};
+    std::vector<std::future<void>> pending(depth);
+    auto submit = [&](size_t c){
+        pending[c % depth] = pool.submit([this, &buffers, &chunk_size, c, depth, offset, chunkBytes](){
+            read(buffers[c % depth].data(), chunk_size(c), offset + c * chunkBytes);
+        });
+    };
+    for(size_t c {0}; c < depth; c++) submit(c);
+    for(size_t c {0}; c < nChunks; c++){
+        pending[c % depth].get();
+        consume(c * chunkBytes, buffers[c % depth].data(), chunk_size(c));
+        if(c + depth < nChunks) submit(c + depth);
+    }
+}
+
+
+
+void VoltageArchive::read_timesteps(size_t first, size_t count, uint8_t *output, unsigned int nThreads){
+    if(first > nTimesteps || count > nTimesteps - first)
+        throw std::invalid_argument {"VoltageArchive::read_timesteps: timesteps past the end of the archive."};
+    if(count == 0) return;
+    // Threads get whole archive chunks, so that none is decompressed twice.
+    const size_t firstChunk {first / timestepsPerChunk}, lastChunk {(first + count - 1) / timestepsPerChunk};
+    parallel_for_ranges(lastChunk - firstChunk + 1, nThreads, 1u, [&](size_t begin, size_t end){
+        const size_t ts {std::max(first, (firstChunk + begin) * timestepsPerChunk)};
+        const size_t tsEnd {std::min(first + count, (firstChunk + end) * timestepsPerChunk)};
+        read(output + (ts - first) * bytesPerTimestep, (tsEnd - ts) * bytesPerTimestep, ts * bytesPerTimestep);
+    });
+}
+
+
+
+void dat_to_archive(const std::string& datFilename, const std::string& archiveFilename, size_t bytesPerTimestep,
+        const ArchiveWriteOptions& options){
+    std::unique_ptr<FileReader> reader {open_file_reader(datFilename)};
+    VoltageArchiveWriter writer {archiveFilename, bytesPerTimestep, options};
+    const size_t nTimesteps {reader->size() / bytesPerTimestep};
+    // Each read feeds one chunk to every compressing thread.
+    const size_t timestepsPerRead {options.timestepsPerChunk * std::max(1u, options.nThreads)};
+    reader->read_chunks(0, nTimesteps * bytesPerTimestep, timestepsPerRead * bytesPerTimestep, 2u,
+            [&](size_t, const uint8_t *data, size_t size){
+        writer.write(data, size / bytesPerTimestep);
+    });
+    writer.close();
+}
+
+
+
+void archive_to_dat(const std::string& archiveFilename, const std::string& datFilename, unsigned int nThreads){
+    VoltageArchive archive {archiveFilename};
+    nThreads = std::max(1u, nThreads);
+    const size_t timestepsPerWrite {archive.timesteps_per_chunk() * nThreads};
+    std::vector<uint8_t> buffer(std::min(timestepsPerWrite, archive.n_timesteps()) * archive.bytes_per_timestep());
+    int fd {open(datFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)};
+    if(fd < 0) throw std::runtime_error {"archive_to_dat: error while opening " + datFilename + ": " + strerror(errno)};
+    try{
+        for(size_t ts {0}; ts < archive.n_timesteps(); ts += timestepsPerWrite){
+            const size_t n {std::min(timestepsPerWrite, archive.n_timesteps() - ts)};
+            archive.read_timesteps(ts, n, buffer.data(), nThreads);
+            pwrite_full(fd, buffer.data(), n * archive.bytes_per_timestep(), ts * archive.bytes_per_timestep());
+        }
+    }catch(...){
+        close(fd);
+        throw;
+    }
+    if(close(fd) != 0) throw std::runtime_error {"archive_to_dat: error while closing " + datFilename + ": " + strerror(errno)};
+}
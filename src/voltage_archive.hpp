@@ -0,0 +1,233 @@
+#ifndef __VOLTAGE_ARCHIVE_H__
+#define __VOLTAGE_ARCHIVE_H__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include "file_reader.hpp"
+
+/*
+    Voltage archives store the content of a .dat file in independently compressed chunks of
+    `timestepsPerChunk` timesteps, so that any timestep range can be read by decompressing only the
+    chunks covering it, and different chunks can be decompressed by different threads.
+
+    All the integers are little endian. The file is made of:
+     - a 64 bytes header: the magic "AIOVARCH", the format version (uint32), the codec (uint32), the
+       number of bytes per timestep (uint64) and of timesteps per chunk (uint64), then zeros;
+     - the compressed chunks, one after the other. Every chunk but the last one holds exactly
+       `timestepsPerChunk` timesteps;
+     - the index: for each chunk, its offset in the file and its compressed size (uint64 each);
+     - a 32 bytes trailer: the number of timesteps (uint64) and of chunks (uint64), the offset of the
+       index (uint64) and the magic "AIOVAIDX".
+    The index is at the end so that archives can be written in a single pass, without knowing the
+    length of the input in advance.
+
+    `open_file_reader` recognises archives and returns a `VoltageArchive`, which reads as the .dat file
+    the archive was created from. All the readers built on it, e.g. `Voltages::from_dat_file`,
+    `PackedVoltages::from_dat_file` and `VoltageStream`, hence accept archives in place of .dat files.
+    `Voltages::from_dat_file_mmap` cannot map an archive and decompresses it through the same path as
+    `Voltages::from_dat_file` instead, while `Voltages::from_dat_file_gpu` rejects archives.
+*/
+
+
+/**
+ * @brief Compression algorithms for the chunks of an archive. Archives written with a codec can only
+ * be read by a library built with it; `NONE` is always available.
+ */
+enum class ArchiveCodec : uint32_t {NONE = 0, ZLIB = 1, ZSTD = 2};
+
+
+/**
+ * @brief Whether the library was built with support for `codec`.
+ */
+bool archive_codec_available(ArchiveCodec codec);
+
+
+/**
+ * @brief The best codec the library was built with: zstd, zlib or no compression, in this order.
+ */
+ArchiveCodec default_archive_codec();
+
+
+/**
+ * @brief Return a human readable name for an archive codec.
+ */
+const char* archive_codec_name(ArchiveCodec codec);
+
+
+/**
+ * @brief Options controlling how archives are written.
+ */
+struct ArchiveWriteOptions {
+    // Number of timesteps in each chunk, i.e. the granularity of random access. Larger chunks compress
+    // slightly better; a few MiB per chunk, e.g. 100 timesteps of MWA VCS data, is a good compromise.
+    size_t timestepsPerChunk {100u};
+    ArchiveCodec codec {default_archive_codec()};
+    // Codec specific compression level. Zero selects the default level of the codec.
+    int compressionLevel {0};
+    // Number of threads compressing chunks concurrently.
+    unsigned int nThreads {1};
+};
+
+
+/**
+ * @brief Writer of voltage archives, fed with consecutive timesteps of .dat data.
+ *
+ * Example:
+ *      VoltageArchiveWriter writer {filename, bytesPerTimestep};
+ *      while(...) writer.write(data, nTimesteps);
+ *      writer.close();
+ */
+class VoltageArchiveWriter {
+    private:
+    int fd {-1};
+    std::string filename;
+    size_t bytesPerTimestep;
+    ArchiveWriteOptions options;
+    // timesteps received but not compressed yet: less than `options.nThreads` chunks.
+    std::vector<uint8_t> pending;
+    size_t nPendingTimesteps {0};
+    size_t nTimesteps {0};
+    size_t fileOffset {0};
+    std::vector<uint64_t> index;
+
+    void flush(bool all);
+
+    public:
+    /**
+     * @brief Create an archive, replacing any existing file.
+     *
+     * @param filename: path to the archive.
+     * @param bytesPerTimestep: size of a timestep of the .dat data, i.e. channels x stations x polarizations.
+     * @param options: chunking and compression settings.
+     */
+    VoltageArchiveWriter(const std::string& filename, size_t bytesPerTimestep, const ArchiveWriteOptions& options = ArchiveWriteOptions {});
+
+    VoltageArchiveWriter(const VoltageArchiveWriter&) = delete;
+    VoltageArchiveWriter& operator=(const VoltageArchiveWriter&) = delete;
+
+    /**
+     * @brief Close the archive if `close` was not called. Errors are ignored, so call `close` to detect them.
+     */
+    ~VoltageArchiveWriter();
+
+    /**
+     * @brief Append `nTimesteps` timesteps of .dat data, i.e. `nTimesteps * bytesPerTimestep` bytes.
+     */
+    void write(const uint8_t *data, size_t nTimesteps);
+
+    /**
+     * @brief Compress the remaining timesteps and write the index. No more data can be written afterwards.
+     */
+    void close();
+};
+
+
+/**
+ * @brief A voltage archive opened for reading. It is a `FileReader` returning the uncompressed .dat
+ * content, whose methods can be called concurrently from multiple threads.
+ */
+class VoltageArchive : public FileReader {
+    private:
+    struct CachedChunk {
+        size_t chunk;
+        std::shared_ptr<std::vector<uint8_t>> data;
+    };
+
+    std::unique_ptr<FileReader> file;
+    ArchiveCodec archiveCodec;
+    size_t bytesPerTimestep;
+    size_t timestepsPerChunk;
+    size_t nTimesteps;
+    // offset and compressed size of each chunk, one after the other.
+    std::vector<uint64_t> index;
+    // chunks recently decompressed to serve partial reads, so that reads not aligned to chunk
+    // boundaries do not decompress the chunks at their edges twice.
+    std::vector<CachedChunk> cache;
+    size_t nextCacheSlot {0};
+    std::mutex cacheMutex;
+
+    size_t chunk_bytes(size_t chunk) const;
+    void decompress_chunk(size_t chunk, uint8_t *output);
+    std::shared_ptr<std::vector<uint8_t>> cached_chunk(size_t chunk);
+
+    public:
+    /**
+     * @brief Open the archive stored in `file`, e.g. as returned by `open_raw_file_reader`.
+     * @throws std::runtime_error if `file` is not a valid archive or its codec is not available.
+     */
+    explicit VoltageArchive(std::unique_ptr<FileReader> file);
+
+    /**
+     * @brief Open an archive for reading with the given backend.
+     */
+    explicit VoltageArchive(const std::string& filename, ReadBackend backend = ReadBackend::BUFFERED);
+
+    ReadBackend backend() const override { return file->backend(); }
+
+    /**
+     * @brief Read `count` bytes of the .dat content, starting at `offset`. Only the chunks covering the
+     * requested range are read from disk and decompressed.
+     */
+    void read(void *buffer, size_t count, size_t offset) override;
+
+    /**
+     * @brief As `FileReader::read_chunks`. Up to `queueDepth` chunks are decompressed concurrently, each
+     * by its own thread, ahead of the one being consumed.
+     */
+    void read_chunks(size_t offset, size_t nBytes, size_t chunkBytes, unsigned int queueDepth,
+        const ChunkConsumer& consume) override;
+
+    /**
+     * @brief Read `count` timesteps, starting from timestep `first`, into `output`, decompressing the
+     * chunks with up to `nThreads` threads.
+     */
+    void read_timesteps(size_t first, size_t count, uint8_t *output, unsigned int nThreads = 1);
+
+    ArchiveCodec codec() const { return archiveCodec; }
+
+    size_t bytes_per_timestep() const { return bytesPerTimestep; }
+
+    size_t timesteps_per_chunk() const { return timestepsPerChunk; }
+
+    size_t n_timesteps() const { return nTimesteps; }
+
+    size_t n_chunks() const { return index.size() / 2; }
+
+    /**
+     * @brief Size of the archive on disk, in bytes.
+     */
+    size_t compressed_size() const { return file->size(); }
+
+    /**
+     * @brief Whether `file` starts with the magic of voltage archives.
+     */
+    static bool is_archive(FileReader& file);
+};
+
+
+/**
+ * @brief Compress a .dat file into an archive. Trailing bytes not making up a whole timestep are dropped.
+ *
+ * @param datFilename: path to the .dat file.
+ * @param archiveFilename: path to the archive to create.
+ * @param bytesPerTimestep: size of a timestep, i.e. channels x stations x polarizations.
+ * @param options: chunking and compression settings.
+ */
+void dat_to_archive(const std::string& datFilename, const std::string& archiveFilename, size_t bytesPerTimestep,
+    const ArchiveWriteOptions& options = ArchiveWriteOptions {});
+
+
+/**
+ * @brief Decompress an archive into the .dat file it was created from.
+ *
+ * @param archiveFilename: path to the archive.
+ * @param datFilename: path to the .dat file to create.
+ * @param nThreads: number of threads decompressing chunks concurrently.
+ */
+void archive_to_dat(const std::string& archiveFilename, const std::string& datFilename, unsigned int nThreads = 1);
+
+#endif
@@ -0,0 +1,826 @@
+#include <cstring>
+#include <algorithm>
+#include "voltage_expansion.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#define ASTROIO_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+    constexpr int8_t sign_extend_4bit(unsigned int nibble){
+        // https://en.wikipedia.org/wiki/Two%27s_complement#Subtraction_from_2N
+        return static_cast<int8_t>(nibble >= 0x8 ? static_cast<int>(nibble) - 0x10 : static_cast<int>(nibble));
+    }
+
+
+    /**
+     * Lookup table mapping a packed 4+4 bit complex sample to its real and imaginary parts.
+     * It is built by the compiler and only takes 512 bytes, so it stays in L1 cache.
+     */
+    struct ExpansionTable {
+        int8_t values[256][2];
+
+        constexpr ExpansionTable() : values {} {
+            for(unsigned int i {0}; i < 256; i++){
+                values[i][0] = sign_extend_4bit(i & 0xf);
+                values[i][1] = sign_extend_4bit(i >> 4);
+            }
+        }
+    };
+
+    constexpr ExpansionTable expansion_table {};
+
+
+    /*
+        Expansion kernels operate on a tile of packed samples belonging to a single channel,
+        `nSteps` timesteps by `nInputs` station/polarization pairs. Input rows are `inStride` bytes
+        apart. The tile is written transposed, such that the `nSteps` samples of an input are
+        contiguous and output rows are `outStride` complex samples apart. Input `j` goes to output
+        row `rows[j]`, or to row `j` when `rows` is null, so that a correlator input mapping is
+        applied by the stores themselves. Inputs with a negative row are expanded but not stored.
+    */
+    using TileKernel = void (*)(const uint8_t*, size_t, size_t, size_t, std::complex<int8_t>*, size_t, const int*);
+
+
+    inline size_t output_row(const int *rows, size_t j){
+        return rows ? static_cast<size_t>(rows[j]) : j;
+    }
+
+
+    // Inputs mapped to a negative row are dropped, i.e. not written to the output.
+    inline bool dropped(const int *rows, size_t j){
+        return rows && rows[j] < 0;
+    }
+
+
+    inline void expand_tile_scalar_range(const uint8_t *input, size_t inStride, size_t nSteps, size_t firstInput,
+            size_t lastInput, std::complex<int8_t> *output, size_t outStride, const int *rows){
+        for(size_t s {0}; s < nSteps; s++){
+            const uint8_t *row {input + s * inStride};
+            for(size_t j {firstInput}; j < lastInput; j++){
+                if(dropped(rows, j)) continue;
+                const int8_t *value {expansion_table.values[row[j]]};
+                output[output_row(rows, j) * outStride + s] = {value[0], value[1]};
+            }
+        }
+    }
+
+
+    void expand_tile_scalar(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        expand_tile_scalar_range(input, inStride, nSteps, 0, nInputs, output, outStride, rows);
+    }
+
+
+    /*
+        Transpose kernels do the same job as the expansion ones on 8+8 bit samples, which only need
+        to be moved. Timesteps are processed in tiles of TRANSPOSE_STEP_TILE rows: a tile of a VCS
+        channel (128 antennas, 2 polarizations) takes 32 KiB and stays in L1 cache while it is walked
+        input by input, so that each output row is written sequentially.
+    */
+    using TransposeKernel = void (*)(const std::complex<int8_t>*, size_t, size_t, size_t, std::complex<int8_t>*, size_t, const int*);
+
+    constexpr size_t TRANSPOSE_STEP_TILE {64};
+
+
+    inline void transpose_tile_scalar_range(const std::complex<int8_t> *input, size_t inStride, size_t nSteps,
+            size_t firstInput, size_t lastInput, std::complex<int8_t> *output, size_t outStride, const int *rows){
+        for(size_t s0 {0}; s0 < nSteps; s0 += TRANSPOSE_STEP_TILE){
+            const size_t s1 {std::min(nSteps, s0 + TRANSPOSE_STEP_TILE)};
+            for(size_t j {firstInput}; j < lastInput; j++){
+                std::complex<int8_t> *pRow {output + output_row(rows, j) * outStride};
+                for(size_t s {s0}; s < s1; s++) pRow[s] = input[s * inStride + j];
+            }
+        }
+    }
+
+
+    void transpose_tile_scalar(const std::complex<int8_t> *input, size_t inStride, size_t nSteps, size_t nInputs,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        transpose_tile_scalar_range(input, inStride, nSteps, 0, nInputs, output, outStride, rows);
+    }
+
+
+    #ifdef ASTROIO_X86_SIMD
+
+    /*
+        The vector kernels zero-extend each packed byte to 16 bits, move the high nibble into the high
+        byte and sign-extend both nibbles with the (x ^ 8) - 8 identity. The result is a register of
+        std::complex<int8_t> values. Eight of those registers, one per timestep, are then transposed
+        within each 128-bit lane so that every lane row holds eight consecutive timesteps of one input.
+    */
+
+    #define ASTROIO_TRANSPOSE_8x8_EPI16(PREFIX, TYPE, r)                     \
+    {                                                                       \
+        TYPE t0 = PREFIX##_unpacklo_epi16(r[0], r[1]);                      \
+        TYPE t1 = PREFIX##_unpackhi_epi16(r[0], r[1]);                      \
+        TYPE t2 = PREFIX##_unpacklo_epi16(r[2], r[3]);                      \
+        TYPE t3 = PREFIX##_unpackhi_epi16(r[2], r[3]);                      \
+        TYPE t4 = PREFIX##_unpacklo_epi16(r[4], r[5]);                      \
+        TYPE t5 = PREFIX##_unpackhi_epi16(r[4], r[5]);                      \
+        TYPE t6 = PREFIX##_unpacklo_epi16(r[6], r[7]);                      \
+        TYPE t7 = PREFIX##_unpackhi_epi16(r[6], r[7]);                      \
+        TYPE u0 = PREFIX##_unpacklo_epi32(t0, t2);                          \
+        TYPE u1 = PREFIX##_unpackhi_epi32(t0, t2);                          \
+        TYPE u2 = PREFIX##_unpacklo_epi32(t1, t3);                          \
+        TYPE u3 = PREFIX##_unpackhi_epi32(t1, t3);                          \
+        TYPE u4 = PREFIX##_unpacklo_epi32(t4, t6);                          \
+        TYPE u5 = PREFIX##_unpackhi_epi32(t4, t6);                          \
+        TYPE u6 = PREFIX##_unpacklo_epi32(t5, t7);                          \
+        TYPE u7 = PREFIX##_unpackhi_epi32(t5, t7);                          \
+        r[0] = PREFIX##_unpacklo_epi64(u0, u4);                             \
+        r[1] = PREFIX##_unpackhi_epi64(u0, u4);                             \
+        r[2] = PREFIX##_unpacklo_epi64(u1, u5);                             \
+        r[3] = PREFIX##_unpackhi_epi64(u1, u5);                             \
+        r[4] = PREFIX##_unpacklo_epi64(u2, u6);                             \
+        r[5] = PREFIX##_unpackhi_epi64(u2, u6);                             \
+        r[6] = PREFIX##_unpacklo_epi64(u3, u7);                             \
+        r[7] = PREFIX##_unpackhi_epi64(u3, u7);                             \
+    }
+
+
+    __attribute__((target("sse4.1")))
+    inline __m128i expand_8_sse4(const uint8_t *input){
+        const __m128i v {_mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(input)))};
+        const __m128i c {_mm_or_si128(_mm_and_si128(v, _mm_set1_epi16(0x000F)),
+            _mm_and_si128(_mm_slli_epi16(v, 4), _mm_set1_epi16(0x0F00)))};
+        const __m128i eight {_mm_set1_epi8(0x08)};
+        return _mm_sub_epi8(_mm_xor_si128(c, eight), eight);
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void expand_tile_sse4(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        const size_t nVecInputs {nInputs - nInputs % 8};
+        size_t s {0};
+        for(; s + 8 <= nSteps; s += 8){
+            for(size_t j {0}; j < nVecInputs; j += 8){
+                __m128i r[8];
+                for(int k {0}; k < 8; k++) r[k] = expand_8_sse4(input + (s + k) * inStride + j);
+                ASTROIO_TRANSPOSE_8x8_EPI16(_mm, __m128i, r);
+                for(int k {0}; k < 8; k++)
+                    if(!dropped(rows, j + k)) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, j + k) * outStride + s), r[k]);
+            }
+        }
+        if(nVecInputs < nInputs) expand_tile_scalar_range(input, inStride, s, nVecInputs, nInputs, output, outStride, rows);
+        expand_tile_scalar(input + s * inStride, inStride, nSteps - s, nInputs, output + s, outStride, rows);
+    }
+
+
+    __attribute__((target("avx2")))
+    inline __m256i expand_16_avx2(const uint8_t *input){
+        const __m256i v {_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input)))};
+        const __m256i c {_mm256_or_si256(_mm256_and_si256(v, _mm256_set1_epi16(0x000F)),
+            _mm256_and_si256(_mm256_slli_epi16(v, 4), _mm256_set1_epi16(0x0F00)))};
+        const __m256i eight {_mm256_set1_epi8(0x08)};
+        return _mm256_sub_epi8(_mm256_xor_si256(c, eight), eight);
+    }
+
+
+    __attribute__((target("avx2")))
+    void expand_tile_avx2(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        const size_t nVecInputs {nInputs - nInputs % 16};
+        size_t s {0};
+        for(; s + 8 <= nSteps; s += 8){
+            for(size_t j {0}; j < nVecInputs; j += 16){
+                __m256i r[8];
+                for(int k {0}; k < 8; k++) r[k] = expand_16_avx2(input + (s + k) * inStride + j);
+                ASTROIO_TRANSPOSE_8x8_EPI16(_mm256, __m256i, r);
+                // lane 0 holds inputs j to j + 7, lane 1 inputs j + 8 to j + 15.
+                for(int k {0}; k < 8; k++){
+                    if(!dropped(rows, j + k)) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, j + k) * outStride + s), _mm256_castsi256_si128(r[k]));
+                    if(!dropped(rows, j + 8 + k)) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, j + 8 + k) * outStride + s), _mm256_extracti128_si256(r[k], 1));
+                }
+            }
+        }
+        if(nVecInputs < nInputs) expand_tile_scalar_range(input, inStride, s, nVecInputs, nInputs, output, outStride, rows);
+        expand_tile_scalar(input + s * inStride, inStride, nSteps - s, nInputs, output + s, outStride, rows);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    inline __m512i expand_32_avx512(const uint8_t *input){
+        const __m512i v {_mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input)))};
+        const __m512i c {_mm512_or_si512(_mm512_and_si512(v, _mm512_set1_epi16(0x000F)),
+            _mm512_and_si512(_mm512_slli_epi16(v, 4), _mm512_set1_epi16(0x0F00)))};
+        const __m512i eight {_mm512_set1_epi8(0x08)};
+        return _mm512_sub_epi8(_mm512_xor_si512(c, eight), eight);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void expand_tile_avx512(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        const size_t nVecInputs {nInputs - nInputs % 32};
+        size_t s {0};
+        for(; s + 8 <= nSteps; s += 8){
+            for(size_t j {0}; j < nVecInputs; j += 32){
+                __m512i r[8];
+                for(int k {0}; k < 8; k++) r[k] = expand_32_avx512(input + (s + k) * inStride + j);
+                ASTROIO_TRANSPOSE_8x8_EPI16(_mm512, __m512i, r);
+                // lane l holds inputs j + 8 * l to j + 8 * l + 7.
+                for(int k {0}; k < 8; k++){
+                    if(!dropped(rows, j + k)) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, j + k) * outStride + s), _mm512_extracti32x4_epi32(r[k], 0));
+                    if(!dropped(rows, j + 8 + k)) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, j + 8 + k) * outStride + s), _mm512_extracti32x4_epi32(r[k], 1));
+                    if(!dropped(rows, j + 16 + k)) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, j + 16 + k) * outStride + s), _mm512_extracti32x4_epi32(r[k], 2));
+                    if(!dropped(rows, j + 24 + k)) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, j + 24 + k) * outStride + s), _mm512_extracti32x4_epi32(r[k], 3));
+                }
+            }
+        }
+        if(nVecInputs < nInputs) expand_tile_scalar_range(input, inStride, s, nVecInputs, nInputs, output, outStride, rows);
+        expand_tile_scalar(input + s * inStride, inStride, nSteps - s, nInputs, output + s, outStride, rows);
+    }
+
+
+    /*
+        Vector transpose kernels are split in a block function, transposing WIDTH inputs by a multiple of
+        8 timesteps, and a driver walking the tile in cache sized blocks. When STREAM is true, blocks are
+        transposed into a small buffer and then copied out with non-temporal stores, row by row, so that
+        the write-combining buffers are flushed as whole cache lines. Those stores bypass the cache: the
+        output is not read back during ingestion and would otherwise evict the input tile.
+    */
+    using TransposeBlock = void (*)(const std::complex<int8_t>*, size_t, size_t, std::complex<int8_t>*, size_t, const int*);
+
+
+    __attribute__((target("sse4.1")))
+    void transpose_block_sse4(const std::complex<int8_t> *input, size_t inStride, size_t nSteps,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        for(size_t s {0}; s < nSteps; s += 8){
+            __m128i r[8];
+            for(int k {0}; k < 8; k++)
+                r[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + (s + k) * inStride));
+            ASTROIO_TRANSPOSE_8x8_EPI16(_mm, __m128i, r);
+            for(int k {0}; k < 8; k++) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, k) * outStride + s), r[k]);
+        }
+    }
+
+
+    __attribute__((target("avx2")))
+    void transpose_block_avx2(const std::complex<int8_t> *input, size_t inStride, size_t nSteps,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        for(size_t s {0}; s < nSteps; s += 8){
+            __m256i r[8];
+            for(int k {0}; k < 8; k++)
+                r[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + (s + k) * inStride));
+            ASTROIO_TRANSPOSE_8x8_EPI16(_mm256, __m256i, r);
+            // lane 0 holds inputs 0 to 7, lane 1 inputs 8 to 15.
+            for(int k {0}; k < 8; k++){
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, k) * outStride + s), _mm256_castsi256_si128(r[k]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, 8 + k) * outStride + s), _mm256_extracti128_si256(r[k], 1));
+            }
+        }
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void transpose_block_avx512(const std::complex<int8_t> *input, size_t inStride, size_t nSteps,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        for(size_t s {0}; s < nSteps; s += 8){
+            __m512i r[8];
+            for(int k {0}; k < 8; k++)
+                r[k] = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(input + (s + k) * inStride));
+            ASTROIO_TRANSPOSE_8x8_EPI16(_mm512, __m512i, r);
+            // lane l holds inputs 8 * l to 8 * l + 7.
+            for(int k {0}; k < 8; k++){
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, k) * outStride + s), _mm512_extracti32x4_epi32(r[k], 0));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, 8 + k) * outStride + s), _mm512_extracti32x4_epi32(r[k], 1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, 16 + k) * outStride + s), _mm512_extracti32x4_epi32(r[k], 2));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + output_row(rows, 24 + k) * outStride + s), _mm512_extracti32x4_epi32(r[k], 3));
+            }
+        }
+    }
+
+
+    // Copy `nRows` rows of `nSteps` samples (a multiple of 8) with non-temporal stores.
+    __attribute__((target("sse2")))
+    void stream_rows(const std::complex<int8_t> *input, size_t inStride, size_t nRows, size_t nSteps,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        for(size_t r {0}; r < nRows; r++)
+            for(size_t s {0}; s < nSteps; s += 8)
+                _mm_stream_si128(reinterpret_cast<__m128i*>(output + output_row(rows, r) * outStride + s),
+                    _mm_load_si128(reinterpret_cast<const __m128i*>(input + r * inStride + s)));
+    }
+
+
+    template <size_t WIDTH, TransposeBlock BLOCK, bool STREAM>
+    void transpose_tile_vector(const std::complex<int8_t> *input, size_t inStride, size_t nSteps, size_t nInputs,
+            std::complex<int8_t> *output, size_t outStride, const int *rows){
+        const size_t nVecInputs {nInputs - nInputs % WIDTH};
+        const size_t nVecSteps {nSteps - nSteps % 8};
+        alignas(64) std::complex<int8_t> staging[STREAM ? WIDTH * TRANSPOSE_STEP_TILE : 1];
+        for(size_t s0 {0}; s0 < nVecSteps; s0 += TRANSPOSE_STEP_TILE){
+            const size_t n {std::min(nVecSteps - s0, TRANSPOSE_STEP_TILE)};
+            for(size_t j {0}; j < nVecInputs; j += WIDTH){
+                // blocks address their rows relative to `blockOutput`, through `blockRows` when mapped.
+                std::complex<int8_t> *blockOutput {(rows ? output : output + j * outStride) + s0};
+                const int *blockRows {rows ? rows + j : nullptr};
+                if(STREAM){
+                    BLOCK(input + s0 * inStride + j, inStride, n, staging, TRANSPOSE_STEP_TILE, nullptr);
+                    stream_rows(staging, TRANSPOSE_STEP_TILE, WIDTH, n, blockOutput, outStride, blockRows);
+                }else{
+                    BLOCK(input + s0 * inStride + j, inStride, n, blockOutput, outStride, blockRows);
+                }
+            }
+        }
+        if(nVecInputs < nInputs) transpose_tile_scalar_range(input, inStride, nVecSteps, nVecInputs, nInputs, output, outStride, rows);
+        transpose_tile_scalar(input + nVecSteps * inStride, inStride, nSteps - nVecSteps, nInputs, output + nVecSteps, outStride, rows);
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void expand_samples_sse4(const uint8_t *input, size_t nSamples, std::complex<int8_t> *output){
+        size_t i {0};
+        for(; i + 8 <= nSamples; i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), expand_8_sse4(input + i));
+        for(; i < nSamples; i++) output[i] = {expansion_table.values[input[i]][0], expansion_table.values[input[i]][1]};
+    }
+
+
+    __attribute__((target("avx2")))
+    void expand_samples_avx2(const uint8_t *input, size_t nSamples, std::complex<int8_t> *output){
+        size_t i {0};
+        for(; i + 16 <= nSamples; i += 16)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), expand_16_avx2(input + i));
+        for(; i < nSamples; i++) output[i] = {expansion_table.values[input[i]][0], expansion_table.values[input[i]][1]};
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void expand_samples_avx512(const uint8_t *input, size_t nSamples, std::complex<int8_t> *output){
+        size_t i {0};
+        for(; i + 32 <= nSamples; i += 32)
+            _mm512_storeu_si512(reinterpret_cast<__m512i*>(output + i), expand_32_avx512(input + i));
+        for(; i < nSamples; i++) output[i] = {expansion_table.values[input[i]][0], expansion_table.values[input[i]][1]};
+    }
+
+    #endif
+
+
+    SimdLevel supported_level(SimdLevel requested){
+        return std::min(requested, detect_simd_level());
+    }
+
+
+    TileKernel select_tile_kernel(SimdLevel level){
+        #ifdef ASTROIO_X86_SIMD
+        switch(supported_level(level)){
+            case SimdLevel::AVX512: return expand_tile_avx512;
+            case SimdLevel::AVX2: return expand_tile_avx2;
+            case SimdLevel::SSE4: return expand_tile_sse4;
+            default: break;
+        }
+        #endif
+        return expand_tile_scalar;
+    }
+
+
+    TransposeKernel select_transpose_kernel(SimdLevel level, bool streaming){
+        #ifdef ASTROIO_X86_SIMD
+        switch(supported_level(level)){
+            case SimdLevel::AVX512:
+                return streaming ? transpose_tile_vector<32, transpose_block_avx512, true> : transpose_tile_vector<32, transpose_block_avx512, false>;
+            case SimdLevel::AVX2:
+                return streaming ? transpose_tile_vector<16, transpose_block_avx2, true> : transpose_tile_vector<16, transpose_block_avx2, false>;
+            case SimdLevel::SSE4:
+                return streaming ? transpose_tile_vector<8, transpose_block_sse4, true> : transpose_tile_vector<8, transpose_block_sse4, false>;
+            default: break;
+        }
+        #endif
+        return transpose_tile_scalar;
+    }
+
+
+    /*
+        Packing kernels are the inverse of the expansion ones: a tile of `nSteps` timesteps of `nInputs`
+        rows of 8+8 bit samples, `inStride` complex samples apart, is saturated to the 4-bit range, packed
+        and written transposed, one .dat timestep every `outStride` bytes. Input `j` of each timestep is
+        read from row `rows[j]`, or row `j` when `rows` is null.
+    */
+    using PackKernel = void (*)(const std::complex<int8_t>*, size_t, size_t, size_t, uint8_t*, size_t, const int*);
+
+
+    inline uint8_t pack_sample(std::complex<int8_t> sample){
+        const int re {std::max(-8, std::min(7, static_cast<int>(sample.real())))};
+        const int im {std::max(-8, std::min(7, static_cast<int>(sample.imag())))};
+        return static_cast<uint8_t>((re & 0xF) | ((im & 0xF) << 4));
+    }
+
+
+    inline void pack_tile_scalar_range(const std::complex<int8_t> *input, size_t inStride, size_t nSteps, size_t firstInput,
+            size_t lastInput, uint8_t *output, size_t outStride, const int *rows){
+        for(size_t s {0}; s < nSteps; s++){
+            uint8_t *row {output + s * outStride};
+            for(size_t j {firstInput}; j < lastInput; j++) row[j] = pack_sample(input[output_row(rows, j) * inStride + s]);
+        }
+    }
+
+
+    void pack_tile_scalar(const std::complex<int8_t> *input, size_t inStride, size_t nSteps, size_t nInputs,
+            uint8_t *output, size_t outStride, const int *rows){
+        pack_tile_scalar_range(input, inStride, nSteps, 0, nInputs, output, outStride, rows);
+    }
+
+
+    #ifdef ASTROIO_X86_SIMD
+
+    /*
+        The vector kernels load eight consecutive timesteps of each input, transpose them with the same
+        8x8 transpose of the expansion kernels, clamp every byte to [-8, 7] and merge the low nibbles of
+        the real and imaginary parts of each 16-bit complex sample. Pairs of timesteps are then narrowed
+        to bytes with a single unsigned saturating pack.
+    */
+
+    __attribute__((target("sse4.1")))
+    inline __m128i pack_16_sse4(__m128i a, __m128i b){
+        const __m128i lo {_mm_set1_epi8(-8)}, hi {_mm_set1_epi8(7)};
+        a = _mm_min_epi8(_mm_max_epi8(a, lo), hi);
+        b = _mm_min_epi8(_mm_max_epi8(b, lo), hi);
+        const __m128i realMask {_mm_set1_epi16(0x000F)}, imagMask {_mm_set1_epi16(0x00F0)};
+        a = _mm_or_si128(_mm_and_si128(a, realMask), _mm_and_si128(_mm_srli_epi16(a, 4), imagMask));
+        b = _mm_or_si128(_mm_and_si128(b, realMask), _mm_and_si128(_mm_srli_epi16(b, 4), imagMask));
+        return _mm_packus_epi16(a, b);
+    }
+
+
+    __attribute__((target("sse4.1")))
+    void pack_tile_sse4(const std::complex<int8_t> *input, size_t inStride, size_t nSteps, size_t nInputs,
+            uint8_t *output, size_t outStride, const int *rows){
+        const size_t nVecInputs {nInputs - nInputs % 8};
+        size_t s {0};
+        for(; s + 8 <= nSteps; s += 8){
+            for(size_t j {0}; j < nVecInputs; j += 8){
+                __m128i r[8];
+                for(int k {0}; k < 8; k++)
+                    r[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + output_row(rows, j + k) * inStride + s));
+                ASTROIO_TRANSPOSE_8x8_EPI16(_mm, __m128i, r);
+                for(int k {0}; k < 8; k += 2){
+                    const __m128i p {pack_16_sse4(r[k], r[k + 1])};
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + (s + k) * outStride + j), p);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + (s + k + 1) * outStride + j), _mm_srli_si128(p, 8));
+                }
+            }
+        }
+        if(nVecInputs < nInputs) pack_tile_scalar_range(input, inStride, s, nVecInputs, nInputs, output, outStride, rows);
+        pack_tile_scalar(input + s, inStride, nSteps - s, nInputs, output + s * outStride, outStride, rows);
+    }
+
+
+    __attribute__((target("avx2")))
+    inline __m256i pack_32_avx2(__m256i a, __m256i b){
+        const __m256i lo {_mm256_set1_epi8(-8)}, hi {_mm256_set1_epi8(7)};
+        a = _mm256_min_epi8(_mm256_max_epi8(a, lo), hi);
+        b = _mm256_min_epi8(_mm256_max_epi8(b, lo), hi);
+        const __m256i realMask {_mm256_set1_epi16(0x000F)}, imagMask {_mm256_set1_epi16(0x00F0)};
+        a = _mm256_or_si256(_mm256_and_si256(a, realMask), _mm256_and_si256(_mm256_srli_epi16(a, 4), imagMask));
+        b = _mm256_or_si256(_mm256_and_si256(b, realMask), _mm256_and_si256(_mm256_srli_epi16(b, 4), imagMask));
+        return _mm256_packus_epi16(a, b);
+    }
+
+
+    __attribute__((target("avx2")))
+    void pack_tile_avx2(const std::complex<int8_t> *input, size_t inStride, size_t nSteps, size_t nInputs,
+            uint8_t *output, size_t outStride, const int *rows){
+        const size_t nVecInputs {nInputs - nInputs % 16};
+        size_t s {0};
+        for(; s + 8 <= nSteps; s += 8){
+            for(size_t j {0}; j < nVecInputs; j += 16){
+                // lane 0 holds inputs j to j + 7, lane 1 inputs j + 8 to j + 15.
+                __m256i r[8];
+                for(int k {0}; k < 8; k++){
+                    const __m128i l0 {_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + output_row(rows, j + k) * inStride + s))};
+                    const __m128i l1 {_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + output_row(rows, j + 8 + k) * inStride + s))};
+                    r[k] = _mm256_inserti128_si256(_mm256_castsi128_si256(l0), l1, 1);
+                }
+                ASTROIO_TRANSPOSE_8x8_EPI16(_mm256, __m256i, r);
+                for(int k {0}; k < 8; k += 2){
+                    // the pack interleaves the lanes of its operands: 64-bit words are timestep k lane 0,
+                    // timestep k + 1 lane 0, timestep k lane 1 and timestep k + 1 lane 1.
+                    const __m256i p {_mm256_permute4x64_epi64(pack_32_avx2(r[k], r[k + 1]), _MM_SHUFFLE(3, 1, 2, 0))};
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + (s + k) * outStride + j), _mm256_castsi256_si128(p));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + (s + k + 1) * outStride + j), _mm256_extracti128_si256(p, 1));
+                }
+            }
+        }
+        if(nVecInputs < nInputs) pack_tile_scalar_range(input, inStride, s, nVecInputs, nInputs, output, outStride, rows);
+        pack_tile_scalar(input + s, inStride, nSteps - s, nInputs, output + s * outStride, outStride, rows);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    inline __m512i pack_64_avx512(__m512i a, __m512i b){
+        const __m512i lo {_mm512_set1_epi8(-8)}, hi {_mm512_set1_epi8(7)};
+        a = _mm512_min_epi8(_mm512_max_epi8(a, lo), hi);
+        b = _mm512_min_epi8(_mm512_max_epi8(b, lo), hi);
+        const __m512i realMask {_mm512_set1_epi16(0x000F)}, imagMask {_mm512_set1_epi16(0x00F0)};
+        a = _mm512_or_si512(_mm512_and_si512(a, realMask), _mm512_and_si512(_mm512_srli_epi16(a, 4), imagMask));
+        b = _mm512_or_si512(_mm512_and_si512(b, realMask), _mm512_and_si512(_mm512_srli_epi16(b, 4), imagMask));
+        return _mm512_packus_epi16(a, b);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void pack_tile_avx512(const std::complex<int8_t> *input, size_t inStride, size_t nSteps, size_t nInputs,
+            uint8_t *output, size_t outStride, const int *rows){
+        const size_t nVecInputs {nInputs - nInputs % 32};
+        const __m512i evenFirst {_mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0)};
+        size_t s {0};
+        for(; s + 8 <= nSteps; s += 8){
+            for(size_t j {0}; j < nVecInputs; j += 32){
+                // lane l holds inputs j + 8 * l to j + 8 * l + 7.
+                __m512i r[8];
+                for(int k {0}; k < 8; k++){
+                    __m128i l[4];
+                    for(int i {0}; i < 4; i++)
+                        l[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + output_row(rows, j + 8 * i + k) * inStride + s));
+                    r[k] = _mm512_inserti32x4(_mm512_inserti32x4(_mm512_inserti32x4(_mm512_castsi128_si512(l[0]), l[1], 1), l[2], 2), l[3], 3);
+                }
+                ASTROIO_TRANSPOSE_8x8_EPI16(_mm512, __m512i, r);
+                for(int k {0}; k < 8; k += 2){
+                    const __m512i p {_mm512_permutexvar_epi64(evenFirst, pack_64_avx512(r[k], r[k + 1]))};
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + (s + k) * outStride + j), _mm512_castsi512_si256(p));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + (s + k + 1) * outStride + j), _mm512_extracti64x4_epi64(p, 1));
+                }
+            }
+        }
+        if(nVecInputs < nInputs) pack_tile_scalar_range(input, inStride, s, nVecInputs, nInputs, output, outStride, rows);
+        pack_tile_scalar(input + s, inStride, nSteps - s, nInputs, output + s * outStride, outStride, rows);
+    }
+
+    #endif
+
+
+    PackKernel select_pack_kernel(SimdLevel level){
+        #ifdef ASTROIO_X86_SIMD
+        switch(supported_level(level)){
+            case SimdLevel::AVX512: return pack_tile_avx512;
+            case SimdLevel::AVX2: return pack_tile_avx2;
+            case SimdLevel::SSE4: return pack_tile_sse4;
+            default: break;
+        }
+        #endif
+        return pack_tile_scalar;
+    }
+}
+
+
+
+SimdLevel detect_simd_level(){
+    #ifdef ASTROIO_X86_SIMD
+    static const SimdLevel level {[](){
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SimdLevel::AVX512;
+        if(__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if(__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE4;
+        return SimdLevel::SCALAR;
+    }()};
+    return level;
+    #else
+    return SimdLevel::SCALAR;
+    #endif
+}
+
+
+
+const char* simd_level_name(SimdLevel level){
+    switch(level){
+        case SimdLevel::AVX512: return "AVX-512";
+        case SimdLevel::AVX2: return "AVX2";
+        case SimdLevel::SSE4: return "SSE4.1";
+        default: return "scalar";
+    }
+}
+
+
+
+void expand_4bit_samples(const uint8_t *input, size_t nSamples, std::complex<int8_t> *output, SimdLevel level){
+    #ifdef ASTROIO_X86_SIMD
+    switch(supported_level(level)){
+        case SimdLevel::AVX512: expand_samples_avx512(input, nSamples, output); return;
+        case SimdLevel::AVX2: expand_samples_avx2(input, nSamples, output); return;
+        case SimdLevel::SSE4: expand_samples_sse4(input, nSamples, output); return;
+        default: break;
+    }
+    #endif
+    for(size_t i {0}; i < nSamples; i++) output[i] = {expansion_table.values[input[i]][0], expansion_table.values[input[i]][1]};
+}
+
+
+
+bool is_input_permutation(const std::vector<int>& inputMapping, size_t nInputs){
+    if(inputMapping.size() != nInputs) return false;
+    std::vector<bool> seen(nInputs, false);
+    for(int row : inputMapping){
+        if(row < 0 || static_cast<size_t>(row) >= nInputs || seen[row]) return false;
+        seen[row] = true;
+    }
+    return true;
+}
+
+
+
+size_t kept_inputs(const std::vector<int>& inputMapping, size_t nInputs){
+    if(inputMapping.empty()) return nInputs;
+    return static_cast<size_t>(std::count_if(inputMapping.begin(), inputMapping.end(), [](int row){ return row >= 0; }));
+}
+
+
+
+bool is_input_selection(const std::vector<int>& inputMapping, size_t nInputs){
+    if(inputMapping.size() != nInputs) return false;
+    const size_t nKept {kept_inputs(inputMapping, nInputs)};
+    std::vector<bool> seen(nKept, false);
+    for(int row : inputMapping){
+        if(row < 0) continue;
+        if(static_cast<size_t>(row) >= nKept || seen[row]) return false;
+        seen[row] = true;
+    }
+    return true;
+}
+
+
+
+void expand_dat_timesteps(const uint8_t *input, size_t firstTimestep, size_t nTimesteps,
+        const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, const ChannelMask& flaggedChannels,
+        std::complex<int8_t> *output, SimdLevel level, const std::vector<int>& inputMapping, VoltageStatistics *statistics,
+        SpectralKurtosisFlagger *kurtosis){
+    const TileKernel kernel {select_tile_kernel(level)};
+    const int *rows {inputMapping.empty() ? nullptr : inputMapping.data()};
+    // variables used for input and output indexing
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t bytesPerTimestep {nInputs * obsInfo.nFrequencies};
+    // dropped inputs shrink the channels of the output.
+    const size_t nOutputInputs {kept_inputs(inputMapping, nInputs)};
+    const size_t samplesInFrequency {nOutputInputs * nIntegrationSteps};
+    const size_t samplesInTimeInterval {samplesInFrequency * obsInfo.nFrequencies};
+
+    size_t t {0};
+    while(t < nTimesteps){
+        // Process at once all the timesteps falling in the current integration interval.
+        const size_t currentTimestep {firstTimestep + t};
+        const size_t currentTimeInterval {currentTimestep / nIntegrationSteps};
+        const size_t currentIntegratorStep {currentTimestep % nIntegrationSteps};
+        const size_t nSteps {std::min(nIntegrationSteps - currentIntegratorStep, nTimesteps - t)};
+        const uint8_t *pInput {input + t * bytesPerTimestep};
+        std::complex<int8_t> *pOutput {output + currentTimeInterval * samplesInTimeInterval + currentIntegratorStep};
+        unsigned int ch {0};
+        while(ch < obsInfo.nFrequencies){
+            if(!flaggedChannels.flagged(ch)){
+                kernel(pInput + ch * nInputs, bytesPerTimestep, nSteps, nInputs, pOutput + ch * samplesInFrequency, nIntegrationSteps, rows);
+                if(statistics) statistics->accumulate_dat_tile(pInput + ch * nInputs, bytesPerTimestep, nSteps, nInputs, ch, rows, level);
+                if(kurtosis) kurtosis->process_dat_tile(pInput + ch * nInputs, bytesPerTimestep, nInputs, rows,
+                    pOutput + ch * samplesInFrequency - currentIntegratorStep, currentTimestep, nSteps, ch, level);
+                ch++;
+                continue;
+            }
+            // Flagged channels are not expanded, but set to zero. When the whole interval is written, a run
+            // of consecutive flagged channels is a single contiguous block.
+            const unsigned int runEnd {flaggedChannels.end_of_run(ch)};
+            if(nSteps == nIntegrationSteps){
+                memset(pOutput + ch * samplesInFrequency, 0, (runEnd - ch) * samplesInFrequency * sizeof(std::complex<int8_t>));
+            }else{
+                for(size_t row {ch * nOutputInputs}; row < runEnd * nOutputInputs; row++)
+                    memset(pOutput + row * nIntegrationSteps, 0, nSteps * sizeof(std::complex<int8_t>));
+            }
+            ch = runEnd;
+        }
+        t += nSteps;
+    }
+    if(statistics) statistics->flush(rows);
+}
+
+
+
+void expand_dat_timesteps(const uint8_t *input, size_t firstTimestep, size_t nTimesteps,
+        const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, const std::vector<unsigned int>& channels,
+        const ChannelMask& flaggedChannels, std::complex<int8_t> *output, SimdLevel level, const std::vector<int>& inputMapping,
+        VoltageStatistics *statistics, SpectralKurtosisFlagger *kurtosis){
+    const TileKernel kernel {select_tile_kernel(level)};
+    const int *rows {inputMapping.empty() ? nullptr : inputMapping.data()};
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t bytesPerTimestep {nInputs * obsInfo.nFrequencies};
+    // dropped inputs shrink the channels of the output.
+    const size_t nOutputInputs {kept_inputs(inputMapping, nInputs)};
+    const size_t samplesInFrequency {nOutputInputs * nIntegrationSteps};
+    const size_t samplesInTimeInterval {samplesInFrequency * channels.size()};
+
+    size_t t {0};
+    while(t < nTimesteps){
+        const size_t currentTimestep {firstTimestep + t};
+        const size_t currentTimeInterval {currentTimestep / nIntegrationSteps};
+        const size_t currentIntegratorStep {currentTimestep % nIntegrationSteps};
+        const size_t nSteps {std::min(nIntegrationSteps - currentIntegratorStep, nTimesteps - t)};
+        const uint8_t *pInput {input + t * bytesPerTimestep};
+        std::complex<int8_t> *pOutput {output + currentTimeInterval * samplesInTimeInterval + currentIntegratorStep};
+        for(size_t c {0}; c < channels.size(); c++){
+            std::complex<int8_t> *pChannel {pOutput + c * samplesInFrequency};
+            if(!flaggedChannels.flagged(channels[c])){
+                kernel(pInput + channels[c] * nInputs, bytesPerTimestep, nSteps, nInputs, pChannel, nIntegrationSteps, rows);
+                if(statistics) statistics->accumulate_dat_tile(pInput + channels[c] * nInputs, bytesPerTimestep, nSteps, nInputs, c, rows, level);
+                if(kurtosis) kurtosis->process_dat_tile(pInput + channels[c] * nInputs, bytesPerTimestep, nInputs, rows,
+                    pChannel - currentIntegratorStep, currentTimestep, nSteps, static_cast<unsigned int>(c), level);
+            }else if(nSteps == nIntegrationSteps){
+                memset(pChannel, 0, samplesInFrequency * sizeof(std::complex<int8_t>));
+            }else{
+                for(size_t j {0}; j < nOutputInputs; j++)
+                    memset(pChannel + j * nIntegrationSteps, 0, nSteps * sizeof(std::complex<int8_t>));
+            }
+        }
+        t += nSteps;
+    }
+    if(statistics) statistics->flush(rows);
+}
+
+
+
+void reorder_complex_timesteps(const std::complex<int8_t> *input, size_t firstTimestep, size_t nTimesteps,
+        const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, std::complex<int8_t> *output,
+        SimdLevel level, bool streamingStores, const std::vector<int>& inputMapping){
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t samplesPerTimestep {nInputs * obsInfo.nFrequencies};
+    const size_t samplesInFrequency {nInputs * nIntegrationSteps};
+    const size_t samplesInTimeInterval {samplesInFrequency * obsInfo.nFrequencies};
+    const TransposeKernel kernel {select_transpose_kernel(level, false)};
+    const TransposeKernel streamingKernel {select_transpose_kernel(level, true)};
+    const int *rows {inputMapping.empty() ? nullptr : inputMapping.data()};
+    bool streamed {false};
+
+    size_t t {0};
+    while(t < nTimesteps){
+        const size_t currentTimestep {firstTimestep + t};
+        const size_t currentTimeInterval {currentTimestep / nIntegrationSteps};
+        const size_t currentIntegratorStep {currentTimestep % nIntegrationSteps};
+        const size_t nSteps {std::min(nIntegrationSteps - currentIntegratorStep, nTimesteps - t)};
+        const std::complex<int8_t> *pInput {input + t * samplesPerTimestep};
+        std::complex<int8_t> *pOutput {output + currentTimeInterval * samplesInTimeInterval + currentIntegratorStep};
+        for(size_t ch {0}; ch < obsInfo.nFrequencies; ch++){
+            std::complex<int8_t> *pChannel {pOutput + ch * samplesInFrequency};
+            // Non-temporal stores need every 8-step row chunk to be 16-byte aligned.
+            const bool aligned {((reinterpret_cast<uintptr_t>(pChannel) | (nIntegrationSteps * sizeof(std::complex<int8_t>))) & 15) == 0};
+            const bool stream {streamingStores && aligned};
+            streamed = streamed || stream;
+            (stream ? streamingKernel : kernel)(pInput + ch * nInputs, samplesPerTimestep, nSteps, nInputs, pChannel, nIntegrationSteps, rows);
+        }
+        t += nSteps;
+    }
+    #ifdef ASTROIO_X86_SIMD
+    // make non-temporal stores visible to other threads before returning.
+    if(streamed) _mm_sfence();
+    #endif
+}
+
+
+
+void reorder_complex_input_range(const std::complex<int8_t> *input, size_t firstTimestep, size_t nTimesteps,
+        size_t firstInput, size_t nInputs, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        std::complex<int8_t> *output, SimdLevel level){
+    const size_t nAllInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t samplesPerTimestep {nInputs * obsInfo.nFrequencies};
+    const size_t samplesInFrequency {nAllInputs * nIntegrationSteps};
+    const size_t samplesInTimeInterval {samplesInFrequency * obsInfo.nFrequencies};
+    const TransposeKernel kernel {select_transpose_kernel(level, false)};
+
+    size_t t {0};
+    while(t < nTimesteps){
+        const size_t currentTimestep {firstTimestep + t};
+        const size_t currentTimeInterval {currentTimestep / nIntegrationSteps};
+        const size_t currentIntegratorStep {currentTimestep % nIntegrationSteps};
+        const size_t nSteps {std::min(nIntegrationSteps - currentIntegratorStep, nTimesteps - t)};
+        const std::complex<int8_t> *pInput {input + t * samplesPerTimestep};
+        std::complex<int8_t> *pOutput {output + currentTimeInterval * samplesInTimeInterval + firstInput * nIntegrationSteps
+            + currentIntegratorStep};
+        for(size_t ch {0}; ch < obsInfo.nFrequencies; ch++)
+            kernel(pInput + ch * nInputs, samplesPerTimestep, nSteps, nInputs, pOutput + ch * samplesInFrequency, nIntegrationSteps, nullptr);
+        t += nSteps;
+    }
+}
+
+
+
+void pack_dat_timesteps(const std::complex<int8_t> *input, size_t firstTimestep, size_t nTimesteps,
+        const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, uint8_t *output, SimdLevel level,
+        const std::vector<int>& inputMapping){
+    const PackKernel kernel {select_pack_kernel(level)};
+    const int *rows {inputMapping.empty() ? nullptr : inputMapping.data()};
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t bytesPerTimestep {nInputs * obsInfo.nFrequencies};
+    const size_t samplesInFrequency {nInputs * nIntegrationSteps};
+    const size_t samplesInTimeInterval {samplesInFrequency * obsInfo.nFrequencies};
+
+    size_t t {0};
+    while(t < nTimesteps){
+        const size_t currentTimestep {firstTimestep + t};
+        const size_t currentTimeInterval {currentTimestep / nIntegrationSteps};
+        const size_t currentIntegratorStep {currentTimestep % nIntegrationSteps};
+        const size_t nSteps {std::min(nIntegrationSteps - currentIntegratorStep, nTimesteps - t)};
+        const std::complex<int8_t> *pInput {input + currentTimeInterval * samplesInTimeInterval + currentIntegratorStep};
+        uint8_t *pOutput {output + t * bytesPerTimestep};
+        for(size_t ch {0}; ch < obsInfo.nFrequencies; ch++)
+            kernel(pInput + ch * samplesInFrequency, nIntegrationSteps, nSteps, nInputs, pOutput + ch * nInputs, bytesPerTimestep, rows);
+        t += nSteps;
+    }
+}
@@ -0,0 +1,180 @@
+#ifndef __VOLTAGE_EXPANSION_H__
+#define __VOLTAGE_EXPANSION_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <complex>
+#include <vector>
+#include "astroio.hpp"
+#include "channel_mask.hpp"
+#include "voltage_statistics.hpp"
+#include "spectral_kurtosis.hpp"
+
+/**
+ * @brief Instruction set extensions the CPU expansion kernels can be compiled for.
+ *
+ * Levels are ordered, so that a CPU supporting a level also supports all the levels below it.
+ */
+enum class SimdLevel {SCALAR, SSE4, AVX2, AVX512};
+
+
+/**
+ * @brief Return the most capable SIMD level supported by both the CPU the program is running on
+ * and the compiled code.
+ */
+SimdLevel detect_simd_level();
+
+
+/**
+ * @brief Return a human readable name for a SIMD level.
+ */
+const char* simd_level_name(SimdLevel level);
+
+
+/**
+ * @brief Expand `nSamples` consecutive 4+4 bit complex samples into 8+8 bit complex samples.
+ *
+ * Each input byte holds one complex sample: the real part in the low nibble and the imaginary part
+ * in the high nibble, both in two's complement.
+ *
+ * @param input: array of `nSamples` packed samples.
+ * @param nSamples: number of complex samples to expand.
+ * @param output: array of at least `nSamples` elements receiving the expanded samples.
+ * @param level: instruction set to use. Levels not supported by the CPU are lowered automatically.
+ */
+void expand_4bit_samples(const uint8_t *input, size_t nSamples, std::complex<int8_t> *output,
+    SimdLevel level = detect_simd_level());
+
+
+/**
+ * @brief Whether `inputMapping` can be used to reorder the inputs of a channel, i.e. it is a permutation
+ * of `0, ..., nInputs - 1`.
+ */
+bool is_input_permutation(const std::vector<int>& inputMapping, size_t nInputs);
+
+
+/**
+ * @brief Whether `inputMapping` can be used to expand .dat samples while dropping some inputs: negative
+ * entries mark the inputs to drop, the other ones are a permutation of `0, ..., k - 1`, where `k` is the
+ * number of inputs kept.
+ */
+bool is_input_selection(const std::vector<int>& inputMapping, size_t nInputs);
+
+
+/**
+ * @brief Number of inputs of a channel written by `expand_dat_timesteps` with `inputMapping`, i.e. `nInputs`
+ * if the mapping is empty, or the number of its non-negative entries.
+ */
+size_t kept_inputs(const std::vector<int>& inputMapping, size_t nInputs);
+
+
+/**
+ * @brief Expand `nTimesteps` consecutive timesteps of 4+4 bit .dat samples, the first of which
+ * is timestep `firstTimestep` of the observation, into the voltage output layout
+ *      [time_interval][channel][station][polarization][integration_step].
+ *
+ * Blocks of timesteps falling in the same integration interval are expanded in registers and
+ * transposed before being stored, so that each store writes consecutive integration steps.
+ *
+ * @param input: packed samples, ordered as [time][channel][station][polarization].
+ * @param firstTimestep: index, within the observation, of the first timestep in `input`.
+ * @param nTimesteps: number of timesteps in `input`.
+ * @param obsInfo: observation the samples belong to.
+ * @param nIntegrationSteps: number of timesteps in an integration interval.
+ * @param flaggedChannels: channels to set to zero. They are not expanded, but cleared with a memset of
+ * whole blocks. An empty mask flags nothing.
+ * @param output: pointer to the beginning of the whole voltage array.
+ * @param level: instruction set to use. Levels not supported by the CPU are lowered automatically.
+ * @param inputMapping: if not empty, input `j` of each channel (station/polarization pair, in file order)
+ * is written to the output position `inputMapping[j]` = station * nPolarizations + polarization, as
+ * returned by `read_metafits_mapping`. Inputs mapped to a negative position are dropped, e.g. those of
+ * flagged antennas, and the output channels only hold the remaining ones. See `is_input_selection`.
+ * @param statistics: if not null, statistics of the expanded samples are accumulated into it, tile by tile
+ * while the input is still in cache. It must have `obsInfo.nFrequencies` channels and one entry per input.
+ * @param kurtosis: if not null, RFI detector run on each channel of the output as soon as it is written.
+ * Flagged channels are not evaluated. Channels and inputs are indexed as in the output.
+ */
+void expand_dat_timesteps(const uint8_t *input, size_t firstTimestep, size_t nTimesteps,
+    const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, const ChannelMask& flaggedChannels,
+    std::complex<int8_t> *output, SimdLevel level = detect_simd_level(),
+    const std::vector<int>& inputMapping = std::vector<int> {}, VoltageStatistics *statistics = nullptr,
+    SpectralKurtosisFlagger *kurtosis = nullptr);
+
+
+/**
+ * @brief As above, but only the given channels are expanded. The output holds `channels.size()`
+ * channels, in the order they appear in `channels`.
+ *
+ * @param obsInfo: observation the samples belong to; it describes the layout of `input`.
+ * @param channels: indices of the channels, in `input`, to expand.
+ * @param flaggedChannels: channels, indexed as in `input`, to set to zero instead of expanding them.
+ * @param statistics: as above, but with `channels.size()` channels, indexed as in the output.
+ * @param kurtosis: as above, with channels indexed as in the output.
+ */
+void expand_dat_timesteps(const uint8_t *input, size_t firstTimestep, size_t nTimesteps,
+    const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, const std::vector<unsigned int>& channels,
+    const ChannelMask& flaggedChannels, std::complex<int8_t> *output, SimdLevel level = detect_simd_level(),
+    const std::vector<int>& inputMapping = std::vector<int> {}, VoltageStatistics *statistics = nullptr,
+    SpectralKurtosisFlagger *kurtosis = nullptr);
+
+
+/**
+ * @brief Reorder `nTimesteps` consecutive timesteps of 8+8 bit samples, the first of which is timestep
+ * `firstTimestep` of the observation, into the voltage output layout
+ *      [time_interval][channel][station][polarization][integration_step].
+ *
+ * The transpose is cache blocked: tiles of timesteps by stations are loaded in registers, transposed
+ * and stored such that each store writes consecutive integration steps.
+ *
+ * @param input: samples ordered as [time][channel][station][polarization].
+ * @param firstTimestep: index, within the observation, of the first timestep in `input`.
+ * @param nTimesteps: number of timesteps in `input`.
+ * @param obsInfo: observation the samples belong to.
+ * @param nIntegrationSteps: number of timesteps in an integration interval.
+ * @param output: pointer to the beginning of the whole voltage array.
+ * @param level: instruction set to use. Levels not supported by the CPU are lowered automatically.
+ * @param streamingStores: write the output with non-temporal stores, bypassing the cache, wherever
+ * the output alignment allows it. Useful when the output is much larger than the cache and is not
+ * going to be read again soon.
+ * @param inputMapping: if not empty, output position of each input, as for `expand_dat_timesteps`.
+ */
+void reorder_complex_timesteps(const std::complex<int8_t> *input, size_t firstTimestep, size_t nTimesteps,
+    const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, std::complex<int8_t> *output,
+    SimdLevel level = detect_simd_level(), bool streamingStores = false,
+    const std::vector<int>& inputMapping = std::vector<int> {});
+
+
+/**
+ * @brief As `reorder_complex_timesteps`, for the inputs [firstInput, firstInput + nInputs) only, e.g. a
+ * block of stations read on its own.
+ *
+ * @param input: samples of the selected inputs, ordered as [time][channel][input - firstInput].
+ */
+void reorder_complex_input_range(const std::complex<int8_t> *input, size_t firstTimestep, size_t nTimesteps,
+    size_t firstInput, size_t nInputs, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+    std::complex<int8_t> *output, SimdLevel level = detect_simd_level());
+
+
+/**
+ * @brief Inverse of `expand_dat_timesteps`: pack `nTimesteps` consecutive timesteps of the voltage array,
+ * the first of which is timestep `firstTimestep` of the observation, into 4+4 bit .dat samples ordered as
+ *      [time][channel][station][polarization].
+ *
+ * Values outside of the 4-bit range [-8, 7] are saturated. Samples that went through
+ * `expand_dat_timesteps` are packed back to the original bytes.
+ *
+ * @param input: pointer to the beginning of the whole voltage array.
+ * @param firstTimestep: index, within the observation, of the first timestep to pack.
+ * @param nTimesteps: number of timesteps to pack.
+ * @param obsInfo: observation the samples belong to.
+ * @param nIntegrationSteps: number of timesteps in an integration interval.
+ * @param output: array of `nTimesteps` timesteps of packed samples.
+ * @param level: instruction set to use. Levels not supported by the CPU are lowered automatically.
+ * @param inputMapping: if not empty, the input mapping the voltages were expanded with: input `j` of each
+ * channel of the output is read from position `inputMapping[j]`, restoring the original file order.
+ */
+void pack_dat_timesteps(const std::complex<int8_t> *input, size_t firstTimestep, size_t nTimesteps,
+    const ObservationInfo& obsInfo, unsigned int nIntegrationSteps, uint8_t *output,
+    SimdLevel level = detect_simd_level(), const std::vector<int>& inputMapping = std::vector<int> {});
+
+#endif
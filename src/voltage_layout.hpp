@@ -0,0 +1,298 @@
+#ifndef __VOLTAGE_LAYOUT_H__
+#define __VOLTAGE_LAYOUT_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <complex>
+#include <memory>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+
+#include "astroio.hpp"
+#include "memory_buffer.hpp"
+#include "file_reader.hpp"
+#include "voltage_expansion.hpp"
+#include "parallel.hpp"
+
+/*
+    Output layouts for voltage ingest, selected at compile time.
+
+    A layout policy maps the (timestep, channel, antenna, polarization) coordinates of a sample to its
+    offset in the output array. Policies are parametrised on the array dimensions, which are either
+    known only at runtime (`DynamicDims`) or fixed at compile time (`FixedDims`). With fixed dimensions
+    the index arithmetic reduces to constant multiplications and shifts, and the loops over antennas
+    and polarizations have a known trip count the compiler can fully unroll and vectorise.
+*/
+
+
+/**
+ * @brief Voltage array dimensions known at runtime.
+ */
+struct DynamicDims {
+    unsigned int nChannels;
+    unsigned int nAntennas;
+    unsigned int nPolarizations;
+    unsigned int nIntegrationSteps;
+    size_t nTimesteps;
+
+    unsigned int n_channels() const { return nChannels; }
+    unsigned int n_antennas() const { return nAntennas; }
+    unsigned int n_polarizations() const { return nPolarizations; }
+
+    static DynamicDims from_observation(const ObservationInfo& obsInfo, unsigned int nIntegrationSteps){
+        return {obsInfo.nFrequencies, obsInfo.nAntennas, obsInfo.nPolarizations, nIntegrationSteps, obsInfo.nTimesteps};
+    }
+};
+
+
+/**
+ * @brief Voltage array whose number of channels, antennas and polarizations is fixed at compile time.
+ */
+template <unsigned int CHANNELS, unsigned int ANTENNAS, unsigned int POLARIZATIONS>
+struct FixedDims {
+    unsigned int nIntegrationSteps;
+    size_t nTimesteps;
+
+    static constexpr unsigned int n_channels() { return CHANNELS; }
+    static constexpr unsigned int n_antennas() { return ANTENNAS; }
+    static constexpr unsigned int n_polarizations() { return POLARIZATIONS; }
+
+    static FixedDims from_observation(const ObservationInfo& obsInfo, unsigned int nIntegrationSteps){
+        if(obsInfo.nFrequencies != CHANNELS || obsInfo.nAntennas != ANTENNAS || obsInfo.nPolarizations != POLARIZATIONS)
+            throw std::invalid_argument {"FixedDims: observation does not match the compile time dimensions."};
+        return {nIntegrationSteps, obsInfo.nTimesteps};
+    }
+};
+
+// Standard MWA VCS coarse channel: 128 fine channels, 128 tiles, 2 polarizations.
+using VcsDims = FixedDims<128, 128, 2>;
+
+
+
+/**
+ * @brief The layout of `Voltages`, used by the correlator:
+ *      [integration_interval][channel][antenna][polarization][integration_step].
+ */
+template <typename Dims>
+struct CorrelatorLayout {
+    using dims_type = Dims;
+    Dims dims;
+
+    size_t n_inputs() const { return static_cast<size_t>(dims.n_antennas()) * dims.n_polarizations(); }
+
+    size_t integration_intervals() const { return (dims.nTimesteps + dims.nIntegrationSteps - 1) / dims.nIntegrationSteps; }
+
+    size_t size() const { return integration_intervals() * dims.nIntegrationSteps * dims.n_channels() * n_inputs(); }
+
+    size_t antenna_stride() const { return static_cast<size_t>(dims.n_polarizations()) * dims.nIntegrationSteps; }
+
+    size_t offset(size_t t, size_t ch, size_t input) const {
+        return ((t / dims.nIntegrationSteps * dims.n_channels() + ch) * n_inputs() + input) * dims.nIntegrationSteps
+            + t % dims.nIntegrationSteps;
+    }
+
+    size_t offset(size_t t, size_t ch, size_t antenna, size_t pol) const {
+        return offset(t, ch, antenna * dims.n_polarizations() + pol);
+    }
+};
+
+
+/**
+ * @brief Antenna-major layout used by the beamformer, where the samples of all the antennas for a given
+ * channel, timestep and polarization are contiguous:
+ *      [channel][time][polarization][antenna].
+ */
+template <typename Dims>
+struct BeamformerLayout {
+    using dims_type = Dims;
+    Dims dims;
+
+    size_t n_inputs() const { return static_cast<size_t>(dims.n_antennas()) * dims.n_polarizations(); }
+
+    size_t size() const { return dims.nTimesteps * dims.n_channels() * n_inputs(); }
+
+    size_t antenna_stride() const { return 1; }
+
+    size_t offset(size_t t, size_t ch, size_t antenna, size_t pol) const {
+        return ((ch * dims.nTimesteps + t) * dims.n_polarizations() + pol) * dims.n_antennas() + antenna;
+    }
+
+    size_t offset(size_t t, size_t ch, size_t input) const {
+        return offset(t, ch, input / dims.n_polarizations(), input % dims.n_polarizations());
+    }
+};
+
+
+/**
+ * @brief The order of the .dat file, left untouched, used by spectrometers working on whole timesteps:
+ *      [time][channel][antenna][polarization].
+ * Samples along any axis are accessed through the strides below.
+ */
+template <typename Dims>
+struct RawLayout {
+    using dims_type = Dims;
+    Dims dims;
+
+    size_t n_inputs() const { return static_cast<size_t>(dims.n_antennas()) * dims.n_polarizations(); }
+
+    size_t size() const { return dims.nTimesteps * dims.n_channels() * n_inputs(); }
+
+    size_t polarization_stride() const { return 1; }
+    size_t antenna_stride() const { return dims.n_polarizations(); }
+    size_t channel_stride() const { return n_inputs(); }
+    size_t time_stride() const { return n_inputs() * dims.n_channels(); }
+
+    size_t offset(size_t t, size_t ch, size_t input) const { return t * time_stride() + ch * channel_stride() + input; }
+
+    size_t offset(size_t t, size_t ch, size_t antenna, size_t pol) const {
+        return offset(t, ch, antenna * antenna_stride() + pol);
+    }
+};
+
+
+
+/**
+ * @brief Expand a packed 4+4 bit complex sample.
+ */
+inline std::complex<int8_t> expand_4bit_sample(uint8_t packed){
+    return {static_cast<int8_t>(((packed & 0xF) ^ 8) - 8), static_cast<int8_t>(((packed >> 4) ^ 8) - 8)};
+}
+
+
+/**
+ * @brief Expand `nTimesteps` consecutive timesteps of 4+4 bit .dat samples, the first of which is
+ * timestep `firstTimestep` of the observation, into `output` arranged according to `layout`.
+ *
+ * This generic version walks each input row once and scatters the samples according to the layout;
+ * the loops over the antennas and polarizations of a channel are fully unrolled for fixed dimensions.
+ */
+template <typename Layout>
+void expand_dat_timesteps(const uint8_t *input, size_t firstTimestep, size_t nTimesteps, const Layout& layout,
+        std::complex<int8_t> *output){
+    const size_t nInputs {layout.n_inputs()};
+    const size_t nChannels {layout.dims.n_channels()};
+    const size_t nAntennas {layout.dims.n_antennas()};
+    const size_t nPolarizations {layout.dims.n_polarizations()};
+    // Blocks of timesteps are processed channel by channel, so that layouts where channels are far apart
+    // receive longer runs of consecutive writes.
+    const size_t timestepsInBlock {16};
+    for(size_t t0 {0}; t0 < nTimesteps; t0 += timestepsInBlock){
+        const size_t t1 {std::min(nTimesteps, t0 + timestepsInBlock)};
+        for(size_t ch {0}; ch < nChannels; ch++){
+            for(size_t t {t0}; t < t1; t++){
+                const uint8_t *row {input + (t * nChannels + ch) * nInputs};
+                // antennas innermost, as they are contiguous in the non-trivial layouts.
+                for(size_t p {0}; p < nPolarizations; p++){
+                    std::complex<int8_t> *out {output + layout.offset(firstTimestep + t, ch, 0, p)};
+                    for(size_t a {0}; a < nAntennas; a++)
+                        out[a * layout.antenna_stride()] = expand_4bit_sample(row[a * nPolarizations + p]);
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief The raw layout is a plain expansion of contiguous samples.
+ */
+template <typename Dims>
+void expand_dat_timesteps(const uint8_t *input, size_t firstTimestep, size_t nTimesteps, const RawLayout<Dims>& layout,
+        std::complex<int8_t> *output){
+    expand_4bit_samples(input, nTimesteps * layout.time_stride(), output + layout.offset(firstTimestep, 0, 0));
+}
+
+
+/**
+ * @brief The correlator layout is the one of `Voltages`, produced by the vectorised transposing kernels.
+ */
+template <typename Dims>
+void expand_dat_timesteps(const uint8_t *input, size_t firstTimestep, size_t nTimesteps, const CorrelatorLayout<Dims>& layout,
+        std::complex<int8_t> *output){
+    ObservationInfo obsInfo {};
+    obsInfo.nFrequencies = layout.dims.n_channels();
+    obsInfo.nAntennas = layout.dims.n_antennas();
+    obsInfo.nPolarizations = layout.dims.n_polarizations();
+    obsInfo.nTimesteps = layout.dims.nTimesteps;
+    expand_dat_timesteps(input, firstTimestep, nTimesteps, obsInfo, layout.dims.nIntegrationSteps, ChannelMask {}, output);
+}
+
+
+
+/**
+ * @brief Voltage data arranged according to the layout policy `Layout`. `Voltages` holds the same data
+ * as `LayoutVoltages<CorrelatorLayout<DynamicDims>>`.
+ */
+template <typename Layout>
+class LayoutVoltages : public MemoryBuffer<std::complex<int8_t>> {
+
+    public:
+    ObservationInfo obsInfo;
+    Layout layout;
+
+    LayoutVoltages(MemoryBuffer<std::complex<int8_t>>&& data, const ObservationInfo& obsInfo, const Layout& layout)
+        : MemoryBuffer {std::move(data)}, obsInfo (obsInfo), layout (layout) {}
+
+    std::complex<int8_t>& at(size_t t, size_t ch, size_t antenna, size_t pol) {
+        return data()[layout.offset(t, ch, antenna, pol)];
+    }
+
+    const std::complex<int8_t>& at(size_t t, size_t ch, size_t antenna, size_t pol) const {
+        return data()[layout.offset(t, ch, antenna, pol)];
+    }
+
+    /**
+     * @brief Read voltage data from a .dat file directly into the layout `Layout`.
+     *
+     * @param filename: path to the .dat file.
+     * @param obsInfo: metadata information regarding the obervation. It must match the layout dimensions,
+     * if these are fixed at compile time.
+     * @param nIntegrationSteps: number of timesteps in an integration interval, used by layouts grouping
+     * timesteps in intervals.
+     * @param options: how the file is read. Timestep and channel selections, flagged channels, input mappings
+     * and flagged antennas are not supported.
+     * @throws std::invalid_argument if `options` requests any of them.
+     */
+    static LayoutVoltages from_dat_file(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+            const DatReadOptions& options = DatReadOptions {}){
+        if(nIntegrationSteps == 0) throw std::invalid_argument {"LayoutVoltages::from_dat_file: `nIntegrationSteps` must be positive."};
+        if(options.timestepsPerRead == 0) throw std::invalid_argument {"LayoutVoltages::from_dat_file: `timestepsPerRead` must be positive."};
+        if(options.firstTimestep != 0 || options.nTimesteps != 0 || !options.channels.empty())
+            throw std::invalid_argument {"LayoutVoltages::from_dat_file: selective reads are not supported."};
+        if(!options.flaggedChannels.empty())
+            throw std::invalid_argument {"LayoutVoltages::from_dat_file: flagged channels are not supported."};
+        if(!options.inputMapping.empty())
+            throw std::invalid_argument {"LayoutVoltages::from_dat_file: input mappings are not supported."};
+        if(!options.flaggedAntennas.empty())
+            throw std::invalid_argument {"LayoutVoltages::from_dat_file: flagged antennas are not supported."};
+        const Layout layout {Layout::dims_type::from_observation(obsInfo, nIntegrationSteps)};
+        std::unique_ptr<FileReader> reader {open_file_reader(filename, options.backend)};
+        const size_t bytesPerTimestep {layout.n_inputs() * layout.dims.n_channels()};
+        const size_t nTimesteps {std::min(reader->size() / bytesPerTimestep, static_cast<size_t>(obsInfo.nTimesteps))};
+        MemoryBuffer<std::complex<int8_t>> mbVoltages {layout.size(), false, false};
+        std::complex<int8_t> *voltages {mbVoltages.data()};
+        // timesteps missing from the file are left to zero.
+        memset(voltages, 0, layout.size() * sizeof(std::complex<int8_t>));
+        if(options.nThreads > 1){
+            parallel_for_ranges(nTimesteps, options.nThreads, 8u, [&](size_t begin, size_t end){
+                std::vector<uint8_t> buffer(std::min<size_t>(options.timestepsPerRead, end - begin) * bytesPerTimestep);
+                for(size_t ts {begin}; ts < end; ts += options.timestepsPerRead){
+                    const size_t nRead {std::min<size_t>(options.timestepsPerRead, end - ts)};
+                    reader->read(buffer.data(), nRead * bytesPerTimestep, ts * bytesPerTimestep);
+                    expand_dat_timesteps(buffer.data(), ts, nRead, layout, voltages);
+                }
+            });
+        }else{
+            reader->read_chunks(0, nTimesteps * bytesPerTimestep, options.timestepsPerRead * bytesPerTimestep, options.queueDepth,
+                    [&](size_t offset, const uint8_t *data, size_t size){
+                expand_dat_timesteps(data, offset / bytesPerTimestep, size / bytesPerTimestep, layout, voltages);
+            });
+        }
+        return LayoutVoltages {std::move(mbVoltages), obsInfo, layout};
+    }
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include <stdexcept>
+#include <algorithm>
+#include "voltage_statistics.hpp"
+#include "voltage_expansion.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#define ASTROIO_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    // 8-bit working counters can take this many samples per input before being flushed.
+    constexpr size_t MAX_PENDING_SAMPLES {255};
+
+
+    // Square of each 4-bit value, indexed by its two's complement representation.
+    constexpr uint8_t nibble_squares[16] {0, 1, 4, 9, 16, 25, 36, 49, 64, 49, 36, 25, 16, 9, 4, 1};
+
+
+    /*
+        Counting kernels add the occurrences of each 4-bit value in `nSteps` rows of packed samples to the
+        working counters `counts`, laid out as [real/imaginary][value + 8][input], and store in `power`
+        the power of each input summed over the rows. Inputs are processed in vectors of consecutive
+        inputs: each value is counted with a comparison and a subtraction for all of them at once.
+    */
+    using CountKernel = void (*)(const uint8_t*, size_t, size_t, size_t, uint8_t*, uint32_t*);
+
+
+    void count_tile_scalar_range(const uint8_t *input, size_t inStride, size_t nSteps, size_t firstInput, size_t nInputs,
+            uint8_t *counts, uint32_t *power){
+        for(size_t j {firstInput}; j < nInputs; j++){
+            uint32_t p {0};
+            for(size_t s {0}; s < nSteps; s++){
+                const uint8_t sample {input[s * inStride + j]};
+                p += nibble_squares[sample & 0xf] + nibble_squares[sample >> 4];
+                // bin `value + 8` of a nibble is the nibble with its sign bit flipped.
+                counts[((sample & 0xf) ^ 0x8) * nInputs + j]++;
+                counts[(VoltageStatistics::N_BINS + ((sample >> 4) ^ 0x8)) * nInputs + j]++;
+            }
+            power[j] = p;
+        }
+    }
+
+
+    void count_tile_scalar(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint8_t *counts, uint32_t *power){
+        count_tile_scalar_range(input, inStride, nSteps, 0, nInputs, counts, power);
+    }
+
+
+    #ifdef ASTROIO_X86_SIMD
+
+    __attribute__((target("sse4.1")))
+    void count_tile_sse4(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint8_t *counts, uint32_t *power){
+        const __m128i lowNibble {_mm_set1_epi8(0x0F)};
+        const __m128i squares {_mm_loadu_si128(reinterpret_cast<const __m128i*>(nibble_squares))};
+        const size_t nVecInputs {nInputs - nInputs % 16};
+        for(size_t j {0}; j < nVecInputs; j += 16){
+            __m128i power16[2] {_mm_setzero_si128(), _mm_setzero_si128()};
+            for(unsigned int part {0}; part < 2; part++){
+                uint8_t *partCounts {counts + part * VoltageStatistics::N_BINS * nInputs + j};
+                __m128i acc[VoltageStatistics::N_BINS];
+                for(unsigned int b {0}; b < VoltageStatistics::N_BINS; b++)
+                    acc[b] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(partCounts + b * nInputs));
+                for(size_t s {0}; s < nSteps; s++){
+                    const __m128i v {_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + s * inStride + j))};
+                    const __m128i nibbles {_mm_and_si128(part == 0 ? v : _mm_srli_epi16(v, 4), lowNibble)};
+                    const __m128i sq {_mm_shuffle_epi8(squares, nibbles)};
+                    power16[0] = _mm_add_epi16(power16[0], _mm_cvtepu8_epi16(sq));
+                    power16[1] = _mm_add_epi16(power16[1], _mm_cvtepu8_epi16(_mm_srli_si128(sq, 8)));
+                    // comparisons give -1 where they match. Counters must stay in registers.
+                    #pragma GCC unroll 16
+                    for(unsigned int b {0}; b < VoltageStatistics::N_BINS; b++)
+                        acc[b] = _mm_sub_epi8(acc[b], _mm_cmpeq_epi8(nibbles, _mm_set1_epi8(static_cast<char>(b ^ 0x8))));
+                }
+                for(unsigned int b {0}; b < VoltageStatistics::N_BINS; b++)
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(partCounts + b * nInputs), acc[b]);
+            }
+            for(unsigned int h {0}; h < 2; h++){
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(power + j + 8 * h), _mm_cvtepu16_epi32(power16[h]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(power + j + 8 * h + 4), _mm_cvtepu16_epi32(_mm_srli_si128(power16[h], 8)));
+            }
+        }
+        count_tile_scalar_range(input, inStride, nSteps, nVecInputs, nInputs, counts, power);
+    }
+
+
+    __attribute__((target("avx2")))
+    void count_tile_avx2(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint8_t *counts, uint32_t *power){
+        const __m256i lowNibble {_mm256_set1_epi8(0x0F)};
+        const __m256i squares {_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nibble_squares)))};
+        const size_t nVecInputs {nInputs - nInputs % 32};
+        for(size_t j {0}; j < nVecInputs; j += 32){
+            __m256i power16[2] {_mm256_setzero_si256(), _mm256_setzero_si256()};
+            for(unsigned int part {0}; part < 2; part++){
+                uint8_t *partCounts {counts + part * VoltageStatistics::N_BINS * nInputs + j};
+                __m256i acc[VoltageStatistics::N_BINS];
+                for(unsigned int b {0}; b < VoltageStatistics::N_BINS; b++)
+                    acc[b] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(partCounts + b * nInputs));
+                for(size_t s {0}; s < nSteps; s++){
+                    const __m256i v {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + s * inStride + j))};
+                    const __m256i nibbles {_mm256_and_si256(part == 0 ? v : _mm256_srli_epi16(v, 4), lowNibble)};
+                    const __m256i sq {_mm256_shuffle_epi8(squares, nibbles)};
+                    power16[0] = _mm256_add_epi16(power16[0], _mm256_cvtepu8_epi16(_mm256_castsi256_si128(sq)));
+                    power16[1] = _mm256_add_epi16(power16[1], _mm256_cvtepu8_epi16(_mm256_extracti128_si256(sq, 1)));
+                    #pragma GCC unroll 16
+                    for(unsigned int b {0}; b < VoltageStatistics::N_BINS; b++)
+                        acc[b] = _mm256_sub_epi8(acc[b], _mm256_cmpeq_epi8(nibbles, _mm256_set1_epi8(static_cast<char>(b ^ 0x8))));
+                }
+                for(unsigned int b {0}; b < VoltageStatistics::N_BINS; b++)
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(partCounts + b * nInputs), acc[b]);
+            }
+            for(unsigned int h {0}; h < 2; h++){
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(power + j + 16 * h), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(power16[h])));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(power + j + 16 * h + 8), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(power16[h], 1)));
+            }
+        }
+        count_tile_scalar_range(input, inStride, nSteps, nVecInputs, nInputs, counts, power);
+    }
+
+
+    __attribute__((target("avx512f,avx512bw")))
+    void count_tile_avx512(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputs, uint8_t *counts, uint32_t *power){
+        const __m512i lowNibble {_mm512_set1_epi8(0x0F)};
+        const __m512i one {_mm512_set1_epi8(1)};
+        const __m512i squares {_mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nibble_squares)))};
+        const size_t nVecInputs {nInputs - nInputs % 64};
+        for(size_t j {0}; j < nVecInputs; j += 64){
+            __m512i power16[2] {_mm512_setzero_si512(), _mm512_setzero_si512()};
+            for(unsigned int part {0}; part < 2; part++){
+                uint8_t *partCounts {counts + part * VoltageStatistics::N_BINS * nInputs + j};
+                __m512i acc[VoltageStatistics::N_BINS];
+                for(unsigned int b {0}; b < VoltageStatistics::N_BINS; b++)
+                    acc[b] = _mm512_loadu_si512(partCounts + b * nInputs);
+                for(size_t s {0}; s < nSteps; s++){
+                    const __m512i v {_mm512_loadu_si512(input + s * inStride + j)};
+                    const __m512i nibbles {_mm512_and_si512(part == 0 ? v : _mm512_srli_epi16(v, 4), lowNibble)};
+                    const __m512i sq {_mm512_shuffle_epi8(squares, nibbles)};
+                    power16[0] = _mm512_add_epi16(power16[0], _mm512_cvtepu8_epi16(_mm512_castsi512_si256(sq)));
+                    power16[1] = _mm512_add_epi16(power16[1], _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(sq, 1)));
+                    #pragma GCC unroll 16
+                    for(unsigned int b {0}; b < VoltageStatistics::N_BINS; b++)
+                        acc[b] = _mm512_mask_add_epi8(acc[b], _mm512_cmpeq_epi8_mask(nibbles, _mm512_set1_epi8(static_cast<char>(b ^ 0x8))),
+                            acc[b], one);
+                }
+                for(unsigned int b {0}; b < VoltageStatistics::N_BINS; b++)
+                    _mm512_storeu_si512(partCounts + b * nInputs, acc[b]);
+            }
+            for(unsigned int h {0}; h < 2; h++){
+                _mm512_storeu_si512(power + j + 32 * h, _mm512_cvtepu16_epi32(_mm512_castsi512_si256(power16[h])));
+                _mm512_storeu_si512(power + j + 32 * h + 16, _mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(power16[h], 1)));
+            }
+        }
+        count_tile_scalar_range(input, inStride, nSteps, nVecInputs, nInputs, counts, power);
+    }
+
+    #endif
+
+
+    CountKernel select_count_kernel(SimdLevel level){
+        #ifdef ASTROIO_X86_SIMD
+        switch(std::min(level, detect_simd_level())){
+            case SimdLevel::AVX512: return count_tile_avx512;
+            case SimdLevel::AVX2: return count_tile_avx2;
+            case SimdLevel::SSE4: return count_tile_sse4;
+            default: break;
+        }
+        #endif
+        return count_tile_scalar;
+    }
+}
+
+
+
+double VoltageStatistics::mean_power(unsigned int channel, unsigned int input) const {
+    if(nTimesteps[channel] == 0) return 0.0;
+    return static_cast<double>(power[static_cast<size_t>(channel) * nInputs + input]) / nTimesteps[channel];
+}
+
+
+
+double VoltageStatistics::input_mean_power(unsigned int input) const {
+    uint64_t totalPower {0}, totalSamples {0};
+    for(unsigned int ch {0}; ch < nChannels; ch++){
+        totalPower += power[static_cast<size_t>(ch) * nInputs + input];
+        totalSamples += nTimesteps[ch];
+    }
+    return totalSamples == 0 ? 0.0 : static_cast<double>(totalPower) / totalSamples;
+}
+
+
+
+double VoltageStatistics::channel_mean_power(unsigned int channel) const {
+    if(nTimesteps[channel] == 0 || nInputs == 0) return 0.0;
+    uint64_t totalPower {0};
+    for(unsigned int j {0}; j < nInputs; j++) totalPower += power[static_cast<size_t>(channel) * nInputs + j];
+    return static_cast<double>(totalPower) / (nTimesteps[channel] * nInputs);
+}
+
+
+
+uint64_t VoltageStatistics::saturated(unsigned int input) const {
+    uint64_t n {0};
+    for(bool imaginary : {false, true})
+        n += count(input, imaginary, -8) + count(input, imaginary, -7) + count(input, imaginary, 7);
+    return n;
+}
+
+
+
+void VoltageStatistics::merge(const VoltageStatistics& other){
+    if(other.nChannels != nChannels || other.nInputs != nInputs)
+        throw std::invalid_argument {"VoltageStatistics::merge: statistics have different shapes."};
+    for(size_t i {0}; i < nTimesteps.size(); i++) nTimesteps[i] += other.nTimesteps[i];
+    for(size_t i {0}; i < power.size(); i++) power[i] += other.power[i];
+    for(size_t i {0}; i < histogram.size(); i++) histogram[i] += other.histogram[i];
+}
+
+
+
+void VoltageStatistics::flush(const int *rows){
+    if(nPendingSamples == 0) return;
+    for(size_t bin {0}; bin < 2 * N_BINS; bin++){
+        for(size_t j {0}; j < nTileInputs; j++){
+            if(rows && rows[j] < 0) continue;
+            const size_t r {rows ? static_cast<size_t>(rows[j]) : j};
+            histogram[r * 2 * N_BINS + bin] += binCounts[bin * nTileInputs + j];
+        }
+    }
+    std::fill(binCounts.begin(), binCounts.end(), 0u);
+    nPendingSamples = 0;
+}
+
+
+
+void VoltageStatistics::accumulate_dat_tile(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputsInTile,
+        unsigned int channel, const int *rows, SimdLevel level){
+    if(binCounts.empty() || nTileInputs != nInputsInTile){
+        if(nPendingSamples > 0)
+            throw std::invalid_argument {"VoltageStatistics::accumulate_dat_tile: tiles of a different width must be preceded by a flush."};
+        nTileInputs = nInputsInTile;
+        binCounts.assign(2 * N_BINS * nTileInputs, 0u);
+        blockPower.assign(nTileInputs, 0u);
+    }
+    const CountKernel kernel {select_count_kernel(level)};
+    uint64_t *channelPower {power.data() + static_cast<size_t>(channel) * nInputs};
+    for(size_t s {0}; s < nSteps;){
+        if(nPendingSamples == MAX_PENDING_SAMPLES) flush(rows);
+        const size_t n {std::min(nSteps - s, MAX_PENDING_SAMPLES - nPendingSamples)};
+        kernel(input + s * inStride, inStride, n, nTileInputs, binCounts.data(), blockPower.data());
+        for(size_t j {0}; j < nTileInputs; j++){
+            if(rows && rows[j] < 0) continue;
+            channelPower[rows ? rows[j] : j] += blockPower[j];
+        }
+        nPendingSamples += n;
+        s += n;
+    }
+    nTimesteps[channel] += nSteps;
+}
@@ -0,0 +1,111 @@
+#ifndef __VOLTAGE_STATISTICS_H__
+#define __VOLTAGE_STATISTICS_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// defined in voltage_expansion.hpp
+enum class SimdLevel;
+
+
+/**
+ * @brief Data quality statistics of 4+4 bit voltages, accumulated while they are expanded.
+ *
+ * Inputs (station/polarization pairs) and channels are indexed as in the expanded `Voltages`, i.e.
+ * after channel selection and input mapping have been applied. Flagged channels are not expanded and
+ * do not contribute to the statistics.
+ *
+ * Counters are exact integers, so that partial statistics computed by different threads, or on
+ * different files, can be merged without loss.
+ */
+struct VoltageStatistics {
+    // Number of distinct 4-bit values, from -8 to 7.
+    static constexpr unsigned int N_BINS {16};
+
+    unsigned int nChannels {0};
+    unsigned int nInputs {0};
+    // Number of timesteps accumulated for each channel.
+    std::vector<uint64_t> nTimesteps;
+    // Sum of the power, re^2 + im^2, of the samples of each [channel][input].
+    std::vector<uint64_t> power;
+    // Occurrences of each value of the real and imaginary parts: [input][real/imaginary][value + 8].
+    std::vector<uint64_t> histogram;
+
+    VoltageStatistics() {}
+
+    VoltageStatistics(unsigned int nChannels, unsigned int nInputs) : nChannels {nChannels}, nInputs {nInputs},
+        nTimesteps(nChannels, 0), power(static_cast<size_t>(nChannels) * nInputs, 0),
+        histogram(static_cast<size_t>(nInputs) * 2 * N_BINS, 0) {}
+
+    bool empty() const { return nChannels == 0; }
+
+    /**
+     * @brief Mean power of an input in a channel, zero if no sample was accumulated.
+     */
+    double mean_power(unsigned int channel, unsigned int input) const;
+
+    /**
+     * @brief Mean power of an input over all the accumulated channels.
+     */
+    double input_mean_power(unsigned int input) const;
+
+    /**
+     * @brief Mean power of a channel over all the inputs.
+     */
+    double channel_mean_power(unsigned int channel) const;
+
+    /**
+     * @brief Number of times the real (`imaginary == false`) or imaginary part of the samples of an input
+     * took the value `value`, in [-8, 7].
+     */
+    uint64_t count(unsigned int input, bool imaginary, int value) const {
+        return histogram[(static_cast<size_t>(input) * 2 + imaginary) * N_BINS + (value + 8)];
+    }
+
+    /**
+     * @brief Number of real and imaginary parts of the samples of an input at the edges of the 4-bit range,
+     * i.e. equal to -8, -7 or 7.
+     */
+    uint64_t saturated(unsigned int input) const;
+
+    /**
+     * @brief Add the counters of `other`, which must have the same shape, to these ones. Both must have
+     * been flushed.
+     */
+    void merge(const VoltageStatistics& other);
+
+    /**
+     * @brief Accumulate a tile of packed .dat samples of a single channel.
+     *
+     * Histograms are first counted in 8-bit working counters laid out such that a vector register holds
+     * the counters of consecutive inputs. They are added to `histogram` by `flush`, which must be called,
+     * with the same `rows`, once all the tiles have been accumulated. The expansion functions do so
+     * before returning.
+     *
+     * @param input: `nSteps` rows of `nInputsInTile` packed samples, `inStride` bytes apart.
+     * @param nInputsInTile: number of inputs in a row. It differs from `nInputs` when inputs are dropped.
+     * @param channel: channel of the output the samples are expanded to.
+     * @param rows: if not null, input `j` of each row is accounted to input `rows[j]`, or ignored if
+     * `rows[j]` is negative.
+     * @param level: instruction set to use. Levels not supported by the CPU are lowered automatically.
+     */
+    void accumulate_dat_tile(const uint8_t *input, size_t inStride, size_t nSteps, size_t nInputsInTile, unsigned int channel,
+        const int *rows, SimdLevel level);
+
+    /**
+     * @brief Add the working counters to `histogram`.
+     */
+    void flush(const int *rows);
+
+    private:
+    // Working counters, [real/imaginary][value + 8][tile input], not yet added to `histogram`.
+    std::vector<uint8_t> binCounts;
+    size_t nTileInputs {0};
+    // Number of samples of each input counted in `binCounts`.
+    size_t nPendingSamples {0};
+    // Power of each input in the last block of timesteps.
+    std::vector<uint32_t> blockPower;
+};
+
+#endif
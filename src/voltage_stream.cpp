@@ -0,0 +1,42 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include "voltage_stream.hpp"
+#include "voltage_expansion.hpp"
+
+
+
+VoltageStream::VoltageStream(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        ReadBackend backend) : obsInfo {obsInfo}, nIntegrationSteps {nIntegrationSteps} {
+    if(nIntegrationSteps == 0) throw std::invalid_argument {"VoltageStream: `nIntegrationSteps` must be positive."};
+    reader = open_file_reader(filename, backend);
+    bytesPerTimestep = static_cast<size_t>(obsInfo.nFrequencies) * obsInfo.nAntennas * obsInfo.nPolarizations;
+    nTimesteps = std::min(reader->size() / bytesPerTimestep, static_cast<size_t>(obsInfo.nTimesteps));
+    staging.resize(nIntegrationSteps * bytesPerTimestep);
+}
+
+
+
+Voltages VoltageStream::allocate_interval(bool use_pinned_mem) const {
+    ObservationInfo intervalInfo {obsInfo};
+    intervalInfo.nTimesteps = nIntegrationSteps;
+    MemoryBuffer<std::complex<int8_t>> mbVoltages {nIntegrationSteps * bytesPerTimestep, false, use_pinned_mem};
+    return Voltages {std::move(mbVoltages), intervalInfo, nIntegrationSteps};
+}
+
+
+
+bool VoltageStream::read_next(Voltages& interval){
+    if(nextTimestep >= nTimesteps) return false;
+    if(interval.nIntegrationSteps != nIntegrationSteps || interval.size() != nIntegrationSteps * bytesPerTimestep
+            || interval.on_gpu())
+        throw std::invalid_argument {"VoltageStream::read_next: output object was not created by `allocate_interval`."};
+    const size_t nSteps {std::min(static_cast<size_t>(nIntegrationSteps), nTimesteps - nextTimestep)};
+    reader->read(staging.data(), nSteps * bytesPerTimestep, nextTimestep * bytesPerTimestep);
+    if(nSteps < nIntegrationSteps)
+        memset(interval.data(), 0, interval.size() * sizeof(std::complex<int8_t>));
+    // The output only holds one interval, hence timesteps are counted from its beginning.
+    expand_dat_timesteps(staging.data(), 0, nSteps, obsInfo, nIntegrationSteps, ChannelMask {}, interval.data());
+    nextTimestep += nSteps;
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef __VOLTAGE_STREAM_H__
+#define __VOLTAGE_STREAM_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include "astroio.hpp"
+#include "file_reader.hpp"
+
+
+/**
+ * @brief Sequential reader of a .dat file yielding one integration interval at a time.
+ *
+ * Unlike `Voltages::from_dat_file`, which materialises the whole file, a `VoltageStream` fills a
+ * caller-owned `Voltages` object holding a single integration interval, i.e. `nIntegrationSteps`
+ * timesteps, with the same layout
+ *      [channel][station][polarization][integration_step].
+ * The same output object can be reused for all the intervals, so that resident memory does not
+ * depend on the length of the file and the first interval is available as soon as it is read.
+ *
+ * Example:
+ *      VoltageStream stream {filename, VCS_OBSERVATION_INFO, 100};
+ *      Voltages interval {stream.allocate_interval()};
+ *      while(stream.read_next(interval)){ ... }
+ */
+class VoltageStream {
+    private:
+    std::unique_ptr<FileReader> reader;
+    ObservationInfo obsInfo;
+    unsigned int nIntegrationSteps;
+    size_t bytesPerTimestep;
+    // number of timesteps that can be read from the file.
+    size_t nTimesteps;
+    size_t nextTimestep {0};
+    std::vector<uint8_t> staging;
+
+    public:
+    /**
+     * @brief Open a .dat file for streaming.
+     *
+     * @param filename: path to the .dat file.
+     * @param obsInfo: metadata information regarding the observation. For VCS data, you can use the constant
+     * VCS_OBSERVATION_INFO.
+     * @param nIntegrationSteps: number of timesteps in each interval returned by `read_next`.
+     * @param backend: how data is read from disk.
+     */
+    VoltageStream(const std::string& filename, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps,
+        ReadBackend backend = ReadBackend::BUFFERED);
+
+    /**
+     * @brief Allocate a `Voltages` object of the right size to hold one integration interval.
+     *
+     * @param use_pinned_mem: if GPU support is enabled, gives the option to pin CPU memory for fast memory
+     * transfers to GPU.
+     */
+    Voltages allocate_interval(bool use_pinned_mem = false) const;
+
+    /**
+     * @brief Read and expand the next integration interval into `interval`.
+     *
+     * If the file ends in the middle of an interval, the missing timesteps are set to zero.
+     *
+     * @param interval: object previously created with `allocate_interval`.
+     * @return `false` if there are no more intervals to read, `true` otherwise.
+     */
+    bool read_next(Voltages& interval);
+
+    /**
+     * @brief Number of integration intervals in the file.
+     */
+    size_t n_intervals() const { return (nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps; }
+
+    /**
+     * @brief Index of the interval that the next call to `read_next` will return.
+     */
+    size_t next_interval() const { return nextTimestep / nIntegrationSteps; }
+
+    /**
+     * @brief Restart reading from the beginning of the file.
+     */
+    void rewind() { nextTimestep = 0; }
+};
+
+#endif
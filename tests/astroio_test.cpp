@@ -1,7 +1,13 @@
 #include <iostream>
 #include <chrono>
+#include <memory>
+#include <cstdio>
 #include "../src/astroio.hpp"
 #include "../src/utils.hpp"
+#include "../src/voltage_stream.hpp"
+#include "../src/parallel.hpp"
+#include "../src/packed_voltages.hpp"
+#include "../src/voltage_layout.hpp"
 #include "common.hpp"
 
 
@@ -42,6 +48,328 @@ void test_from_dat_file(){
 
 
 
+void test_from_dat_file_mmap(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    auto voltages = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100);
+    auto voltages_mmap = Voltages::from_dat_file_mmap(filename, VCS_OBSERVATION_INFO, 100);
+    if(voltages.size() != voltages_mmap.size())
+        throw TestFailed("test_from_dat_file_mmap: voltage objects are not of the same size.");
+    if(memcmp(voltages.data(), voltages_mmap.data(), voltages.size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("test_from_dat_file_mmap: voltages read with mmap differ from the ifstream ones.");
+    bool thrown {false};
+    try{
+        Voltages::from_dat_file_mmap(filename, VCS_OBSERVATION_INFO, 0);
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("test_from_dat_file_mmap: zero integration steps were accepted.");
+    std::cout << "'test_from_dat_file_mmap' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_parallel(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    // 10000 steps make a single integration interval: exercises the split by timestep.
+    for(unsigned int nIntegrationSteps : {100u, 10000u}){
+        auto reference = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps);
+        auto voltages_parallel = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps, 7);
+        if(memcmp(reference.data(), voltages_parallel.data(), reference.size() * sizeof(std::complex<int8_t>)))
+            throw TestFailed("test_from_dat_file_parallel: voltages read with multiple threads differ from the sequential ones.");
+    }
+    std::cout << "'test_from_dat_file_parallel' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_read_ahead(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    DatReadOptions synchronous;
+    synchronous.queueDepth = 1;
+    auto reference = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100, synchronous);
+    // chunks not aligned to integration intervals and a deeper queue.
+    DatReadOptions readAhead;
+    readAhead.timestepsPerRead = 33;
+    readAhead.queueDepth = 4;
+    auto voltages = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100, readAhead);
+    if(memcmp(reference.data(), voltages.data(), reference.size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("test_from_dat_file_read_ahead: voltages read with read-ahead differ from the synchronous ones.");
+    std::cout << "'test_from_dat_file_read_ahead' passed." << std::endl;
+}
+
+
+
+void test_voltage_stream(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    const unsigned int nIntegrationSteps {1000};
+    auto voltages = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps);
+    VoltageStream stream {filename, VCS_OBSERVATION_INFO, nIntegrationSteps};
+    Voltages interval {stream.allocate_interval()};
+    size_t nIntervals {0};
+    while(stream.read_next(interval)){
+        if(memcmp(voltages.data() + nIntervals * interval.size(), interval.data(), interval.size() * sizeof(std::complex<int8_t>)))
+            throw TestFailed("test_voltage_stream: streamed interval differs from the one read with from_dat_file.");
+        nIntervals++;
+    }
+    if(nIntervals != stream.n_intervals() || nIntervals * interval.size() != voltages.size())
+        throw TestFailed("test_voltage_stream: wrong number of intervals.");
+    std::cout << "'test_voltage_stream' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_selection(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    const unsigned int nIntegrationSteps {100};
+    auto full = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps);
+    const size_t nInputs {static_cast<size_t>(VCS_OBSERVATION_INFO.nAntennas) * VCS_OBSERVATION_INFO.nPolarizations};
+    DatReadOptions options;
+    // The range starts and ends in the middle of integration intervals.
+    options.firstTimestep = 250;
+    options.nTimesteps = 310;
+    options.channels = {100, 3, 64};
+    for(unsigned int nThreads : {1u, 3u}){
+        options.nThreads = nThreads;
+        auto selection = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps, options);
+        if(selection.obsInfo.nTimesteps != options.nTimesteps || selection.obsInfo.nFrequencies != options.channels.size())
+            throw TestFailed("test_from_dat_file_selection: wrong observation information.");
+        for(size_t t {0}; t < options.nTimesteps; t++){
+            const size_t ft {options.firstTimestep + t};
+            for(size_t c {0}; c < options.channels.size(); c++){
+                for(size_t j {0}; j < nInputs; j++){
+                    const auto expected = full.data()[(ft / nIntegrationSteps) * VCS_OBSERVATION_INFO.nFrequencies * nInputs * nIntegrationSteps
+                        + (options.channels[c] * nInputs + j) * nIntegrationSteps + ft % nIntegrationSteps];
+                    const auto value = selection.data()[(t / nIntegrationSteps) * options.channels.size() * nInputs * nIntegrationSteps
+                        + (c * nInputs + j) * nIntegrationSteps + t % nIntegrationSteps];
+                    if(value != expected) throw TestFailed("test_from_dat_file_selection: wrong sample in the selection.");
+                }
+            }
+        }
+    }
+    bool thrown {false};
+    try{
+        Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 0, DatReadOptions {});
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("test_from_dat_file_selection: zero integration steps were accepted.");
+    std::cout << "'test_from_dat_file_selection' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_flagged_channels(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    const unsigned int nIntegrationSteps {100};
+    auto full = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps);
+    const size_t samplesInFrequency {static_cast<size_t>(VCS_OBSERVATION_INFO.nAntennas) * VCS_OBSERVATION_INFO.nPolarizations * nIntegrationSteps};
+    DatReadOptions options;
+    options.flaggedChannels = ChannelMask::edges(VCS_OBSERVATION_INFO.nFrequencies, 8);
+    options.flaggedChannels.flag(64);
+    for(unsigned int nThreads : {1u, 3u}){
+        options.nThreads = nThreads;
+        auto flagged = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps, options);
+        if(flagged.size() != full.size()) throw TestFailed("test_from_dat_file_flagged_channels: wrong number of samples.");
+        for(size_t block {0}; block < full.size() / samplesInFrequency; block++){
+            const unsigned int ch {static_cast<unsigned int>(block % VCS_OBSERVATION_INFO.nFrequencies)};
+            const std::complex<int8_t> *expected {full.data() + block * samplesInFrequency};
+            const std::complex<int8_t> *value {flagged.data() + block * samplesInFrequency};
+            for(size_t i {0}; i < samplesInFrequency; i++){
+                if(value[i] != (options.flaggedChannels.flagged(ch) ? std::complex<int8_t> {0, 0} : expected[i]))
+                    throw TestFailed("test_from_dat_file_flagged_channels: wrong sample in channel " + std::to_string(ch) + ".");
+            }
+        }
+    }
+    bool thrown {false};
+    options.flaggedChannels = ChannelMask {10};
+    try{
+        Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps, options);
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("test_from_dat_file_flagged_channels: a mask of the wrong size was accepted.");
+    std::cout << "'test_from_dat_file_flagged_channels' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_input_mapping(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    const unsigned int nIntegrationSteps {100};
+    auto voltages = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps);
+    const size_t nInputs {static_cast<size_t>(VCS_OBSERVATION_INFO.nAntennas) * VCS_OBSERVATION_INFO.nPolarizations};
+    DatReadOptions options;
+    // A rotation, which is not its own inverse, so that the direction of the mapping is checked.
+    for(size_t j {0}; j < nInputs; j++) options.inputMapping.push_back(static_cast<int>((j + 3) % nInputs));
+    for(unsigned int nThreads : {1u, 3u}){
+        options.nThreads = nThreads;
+        auto mapped = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps, options);
+        for(size_t block {0}; block < voltages.size() / (nInputs * nIntegrationSteps); block++)
+            for(size_t j {0}; j < nInputs; j++)
+                if(memcmp(mapped.data() + (block * nInputs + options.inputMapping[j]) * nIntegrationSteps,
+                        voltages.data() + (block * nInputs + j) * nIntegrationSteps, nIntegrationSteps * sizeof(std::complex<int8_t>)))
+                    throw TestFailed("test_from_dat_file_input_mapping: input mapping not applied.");
+    }
+    bool thrown {false};
+    options.inputMapping[0] = options.inputMapping[2];
+    try{
+        Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps, options);
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("test_from_dat_file_input_mapping: a mapping that is not a permutation was accepted.");
+    std::cout << "'test_from_dat_file_input_mapping' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_flagged_antennas(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    const unsigned int nIntegrationSteps {100};
+    const unsigned int nPols {VCS_OBSERVATION_INFO.nPolarizations};
+    auto voltages = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps);
+    const size_t nInputs {static_cast<size_t>(VCS_OBSERVATION_INFO.nAntennas) * nPols};
+    DatReadOptions options;
+    options.flaggedAntennas.assign(VCS_OBSERVATION_INFO.nAntennas, false);
+    for(unsigned int a : {0u, 17u, 18u, VCS_OBSERVATION_INFO.nAntennas - 1}) options.flaggedAntennas[a] = true;
+    for(unsigned int nThreads : {1u, 3u}){
+        options.nThreads = nThreads;
+        VoltageStatistics stats;
+        auto compacted = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps, options, stats);
+        const ObservationInfo& info {compacted.obsInfo};
+        if(info.nAntennas != VCS_OBSERVATION_INFO.nAntennas - 4 || info.antennaIndices.size() != info.nAntennas
+                || info.antennaIndices[0] != 1 || info.antennaIndices[16] != 19 || stats.nInputs != info.nAntennas * nPols)
+            throw TestFailed("test_from_dat_file_flagged_antennas: wrong antenna selection.");
+        const size_t nKept {static_cast<size_t>(info.nAntennas) * nPols};
+        if(compacted.size() != voltages.size() / nInputs * nKept)
+            throw TestFailed("test_from_dat_file_flagged_antennas: wrong size.");
+        for(size_t block {0}; block < voltages.size() / (nInputs * nIntegrationSteps); block++)
+            for(size_t a {0}; a < info.nAntennas; a++)
+                if(memcmp(compacted.data() + (block * nKept + a * nPols) * nIntegrationSteps,
+                        voltages.data() + (block * nInputs + info.antennaIndices[a] * nPols) * nIntegrationSteps,
+                        nPols * nIntegrationSteps * sizeof(std::complex<int8_t>)))
+                    throw TestFailed("test_from_dat_file_flagged_antennas: flagged antennas not removed.");
+    }
+    std::cout << "'test_from_dat_file_flagged_antennas' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_statistics(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    const unsigned int nIntegrationSteps {100};
+    auto reference = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps);
+    const unsigned int nInputs {VCS_OBSERVATION_INFO.nAntennas * VCS_OBSERVATION_INFO.nPolarizations};
+    DatReadOptions options;
+    VoltageStatistics single;
+    for(unsigned int nThreads : {1u, 3u}){
+        options.nThreads = nThreads;
+        VoltageStatistics stats;
+        auto voltages = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, nIntegrationSteps, options, stats);
+        if(memcmp(reference.data(), voltages.data(), reference.size() * sizeof(std::complex<int8_t>)))
+            throw TestFailed("test_from_dat_file_statistics: collecting statistics changed the voltages.");
+        if(stats.nChannels != VCS_OBSERVATION_INFO.nFrequencies || stats.nInputs != nInputs
+                || stats.nTimesteps[0] != VCS_OBSERVATION_INFO.nTimesteps)
+            throw TestFailed("test_from_dat_file_statistics: statistics have a wrong shape.");
+        if(nThreads == 1){
+            single = stats;
+            continue;
+        }
+        if(stats.power != single.power || stats.histogram != single.histogram)
+            throw TestFailed("test_from_dat_file_statistics: statistics depend on the number of threads.");
+    }
+    // Each sample contributes once to the histograms of its input.
+    for(unsigned int j {0}; j < nInputs; j++){
+        uint64_t total {0};
+        for(int value {-8}; value < 8; value++) total += single.count(j, false, value);
+        if(total != static_cast<uint64_t>(VCS_OBSERVATION_INFO.nTimesteps) * VCS_OBSERVATION_INFO.nFrequencies)
+            throw TestFailed("test_from_dat_file_statistics: wrong histogram totals.");
+    }
+    std::cout << "'test_from_dat_file_statistics' passed." << std::endl;
+}
+
+
+
+void test_to_dat_file(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    const std::string tmpfile {dataRootDir + "/test_to_dat_file.dat.tmp"};
+    const size_t nInputs {static_cast<size_t>(VCS_OBSERVATION_INFO.nAntennas) * VCS_OBSERVATION_INFO.nPolarizations};
+    const size_t nBytes {nInputs * VCS_OBSERVATION_INFO.nFrequencies * VCS_OBSERVATION_INFO.nTimesteps};
+    char *original {nullptr};
+    size_t originalSize {0};
+    read_data_from_file(filename, original, originalSize);
+    std::unique_ptr<char[]> originalOwner {original};
+    DatReadOptions options;
+    for(size_t j {0}; j < nInputs; j++) options.inputMapping.push_back(static_cast<int>(j ^ 1));
+    // The file written back must be identical to the one read, also when an input mapping is undone.
+    for(bool mapped : {false, true}){
+        auto voltages = mapped ? Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100, options)
+            : Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100);
+        voltages.to_dat_file(tmpfile, mapped ? options.inputMapping : std::vector<int> {});
+        char *written {nullptr};
+        size_t writtenSize {0};
+        read_data_from_file(tmpfile, written, writtenSize);
+        std::unique_ptr<char[]> writtenOwner {written};
+        std::remove(tmpfile.c_str());
+        if(writtenSize != nBytes || originalSize < nBytes || memcmp(written, original, nBytes))
+            throw TestFailed("test_to_dat_file: the file written differs from the one read.");
+    }
+    std::cout << "'test_to_dat_file' passed." << std::endl;
+}
+
+
+
+void test_load_dat_files(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    auto reference = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100);
+    // Same file multiple times, to keep memory usage of the test reasonable.
+    std::vector<DatFile> files(3, DatFile {filename, VCS_OBSERVATION_INFO});
+    ThreadPool pool {2};
+    for(unsigned int maxFilesInFlight : {0u, 1u}){
+        auto voltages = load_dat_files(files, 100, pool, maxFilesInFlight);
+        if(voltages.size() != files.size()) throw TestFailed("test_load_dat_files: wrong number of Voltages objects.");
+        for(auto& v : voltages){
+            if(memcmp(reference.data(), v.data(), reference.size() * sizeof(std::complex<int8_t>)))
+                throw TestFailed("test_load_dat_files: voltages loaded concurrently differ from the sequential ones.");
+        }
+    }
+    std::cout << "'test_load_dat_files' passed." << std::endl;
+}
+
+
+
+void test_packed_voltages_from_dat_file(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    auto reference = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100);
+    auto packed = PackedVoltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100);
+    auto unpacked = packed.to_voltages();
+    if(memcmp(reference.data(), unpacked.data(), reference.size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("test_packed_voltages_from_dat_file: unpacked voltages differ from `from_dat_file` ones.");
+    std::cout << "'test_packed_voltages_from_dat_file' passed." << std::endl;
+}
+
+
+
+void test_layout_voltages_from_dat_file(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    auto reference = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100);
+    auto correlator = LayoutVoltages<CorrelatorLayout<VcsDims>>::from_dat_file(filename, VCS_OBSERVATION_INFO, 100);
+    if(memcmp(reference.data(), correlator.data(), reference.size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("test_layout_voltages_from_dat_file: correlator layout differs from `Voltages`.");
+    DatReadOptions options;
+    options.nThreads = 2;
+    auto beamformer = LayoutVoltages<BeamformerLayout<VcsDims>>::from_dat_file(filename, VCS_OBSERVATION_INFO, 100, options);
+    for(size_t t {0}; t < VCS_OBSERVATION_INFO.nTimesteps; t += 97)
+        for(size_t ch {0}; ch < VCS_OBSERVATION_INFO.nFrequencies; ch += 13)
+            for(size_t a {0}; a < VCS_OBSERVATION_INFO.nAntennas; a += 7)
+                for(size_t p {0}; p < VCS_OBSERVATION_INFO.nPolarizations; p++)
+                    if(beamformer.at(t, ch, a, p) != correlator.at(t, ch, a, p))
+                        throw TestFailed("test_layout_voltages_from_dat_file: beamformer layout holds different samples.");
+    std::cout << "'test_layout_voltages_from_dat_file' passed." << std::endl;
+}
+
+
+
 void test_from_memory(){
     char *input_char;
     size_t insize;
@@ -49,11 +377,88 @@ void test_from_memory(){
     ObservationInfo obsInfo {.nAntennas = 128, .nFrequencies = 128, .nPolarizations = 2, .nTimesteps=100};
     int8_t *input_data {reinterpret_cast<int8_t *>(input_char)};
     auto voltages = Voltages::from_memory(input_data, insize, obsInfo, 100);
+    // Sample by sample reordering, as done by the original implementation.
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    for(size_t t {0}; t < obsInfo.nTimesteps; t++){
+        for(size_t ch {0}; ch < obsInfo.nFrequencies; ch++){
+            for(size_t j {0}; j < nInputs; j++){
+                const int8_t *in {input_data + ((t * obsInfo.nFrequencies + ch) * nInputs + j) * 2};
+                const std::complex<int8_t> out {voltages.data()[(ch * nInputs + j) * 100 + t]};
+                if(out.real() != in[0] || out.imag() != in[1])
+                    throw TestFailed("test_from_memory: wrong sample in output.");
+            }
+        }
+    }
+    // Multiple threads splitting the single integration interval.
+    auto voltagesParallel = Voltages::from_memory(input_data, insize, obsInfo, 100, false, 3, true);
+    if(memcmp(voltages.data(), voltagesParallel.data(), voltages.size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("test_from_memory: multithreaded output differs from the single threaded one.");
+    // Inputs in reverse order.
+    std::vector<int> mapping(nInputs);
+    for(size_t j {0}; j < nInputs; j++) mapping[j] = static_cast<int>(nInputs - 1 - j);
+    auto mapped = Voltages::from_memory(input_data, insize, obsInfo, 100, mapping, false, 2);
+    for(size_t ch {0}; ch < obsInfo.nFrequencies; ch++)
+        for(size_t j {0}; j < nInputs; j++)
+            if(memcmp(mapped.data() + (ch * nInputs + mapping[j]) * 100, voltages.data() + (ch * nInputs + j) * 100, 100 * sizeof(std::complex<int8_t>)))
+                throw TestFailed("test_from_memory: input mapping not applied.");
+    delete[] input_char;
     std::cout << "'test_from_memory' passed." << std::endl;
 }
 
 
 
+void test_from_packed_memory(){
+    const std::string filename {dataRootDir + "/offline_correlator/1240826896_1240827191_ch146.dat"};
+    const size_t nInputs {static_cast<size_t>(VCS_OBSERVATION_INFO.nAntennas) * VCS_OBSERVATION_INFO.nPolarizations};
+    const size_t length {nInputs * VCS_OBSERVATION_INFO.nFrequencies * VCS_OBSERVATION_INFO.nTimesteps};
+    char *input;
+    size_t insize;
+    read_data_from_file(filename, input, insize);
+    std::unique_ptr<char[]> inputOwner {input};
+    if(insize < length) throw TestFailed("test_from_packed_memory: the test file is too short.");
+    const uint8_t *packed {reinterpret_cast<const uint8_t*>(input)};
+    auto reference = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100);
+    auto voltages = Voltages::from_packed_memory(packed, length, VCS_OBSERVATION_INFO, 100);
+    if(memcmp(reference.data(), voltages.data(), reference.size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("test_from_packed_memory: voltages differ from the ones read from the file.");
+    // Multiple threads and input mapping give the same result as the file path.
+    DatReadOptions options;
+    for(size_t j {0}; j < nInputs; j++) options.inputMapping.push_back(static_cast<int>(nInputs - 1 - j));
+    auto mappedReference = Voltages::from_dat_file(filename, VCS_OBSERVATION_INFO, 100, options);
+    auto mapped = Voltages::from_packed_memory(packed, length, VCS_OBSERVATION_INFO, 100, options.inputMapping, false, 3);
+    if(memcmp(mappedReference.data(), mapped.data(), mappedReference.size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("test_from_packed_memory: wrong multithreaded expansion with input mapping.");
+    bool thrown {false};
+    try{
+        Voltages::from_packed_memory(packed, length - 1, VCS_OBSERVATION_INFO, 100);
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("test_from_packed_memory: a buffer of the wrong size was accepted.");
+    std::cout << "'test_from_packed_memory' passed." << std::endl;
+}
+
+
+
+void test_from_eda2_file(){
+    // The xGPU input has the same format as an EDA2 binary dump: 8+8 bit samples in [time][channel][station][pol].
+    const std::string filename {dataRootDir + "/xGPU/input_array_128_128_128_100.bin"};
+    char *input_char;
+    size_t insize;
+    read_data_from_file(filename, input_char, insize);
+    ObservationInfo obsInfo {.nAntennas = 128, .nFrequencies = 128, .nPolarizations = 2, .nTimesteps=100};
+    auto expected = Voltages::from_memory(reinterpret_cast<int8_t *>(input_char), insize, obsInfo, 100);
+    delete[] input_char;
+    for(unsigned int nThreads : {1u, 4u}){
+        auto voltages = Voltages::from_eda2_file(filename, obsInfo, 100, nThreads);
+        if(memcmp(expected.data(), voltages.data(), expected.size() * sizeof(std::complex<int8_t>)))
+            throw TestFailed("test_from_eda2_file: voltages differ from the ones obtained with `from_memory`.");
+    }
+    std::cout << "'test_from_eda2_file' passed." << std::endl;
+}
+
+
+
 void test_simply_writing_and_reading_fits_file(){
     ObservationInfo obsInfo;
     obsInfo.nAntennas = 128;
@@ -100,7 +505,22 @@ int main(void){
     dataRootDir = std::string {pathToData};
     try{
         test_from_dat_file();
+        test_from_dat_file_mmap();
+        test_from_dat_file_parallel();
+        test_from_dat_file_read_ahead();
+        test_voltage_stream();
+        test_from_dat_file_selection();
+        test_from_dat_file_flagged_channels();
+        test_from_dat_file_input_mapping();
+        test_from_dat_file_flagged_antennas();
+        test_from_dat_file_statistics();
+        test_to_dat_file();
+        test_load_dat_files();
+        test_packed_voltages_from_dat_file();
+        test_layout_voltages_from_dat_file();
         test_from_memory();
+        test_from_packed_memory();
+        test_from_eda2_file();
         test_simply_writing_and_reading_fits_file();
     } catch (std::exception& ex){
         std::cerr << ex.what() << std::endl;
@@ -3,6 +3,10 @@
 
 #include <exception>
 #include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include "../src/voltage_expansion.hpp"
 
 #define ENV_DATA_ROOT_DIR "BLINK_TEST_DATADIR"
 
@@ -16,4 +20,27 @@ class TestFailed : public std::exception {
 };
 
 
+/**
+ * @brief `n` random bytes, always the same ones for a given `n`, e.g. packed 4+4 bit samples.
+ */
+inline std::vector<uint8_t> random_bytes(size_t n){
+    std::mt19937 gen {1234};
+    std::uniform_int_distribution<int> dist {0, 255};
+    std::vector<uint8_t> bytes(n);
+    for(auto& b : bytes) b = static_cast<uint8_t>(dist(gen));
+    return bytes;
+}
+
+
+/**
+ * @brief SIMD levels supported by the CPU running the tests, the scalar one included.
+ */
+inline std::vector<SimdLevel> levels_to_test(){
+    std::vector<SimdLevel> levels;
+    for(auto level : {SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512})
+        if(level <= detect_simd_level()) levels.push_back(level);
+    return levels;
+}
+
+
 #endif
\ No newline at end of file
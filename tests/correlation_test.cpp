@@ -0,0 +1,156 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <complex>
+#include <random>
+#include <cmath>
+#include "common.hpp"
+#include "../src/astroio.hpp"
+#include "../src/correlation.hpp"
+
+
+namespace {
+    /**
+     * Voltages of random samples in [-maxValue, maxValue], and -128 if `maxValue` is 128.
+     */
+    Voltages random_voltages(unsigned int nAntennas, unsigned int nFrequencies, size_t nTimesteps, unsigned int nIntegrationSteps,
+            int maxValue, unsigned int seed){
+        ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+        obsInfo.nAntennas = nAntennas;
+        obsInfo.nFrequencies = nFrequencies;
+        obsInfo.nPolarizations = 2;
+        obsInfo.nTimesteps = nTimesteps;
+        const size_t nIntervals {(nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+        const size_t nSamples {nIntervals * nFrequencies * nAntennas * 2 * nIntegrationSteps};
+        MemoryBuffer<std::complex<int8_t>> buffer {nSamples};
+        std::mt19937 gen {seed};
+        std::uniform_int_distribution<int> dist {-maxValue, std::min(maxValue, 127)};
+        for(size_t i {0}; i < nSamples; i++)
+            buffer.data()[i] = {static_cast<int8_t>(dist(gen)), static_cast<int8_t>(dist(gen))};
+        // padding of the last interval.
+        for(size_t i {0}; i < nSamples; i++)
+            if((nTimesteps % nIntegrationSteps) != 0 && i / (nSamples / nIntervals) == nIntervals - 1
+                    && i % nIntegrationSteps >= nTimesteps % nIntegrationSteps)
+                buffer.data()[i] = {0, 0};
+        return Voltages {std::move(buffer), obsInfo, nIntegrationSteps};
+    }
+
+
+    /**
+     * Straightforward correlation of `voltages`, with samples of -128 saturated to -127.
+     */
+    std::complex<double> reference_visibility(const Voltages& voltages, size_t interval, unsigned int outChannel,
+            unsigned int nAveraged, unsigned int a1, unsigned int p1, unsigned int a2, unsigned int p2){
+        const ObservationInfo& obsInfo {voltages.obsInfo};
+        const size_t nSteps {voltages.nIntegrationSteps};
+        const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+        auto saturate = [](std::complex<int8_t> v){
+            return std::complex<double> {static_cast<double>(std::max<int>(v.real(), -127)), static_cast<double>(std::max<int>(v.imag(), -127))};
+        };
+        std::complex<double> sum {0, 0};
+        for(unsigned int c {0}; c < nAveraged; c++){
+            const size_t channel {outChannel * nAveraged + c};
+            const std::complex<int8_t> *rows {voltages.data() + (interval * obsInfo.nFrequencies + channel) * nInputs * nSteps};
+            const std::complex<int8_t> *x {rows + (a1 * obsInfo.nPolarizations + p1) * nSteps};
+            const std::complex<int8_t> *y {rows + (a2 * obsInfo.nPolarizations + p2) * nSteps};
+            for(size_t t {0}; t < nSteps; t++) sum += saturate(x[t]) * std::conj(saturate(y[t]));
+        }
+        const size_t validSteps {std::min(nSteps, obsInfo.nTimesteps - interval * nSteps)};
+        return sum / static_cast<double>(validSteps * nAveraged);
+    }
+
+
+    void check_visibilities(const std::string& testName, const Voltages& voltages, Visibilities& visibilities,
+            unsigned int nAveraged, const std::string& configuration){
+        const ObservationInfo& obsInfo {voltages.obsInfo};
+        for(size_t interval {0}; interval < visibilities.integration_intervals(); interval++){
+            for(unsigned int ch {0}; ch < visibilities.nFrequencies; ch++){
+                for(unsigned int a1 {0}; a1 < obsInfo.nAntennas; a1++){
+                    for(unsigned int a2 {0}; a2 <= a1; a2++){
+                        for(unsigned int p1 {0}; p1 < obsInfo.nPolarizations; p1++){
+                            for(unsigned int p2 {0}; p2 < obsInfo.nPolarizations; p2++){
+                                const std::complex<double> expected {reference_visibility(voltages, interval, ch, nAveraged, a1, p1, a2, p2)};
+                                const std::complex<float> value {visibilities.at(interval, ch, a1, a2)[p1 * obsInfo.nPolarizations + p2]};
+                                if(std::abs(std::complex<double> {value} - expected) > 1e-5 * std::max(1.0, std::abs(expected))){
+                                    std::stringstream ss;
+                                    ss << "'" << testName << "' failed: wrong visibility of interval " << interval << ", channel " << ch
+                                        << ", baseline (" << a1 << ", " << p1 << ") x (" << a2 << ", " << p2 << ") with " << configuration
+                                        << ": " << value << " instead of " << expected << ".";
+                                    throw TestFailed(ss.str());
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+
+void test_correlate(){
+    // 7 antennas make tiles straddle antennas; the last interval is partially filled.
+    const Voltages voltages {random_voltages(7, 6, 250, 100, 128, 11)};
+    for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}){
+        for(unsigned int nAveraged : {1u, 3u}){
+            for(unsigned int nThreads : {1u, 4u}){
+                CorrelationOptions options;
+                options.nThreads = nThreads;
+                options.nAveragedChannels = nAveraged;
+                Visibilities visibilities {correlate(voltages, options, level)};
+                if(visibilities.integration_intervals() != 3 || visibilities.nFrequencies != 6 / nAveraged)
+                    throw TestFailed("'test_correlate' failed: wrong shape of the visibilities.");
+                std::stringstream configuration;
+                configuration << "the " << correlation_kernel_name(level) << " kernel, " << nAveraged << " averaged channels, "
+                    << nThreads << " threads";
+                check_visibilities("test_correlate", voltages, visibilities, nAveraged, configuration.str());
+            }
+        }
+    }
+    std::cout << "'test_correlate' passed." << std::endl;
+}
+
+
+
+void test_correlate_long_intervals(){
+    // Intervals longer than the chunks accumulated in 32-bit integers, with full scale samples.
+    const Voltages voltages {random_voltages(3, 1, 40000, 40000, 127, 5)};
+    for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2, SimdLevel::AVX512}){
+        Visibilities visibilities {correlate(voltages, CorrelationOptions {}, level)};
+        check_visibilities("test_correlate_long_intervals", voltages, visibilities, 1,
+            std::string {"the "} + correlation_kernel_name(level) + " kernel");
+    }
+    std::cout << "'test_correlate_long_intervals' passed." << std::endl;
+}
+
+
+
+void test_correlate_errors(){
+    const Voltages voltages {random_voltages(2, 6, 100, 100, 8, 3)};
+    CorrelationOptions options;
+    options.nAveragedChannels = 4;
+    bool thrown {false};
+    try{
+        correlate(voltages, options);
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("'test_correlate_errors' failed: averaging not dividing the channels accepted.");
+    std::cout << "'test_correlate_errors' passed." << std::endl;
+}
+
+
+
+int main(void){
+    try{
+        test_correlate();
+        test_correlate_long_intervals();
+        test_correlate_errors();
+    } catch (std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <complex>
+#include <cstdio>
+#include "common.hpp"
+#include "../src/astroio.hpp"
+#include "../src/eda2_hdf5.hpp"
+
+#ifdef ASTROIO_USE_HDF5
+#include <hdf5.h>
+#endif
+
+
+std::string dataRootDir;
+
+
+#ifdef ASTROIO_USE_HDF5
+
+namespace {
+    const size_t N_TIMESTEPS {203};
+
+
+    ObservationInfo small_eda2_info(unsigned int nFrequencies){
+        ObservationInfo obsInfo {EDA2_OBSERVATION_INFO};
+        obsInfo.nAntennas = 5;
+        obsInfo.nPolarizations = 2;
+        obsInfo.nFrequencies = nFrequencies;
+        obsInfo.nTimesteps = N_TIMESTEPS;
+        return obsInfo;
+    }
+
+
+    // The content of the dataset, as [time][channel][station][polarization] 8+8 bit samples.
+    std::vector<int8_t> dump_samples(const ObservationInfo& obsInfo){
+        std::vector<int8_t> samples(N_TIMESTEPS * obsInfo.nFrequencies * obsInfo.nAntennas * obsInfo.nPolarizations * 2);
+        for(size_t i {0}; i < samples.size(); i++) samples[i] = static_cast<int8_t>(i * 13 + i / 7);
+        return samples;
+    }
+
+
+    /**
+     * Write `samples` to the dataset "chan_/data" of a new file, with the shape [time][channel][station][pol]
+     * or, for a single channel, [time][station][pol]. `chunkTimesteps` equal to zero gives a contiguous dataset.
+     */
+    void write_hdf5_file(const std::string& filename, const ObservationInfo& obsInfo, const std::vector<int8_t>& samples,
+            hsize_t chunkTimesteps, hsize_t chunkAntennas, bool compress){
+        std::vector<hsize_t> dims {N_TIMESTEPS};
+        if(obsInfo.nFrequencies > 1) dims.push_back(obsInfo.nFrequencies);
+        dims.push_back(obsInfo.nAntennas);
+        dims.push_back(obsInfo.nPolarizations);
+        hid_t file {H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT)};
+        hid_t group {H5Gcreate2(file, "chan_", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)};
+        hid_t type {H5Tcreate(H5T_COMPOUND, 2)};
+        H5Tinsert(type, "real", 0, H5T_NATIVE_INT8);
+        H5Tinsert(type, "imag", 1, H5T_NATIVE_INT8);
+        hid_t space {H5Screate_simple(static_cast<int>(dims.size()), dims.data(), nullptr)};
+        hid_t plist {H5Pcreate(H5P_DATASET_CREATE)};
+        if(chunkTimesteps > 0){
+            std::vector<hsize_t> chunk {dims};
+            chunk[0] = chunkTimesteps;
+            chunk[dims.size() - 2] = chunkAntennas;
+            H5Pset_chunk(plist, static_cast<int>(chunk.size()), chunk.data());
+            if(compress) H5Pset_deflate(plist, 4);
+        }
+        hid_t dataset {H5Dcreate2(group, "data", type, space, H5P_DEFAULT, plist, H5P_DEFAULT)};
+        if(dataset < 0) throw TestFailed("write_hdf5_file: cannot create the dataset.");
+        H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, samples.data());
+        H5Dclose(dataset);
+        H5Pclose(plist);
+        H5Sclose(space);
+        H5Tclose(type);
+        H5Gclose(group);
+        H5Fclose(file);
+    }
+}
+
+
+
+void test_eda2_hdf5_file(){
+    const std::string filename {dataRootDir + "/eda2_hdf5_test.h5.tmp"};
+    const ObservationInfo obsInfo {small_eda2_info(3)};
+    write_hdf5_file(filename, obsInfo, dump_samples(obsInfo), 16, 2, false);
+    Eda2Hdf5File file {filename, "chan_/data", obsInfo};
+    if(file.n_timesteps() != N_TIMESTEPS || file.chunk_timesteps() != 16 || file.chunk_antennas() != 2)
+        throw TestFailed("'test_eda2_hdf5_file' failed: wrong dataset extents.");
+    // A hyperslab holds the selected stations only.
+    std::vector<std::complex<int8_t>> slab(4 * 3 * 2 * 2);
+    file.read(10, 4, 3, 2, slab.data());
+    const std::vector<int8_t> samples {dump_samples(obsInfo)};
+    const auto *expected = reinterpret_cast<const std::complex<int8_t>*>(samples.data());
+    for(size_t t {0}; t < 4; t++)
+        for(size_t ch {0}; ch < 3; ch++)
+            for(size_t i {0}; i < 4; i++)
+                if(slab[(t * 3 + ch) * 4 + i] != expected[((10 + t) * 3 + ch) * 10 + 6 + i])
+                    throw TestFailed("'test_eda2_hdf5_file' failed: wrong samples in the hyperslab.");
+
+    bool thrown {false};
+    try{
+        Eda2Hdf5File {filename, "chan_/data", small_eda2_info(2)};
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("'test_eda2_hdf5_file' failed: mismatching observation accepted.");
+    thrown = false;
+    try{
+        Eda2Hdf5File {filename, "missing/data", obsInfo};
+    }catch(const std::runtime_error&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("'test_eda2_hdf5_file' failed: missing dataset accepted.");
+    std::remove(filename.c_str());
+    std::cout << "'test_eda2_hdf5_file' passed." << std::endl;
+}
+
+
+
+void test_from_eda2_hdf5_file(){
+    const std::string filename {dataRootDir + "/eda2_hdf5_test.h5.tmp"};
+    const unsigned int nIntegrationSteps {20};
+    struct Layout { unsigned int nFrequencies; hsize_t chunkTimesteps, chunkAntennas; bool compress; };
+    struct Selection { size_t firstTimestep, nTimesteps; unsigned int nThreads; };
+    for(const Layout& layout : {Layout {3, 16, 2, false}, Layout {1, 0, 0, false}, Layout {2, 50, 5, true}, Layout {1, 7, 3, true}}){
+        const ObservationInfo obsInfo {small_eda2_info(layout.nFrequencies)};
+        const std::vector<int8_t> samples {dump_samples(obsInfo)};
+        write_hdf5_file(filename, obsInfo, samples, layout.chunkTimesteps, layout.chunkAntennas, layout.compress);
+        const size_t bytesPerTimestep {samples.size() / N_TIMESTEPS};
+        for(const Selection& s : {Selection {0, 0, 1}, Selection {0, 0, 3}, Selection {9, 100, 2}, Selection {150, 500, 4}}){
+            Eda2ReadOptions options;
+            options.firstTimestep = s.firstTimestep;
+            options.nTimesteps = s.nTimesteps;
+            options.nThreads = s.nThreads;
+            options.timestepsPerRead = 64;
+            auto voltages = Voltages::from_eda2_hdf5_file(filename, obsInfo, nIntegrationSteps, options);
+            const size_t nTimesteps {s.nTimesteps > 0 ? std::min(s.nTimesteps, N_TIMESTEPS - s.firstTimestep) : N_TIMESTEPS - s.firstTimestep};
+            ObservationInfo sliceInfo {obsInfo};
+            sliceInfo.nTimesteps = nTimesteps;
+            auto reference = Voltages::from_memory(samples.data() + s.firstTimestep * bytesPerTimestep, nTimesteps * bytesPerTimestep,
+                sliceInfo, nIntegrationSteps);
+            if(voltages.obsInfo.nTimesteps != nTimesteps || voltages.size() != reference.size())
+                throw TestFailed("'test_from_eda2_hdf5_file' failed: wrong number of timesteps.");
+            for(size_t i {0}; i < reference.size(); i++){
+                if(voltages.data()[i] != reference.data()[i]){
+                    std::stringstream ss;
+                    ss << "'test_from_eda2_hdf5_file' failed: wrong sample at position " << i << " with " << layout.nFrequencies
+                        << " channels and chunks of " << layout.chunkTimesteps << " timesteps, reading from timestep "
+                        << s.firstTimestep << " with " << s.nThreads << " threads.";
+                    throw TestFailed(ss.str());
+                }
+            }
+            // Samples of other types are converted one station chunk at a time.
+            auto floatVoltages = BasicVoltages<float>::from_eda2_hdf5_file(filename, obsInfo, nIntegrationSteps, options);
+            for(size_t i {0}; i < reference.size(); i++)
+                if(floatVoltages.data()[i] != std::complex<float> {static_cast<float>(reference.data()[i].real()),
+                        static_cast<float>(reference.data()[i].imag())})
+                    throw TestFailed("'test_from_eda2_hdf5_file' failed: wrong float sample at position " + std::to_string(i) + ".");
+        }
+    }
+    std::remove(filename.c_str());
+    std::cout << "'test_from_eda2_hdf5_file' passed." << std::endl;
+}
+
+#endif
+
+
+
+int main(void){
+    char *pathToData {std::getenv(ENV_DATA_ROOT_DIR)};
+    if(!pathToData){
+        std::cerr << "'" << ENV_DATA_ROOT_DIR << "' environment variable is not set." << std::endl;
+        return -1;
+    }
+    dataRootDir = std::string{pathToData};
+#ifdef ASTROIO_USE_HDF5
+    try{
+        test_eda2_hdf5_file();
+        test_from_eda2_hdf5_file();
+    } catch (std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed." << std::endl;
+#else
+    if(eda2_hdf5_available()) throw TestFailed("HDF5 support reported in a build without it.");
+    std::cout << "Built without HDF5 support, tests skipped." << std::endl;
+#endif
+    return 0;
+}
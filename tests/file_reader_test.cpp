@@ -0,0 +1,74 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include "common.hpp"
+#include "../src/file_reader.hpp"
+
+
+std::string dataRootDir;
+
+
+namespace {
+    std::vector<uint8_t> write_test_file(const std::string& filename, size_t size){
+        std::vector<uint8_t> content(size);
+        for(size_t i {0}; i < size; i++) content[i] = static_cast<uint8_t>((i * 31 + 7) % 251);
+        std::ofstream out {filename, std::ios::binary};
+        out.write(reinterpret_cast<char*>(content.data()), size);
+        return content;
+    }
+}
+
+
+
+void test_read_backends(){
+    // A size which is not a multiple of the O_DIRECT alignment.
+    const std::string filename {dataRootDir + "/file_reader_test.bin.tmp"};
+    auto content = write_test_file(filename, 3 * 1024 * 1024 + 1234);
+    for(auto backend : {ReadBackend::BUFFERED, ReadBackend::DIRECT, ReadBackend::IO_URING}){
+        auto reader = open_file_reader(filename, backend);
+        if(reader->size() != content.size()) throw TestFailed("test_read_backends: wrong file size.");
+        // unaligned random access reads.
+        std::vector<uint8_t> buffer(10000);
+        for(size_t offset : {size_t {0}, size_t {1}, size_t {4095}, size_t {65536}, content.size() - buffer.size()}){
+            reader->read(buffer.data(), buffer.size(), offset);
+            if(memcmp(buffer.data(), content.data() + offset, buffer.size()))
+                throw TestFailed(std::string {"test_read_backends: read() returned wrong data with "} + read_backend_name(backend));
+        }
+        // unaligned chunked reads.
+        for(unsigned int queueDepth : {1u, 3u}){
+            std::vector<uint8_t> output(content.size() - 100);
+            size_t expectedOffset {0};
+            reader->read_chunks(100, output.size(), 100000, queueDepth, [&](size_t offset, const uint8_t *data, size_t size){
+                if(offset != expectedOffset) throw TestFailed("test_read_backends: chunks out of order.");
+                memcpy(output.data() + offset, data, size);
+                expectedOffset += size;
+            });
+            if(expectedOffset != output.size() || memcmp(output.data(), content.data() + 100, output.size()))
+                throw TestFailed(std::string {"test_read_backends: read_chunks() returned wrong data with "} + read_backend_name(backend));
+        }
+    }
+    std::remove(filename.c_str());
+    std::cout << "'test_read_backends' passed." << std::endl;
+}
+
+
+
+int main(void){
+    char *pathToData {std::getenv(ENV_DATA_ROOT_DIR)};
+    if(!pathToData){
+        std::cerr << "'" << ENV_DATA_ROOT_DIR << "' environment variable is not set." << std::endl;
+        return -1;
+    }
+    dataRootDir = std::string{pathToData};
+    try{
+        test_read_backends();
+    } catch (std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
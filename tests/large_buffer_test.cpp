@@ -0,0 +1,117 @@
+/**
+ * Tests of indexing past 2^31 elements and 4 GiB. Buffers are allocated without being initialised, so
+ * that only the few pages actually addressed are committed: the tests need about 4 GiB of address space
+ * but only a few MiB of memory.
+ */
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <complex>
+#include <cstring>
+#include "common.hpp"
+#include "../src/astroio.hpp"
+#include "../src/memory_buffer.hpp"
+#include "../src/voltage_expansion.hpp"
+
+
+namespace {
+    const size_t FOUR_GIB {size_t {1} << 32};
+}
+
+
+
+void test_memory_buffer_indexing(){
+    MemoryBuffer<uint8_t> buffer {FOUR_GIB + 4096};
+    for(size_t i : {size_t {0}, (size_t {1} << 31) + 3, FOUR_GIB + 17, buffer.size() - 1}){
+        buffer[i] = static_cast<uint8_t>(i % 251);
+        if(&buffer[i] != buffer.data() + i || buffer.data()[i] != i % 251)
+            throw TestFailed("'test_memory_buffer_indexing' failed: wrong element addressed.");
+    }
+    const MemoryBuffer<uint8_t>& constBuffer {buffer};
+    if(&constBuffer[FOUR_GIB + 17] != buffer.data() + FOUR_GIB + 17)
+        throw TestFailed("'test_memory_buffer_indexing' failed: wrong element addressed by the const operator.");
+    std::cout << "'test_memory_buffer_indexing' passed." << std::endl;
+}
+
+
+
+void test_expansion_past_2g_samples(){
+    // A MWA VCS coarse channel: one integration interval holds 3.2 M samples.
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    const unsigned int nIntegrationSteps {100};
+    const size_t samplesInTimeInterval {static_cast<size_t>(obsInfo.nFrequencies) * obsInfo.nAntennas * obsInfo.nPolarizations
+        * nIntegrationSteps};
+    const size_t bytesPerTimestep {samplesInTimeInterval / nIntegrationSteps};
+    // Enough intervals for the last one to start past 2^31 complex samples, i.e. 4 GiB.
+    const size_t nIntervals {(size_t {1} << 31) / samplesInTimeInterval + 2};
+    obsInfo.nTimesteps = nIntervals * nIntegrationSteps;
+    MemoryBuffer<uint8_t> buffer {nIntervals * samplesInTimeInterval * sizeof(std::complex<int8_t>)};
+    std::complex<int8_t> *output {reinterpret_cast<std::complex<int8_t>*>(buffer.data())};
+
+    std::vector<uint8_t> input(nIntegrationSteps * bytesPerTimestep);
+    std::mt19937 gen {1234};
+    for(auto& b : input) b = static_cast<uint8_t>(gen());
+    ObservationInfo oneInterval {obsInfo};
+    oneInterval.nTimesteps = nIntegrationSteps;
+    std::vector<std::complex<int8_t>> expected(samplesInTimeInterval);
+    expand_dat_timesteps(input.data(), 0, nIntegrationSteps, oneInterval, nIntegrationSteps, ChannelMask {}, expected.data());
+
+    // The last interval starts past 2^31 samples.
+    const size_t lastInterval {nIntervals - 1};
+    if(lastInterval * samplesInTimeInterval <= (size_t {1} << 31))
+        throw TestFailed("'test_expansion_past_2g_samples' failed: the output is too small.");
+    for(auto level : levels_to_test()){
+        memset(output + lastInterval * samplesInTimeInterval, 0, samplesInTimeInterval * sizeof(std::complex<int8_t>));
+        expand_dat_timesteps(input.data(), lastInterval * nIntegrationSteps, nIntegrationSteps, obsInfo, nIntegrationSteps,
+            ChannelMask {}, output, level);
+        if(memcmp(output + lastInterval * samplesInTimeInterval, expected.data(), samplesInTimeInterval * sizeof(std::complex<int8_t>))){
+            std::stringstream ss;
+            ss << "'test_expansion_past_2g_samples' failed: wrong expansion with " << simd_level_name(level) << ".";
+            throw TestFailed(ss.str());
+        }
+    }
+    std::cout << "'test_expansion_past_2g_samples' passed." << std::endl;
+}
+
+
+
+void test_large_observation_sizes(){
+    // More timesteps and baselines than 32-bit products can count.
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nTimesteps = 3 * FOUR_GIB;
+    obsInfo.nFrequencies = 1;
+    MemoryBuffer<std::complex<int8_t>> small {1};
+    Voltages voltages {std::move(small), obsInfo, 100};
+    if(voltages.size() != 3 * FOUR_GIB * obsInfo.nAntennas * obsInfo.nPolarizations)
+        throw TestFailed("'test_large_observation_sizes' failed: wrong number of voltage samples.");
+
+    obsInfo.nAntennas = 70000;
+    obsInfo.nTimesteps = 100;
+    MemoryBuffer<std::complex<float>> smallVis {1};
+    Visibilities visibilities {std::move(smallVis), obsInfo, 100, 1};
+    const size_t nBaselines {size_t {70000} * 70001 / 2};
+    if(visibilities.matrix_size() != nBaselines * 4)
+        throw TestFailed("'test_large_observation_sizes' failed: wrong matrix size.");
+    // Offset, from the beginning of the array, of the last baseline.
+    const std::ptrdiff_t offset {visibilities.at(0, 0, 69999, 69999) - visibilities.data()};
+    if(offset != static_cast<std::ptrdiff_t>((nBaselines - 1) * 4))
+        throw TestFailed("'test_large_observation_sizes' failed: wrong visibility offset.");
+    std::cout << "'test_large_observation_sizes' passed." << std::endl;
+}
+
+
+
+int main(void){
+    try{
+        test_memory_buffer_indexing();
+        test_expansion_past_2g_samples();
+        test_large_observation_sizes();
+    } catch (TestFailed ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
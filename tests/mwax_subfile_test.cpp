@@ -0,0 +1,157 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <complex>
+#include <cstring>
+#include <cstdio>
+#include "common.hpp"
+#include "../src/astroio.hpp"
+#include "../src/mwax_subfile.hpp"
+
+
+std::string dataRootDir;
+
+
+namespace {
+    // A small subfile: 3 tiles, 8 blocks of 100 samples, 800 samples in total.
+    const size_t N_INPUTS {6}, SAMPLES_PER_BLOCK {100}, N_BLOCKS {8};
+
+
+    std::string subfile_header(const std::string& extra = ""){
+        std::stringstream ss;
+        ss << "HDR_SIZE 4096\nPOPULATED 1\nOBS_ID 1324440018\nSUBOBS_ID 1324440026\nMODE MWAX_VCS\n"
+            << "OBS_OFFSET 8\nNBIT 8\nNPOL 2\nNTIMESAMPLES " << SAMPLES_PER_BLOCK << "\nNINPUTS " << N_INPUTS << "\n"
+            << "COARSE_CHANNEL 169\nCORR_COARSE_CHANNEL 12\nSECS_PER_SUBOBS 8\nUNIXTIME 1640491207\n"
+            << "BANDWIDTH_HZ 1280000\nSAMPLE_RATE 100\nMWAX_SUB_VER 2\n" << extra;
+        return ss.str();
+    }
+
+
+    // Value of a sample, unique for each input and timestep of the subfile (modulo 256).
+    std::complex<int8_t> sample(size_t input, size_t ts){
+        return {static_cast<int8_t>(ts * 7 + input), static_cast<int8_t>(ts / 3 - input * 11)};
+    }
+
+
+    void write_subfile(const std::string& filename, const std::string& header, size_t nBlocks = N_BLOCKS){
+        std::vector<char> content(4096, 0);
+        memcpy(content.data(), header.data(), header.size());
+        // the delay block, whose content is ignored.
+        content.resize(content.size() + N_INPUTS * SAMPLES_PER_BLOCK * 2, 0x55);
+        for(size_t b {0}; b < nBlocks; b++)
+            for(size_t input {0}; input < N_INPUTS; input++)
+                for(size_t s {0}; s < SAMPLES_PER_BLOCK; s++){
+                    auto value = sample(input, b * SAMPLES_PER_BLOCK + s);
+                    content.push_back(static_cast<char>(value.real()));
+                    content.push_back(static_cast<char>(value.imag()));
+                }
+        std::ofstream out {filename, std::ios::binary};
+        out.write(content.data(), content.size());
+    }
+}
+
+
+
+void test_parse_subfile_header(){
+    const std::string header {subfile_header()};
+    SubfileInfo info {parse_subfile_header(header.data(), header.size())};
+    const ObservationInfo& obsInfo {info.obsInfo};
+    if(info.headerBytes != 4096 || info.samplesPerBlock != SAMPLES_PER_BLOCK || info.nBlocks != N_BLOCKS
+            || info.block_bytes() != N_INPUTS * SAMPLES_PER_BLOCK * 2 || info.header.at("MODE") != "MWAX_VCS")
+        throw TestFailed("'test_parse_subfile_header' failed: wrong block structure.");
+    if(obsInfo.nAntennas != 3 || obsInfo.nPolarizations != 2 || obsInfo.nFrequencies != 1 || obsInfo.nTimesteps != 800
+            || obsInfo.timeResolution != 0.01 || obsInfo.coarseChannelBandwidth != 1.28 || obsInfo.startTime != 1640491207
+            || obsInfo.coarseChannel != 169 || obsInfo.coarse_channel_index != 11 || obsInfo.id != "1324440018"
+            || obsInfo.telescope != TelescopeID::MWA3)
+        throw TestFailed("'test_parse_subfile_header' failed: wrong observation information.");
+
+    for(const std::string bad : {std::string {"NBIT 4\n"}, std::string {"NINPUTS 5\n"}, std::string {"NTIMESAMPLES 30\n"},
+            std::string {"SAMPLE_RATE abc\n"}}){
+        // later entries replace earlier ones.
+        const std::string badHeader {subfile_header(bad)};
+        bool thrown {false};
+        try{
+            parse_subfile_header(badHeader.data(), badHeader.size());
+        }catch(const std::invalid_argument&){
+            thrown = true;
+        }
+        if(!thrown) throw TestFailed("'test_parse_subfile_header' failed: invalid header accepted: " + bad);
+    }
+    std::cout << "'test_parse_subfile_header' passed." << std::endl;
+}
+
+
+
+void test_from_sub_file(){
+    const std::string filename {dataRootDir + "/mwax_subfile_test.sub.tmp"};
+    write_subfile(filename, subfile_header());
+    const unsigned int nIntegrationSteps {30};
+    std::vector<int> reversed(N_INPUTS);
+    for(size_t i {0}; i < N_INPUTS; i++) reversed[i] = static_cast<int>(N_INPUTS - 1 - i);
+    struct Case { size_t firstBlock, nBlocks; unsigned int nThreads; bool mapped; };
+    for(const Case& c : {Case {0, 0, 1, false}, Case {0, 0, 3, true}, Case {3, 2, 2, false}, Case {6, 10, 4, true}}){
+        SubfileReadOptions options;
+        options.firstBlock = c.firstBlock;
+        options.nBlocks = c.nBlocks;
+        options.nThreads = c.nThreads;
+        if(c.mapped) options.inputMapping = reversed;
+        auto voltages = Voltages::from_sub_file(filename, nIntegrationSteps, options);
+        const size_t nBlocks {c.nBlocks > 0 ? std::min(c.nBlocks, N_BLOCKS - c.firstBlock) : N_BLOCKS - c.firstBlock};
+        if(voltages.obsInfo.nTimesteps != nBlocks * SAMPLES_PER_BLOCK || voltages.nIntegrationSteps != nIntegrationSteps)
+            throw TestFailed("'test_from_sub_file' failed: wrong number of timesteps.");
+        const size_t nIntervals {(voltages.obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+        for(size_t ts {0}; ts < nIntervals * nIntegrationSteps; ts++){
+            for(size_t input {0}; input < N_INPUTS; input++){
+                const size_t row {c.mapped ? N_INPUTS - 1 - input : input};
+                const std::complex<int8_t> value {voltages.data()[(ts / nIntegrationSteps) * N_INPUTS * nIntegrationSteps
+                    + row * nIntegrationSteps + ts % nIntegrationSteps]};
+                const std::complex<int8_t> expected {ts < voltages.obsInfo.nTimesteps ?
+                    sample(input, c.firstBlock * SAMPLES_PER_BLOCK + ts) : std::complex<int8_t> {0, 0}};
+                if(value != expected){
+                    std::stringstream ss;
+                    ss << "'test_from_sub_file' failed: wrong sample of input " << input << " at timestep " << ts
+                        << " when reading from block " << c.firstBlock << " with " << c.nThreads << " threads.";
+                    throw TestFailed(ss.str());
+                }
+            }
+        }
+    }
+    // Other sample types hold the same values.
+    auto floatVoltages = BasicVoltages<float>::from_sub_file(filename, nIntegrationSteps);
+    if(floatVoltages.data()[N_INPUTS * nIntegrationSteps + 1] != std::complex<float> {static_cast<float>(sample(0, 31).real()),
+            static_cast<float>(sample(0, 31).imag())})
+        throw TestFailed("'test_from_sub_file' failed: wrong float samples.");
+
+    // A subfile missing some blocks is rejected.
+    write_subfile(filename, subfile_header(), N_BLOCKS - 1);
+    bool thrown {false};
+    try{
+        Voltages::from_sub_file(filename, nIntegrationSteps);
+    }catch(const std::runtime_error&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("'test_from_sub_file' failed: truncated subfile accepted.");
+    std::remove(filename.c_str());
+    std::cout << "'test_from_sub_file' passed." << std::endl;
+}
+
+
+
+int main(void){
+    char *pathToData {std::getenv(ENV_DATA_ROOT_DIR)};
+    if(!pathToData){
+        std::cerr << "'" << ENV_DATA_ROOT_DIR << "' environment variable is not set." << std::endl;
+        return -1;
+    }
+    dataRootDir = std::string{pathToData};
+    try{
+        test_parse_subfile_header();
+        test_from_sub_file();
+    } catch (std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <complex>
+#include <cstring>
+#include "common.hpp"
+#include "../src/packed_voltages.hpp"
+
+
+namespace {
+    // Odd shapes exercise the scalar tails of the reordering loop.
+    ObservationInfo small_observation(){
+        ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+        obsInfo.nAntennas = 21;
+        obsInfo.nFrequencies = 3;
+        obsInfo.nTimesteps = 250;
+        return obsInfo;
+    }
+
+
+    PackedVoltages reorder(const std::vector<uint8_t>& input, const ObservationInfo& obsInfo, unsigned int nIntegrationSteps){
+        const size_t bytesPerTimestep {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations * obsInfo.nFrequencies};
+        const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+        MemoryBuffer<uint8_t> mb {nIntervals * nIntegrationSteps * bytesPerTimestep};
+        memset(mb.data(), 0, nIntervals * nIntegrationSteps * bytesPerTimestep);
+        // Reorder in two calls, the second starting in the middle of an integration interval.
+        const size_t split {47};
+        reorder_dat_timesteps(input.data(), 0, split, obsInfo, nIntegrationSteps, mb.data());
+        reorder_dat_timesteps(input.data() + split * bytesPerTimestep, split, obsInfo.nTimesteps - split,
+            obsInfo, nIntegrationSteps, mb.data());
+        return PackedVoltages {std::move(mb), obsInfo, nIntegrationSteps};
+    }
+}
+
+
+
+void test_reorder_dat_timesteps(){
+    const ObservationInfo obsInfo {small_observation()};
+    const unsigned int nIntegrationSteps {30};
+    const size_t bytesPerTimestep {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations * obsInfo.nFrequencies};
+    const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+    auto input = random_bytes(obsInfo.nTimesteps * bytesPerTimestep);
+
+    // Reordering then unpacking must give the same result as expanding directly.
+    std::vector<std::complex<int8_t>> expected(nIntervals * nIntegrationSteps * bytesPerTimestep);
+    expand_dat_timesteps(input.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, ChannelMask {}, expected.data());
+    PackedVoltages packed {reorder(input, obsInfo, nIntegrationSteps)};
+    Voltages voltages {packed.to_voltages()};
+    if(memcmp(voltages.data(), expected.data(), expected.size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("test_reorder_dat_timesteps: unpacked voltages differ from the expanded ones.");
+    std::cout << "'test_reorder_dat_timesteps' passed." << std::endl;
+}
+
+
+
+void test_unpack_channel(){
+    const ObservationInfo obsInfo {small_observation()};
+    const unsigned int nIntegrationSteps {30};
+    const size_t bytesPerTimestep {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations * obsInfo.nFrequencies};
+    PackedVoltages packed {reorder(random_bytes(obsInfo.nTimesteps * bytesPerTimestep), obsInfo, nIntegrationSteps)};
+    Voltages voltages {packed.to_voltages()};
+    std::vector<std::complex<int8_t>> block(packed.channel_block_size());
+    for(size_t interval {0}; interval < packed.integration_intervals(); interval++){
+        for(unsigned int ch {0}; ch < obsInfo.nFrequencies; ch++){
+            packed.unpack_channel(interval, ch, block.data());
+            const std::complex<int8_t> *expected {voltages.data() + (interval * obsInfo.nFrequencies + ch) * block.size()};
+            if(memcmp(block.data(), expected, block.size() * sizeof(std::complex<int8_t>)))
+                throw TestFailed("test_unpack_channel: unpacked block differs from the whole array expansion.");
+            // `at` points to the packed samples of one antenna and polarization within the same block.
+            const uint8_t *p {packed.at(interval, ch, 5, 1)};
+            if(p - packed.data() != static_cast<std::ptrdiff_t>((interval * obsInfo.nFrequencies + ch) * block.size()
+                    + (5 * obsInfo.nPolarizations + 1) * nIntegrationSteps))
+                throw TestFailed("test_unpack_channel: `at` returned a wrong pointer.");
+        }
+    }
+    std::cout << "'test_unpack_channel' passed." << std::endl;
+}
+
+
+
+void test_from_voltages(){
+    const ObservationInfo obsInfo {small_observation()};
+    const unsigned int nIntegrationSteps {25};
+    const size_t bytesPerTimestep {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations * obsInfo.nFrequencies};
+    PackedVoltages packed {reorder(random_bytes(obsInfo.nTimesteps * bytesPerTimestep), obsInfo, nIntegrationSteps)};
+    Voltages voltages {packed.to_voltages()};
+    PackedVoltages repacked {PackedVoltages::from_voltages(voltages)};
+    if(memcmp(repacked.data(), packed.data(), packed.size()))
+        throw TestFailed("test_from_voltages: packing is not the inverse of unpacking.");
+
+    // out of range values saturate.
+    voltages.data()[0] = {100, -100};
+    repacked = PackedVoltages::from_voltages(voltages);
+    std::complex<int8_t> first;
+    repacked.unpack(0, 1, &first);
+    if(first != std::complex<int8_t> {7, -8}) throw TestFailed("test_from_voltages: out of range values are not clipped.");
+    std::cout << "'test_from_voltages' passed." << std::endl;
+}
+
+
+
+int main(void){
+    try{
+        test_reorder_dat_timesteps();
+        test_unpack_channel();
+        test_from_voltages();
+    } catch (TestFailed ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <complex>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include "common.hpp"
+#include "../src/sample_conversion.hpp"
+
+
+namespace {
+    template <typename T>
+    std::vector<T> random_values(size_t n, double lo, double hi){
+        std::mt19937 gen {1234};
+        std::uniform_int_distribution<int> dist {static_cast<int>(lo), static_cast<int>(hi)};
+        std::vector<T> values(n);
+        for(auto& v : values) v = static_cast<T>(dist(gen));
+        return values;
+    }
+
+
+    // Vector kernels must give the same result as the scalar one on every length, including the tails.
+    template <typename In, typename Out>
+    void check_levels(const std::vector<In>& input, const char *name){
+        std::vector<Out> expected(input.size());
+        convert_samples(input.data(), expected.data(), input.size(), SimdLevel::SCALAR);
+        for(auto level : levels_to_test()){
+            for(size_t n : {input.size(), input.size() - 1, size_t {7}}){
+                std::vector<Out> output(input.size(), Out {});
+                convert_samples(input.data(), output.data(), n, level);
+                if(memcmp(output.data(), expected.data(), n * sizeof(Out))){
+                    std::stringstream ss;
+                    ss << "'test_convert_samples' failed: wrong " << name << " conversion with " << simd_level_name(level) << ".";
+                    throw TestFailed(ss.str());
+                }
+            }
+        }
+    }
+}
+
+
+
+void test_convert_samples(){
+    const size_t n {1003};
+    const auto int8Values = random_values<int8_t>(n, -128, 127);
+    const auto int16Values = random_values<int16_t>(n, -1000, 1000);
+    // Floats include halves, to check the rounding, and values out of every range.
+    std::vector<float> floatValues(n);
+    std::mt19937 gen {4321};
+    std::uniform_int_distribution<int> dist {-80000, 80000};
+    for(auto& v : floatValues) v = dist(gen) / 2.0f;
+    floatValues[1] = std::numeric_limits<float>::quiet_NaN();
+    floatValues[2] = std::numeric_limits<float>::infinity();
+    floatValues[3] = -3e9f;
+    floatValues[4] = 2.5f;
+    floatValues[5] = -0.5f;
+
+    check_levels<int8_t, int16_t>(int8Values, "int8 to int16");
+    check_levels<int8_t, float>(int8Values, "int8 to float");
+    check_levels<int16_t, int8_t>(int16Values, "int16 to int8");
+    check_levels<int16_t, float>(int16Values, "int16 to float");
+    check_levels<float, int8_t>(floatValues, "float to int8");
+    check_levels<float, int16_t>(floatValues, "float to int16");
+
+    // Reference values of the scalar conversions.
+    std::vector<int8_t> int8Out(n);
+    convert_samples(floatValues.data(), int8Out.data(), n, SimdLevel::SCALAR);
+    if(int8Out[1] != -128 || int8Out[2] != 127 || int8Out[3] != -128 || int8Out[4] != 2 || int8Out[5] != 0)
+        throw TestFailed("'test_convert_samples' failed: wrong rounding or saturation to int8.");
+    std::vector<int16_t> int16Out(n);
+    convert_samples(int8Values.data(), int16Out.data(), n, SimdLevel::SCALAR);
+    for(size_t i {0}; i < n; i++)
+        if(int16Out[i] != int8Values[i]) throw TestFailed("'test_convert_samples' failed: int8 values not preserved.");
+    std::cout << "'test_convert_samples' passed." << std::endl;
+}
+
+
+
+void test_convert_voltages(){
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 5;
+    obsInfo.nFrequencies = 3;
+    obsInfo.nTimesteps = 250;
+    const unsigned int nIntegrationSteps {40};
+    const size_t bytesPerTimestep {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations * obsInfo.nFrequencies};
+    const auto packed = random_values<uint8_t>(obsInfo.nTimesteps * bytesPerTimestep, 0, 255);
+    auto voltages = Voltages::from_packed_memory(packed.data(), packed.size(), obsInfo, nIntegrationSteps);
+
+    // Readers of other sample types give the 8-bit samples, converted.
+    auto floatVoltages = BasicVoltages<float>::from_packed_memory(packed.data(), packed.size(), obsInfo, nIntegrationSteps, {}, false, 2);
+    if(floatVoltages.obsInfo.nTimesteps != obsInfo.nTimesteps || floatVoltages.nIntegrationSteps != nIntegrationSteps
+            || floatVoltages.MemoryBuffer::size() != voltages.MemoryBuffer::size())
+        throw TestFailed("'test_convert_voltages' failed: wrong shape of the float voltages.");
+    for(size_t i {0}; i < voltages.MemoryBuffer::size(); i++)
+        if(floatVoltages.data()[i] != std::complex<float> {static_cast<float>(voltages.data()[i].real()),
+                static_cast<float>(voltages.data()[i].imag())})
+            throw TestFailed("'test_convert_voltages' failed: wrong float samples.");
+    const auto unpacked = random_values<int8_t>(2 * packed.size(), -128, 127);
+    auto reordered = Voltages::from_memory(unpacked.data(), unpacked.size(), obsInfo, nIntegrationSteps, false, 1);
+    auto int16Reordered = BasicVoltages<int16_t>::from_memory(unpacked.data(), unpacked.size(), obsInfo, nIntegrationSteps, false, 3);
+    for(size_t i {0}; i < reordered.MemoryBuffer::size(); i++)
+        if(int16Reordered.data()[i] != std::complex<int16_t> {reordered.data()[i].real(), reordered.data()[i].imag()})
+            throw TestFailed("'test_convert_voltages' failed: wrong 16-bit samples.");
+
+    // Converting back to 8 bits is lossless, through any type.
+    auto int16Voltages = convert_voltages<int16_t>(floatVoltages, 3);
+    auto roundTrip = convert_voltages<int8_t>(int16Voltages);
+    if(memcmp(roundTrip.data(), voltages.data(), voltages.MemoryBuffer::size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("'test_convert_voltages' failed: conversions are not lossless.");
+    std::cout << "'test_convert_voltages' passed." << std::endl;
+}
+
+
+
+int main(void){
+    try{
+        test_convert_samples();
+        test_convert_voltages();
+    } catch (TestFailed ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <complex>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include "common.hpp"
+#include "../src/astroio.hpp"
+#include "../src/spectral_kurtosis.hpp"
+#include "../src/voltage_expansion.hpp"
+
+
+std::string dataRootDir;
+
+
+namespace {
+    const unsigned int N_CHANNELS {4}, N_ANTENNAS {3}, N_POLARIZATIONS {2}, N_INPUTS {N_ANTENNAS * N_POLARIZATIONS};
+    const unsigned int N_INTEGRATION_STEPS {100}, BLOCK_SIZE {50};
+
+    struct Injection { size_t interval; unsigned int channel, input; };
+    // An impulsive burst and a continuous wave, both confined to a single block.
+    const Injection BURST {3, 2, 5}, CONTINUOUS_WAVE {6, 0, 1};
+
+
+    // Approximately Gaussian 4-bit values, reproducible across platforms.
+    int noise_value(std::mt19937& gen){
+        int v {0};
+        for(int i {0}; i < 4; i++) v += static_cast<int>(gen() % 5) - 2;
+        return std::max(-8, std::min(7, v));
+    }
+
+
+    uint8_t pack(int re, int im){
+        return static_cast<uint8_t>((re & 0xf) | ((im & 0xf) << 4));
+    }
+
+
+    ObservationInfo small_obs_info(size_t nTimesteps){
+        ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+        obsInfo.nFrequencies = N_CHANNELS;
+        obsInfo.nAntennas = N_ANTENNAS;
+        obsInfo.nPolarizations = N_POLARIZATIONS;
+        obsInfo.nTimesteps = nTimesteps;
+        return obsInfo;
+    }
+
+
+    /**
+     * Write a .dat file of noise with a burst in the second block of the BURST interval, channel and input,
+     * and a continuous wave in the first block of the CONTINUOUS_WAVE ones.
+     */
+    void write_dat_file(const std::string& filename, size_t nTimesteps){
+        std::mt19937 gen {2024};
+        std::vector<uint8_t> content(nTimesteps * N_CHANNELS * N_INPUTS);
+        for(size_t t {0}; t < nTimesteps; t++){
+            for(unsigned int ch {0}; ch < N_CHANNELS; ch++){
+                for(unsigned int input {0}; input < N_INPUTS; input++){
+                    const size_t interval {t / N_INTEGRATION_STEPS}, step {t % N_INTEGRATION_STEPS};
+                    int re {noise_value(gen)}, im {noise_value(gen)};
+                    if(interval == BURST.interval && ch == BURST.channel && input == BURST.input && step >= BLOCK_SIZE){
+                        // low level noise, with a few saturated samples.
+                        re /= 4;
+                        im /= 4;
+                        if(step % 16 == 0) re = im = 7;
+                    }
+                    if(interval == CONTINUOUS_WAVE.interval && ch == CONTINUOUS_WAVE.channel && input == CONTINUOUS_WAVE.input
+                            && step < BLOCK_SIZE){
+                        // constant amplitude, rotating phase.
+                        const int phase {static_cast<int>(step % 4)};
+                        re = phase == 0 ? 3 : phase == 1 ? 0 : phase == 2 ? -3 : 0;
+                        im = phase == 1 ? 3 : phase == 3 ? -3 : 0;
+                    }
+                    content[(t * N_CHANNELS + ch) * N_INPUTS + input] = pack(re, im);
+                }
+            }
+        }
+        std::ofstream out {filename, std::ios::binary};
+        out.write(reinterpret_cast<const char*>(content.data()), content.size());
+    }
+
+
+    bool injected(size_t interval, unsigned int channel, unsigned int input){
+        for(const Injection& i : {BURST, CONTINUOUS_WAVE})
+            if(i.interval == interval && i.channel == channel && i.input == input) return true;
+        return false;
+    }
+}
+
+
+
+void test_spectral_kurtosis_estimator(){
+    // A constant power gives zero, a single impulse M + 1.
+    if(std::abs(spectral_kurtosis(100 * 9, 100 * 81, 100)) > 1e-12 || std::abs(spectral_kurtosis(128, 128 * 128, 100) - 101) > 1e-9)
+        throw TestFailed("'test_spectral_kurtosis_estimator' failed: wrong estimator.");
+    if(spectral_kurtosis(0, 0, 100) != 1.0)
+        throw TestFailed("'test_spectral_kurtosis_estimator' failed: zero samples are not neutral.");
+    if(std::abs(spectral_kurtosis_sigma(4) - std::sqrt(64.0 / 126.0)) > 1e-12)
+        throw TestFailed("'test_spectral_kurtosis_estimator' failed: wrong standard deviation.");
+    std::cout << "'test_spectral_kurtosis_estimator' passed." << std::endl;
+}
+
+
+
+void test_power_sums(){
+    std::mt19937 gen {7};
+    const size_t stride {211}, nRows {5};
+    std::vector<std::complex<int8_t>> samples(stride * nRows);
+    for(auto& s : samples) s = {static_cast<int8_t>(static_cast<int>(gen() % 16) - 8), static_cast<int8_t>(static_cast<int>(gen() % 16) - 8)};
+    for(size_t nSamples : {size_t {1}, size_t {7}, size_t {32}, size_t {45}, size_t {200}}){
+        uint64_t expected1[nRows], expected2[nRows];
+        for(size_t r {0}; r < nRows; r++){
+            expected1[r] = expected2[r] = 0;
+            for(size_t i {0}; i < nSamples; i++){
+                const auto s = samples[r * stride + 1 + i];
+                const uint64_t p {static_cast<uint64_t>(s.real() * s.real() + s.imag() * s.imag())};
+                expected1[r] += p;
+                expected2[r] += p * p;
+            }
+        }
+        for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}){
+            uint64_t s1[nRows], s2[nRows];
+            power_sums(samples.data() + 1, stride, nSamples, nRows, s1, s2, level);
+            for(size_t r {0}; r < nRows; r++){
+                if(s1[r] != expected1[r] || s2[r] != expected2[r]){
+                    std::stringstream ss;
+                    ss << "'test_power_sums' failed: wrong sums of row " << r << " of " << nSamples << " samples with the "
+                        << simd_level_name(level) << " kernel.";
+                    throw TestFailed(ss.str());
+                }
+            }
+        }
+    }
+    std::cout << "'test_power_sums' passed." << std::endl;
+}
+
+
+
+void test_dat_power_sums(){
+    std::mt19937 gen {11};
+    // Sizes cover the vector widths, their remainders, and the 16-bit partial sums of long blocks.
+    const size_t stride {150};
+    std::vector<uint8_t> input(stride * 600);
+    for(auto& b : input) b = static_cast<uint8_t>(gen() % 256);
+    for(size_t nInputs : {size_t {5}, size_t {64}, size_t {143}}){
+        for(size_t nSteps : {size_t {1}, size_t {50}, size_t {600}}){
+            std::vector<uint64_t> expected1(nInputs, 0), expected2(nInputs, 0);
+            for(size_t j {0}; j < nInputs; j++){
+                for(size_t s {0}; s < nSteps; s++){
+                    const uint8_t b {input[s * stride + 1 + j]};
+                    const int re {static_cast<int8_t>(b << 4) >> 4}, im {static_cast<int8_t>(b) >> 4};
+                    const uint64_t p {static_cast<uint64_t>(re * re + im * im)};
+                    expected1[j] += p;
+                    expected2[j] += p * p;
+                }
+            }
+            for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}){
+                std::vector<uint64_t> s1(nInputs, 1), s2(nInputs, 1);
+                dat_power_sums(input.data() + 1, stride, nSteps, nInputs, s1.data(), s2.data(), level);
+                if(s1 != expected1 || s2 != expected2){
+                    std::stringstream ss;
+                    ss << "'test_dat_power_sums' failed: wrong sums of " << nInputs << " inputs over " << nSteps
+                        << " timesteps with the " << simd_level_name(level) << " kernel.";
+                    throw TestFailed(ss.str());
+                }
+            }
+        }
+    }
+    std::cout << "'test_dat_power_sums' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_rfi_mask(){
+    const std::string filename {dataRootDir + "/spectral_kurtosis_test.dat.tmp"};
+    // The last interval is only partially filled.
+    const size_t nTimesteps {1030};
+    write_dat_file(filename, nTimesteps);
+    const ObservationInfo obsInfo {small_obs_info(nTimesteps)};
+    for(unsigned int nThreads : {1u, 2u, 16u}){
+        for(unsigned int timestepsPerRead : {100u, 37u}){
+            DatReadOptions options;
+            options.nThreads = nThreads;
+            options.timestepsPerRead = timestepsPerRead;
+            options.kurtosisBlockSize = BLOCK_SIZE;
+            RfiMask rfiMask;
+            auto voltages = Voltages::from_dat_file(filename, obsInfo, N_INTEGRATION_STEPS, options, rfiMask);
+            if(rfiMask.n_intervals() != 11 || rfiMask.n_channels() != N_CHANNELS || rfiMask.n_inputs() != N_INPUTS)
+                throw TestFailed("'test_from_dat_file_rfi_mask' failed: wrong shape of the mask.");
+            for(size_t interval {0}; interval < rfiMask.n_intervals(); interval++){
+                for(unsigned int ch {0}; ch < N_CHANNELS; ch++){
+                    for(unsigned int input {0}; input < N_INPUTS; input++){
+                        if(rfiMask.flagged(interval, ch, input) != injected(interval, ch, input)){
+                            std::stringstream ss;
+                            ss << "'test_from_dat_file_rfi_mask' failed: wrong flag of interval " << interval << ", channel " << ch
+                                << ", input " << input << " with " << nThreads << " threads, " << timestepsPerRead << " timesteps per read.";
+                            throw TestFailed(ss.str());
+                        }
+                    }
+                }
+            }
+            // Flagged samples are only zeroed on request.
+            const size_t burstRow {(BURST.interval * N_CHANNELS + BURST.channel) * N_INPUTS + BURST.input};
+            if(voltages.data()[burstRow * N_INTEGRATION_STEPS + 64] != std::complex<int8_t> {7, 7})
+                throw TestFailed("'test_from_dat_file_rfi_mask' failed: samples changed by the detector.");
+            voltages.apply_rfi_mask(rfiMask);
+            for(size_t i {0}; i < N_INTEGRATION_STEPS; i++)
+                if(voltages.data()[burstRow * N_INTEGRATION_STEPS + i] != std::complex<int8_t> {0, 0})
+                    throw TestFailed("'test_from_dat_file_rfi_mask' failed: flagged samples not zeroed.");
+            if(voltages.data()[(burstRow + 1) * N_INTEGRATION_STEPS] == std::complex<int8_t> {0, 0}
+                    && voltages.data()[(burstRow + 1) * N_INTEGRATION_STEPS + 1] == std::complex<int8_t> {0, 0})
+                throw TestFailed("'test_from_dat_file_rfi_mask' failed: samples of another input zeroed.");
+        }
+    }
+
+    // Blocks must tile the integration intervals.
+    DatReadOptions options;
+    options.kurtosisBlockSize = 30;
+    RfiMask rfiMask;
+    bool thrown {false};
+    try{
+        Voltages::from_dat_file(filename, obsInfo, N_INTEGRATION_STEPS, options, rfiMask);
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("'test_from_dat_file_rfi_mask' failed: block size not dividing the interval accepted.");
+    thrown = false;
+    try{
+        auto voltages = Voltages::from_dat_file(filename, obsInfo, N_INTEGRATION_STEPS, DatReadOptions {});
+        voltages.apply_rfi_mask(RfiMask {10, N_CHANNELS, N_INPUTS});
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("'test_from_dat_file_rfi_mask' failed: mask of the wrong shape applied.");
+    std::remove(filename.c_str());
+    std::cout << "'test_from_dat_file_rfi_mask' passed." << std::endl;
+}
+
+
+
+int main(void){
+    char *pathToData {std::getenv(ENV_DATA_ROOT_DIR)};
+    if(!pathToData){
+        std::cerr << "'" << ENV_DATA_ROOT_DIR << "' environment variable is not set." << std::endl;
+        return -1;
+    }
+    dataRootDir = std::string{pathToData};
+    try{
+        test_spectral_kurtosis_estimator();
+        test_power_sums();
+        test_dat_power_sums();
+        test_from_dat_file_rfi_mask();
+    } catch (std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
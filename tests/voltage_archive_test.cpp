@@ -0,0 +1,213 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <cstdio>
+#include "common.hpp"
+#include "../src/astroio.hpp"
+#include "../src/voltage_archive.hpp"
+#include "../src/utils.hpp"
+
+
+std::string dataRootDir;
+
+
+namespace {
+    // .dat content of small, roughly gaussian 4-bit samples, as recorded by the telescope.
+    std::vector<uint8_t> synthetic_dat(size_t nBytes){
+        std::mt19937 gen {1234};
+        std::normal_distribution<float> dist {0.0f, 2.0f};
+        auto nibble = [&](){ return static_cast<uint8_t>(std::max(-8, std::min(7, static_cast<int>(dist(gen))))) & 0xF; };
+        std::vector<uint8_t> content(nBytes);
+        for(auto& b : content) b = static_cast<uint8_t>(nibble() | (nibble() << 4));
+        return content;
+    }
+
+
+    void write_file(const std::string& filename, const std::vector<uint8_t>& content){
+        std::ofstream out {filename, std::ios::binary};
+        out.write(reinterpret_cast<const char*>(content.data()), content.size());
+    }
+
+
+    std::vector<uint8_t> read_file(const std::string& filename){
+        char *data;
+        size_t size;
+        read_data_from_file(filename, data, size);
+        std::vector<uint8_t> content(data, data + size);
+        delete[] data;
+        return content;
+    }
+
+
+    std::vector<ArchiveCodec> codecs_to_test(){
+        std::vector<ArchiveCodec> codecs;
+        for(auto codec : {ArchiveCodec::NONE, ArchiveCodec::ZLIB, ArchiveCodec::ZSTD})
+            if(archive_codec_available(codec)) codecs.push_back(codec);
+        return codecs;
+    }
+}
+
+
+
+void test_archive_round_trip(){
+    // 5 antennas, 3 channels, 2 polarizations, and a last chunk holding fewer timesteps.
+    const size_t bytesPerTimestep {30}, nTimesteps {1037};
+    const auto content = synthetic_dat(nTimesteps * bytesPerTimestep);
+    const std::string archiveFile {dataRootDir + "/voltage_archive_test.vca.tmp"};
+    const std::string datFile {dataRootDir + "/voltage_archive_test.dat.tmp"};
+    for(auto codec : codecs_to_test()){
+        for(unsigned int nThreads : {1u, 3u}){
+            const std::string name {std::string {archive_codec_name(codec)} + " codec and " + std::to_string(nThreads) + " threads"};
+            ArchiveWriteOptions options;
+            options.codec = codec;
+            options.timestepsPerChunk = 100;
+            options.nThreads = nThreads;
+            {
+                // pieces not aligned to chunks.
+                VoltageArchiveWriter writer {archiveFile, bytesPerTimestep, options};
+                for(size_t ts {0}; ts < nTimesteps; ts += 77)
+                    writer.write(content.data() + ts * bytesPerTimestep, std::min<size_t>(77, nTimesteps - ts));
+                writer.close();
+            }
+            VoltageArchive archive {archiveFile};
+            if(archive.codec() != codec || archive.n_timesteps() != nTimesteps || archive.n_chunks() != 11
+                    || archive.bytes_per_timestep() != bytesPerTimestep || archive.size() != content.size())
+                throw TestFailed("'test_archive_round_trip' failed: wrong archive metadata with " + name + ".");
+            if(codec != ArchiveCodec::NONE && archive.compressed_size() >= content.size())
+                throw TestFailed("'test_archive_round_trip' failed: data was not compressed with " + name + ".");
+
+            std::vector<uint8_t> output(content.size());
+            archive.read_timesteps(0, nTimesteps, output.data(), nThreads);
+            if(output != content) throw TestFailed("'test_archive_round_trip' failed: wrong timesteps with " + name + ".");
+            // random access, across and within chunks.
+            for(size_t offset : {size_t {0}, size_t {1}, size_t {2999}, size_t {3001}, content.size() - 1000}){
+                std::vector<uint8_t> buffer(1000);
+                archive.read(buffer.data(), buffer.size(), offset);
+                if(memcmp(buffer.data(), content.data() + offset, buffer.size()))
+                    throw TestFailed("'test_archive_round_trip' failed: wrong random read with " + name + ".");
+            }
+            for(unsigned int queueDepth : {1u, 3u}){
+                std::vector<uint8_t> chunked(content.size() - 100);
+                size_t expectedOffset {0};
+                archive.read_chunks(100, chunked.size(), 4321, queueDepth, [&](size_t offset, const uint8_t *data, size_t size){
+                    if(offset != expectedOffset) throw TestFailed("'test_archive_round_trip' failed: chunks out of order.");
+                    memcpy(chunked.data() + offset, data, size);
+                    expectedOffset += size;
+                });
+                if(expectedOffset != chunked.size() || memcmp(chunked.data(), content.data() + 100, chunked.size()))
+                    throw TestFailed("'test_archive_round_trip' failed: wrong chunked read with " + name + ".");
+            }
+            archive_to_dat(archiveFile, datFile, nThreads);
+            if(read_file(datFile) != content) throw TestFailed("'test_archive_round_trip' failed: wrong .dat file with " + name + ".");
+        }
+    }
+    std::remove(archiveFile.c_str());
+    std::remove(datFile.c_str());
+    std::cout << "'test_archive_round_trip' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_archive(){
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 6;
+    obsInfo.nFrequencies = 5;
+    obsInfo.nTimesteps = 1000;
+    const size_t bytesPerTimestep {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nFrequencies * obsInfo.nPolarizations};
+    const std::string datFile {dataRootDir + "/voltage_archive_test.dat.tmp"};
+    const std::string archiveFile {dataRootDir + "/voltage_archive_test.vca.tmp"};
+    write_file(datFile, synthetic_dat(obsInfo.nTimesteps * bytesPerTimestep));
+    ArchiveWriteOptions archiveOptions;
+    archiveOptions.timestepsPerChunk = 64;
+    dat_to_archive(datFile, archiveFile, bytesPerTimestep, archiveOptions);
+
+    // The archive goes through the same readers, with all their options, as the .dat file.
+    for(unsigned int nThreads : {1u, 3u}){
+        DatReadOptions options;
+        options.nThreads = nThreads;
+        options.firstTimestep = 250;
+        options.nTimesteps = 500;
+        options.channels = {4, 1};
+        auto expected = Voltages::from_dat_file(datFile, obsInfo, 50, options);
+        auto voltages = Voltages::from_dat_file(archiveFile, obsInfo, 50, options);
+        if(voltages.obsInfo.nTimesteps != expected.obsInfo.nTimesteps || voltages.MemoryBuffer::size() != expected.MemoryBuffer::size()
+                || memcmp(voltages.data(), expected.data(), expected.MemoryBuffer::size() * sizeof(std::complex<int8_t>)))
+            throw TestFailed("'test_from_dat_file_archive' failed: wrong voltages with " + std::to_string(nThreads) + " threads.");
+    }
+    // Archives cannot be mapped: the mmap reader must decompress them instead of expanding the compressed bytes.
+    auto expected = Voltages::from_dat_file(datFile, obsInfo, 50);
+    auto mapped = Voltages::from_dat_file_mmap(archiveFile, obsInfo, 50);
+    if(mapped.MemoryBuffer::size() != expected.MemoryBuffer::size()
+            || memcmp(mapped.data(), expected.data(), expected.MemoryBuffer::size() * sizeof(std::complex<int8_t>)))
+        throw TestFailed("'test_from_dat_file_archive' failed: wrong voltages read with from_dat_file_mmap.");
+    std::remove(datFile.c_str());
+    std::remove(archiveFile.c_str());
+    std::cout << "'test_from_dat_file_archive' passed." << std::endl;
+}
+
+
+
+void test_corrupted_archive(){
+    const size_t bytesPerTimestep {16};
+    const auto content = synthetic_dat(500 * bytesPerTimestep);
+    const std::string archiveFile {dataRootDir + "/voltage_archive_test.vca.tmp"};
+    for(auto codec : codecs_to_test()){
+        ArchiveWriteOptions options;
+        options.codec = codec;
+        {
+            VoltageArchiveWriter writer {archiveFile, bytesPerTimestep, options};
+            writer.write(content.data(), 500);
+        }
+        auto archived = read_file(archiveFile);
+        // A truncated archive is rejected when opened.
+        std::vector<uint8_t> truncated(archived.begin(), archived.end() - 10);
+        write_file(archiveFile, truncated);
+        bool thrown {false};
+        try{
+            open_file_reader(archiveFile);
+        }catch(const std::runtime_error&){
+            thrown = true;
+        }
+        if(!thrown) throw TestFailed("'test_corrupted_archive' failed: truncated archive accepted.");
+        if(codec == ArchiveCodec::NONE) continue;
+        // A damaged chunk is detected when it is read.
+        archived[100] ^= 0xFF;
+        archived[101] ^= 0xFF;
+        write_file(archiveFile, archived);
+        auto reader = open_file_reader(archiveFile);
+        std::vector<uint8_t> buffer(reader->size());
+        thrown = false;
+        try{
+            reader->read(buffer.data(), buffer.size(), 0);
+        }catch(const std::runtime_error&){
+            thrown = true;
+        }
+        if(!thrown && buffer == content) throw TestFailed("'test_corrupted_archive' failed: damaged chunk not detected.");
+    }
+    std::remove(archiveFile.c_str());
+    std::cout << "'test_corrupted_archive' passed." << std::endl;
+}
+
+
+
+int main(void){
+    char *pathToData {std::getenv(ENV_DATA_ROOT_DIR)};
+    if(!pathToData){
+        std::cerr << "'" << ENV_DATA_ROOT_DIR << "' environment variable is not set." << std::endl;
+        return -1;
+    }
+    dataRootDir = std::string{pathToData};
+    try{
+        test_archive_round_trip();
+        test_from_dat_file_archive();
+        test_corrupted_archive();
+    } catch (std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
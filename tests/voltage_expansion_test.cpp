@@ -0,0 +1,429 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <complex>
+#include <cstring>
+#include <algorithm>
+#include "common.hpp"
+#include "../src/voltage_expansion.hpp"
+
+
+namespace {
+    // Reference 4+4 bit to 8+8 bit conversion, as done by the original lookup table.
+    std::complex<int8_t> reference_expansion(uint8_t packed){
+        int8_t expanded[2];
+        for(int outval {0}; outval < 2; outval++){
+            uint8_t original = (packed >> (outval * 4)) & 0xf;
+            int value = original >= 0x8 ? original - 0x10 : original;
+            expanded[outval] = value & 0xff;
+        }
+        return {expanded[0], expanded[1]};
+    }
+}
+
+
+
+void test_expand_4bit_samples(){
+    // all the possible byte values, plus a tail not multiple of any vector width.
+    std::vector<uint8_t> input(256 + 37);
+    for(size_t i {0}; i < input.size(); i++) input[i] = static_cast<uint8_t>(i);
+    for(auto level : levels_to_test()){
+        std::vector<std::complex<int8_t>> output(input.size());
+        expand_4bit_samples(input.data(), input.size(), output.data(), level);
+        for(size_t i {0}; i < input.size(); i++){
+            if(output[i] != reference_expansion(input[i])){
+                std::stringstream ss;
+                ss << "'test_expand_4bit_samples' failed: wrong expansion of " << static_cast<int>(input[i])
+                    << " with " << simd_level_name(level) << ".";
+                throw TestFailed(ss.str());
+            }
+        }
+    }
+    std::cout << "'test_expand_4bit_samples' passed." << std::endl;
+}
+
+
+
+void test_expand_dat_timesteps(){
+    // Odd shapes exercise the scalar tails of the vector kernels.
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 21;
+    obsInfo.nFrequencies = 3;
+    obsInfo.nTimesteps = 250;
+    const unsigned int nIntegrationSteps {30};
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t samplesInTimeInterval {nInputs * obsInfo.nFrequencies * nIntegrationSteps};
+    const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+    auto input = random_bytes(obsInfo.nTimesteps * nInputs * obsInfo.nFrequencies);
+
+    std::vector<std::complex<int8_t>> expected(nIntervals * samplesInTimeInterval);
+    size_t idx {0};
+    for(size_t t {0}; t < obsInfo.nTimesteps; t++)
+        for(size_t ch {0}; ch < obsInfo.nFrequencies; ch++)
+            for(size_t j {0}; j < nInputs; j++)
+                expected[(t / nIntegrationSteps) * samplesInTimeInterval + (ch * nInputs + j) * nIntegrationSteps
+                    + t % nIntegrationSteps] = reference_expansion(input[idx++]);
+
+    for(auto level : levels_to_test()){
+        std::vector<std::complex<int8_t>> output(expected.size());
+        // Expand in two calls, the second starting in the middle of an integration interval.
+        const size_t split {47};
+        expand_dat_timesteps(input.data(), 0, split, obsInfo, nIntegrationSteps, ChannelMask {}, output.data(), level);
+        expand_dat_timesteps(input.data() + split * nInputs * obsInfo.nFrequencies, split, obsInfo.nTimesteps - split,
+            obsInfo, nIntegrationSteps, ChannelMask {}, output.data(), level);
+        if(output != expected){
+            std::stringstream ss;
+            ss << "'test_expand_dat_timesteps' failed: output differs from the reference with " << simd_level_name(level) << ".";
+            throw TestFailed(ss.str());
+        }
+    }
+    std::cout << "'test_expand_dat_timesteps' passed." << std::endl;
+}
+
+
+
+void test_expand_dat_timesteps_channels(){
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 21;
+    obsInfo.nFrequencies = 3;
+    obsInfo.nTimesteps = 250;
+    const unsigned int nIntegrationSteps {30};
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t samplesInFrequency {nInputs * nIntegrationSteps};
+    const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+    auto input = random_bytes(obsInfo.nTimesteps * nInputs * obsInfo.nFrequencies);
+    std::vector<std::complex<int8_t>> full(nIntervals * obsInfo.nFrequencies * samplesInFrequency);
+    expand_dat_timesteps(input.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, ChannelMask {}, full.data());
+
+    const std::vector<unsigned int> channels {2, 0};
+    for(auto level : levels_to_test()){
+        std::vector<std::complex<int8_t>> output(nIntervals * channels.size() * samplesInFrequency);
+        expand_dat_timesteps(input.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, channels, ChannelMask {}, output.data(), level);
+        for(size_t i {0}; i < nIntervals; i++){
+            for(size_t c {0}; c < channels.size(); c++){
+                const auto expected = full.begin() + (i * obsInfo.nFrequencies + channels[c]) * samplesInFrequency;
+                const auto selected = output.begin() + (i * channels.size() + c) * samplesInFrequency;
+                if(!std::equal(selected, selected + samplesInFrequency, expected)){
+                    std::stringstream ss;
+                    ss << "'test_expand_dat_timesteps_channels' failed: wrong channel " << channels[c] << " with " << simd_level_name(level) << ".";
+                    throw TestFailed(ss.str());
+                }
+            }
+        }
+    }
+    std::cout << "'test_expand_dat_timesteps_channels' passed." << std::endl;
+}
+
+
+
+void test_expand_dat_timesteps_flagged(){
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 21;
+    obsInfo.nFrequencies = 7;
+    obsInfo.nTimesteps = 250;
+    const unsigned int nIntegrationSteps {30};
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t samplesInFrequency {nInputs * nIntegrationSteps};
+    const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+    auto input = random_bytes(obsInfo.nTimesteps * nInputs * obsInfo.nFrequencies);
+    std::vector<std::complex<int8_t>> expected(nIntervals * obsInfo.nFrequencies * samplesInFrequency);
+    expand_dat_timesteps(input.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, ChannelMask {}, expected.data());
+    // a run of flagged channels at the bottom of the band and an isolated one.
+    ChannelMask flagged {obsInfo.nFrequencies};
+    for(unsigned int ch : {0u, 1u, 5u}) flagged.flag(ch);
+    for(size_t i {0}; i < nIntervals; i++)
+        for(unsigned int ch : {0u, 1u, 5u})
+            std::fill_n(expected.begin() + (i * obsInfo.nFrequencies + ch) * samplesInFrequency, samplesInFrequency, std::complex<int8_t> {0, 0});
+
+    const std::vector<unsigned int> channels {5, 2, 0};
+    for(auto level : levels_to_test()){
+        std::vector<std::complex<int8_t>> output(expected.size());
+        const size_t split {47};
+        expand_dat_timesteps(input.data(), 0, split, obsInfo, nIntegrationSteps, flagged, output.data(), level);
+        expand_dat_timesteps(input.data() + split * nInputs * obsInfo.nFrequencies, split, obsInfo.nTimesteps - split,
+            obsInfo, nIntegrationSteps, flagged, output.data(), level);
+        if(output != expected){
+            std::stringstream ss;
+            ss << "'test_expand_dat_timesteps_flagged' failed: output differs from the reference with " << simd_level_name(level) << ".";
+            throw TestFailed(ss.str());
+        }
+        // flagged channels are zeroed also when only a subset of the channels is expanded. The last,
+        // partial, interval is not compared as its padding is left untouched.
+        std::vector<std::complex<int8_t>> selection(nIntervals * channels.size() * samplesInFrequency, std::complex<int8_t> {1, 1});
+        expand_dat_timesteps(input.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, channels, flagged,
+            selection.data(), level);
+        for(size_t i {0}; i < nIntervals - 1; i++){
+            for(size_t c {0}; c < channels.size(); c++){
+                const auto reference = expected.begin() + (i * obsInfo.nFrequencies + channels[c]) * samplesInFrequency;
+                const auto selected = selection.begin() + (i * channels.size() + c) * samplesInFrequency;
+                if(!std::equal(selected, selected + samplesInFrequency, reference)){
+                    std::stringstream ss;
+                    ss << "'test_expand_dat_timesteps_flagged' failed: wrong channel " << channels[c] << " with " << simd_level_name(level) << ".";
+                    throw TestFailed(ss.str());
+                }
+            }
+        }
+    }
+    std::cout << "'test_expand_dat_timesteps_flagged' passed." << std::endl;
+}
+
+
+
+void test_reorder_complex_timesteps(){
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 21;
+    obsInfo.nFrequencies = 3;
+    obsInfo.nTimesteps = 250;
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    auto bytes = random_bytes(obsInfo.nTimesteps * nInputs * obsInfo.nFrequencies * 2);
+    const std::complex<int8_t> *input {reinterpret_cast<const std::complex<int8_t>*>(bytes.data())};
+
+    // 30 steps per interval make rows misaligned, 40 allow non-temporal stores.
+    for(unsigned int nIntegrationSteps : {30u, 40u}){
+        const size_t samplesInTimeInterval {nInputs * obsInfo.nFrequencies * nIntegrationSteps};
+        const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+        std::vector<std::complex<int8_t>> expected(nIntervals * samplesInTimeInterval);
+        size_t idx {0};
+        for(size_t t {0}; t < obsInfo.nTimesteps; t++)
+            for(size_t ch {0}; ch < obsInfo.nFrequencies; ch++)
+                for(size_t j {0}; j < nInputs; j++)
+                    expected[(t / nIntegrationSteps) * samplesInTimeInterval + (ch * nInputs + j) * nIntegrationSteps
+                        + t % nIntegrationSteps] = input[idx++];
+
+        for(auto level : levels_to_test()){
+            for(bool streaming : {false, true}){
+                std::vector<std::complex<int8_t>> output(expected.size());
+                const size_t split {47};
+                reorder_complex_timesteps(input, 0, split, obsInfo, nIntegrationSteps, output.data(), level, streaming);
+                reorder_complex_timesteps(input + split * nInputs * obsInfo.nFrequencies, split, obsInfo.nTimesteps - split,
+                    obsInfo, nIntegrationSteps, output.data(), level, streaming);
+                if(output != expected){
+                    std::stringstream ss;
+                    ss << "'test_reorder_complex_timesteps' failed: output differs from the reference with " << simd_level_name(level)
+                        << (streaming ? " and non-temporal stores." : ".");
+                    throw TestFailed(ss.str());
+                }
+            }
+        }
+    }
+    std::cout << "'test_reorder_complex_timesteps' passed." << std::endl;
+}
+
+
+
+void test_input_mapping(){
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 37;
+    obsInfo.nFrequencies = 3;
+    obsInfo.nTimesteps = 250;
+    const unsigned int nIntegrationSteps {40};
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+    const size_t nSamples {nIntervals * nInputs * obsInfo.nFrequencies * nIntegrationSteps};
+    std::vector<int> mapping(nInputs);
+    for(size_t j {0}; j < nInputs; j++) mapping[j] = static_cast<int>(j);
+    std::shuffle(mapping.begin(), mapping.end(), std::mt19937 {7});
+    if(!is_input_permutation(mapping, nInputs) || is_input_permutation(std::vector<int>(nInputs, 0), nInputs)
+            || is_input_permutation(mapping, nInputs + 1))
+        throw TestFailed("'test_input_mapping' failed: wrong permutation check.");
+
+    // Rows of the mapped output are the rows of the unmapped one, moved to their mapped position.
+    auto permute = [&](const std::vector<std::complex<int8_t>>& unmapped){
+        std::vector<std::complex<int8_t>> permuted(unmapped.size());
+        for(size_t block {0}; block < nIntervals * obsInfo.nFrequencies; block++)
+            for(size_t j {0}; j < nInputs; j++)
+                std::copy_n(unmapped.begin() + (block * nInputs + j) * nIntegrationSteps, nIntegrationSteps,
+                    permuted.begin() + (block * nInputs + mapping[j]) * nIntegrationSteps);
+        return permuted;
+    };
+    auto packed = random_bytes(obsInfo.nTimesteps * nInputs * obsInfo.nFrequencies * 2);
+    const std::complex<int8_t> *complexInput {reinterpret_cast<const std::complex<int8_t>*>(packed.data())};
+    std::vector<std::complex<int8_t>> expanded(nSamples), reordered(nSamples);
+    expand_dat_timesteps(packed.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, ChannelMask {}, expanded.data());
+    reorder_complex_timesteps(complexInput, 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, reordered.data());
+    const auto expectedExpanded = permute(expanded);
+    const auto expectedReordered = permute(reordered);
+
+    for(auto level : levels_to_test()){
+        std::vector<std::complex<int8_t>> output(nSamples);
+        const size_t split {47};
+        expand_dat_timesteps(packed.data(), 0, split, obsInfo, nIntegrationSteps, ChannelMask {}, output.data(), level, mapping);
+        expand_dat_timesteps(packed.data() + split * nInputs * obsInfo.nFrequencies, split, obsInfo.nTimesteps - split,
+            obsInfo, nIntegrationSteps, ChannelMask {}, output.data(), level, mapping);
+        if(output != expectedExpanded){
+            std::stringstream ss;
+            ss << "'test_input_mapping' failed: wrong expansion with " << simd_level_name(level) << ".";
+            throw TestFailed(ss.str());
+        }
+        for(bool streaming : {false, true}){
+            std::fill(output.begin(), output.end(), std::complex<int8_t> {0, 0});
+            reorder_complex_timesteps(complexInput, 0, split, obsInfo, nIntegrationSteps, output.data(), level, streaming, mapping);
+            reorder_complex_timesteps(complexInput + split * nInputs * obsInfo.nFrequencies, split, obsInfo.nTimesteps - split,
+                obsInfo, nIntegrationSteps, output.data(), level, streaming, mapping);
+            if(output != expectedReordered){
+                std::stringstream ss;
+                ss << "'test_input_mapping' failed: wrong reordering with " << simd_level_name(level)
+                    << (streaming ? " and non-temporal stores." : ".");
+                throw TestFailed(ss.str());
+            }
+        }
+    }
+    std::cout << "'test_input_mapping' passed." << std::endl;
+}
+
+
+
+void test_dropped_inputs(){
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 37;
+    obsInfo.nFrequencies = 3;
+    obsInfo.nTimesteps = 250;
+    const unsigned int nIntegrationSteps {40};
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+    // Drop both inputs of a few antennas, including the first and the last one, and keep the others in reverse order.
+    std::vector<int> mapping(nInputs, -1);
+    size_t nKept {0};
+    for(size_t j {nInputs}; j-- > 0;){
+        const size_t antenna {j / 2};
+        if(antenna != 0 && antenna != 5 && antenna != 6 && antenna != 36) mapping[j] = static_cast<int>(nKept++);
+    }
+    if(kept_inputs(mapping, nInputs) != nKept || kept_inputs({}, nInputs) != nInputs)
+        throw TestFailed("'test_dropped_inputs' failed: wrong number of kept inputs.");
+    if(!is_input_selection(mapping, nInputs) || is_input_permutation(mapping, nInputs))
+        throw TestFailed("'test_dropped_inputs' failed: wrong selection check.");
+    auto duplicated = mapping;
+    duplicated[2] = duplicated[3];
+    if(is_input_selection(duplicated, nInputs)) throw TestFailed("'test_dropped_inputs' failed: duplicated rows accepted.");
+
+    auto packed = random_bytes(obsInfo.nTimesteps * nInputs * obsInfo.nFrequencies);
+    std::vector<std::complex<int8_t>> expanded(nIntervals * nInputs * obsInfo.nFrequencies * nIntegrationSteps);
+    expand_dat_timesteps(packed.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, ChannelMask {}, expanded.data());
+    std::vector<std::complex<int8_t>> expected(nIntervals * nKept * obsInfo.nFrequencies * nIntegrationSteps);
+    for(size_t block {0}; block < nIntervals * obsInfo.nFrequencies; block++)
+        for(size_t j {0}; j < nInputs; j++)
+            if(mapping[j] >= 0)
+                std::copy_n(expanded.begin() + (block * nInputs + j) * nIntegrationSteps, nIntegrationSteps,
+                    expected.begin() + (block * nKept + mapping[j]) * nIntegrationSteps);
+
+    VoltageStatistics reference;
+    for(auto level : levels_to_test()){
+        std::vector<std::complex<int8_t>> output(expected.size());
+        VoltageStatistics statistics {obsInfo.nFrequencies, static_cast<unsigned int>(nKept)};
+        const size_t split {47};
+        expand_dat_timesteps(packed.data(), 0, split, obsInfo, nIntegrationSteps, ChannelMask {}, output.data(), level,
+            mapping, &statistics);
+        expand_dat_timesteps(packed.data() + split * nInputs * obsInfo.nFrequencies, split, obsInfo.nTimesteps - split,
+            obsInfo, nIntegrationSteps, ChannelMask {}, output.data(), level, mapping, &statistics);
+        if(output != expected){
+            std::stringstream ss;
+            ss << "'test_dropped_inputs' failed: wrong expansion with " << simd_level_name(level) << ".";
+            throw TestFailed(ss.str());
+        }
+        if(reference.empty()){
+            reference = statistics;
+        }else if(statistics.power != reference.power || statistics.histogram != reference.histogram){
+            std::stringstream ss;
+            ss << "'test_dropped_inputs' failed: wrong statistics with " << simd_level_name(level) << ".";
+            throw TestFailed(ss.str());
+        }
+    }
+    // Statistics of the kept inputs are those of the corresponding inputs of the full expansion.
+    VoltageStatistics full {obsInfo.nFrequencies, static_cast<unsigned int>(nInputs)};
+    expand_dat_timesteps(packed.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, ChannelMask {}, expanded.data(),
+        SimdLevel::SCALAR, {}, &full);
+    for(size_t j {0}; j < nInputs; j++){
+        if(mapping[j] < 0) continue;
+        for(int value {-8}; value < 8; value++)
+            if(full.count(j, true, value) != reference.count(mapping[j], true, value))
+                throw TestFailed("'test_dropped_inputs' failed: statistics of a kept input differ.");
+    }
+    std::cout << "'test_dropped_inputs' passed." << std::endl;
+}
+
+
+
+void test_pack_dat_timesteps(){
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 37;
+    obsInfo.nFrequencies = 3;
+    obsInfo.nTimesteps = 250;
+    const unsigned int nIntegrationSteps {40};
+    const size_t nInputs {static_cast<size_t>(obsInfo.nAntennas) * obsInfo.nPolarizations};
+    const size_t bytesPerTimestep {nInputs * obsInfo.nFrequencies};
+    const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+    const size_t nSamples {nIntervals * nIntegrationSteps * bytesPerTimestep};
+    std::vector<int> mapping(nInputs);
+    for(size_t j {0}; j < nInputs; j++) mapping[j] = static_cast<int>(j);
+    std::shuffle(mapping.begin(), mapping.end(), std::mt19937 {7});
+    auto packed = random_bytes(obsInfo.nTimesteps * bytesPerTimestep);
+
+    // Packing undoes the expansion, with and without input mapping.
+    for(bool mapped : {false, true}){
+        const std::vector<int> inputMapping {mapped ? mapping : std::vector<int> {}};
+        std::vector<std::complex<int8_t>> expanded(nSamples);
+        expand_dat_timesteps(packed.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, ChannelMask {}, expanded.data(),
+            detect_simd_level(), inputMapping);
+        for(auto level : levels_to_test()){
+            std::vector<uint8_t> output(packed.size());
+            const size_t split {47};
+            pack_dat_timesteps(expanded.data(), 0, split, obsInfo, nIntegrationSteps, output.data(), level, inputMapping);
+            pack_dat_timesteps(expanded.data(), split, obsInfo.nTimesteps - split, obsInfo, nIntegrationSteps,
+                output.data() + split * bytesPerTimestep, level, inputMapping);
+            if(output != packed){
+                std::stringstream ss;
+                ss << "'test_pack_dat_timesteps' failed: packing is not the inverse of the expansion with "
+                    << simd_level_name(level) << (mapped ? " and input mapping." : ".");
+                throw TestFailed(ss.str());
+            }
+        }
+    }
+
+    // Values out of the 4-bit range saturate.
+    auto wide = random_bytes(nSamples * 2);
+    const std::complex<int8_t> *voltages {reinterpret_cast<const std::complex<int8_t>*>(wide.data())};
+    std::vector<uint8_t> expected(packed.size());
+    for(size_t t {0}; t < obsInfo.nTimesteps; t++){
+        for(size_t ch {0}; ch < obsInfo.nFrequencies; ch++){
+            for(size_t j {0}; j < nInputs; j++){
+                const std::complex<int8_t> v {voltages[(t / nIntegrationSteps) * nIntegrationSteps * bytesPerTimestep
+                    + (ch * nInputs + j) * nIntegrationSteps + t % nIntegrationSteps]};
+                const int re {std::max(-8, std::min(7, static_cast<int>(v.real())))};
+                const int im {std::max(-8, std::min(7, static_cast<int>(v.imag())))};
+                expected[t * bytesPerTimestep + ch * nInputs + j] = static_cast<uint8_t>((re & 0xF) | ((im & 0xF) << 4));
+            }
+        }
+    }
+    for(auto level : levels_to_test()){
+        std::vector<uint8_t> output(packed.size());
+        pack_dat_timesteps(voltages, 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, output.data(), level);
+        if(output != expected){
+            std::stringstream ss;
+            ss << "'test_pack_dat_timesteps' failed: wrong saturation with " << simd_level_name(level) << ".";
+            throw TestFailed(ss.str());
+        }
+    }
+    std::cout << "'test_pack_dat_timesteps' passed." << std::endl;
+}
+
+
+
+int main(void){
+    try{
+        test_expand_4bit_samples();
+        test_expand_dat_timesteps();
+        test_expand_dat_timesteps_channels();
+        test_expand_dat_timesteps_flagged();
+        test_reorder_complex_timesteps();
+        test_input_mapping();
+        test_dropped_inputs();
+        test_pack_dat_timesteps();
+    } catch (TestFailed ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
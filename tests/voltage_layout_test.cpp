@@ -0,0 +1,128 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <complex>
+#include <cstring>
+#include "common.hpp"
+#include "../src/voltage_layout.hpp"
+
+
+namespace {
+    // Expand `input` in two calls, the second one starting in the middle of an integration interval,
+    // and check every sample against the .dat file order.
+    template <typename Layout>
+    void check_layout(const std::string& name, const Layout& layout){
+        const auto& dims = layout.dims;
+        const size_t nInputs {layout.n_inputs()};
+        auto input = random_bytes(dims.nTimesteps * dims.n_channels() * nInputs);
+        std::vector<std::complex<int8_t>> output(layout.size());
+        const size_t split {dims.nTimesteps / 3};
+        expand_dat_timesteps(input.data(), 0, split, layout, output.data());
+        expand_dat_timesteps(input.data() + split * dims.n_channels() * nInputs, split, dims.nTimesteps - split, layout, output.data());
+        size_t idx {0};
+        for(size_t t {0}; t < dims.nTimesteps; t++)
+            for(size_t ch {0}; ch < dims.n_channels(); ch++)
+                for(size_t a {0}; a < dims.n_antennas(); a++)
+                    for(size_t p {0}; p < dims.n_polarizations(); p++){
+                        if(output[layout.offset(t, ch, a, p)] != expand_4bit_sample(input[idx++])){
+                            std::stringstream ss;
+                            ss << "check_layout: wrong sample with layout " << name << " at t = " << t << ", ch = " << ch
+                                << ", antenna = " << a << ", pol = " << p << ".";
+                            throw TestFailed(ss.str());
+                        }
+                    }
+    }
+}
+
+
+
+void test_expand_4bit_sample(){
+    for(unsigned int b {0}; b < 256; b++){
+        const int re {static_cast<int>(b & 0xF) >= 8 ? static_cast<int>(b & 0xF) - 16 : static_cast<int>(b & 0xF)};
+        const int im {static_cast<int>(b >> 4) >= 8 ? static_cast<int>(b >> 4) - 16 : static_cast<int>(b >> 4)};
+        const auto sample = expand_4bit_sample(static_cast<uint8_t>(b));
+        if(sample.real() != re || sample.imag() != im) throw TestFailed("test_expand_4bit_sample: wrong expansion.");
+    }
+    std::cout << "'test_expand_4bit_sample' passed." << std::endl;
+}
+
+
+
+void test_dynamic_layouts(){
+    // Odd shapes, with a partial last integration interval.
+    const DynamicDims dims {3, 21, 2, 30, 250};
+    check_layout("correlator", CorrelatorLayout<DynamicDims> {dims});
+    check_layout("beamformer", BeamformerLayout<DynamicDims> {dims});
+    check_layout("raw", RawLayout<DynamicDims> {dims});
+    std::cout << "'test_dynamic_layouts' passed." << std::endl;
+}
+
+
+
+void test_fixed_layouts(){
+    const VcsDims dims {8, 20};
+    check_layout("correlator (VCS)", CorrelatorLayout<VcsDims> {dims});
+    check_layout("beamformer (VCS)", BeamformerLayout<VcsDims> {dims});
+    check_layout("raw (VCS)", RawLayout<VcsDims> {dims});
+    ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+    obsInfo.nAntennas = 64;
+    bool thrown {false};
+    try{
+        VcsDims::from_observation(obsInfo, 100);
+    }catch(std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("test_fixed_layouts: mismatching observation was accepted.");
+    std::cout << "'test_fixed_layouts' passed." << std::endl;
+}
+
+
+
+void test_from_dat_file_unsupported_options(){
+    // Options are checked before the file is opened.
+    const std::string filename {"missing.dat"};
+    const auto rejected = [&](const DatReadOptions& options){
+        try{
+            LayoutVoltages<RawLayout<DynamicDims>>::from_dat_file(filename, VCS_OBSERVATION_INFO, 100, options);
+        }catch(std::invalid_argument&){
+            return true;
+        }
+        return false;
+    };
+    DatReadOptions flaggedChannels;
+    flaggedChannels.flaggedChannels = ChannelMask::edges(VCS_OBSERVATION_INFO.nFrequencies, 2);
+    if(!rejected(flaggedChannels)) throw TestFailed("test_from_dat_file_unsupported_options: flagged channels were silently ignored.");
+    DatReadOptions inputMapping;
+    for(unsigned int j {0}; j < VCS_OBSERVATION_INFO.nAntennas * VCS_OBSERVATION_INFO.nPolarizations; j++) inputMapping.inputMapping.push_back(j);
+    if(!rejected(inputMapping)) throw TestFailed("test_from_dat_file_unsupported_options: the input mapping was silently ignored.");
+    DatReadOptions flaggedAntennas;
+    flaggedAntennas.flaggedAntennas.assign(VCS_OBSERVATION_INFO.nAntennas, false);
+    flaggedAntennas.flaggedAntennas[3] = true;
+    if(!rejected(flaggedAntennas)) throw TestFailed("test_from_dat_file_unsupported_options: flagged antennas were silently ignored.");
+    bool thrown {false};
+    try{
+        LayoutVoltages<CorrelatorLayout<DynamicDims>>::from_dat_file(filename, VCS_OBSERVATION_INFO, 0);
+    }catch(std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("test_from_dat_file_unsupported_options: zero integration steps were accepted.");
+    std::cout << "'test_from_dat_file_unsupported_options' passed." << std::endl;
+}
+
+
+
+int main(void){
+    try{
+        test_expand_4bit_sample();
+        test_dynamic_layouts();
+        test_fixed_layouts();
+        test_from_dat_file_unsupported_options();
+    } catch (TestFailed ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <complex>
+#include <algorithm>
+#include <string>
+#include "common.hpp"
+#include "../src/voltage_expansion.hpp"
+#include "../src/voltage_statistics.hpp"
+
+
+namespace {
+    ObservationInfo small_observation(){
+        ObservationInfo obsInfo {VCS_OBSERVATION_INFO};
+        obsInfo.nAntennas = 21;
+        obsInfo.nFrequencies = 5;
+        obsInfo.nTimesteps = 250;
+        return obsInfo;
+    }
+
+
+    // Statistics computed from the expanded voltages, one sample at a time.
+    VoltageStatistics reference_statistics(const std::vector<std::complex<int8_t>>& voltages, const ObservationInfo& obsInfo,
+            unsigned int nIntegrationSteps, const ChannelMask& flaggedChannels){
+        const unsigned int nInputs {obsInfo.nAntennas * obsInfo.nPolarizations};
+        VoltageStatistics stats {obsInfo.nFrequencies, nInputs};
+        for(size_t t {0}; t < obsInfo.nTimesteps; t++){
+            for(unsigned int ch {0}; ch < obsInfo.nFrequencies; ch++){
+                if(flaggedChannels.flagged(ch)) continue;
+                for(unsigned int j {0}; j < nInputs; j++){
+                    const std::complex<int8_t> v {voltages[(((t / nIntegrationSteps) * obsInfo.nFrequencies + ch) * nInputs + j)
+                        * nIntegrationSteps + t % nIntegrationSteps]};
+                    stats.power[ch * nInputs + j] += v.real() * v.real() + v.imag() * v.imag();
+                    stats.histogram[(j * 2) * VoltageStatistics::N_BINS + v.real() + 8]++;
+                    stats.histogram[(j * 2 + 1) * VoltageStatistics::N_BINS + v.imag() + 8]++;
+                }
+                stats.nTimesteps[ch]++;
+            }
+        }
+        return stats;
+    }
+
+
+    bool same_counters(const VoltageStatistics& a, const VoltageStatistics& b){
+        return a.nTimesteps == b.nTimesteps && a.power == b.power && a.histogram == b.histogram;
+    }
+}
+
+
+
+void test_fused_statistics(){
+    const ObservationInfo obsInfo {small_observation()};
+    const unsigned int nIntegrationSteps {30};
+    const unsigned int nInputs {obsInfo.nAntennas * obsInfo.nPolarizations};
+    const size_t bytesPerTimestep {static_cast<size_t>(nInputs) * obsInfo.nFrequencies};
+    const size_t nIntervals {(obsInfo.nTimesteps + nIntegrationSteps - 1) / nIntegrationSteps};
+    auto input = random_bytes(obsInfo.nTimesteps * bytesPerTimestep);
+    ChannelMask flagged {obsInfo.nFrequencies};
+    flagged.flag(3);
+    std::vector<int> mapping(nInputs);
+    for(unsigned int j {0}; j < nInputs; j++) mapping[j] = static_cast<int>(nInputs - 1 - j);
+
+    for(bool mapped : {false, true}){
+        const std::vector<int> inputMapping {mapped ? mapping : std::vector<int> {}};
+        std::vector<std::complex<int8_t>> voltages(nIntervals * nIntegrationSteps * bytesPerTimestep);
+        VoltageStatistics stats {obsInfo.nFrequencies, nInputs};
+        // Statistics of two calls starting in different integration intervals.
+        const size_t split {47};
+        expand_dat_timesteps(input.data(), 0, split, obsInfo, nIntegrationSteps, flagged, voltages.data(),
+            detect_simd_level(), inputMapping, &stats);
+        expand_dat_timesteps(input.data() + split * bytesPerTimestep, split, obsInfo.nTimesteps - split, obsInfo, nIntegrationSteps,
+            flagged, voltages.data(), detect_simd_level(), inputMapping, &stats);
+        if(!same_counters(stats, reference_statistics(voltages, obsInfo, nIntegrationSteps, flagged)))
+            throw TestFailed("test_fused_statistics: statistics differ from the ones of the expanded voltages.");
+    }
+
+    // Statistics of a channel selection are indexed as the output.
+    const std::vector<unsigned int> channels {4, 1};
+    VoltageStatistics selected {static_cast<unsigned int>(channels.size()), nInputs};
+    std::vector<std::complex<int8_t>> voltages(nIntervals * nIntegrationSteps * nInputs * channels.size());
+    expand_dat_timesteps(input.data(), 0, obsInfo.nTimesteps, obsInfo, nIntegrationSteps, channels, ChannelMask {}, voltages.data(),
+        detect_simd_level(), std::vector<int> {}, &selected);
+    ObservationInfo selectedInfo {obsInfo};
+    selectedInfo.nFrequencies = channels.size();
+    if(!same_counters(selected, reference_statistics(voltages, selectedInfo, nIntegrationSteps, ChannelMask {})))
+        throw TestFailed("test_fused_statistics: wrong statistics of a channel selection.");
+    std::cout << "'test_fused_statistics' passed." << std::endl;
+}
+
+
+
+void test_statistics_levels(){
+    // Enough inputs for full vectors of every level plus a scalar tail, and enough timesteps to
+    // overflow the 8-bit working counters.
+    const unsigned int nInputs {2 * 64 + 32 + 5};
+    const size_t nSteps {600};
+    auto input = random_bytes(nSteps * nInputs);
+    std::vector<int> rows(nInputs);
+    for(unsigned int j {0}; j < nInputs; j++) rows[j] = static_cast<int>((j * 7) % nInputs);
+
+    VoltageStatistics expected {2, nInputs};
+    for(size_t s {0}; s < nSteps; s++){
+        for(unsigned int j {0}; j < nInputs; j++){
+            const uint8_t sample {input[s * nInputs + j]};
+            const int re {static_cast<int8_t>(sample << 4) >> 4}, im {static_cast<int8_t>(sample) >> 4};
+            expected.power[nInputs + rows[j]] += re * re + im * im;
+            expected.histogram[(rows[j] * 2) * VoltageStatistics::N_BINS + re + 8]++;
+            expected.histogram[(rows[j] * 2 + 1) * VoltageStatistics::N_BINS + im + 8]++;
+        }
+    }
+    expected.nTimesteps[1] = nSteps;
+
+    for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}){
+        VoltageStatistics stats {2, nInputs};
+        // Uneven tiles, such that flushes happen in the middle of one.
+        for(size_t s {0}; s < nSteps; s += 100)
+            stats.accumulate_dat_tile(input.data() + s * nInputs, nInputs, 100, nInputs, 1, rows.data(), level);
+        stats.flush(rows.data());
+        if(!same_counters(stats, expected))
+            throw TestFailed("test_statistics_levels: wrong statistics at level " + std::to_string(static_cast<int>(level)) + ".");
+    }
+    std::cout << "'test_statistics_levels' passed." << std::endl;
+}
+
+
+
+void test_statistics_summary(){
+    VoltageStatistics stats {2, 3};
+    // Input 1 only sees the packed sample 0x87, i.e. (7, -8), in channel 0.
+    const uint8_t tile[3] {0x00, 0x87, 0x11};
+    stats.accumulate_dat_tile(tile, 3, 1, 3, 0, nullptr, SimdLevel::SCALAR);
+    stats.accumulate_dat_tile(tile, 3, 1, 3, 0, nullptr, SimdLevel::SCALAR);
+    stats.flush(nullptr);
+    if(stats.mean_power(0, 1) != 113.0 || stats.mean_power(0, 2) != 2.0 || stats.mean_power(1, 1) != 0.0)
+        throw TestFailed("test_statistics_summary: wrong mean power.");
+    if(stats.channel_mean_power(0) != 115.0 / 3 || stats.input_mean_power(1) != 113.0)
+        throw TestFailed("test_statistics_summary: wrong aggregated mean power.");
+    if(stats.count(1, false, 7) != 2 || stats.count(1, true, -8) != 2 || stats.count(0, false, 0) != 2)
+        throw TestFailed("test_statistics_summary: wrong histogram.");
+    if(stats.saturated(1) != 4 || stats.saturated(0) != 0 || stats.saturated(2) != 0)
+        throw TestFailed("test_statistics_summary: wrong saturation count.");
+
+    VoltageStatistics other {2, 3};
+    other.accumulate_dat_tile(tile, 3, 1, 3, 1, nullptr, SimdLevel::SCALAR);
+    other.flush(nullptr);
+    stats.merge(other);
+    if(stats.nTimesteps[1] != 1 || stats.mean_power(1, 1) != 113.0 || stats.saturated(1) != 6)
+        throw TestFailed("test_statistics_summary: wrong merged statistics.");
+    bool thrown {false};
+    try{
+        stats.merge(VoltageStatistics {1, 3});
+    }catch(const std::invalid_argument&){
+        thrown = true;
+    }
+    if(!thrown) throw TestFailed("test_statistics_summary: statistics of different shapes were merged.");
+    std::cout << "'test_statistics_summary' passed." << std::endl;
+}
+
+
+
+int main(void){
+    try{
+        test_fused_statistics();
+        test_statistics_levels();
+        test_statistics_summary();
+    } catch (TestFailed ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}